@@ -0,0 +1,40 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Subsystems that each allocation made by Bulb is attributed to.
+enum bulb_alloc_tag
+{
+    BULB_ALLOC_GENERAL,
+    BULB_ALLOC_NETWORKING,      // Sockets, socket managers and send/recv queues.
+    BULB_ALLOC_OBJECTS,         // Bulb objects being read or written.
+    BULB_ALLOC_TRIE,            // Dictionaries, such as the command tables.
+    BULB_ALLOC_BANLIST,         // Bulb's banlist database.
+    BULB_ALLOC_ROSTER,          // Client nodes and their userinfo objects.
+    BULB_ALLOC_HISTORY,         // Recent messages and users seen by a server.
+
+    BULB_ALLOC_TAG_COUNT
+};
+
+// A custom allocator that all of Bulb's memory is requested from. This can be used
+// to plug in e.g. jemalloc, mimalloc or an arena allocator. malloc_func must return
+// memory aligned for any object type, or NULL on failure.
+struct bulb_allocator
+{
+    void* (*malloc_func)(size_t size, void* user_data);
+    void (*free_func)(void* ptr, void* user_data);
+    void* user_data;
+};
+
+// Allocation statistics for a given subsystem.
+struct bulb_alloc_stats
+{
+    uint64_t live_bytes;        // Bytes currently allocated.
+    uint64_t live_allocs;       // Allocations currently alive.
+    uint64_t total_bytes;       // Bytes allocated since the process started.
+    uint64_t total_allocs;      // Allocations made since the process started.
+};
@@ -8,31 +8,44 @@
 
 #define MAX_BANLIST_REASON_LENGTH   1024
 
-// Read from a banlist database text file into memory. This will create a new
-// database if the file is not present. Returns false on failure.
+// Read the banlist database from its memory-mapped file and journal, and start its
+// persistence thread. If no database file exists, any banlist text file is imported.
+// Returns false on failure.
 BULB_API bool server_banlist_load(struct bulb_server* server);
 
-// Add a new IP address to the banlist database. Returns false if the address
-// is already present, or on failure.
+// Add a new IP address or CIDR range (e.g. 10.0.0.0/8) to the banlist database. 
+// Returns false if the address is already present, or on failure.
 BULB_API bool server_banlist_addip(struct bulb_server* server, 
                                    const char* ip_addr, 
                                    const char* reason,
                                    bool* already_banned);
 
-// Remove an IP address from the banlist database. Returns false if the address
-// was not already present, or on failure.
+// Remove an IP address or CIDR range from the banlist database. Returns false if
+// the address was not already present, or on failure.
 BULB_API bool server_banlist_removeip(struct bulb_server* server, 
                                       const char* ip_addr, 
                                       bool* already_banned);
 
-// Check if an IP address is already included in the banlist database.
+// Check if an IP address, or every address of a CIDR range, is included in the
+// banlist database. reason remains valid until the calling thread next checks the
+// banlist.
 BULB_API bool server_banlist_isbanned(struct bulb_server* server, 
                                       const char* ip_addr, 
                                       const char** reason);
 
-// Store the banlist database text file onto permanent storage. Returns false
-// on failure.
+// Queue every ban of a banlist text file to be added to the banlist database. Each
+// line holds an address or CIDR range, optionally followed by a ban reason. Returns
+// false on failure.
+BULB_API bool server_banlist_import(struct bulb_server* server, const char* path);
+
+// Queue every ban in the banlist database to be written to a banlist text file.
+// Returns false on failure.
+BULB_API bool server_banlist_export(struct bulb_server* server, const char* path);
+
+// Request that the banlist database's journal is compacted into its file on
+// permanent storage. Returns false on failure.
 BULB_API bool server_banlist_store(struct bulb_server* server);
 
-// De-allocate the loaded banlist database from memory.
+// Write any outstanding changes to the loaded banlist database, and de-allocate it
+// from memory.
 BULB_API void server_banlist_close(struct bulb_server* server);
\ No newline at end of file
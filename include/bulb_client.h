@@ -7,6 +7,7 @@
 
 #include "bulb_macros.h"
 #include "bulb_structs.h"
+#include "bulb_alloc.h"
 
 struct bulb_client;
 struct client_node;
@@ -22,7 +23,13 @@ enum client_error_state
     CLIENT_CONNECTED,
     CLIENT_PRINT_STDOUT,        // data is bulb_stdout*
     CLIENT_RECEIVED_MESSAGE,    // data is bulb_message*
+    CLIENT_RECEIVED_DIRECT,     // data is bulb_message*
+    CLIENT_DIRECT_RESULT,       // data is bulb_direct_result*
     CLIENT_STATUS_CMD,          // data is bulb_userinfo* (first instance is server, rest are clients)
+    CLIENT_STREAM_OPENED,       // data is bulb_stream*
+    CLIENT_STREAM_DATA,         // data is bulb_stream*
+    CLIENT_STREAM_CLOSED,       // data is bulb_stream*
+    CLIENT_ROOM_CHANGED,        // data is const char* (name of the room now joined)
 
     // Client disconnect that results in the client thread being ended.
     CLIENT_DISCONNECT, 
@@ -56,6 +63,15 @@ struct bulb_client
     struct server_node* server_node;
 };
 
+// Install a custom allocator for the client library. This must be called before
+// any client instance is created. Passing NULL restores the system allocator.
+// Returns false if the client library has already allocated memory.
+BULB_API bool client_set_allocator(const struct bulb_allocator* allocator);
+
+// Get the allocation statistics of one of the client library's subsystems. Returns
+// false if the tag is invalid.
+BULB_API bool client_get_alloc_stats(enum bulb_alloc_tag tag, struct bulb_alloc_stats* stats);
+
 // Create a new client instance. Returns NULL on error.
 BULB_API struct bulb_client* client_init(const char* host, 
                                          const char* port, 
@@ -102,5 +118,31 @@ BULB_API bool client_disconnecting(struct bulb_client* client);
 // Process client input. Returns true if a command was detected, otherwise false.
 BULB_API bool client_input(struct bulb_client* client, const char* msg, bool* cmd_success);
 
+// Send a message to a single client by name, in whichever room it is. Its outcome is
+// reported through CLIENT_DIRECT_RESULT, with the ID optionally written to id. Returns 
+// false if the message could not be sent.
+BULB_API bool client_direct_message(struct bulb_client* client, 
+                                    const char* name, 
+                                    const char* msg, 
+                                    uint32_t* id);
+
+// Stream a payload of any size to every other member of the room, in chunks interleaved 
+// with other traffic. size is only informative and can be 0 if unknown. The source is 
+// read from as the server grants credit, and its close_func is called once the stream 
+// ends. Returns false, without calling close_func, if the stream could not be opened.
+BULB_API bool client_stream_send(struct bulb_client* client, 
+                                 const char* title, 
+                                 uint64_t size, 
+                                 const struct bulb_stream_source* source);
+
+// Move the client into a room, creating the room if it does not exist yet. NULL or an
+// empty name returns the client to the lobby. The move is reported through 
+// CLIENT_ROOM_CHANGED. Returns false if the room name is invalid.
+BULB_API bool client_join_room(struct bulb_client* client, const char* name);
+
+// Get the name of the room the client is in. Returns an empty string until the
+// client has been validated by the server.
+BULB_API const char* client_get_room(struct bulb_client* client);
+
 // Free a client instance.
 BULB_API void client_free(struct bulb_client* client);
\ No newline at end of file
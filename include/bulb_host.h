@@ -0,0 +1,44 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// A host runs many virtual servers in one process, which share one listen thread, one
+// client management thread and one set of socket manager instances, rather than each
+// server starting threads of its own. Each virtual server is otherwise a server like
+// any other, with its own clients, rooms, banlist database and userinfo.
+//
+// Connections are routed to a virtual server by the port that they connect to, or by
+// the server_name attribute of the userinfo that each client authenticates with. A
+// client naming another virtual server of the same host is moved to that server before
+// it is validated, so that many virtual servers can be reached through a single port.
+// Virtual servers created without a port of their own can only be reached by name.
+//
+// The banlist database files of each named virtual server are prefixed with its name,
+// e.g. "lobby.banlist.bin".
+
+#pragma once
+
+#include <stdint.h>
+
+#include "bulb_macros.h"
+#include "bulb_server.h"
+
+struct bulb_host;
+
+// Create a new host, and start its listen thread and client management thread.
+// Returns NULL on error.
+BULB_API struct bulb_host* host_init();
+
+// Create a new virtual server on a host, which is otherwise used like any server
+// created by server_init(). If port is 0, the virtual server can only be reached by
+// name through the ports of the host's other virtual servers. error_state can be NULL.
+// Returns NULL on error.
+BULB_API struct bulb_server* host_server_init(struct bulb_host* host,
+                                              uint16_t port,
+                                              enum server_error_state* error_state);
+
+// Get the number of virtual servers on a host.
+BULB_API unsigned host_num_servers(struct bulb_host* host);
+
+// Stop a host's threads and free it. Any virtual servers that have not yet been freed
+// with server_free() are freed first.
+BULB_API void host_free(struct bulb_host* host);
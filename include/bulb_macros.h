@@ -10,6 +10,10 @@
 #define MAX_NAME_LENGTH     32
 #define MAX_DESC_LENGTH     512
 #define MAX_MESSAGE_LENGTH  2048
+#define MAX_STREAM_TITLE_LENGTH 64
+#define MAX_ROOM_NAME_LENGTH 32
+#define MAX_LINK_KEY_LENGTH 64
+#define MAX_MUX_KEY_LENGTH  64
 #define MAX_ERROR_LENGTH    128 // Only used internally.
 
 #define IPV4_ADDRESS_STRLEN 16  // xxx.xxx.xxx.xxx\0
@@ -36,5 +40,6 @@ enum stdout_type
     // All of these messages are associated with the server disconnecting the client.
     STDOUT_KICK_MSG,
     STDOUT_BAN_MSG,
-    STDOUT_SERVER_SHUTDOWN
+    STDOUT_SERVER_SHUTDOWN,
+    STDOUT_SERVER_BUSY
 };
\ No newline at end of file
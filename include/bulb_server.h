@@ -4,12 +4,15 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <threads.h>
 
 #include "bulb_macros.h"
 #include "bulb_structs.h"
+#include "bulb_alloc.h"
 
 struct bulb_server;
+struct bulb_host;
 struct server_node;
 
 // Unless specified, data in the exception handler function is NULL by default.
@@ -29,7 +32,8 @@ enum server_error_state
     // default to the Bulb banlist database implementation.
     SERVER_BAN_CLIENT,          // data is bulb_ban*, may update is_banned if address already banned
     SERVER_UNBAN_CLIENT,        // data is bulb_ban*, may update is_banned if address was banned
-    SERVER_IS_CLIENT_BANNED,    // data is bulb_ban*, may update reason and is_banned
+    SERVER_IS_CLIENT_BANNED,    // data is bulb_ban*, may update reason and is_banned (also thrown
+                                // by the listen thread for every accepted connection)
     SERVER_BANLIST_SAVE,
 
     // Server exit that results in the server thread being ended.
@@ -40,6 +44,7 @@ enum server_error_state
     SERVER_ADDRESS_FAIL,
     SERVER_LISTEN_SOCKET_FAIL,
     SERVER_BANLIST_INIT_FAIL,
+    SERVER_HANDOFF_FAIL,        // Raised by server_resume() only.
 };
 
 // Return false to hint critical fault to the server.
@@ -48,6 +53,39 @@ typedef bool (*server_exception_func)(struct bulb_server* server,
                                       bool fatal, 
                                       void* data);
 
+// Connection statistics of a server instance.
+struct bulb_server_stats
+{
+    uint64_t accepted_connections;      // Connections admitted by the listen thread.
+    uint64_t rejected_connections;      // Connections from banned addresses, closed upon accept.
+    uint64_t limited_connections;       // Connections exceeding per-address limits, closed upon accept.
+
+    // Send queue statistics. Queue depths are sampled across every connected client.
+    uint64_t dropped_objects;           // Objects not queued for congested clients.
+    uint64_t conflated_objects;         // Presence updates merged into one already queued.
+    uint64_t congestion_disconnects;    // Clients disconnected for staying congested.
+    uint64_t queued_bytes;              // Bytes currently queued for sending.
+    uint64_t queued_objects;            // Objects currently queued for sending.
+    uint64_t max_client_queued_bytes;   // Most bytes currently queued for any one client.
+    uint64_t congested_clients;         // Clients whose send queue is currently congested.
+    uint64_t spilled_bytes;             // Bytes currently spilled to disk.
+    bool over_budget;                   // Whether the send queues exceed the server's memory budget.
+
+    // Overload statistics, sampled from the client management thread.
+    uint64_t processing_lag_ms;         // Time the longest waiting ready socket has waited.
+    uint64_t ready_sockets;             // Sockets waiting to be processed.
+    uint64_t parked_connections;        // New connections held back in the admission queue.
+    uint64_t busy_connections;          // New connections refused while the server was overloaded.
+
+    // Federation statistics, see server_link().
+    uint64_t linked_servers;            // Servers directly linked to this server.
+    uint64_t remote_clients;            // Clients connected to other servers in the network.
+
+    // Multiplexing statistics, see bulb_userinfo's mux_key.
+    uint64_t mux_proxies;               // Proxy connections carrying client sessions.
+    uint64_t mux_sessions;              // Client sessions carried by proxy connections.
+};
+
 struct bulb_server
 {
     thrd_t listen_thread;
@@ -61,8 +99,34 @@ struct bulb_server
     server_exception_func exception_handler;
 
     struct server_node* server_node;
+
+    // The host that this server shares its I/O threads with, or NULL. See bulb_host.h.
+    struct bulb_host* host;
+
+    // Set while the server is being handed over to another process, see server_hand_off().
+    bool handing_off;
+
+    // State handed over by another process, which is restored once the server starts
+    // listening, see server_resume().
+    void* handoff;
+
+    // Monotonic time in milliseconds at which the server's next snapshot is due. Snapshots
+    // keep recent messages and users seen across restarts, see warm_start.
+    int64_t next_snapshot_ms;
 };
 
+// Install a custom allocator for the server library. This must be called before
+// any server instance is created. Passing NULL restores the system allocator.
+// Returns false if the server library has already allocated memory.
+BULB_API bool server_set_allocator(const struct bulb_allocator* allocator);
+
+// Get the allocation statistics of one of the server library's subsystems. Returns
+// false if the tag is invalid.
+BULB_API bool server_get_alloc_stats(enum bulb_alloc_tag tag, struct bulb_alloc_stats* stats);
+
+// Get the connection statistics of a server instance. Returns false on failure.
+BULB_API bool server_get_stats(struct bulb_server* server, struct bulb_server_stats* stats);
+
 // Create a new server instance. error_state can be NULL. Returns NULL on error.
 BULB_API struct bulb_server* server_init(uint16_t port, enum server_error_state* error_state);
 
@@ -78,6 +142,14 @@ BULB_API void server_throw_critical_error(struct bulb_server* server,
                                           enum server_error_state error, 
                                           void* data);
 
+// Create a new server instance that takes over from a server being handed off by
+// another process, see server_hand_off(). This waits for the other process to connect
+// to a Unix domain socket created at path. The server is then configured as usual, and
+// resumes serving every client handed over once server_listen() is called, without the
+// clients noticing. Hot restarts are only supported on POSIX systems. error_state can be
+// NULL. Returns NULL on error.
+BULB_API struct bulb_server* server_resume(const char* path, enum server_error_state* error_state);
+
 // Set a custom exception handler.
 BULB_API void server_set_exception_handler(struct bulb_server* server, server_exception_func func);
 
@@ -87,6 +159,26 @@ BULB_API void server_set_userinfo(struct bulb_server* server, struct bulb_userin
 // Start accepting new clients asynchronously. Returns false on error.
 BULB_API bool server_listen(struct bulb_server* server);
 
+// Link the server to another server, so that the clients of both see each other as
+// though they were connected to one server. Both servers must share the same link key,
+// and be named uniquely within their network. Returns false if the other server could
+// not be reached. Whether the link was accepted is reported to the server console.
+//
+// Servers whose userinfo has the relay attribute set instead act as edge relays for a
+// core server: they link to that server alone, refuse links from other servers, and
+// fan the core network's traffic out to their own clients. Each message broadcast by
+// the core is then sent once per relay rather than once per client.
+BULB_API bool server_link(struct bulb_server* server, const char* host, uint16_t port);
+
+// Hand the server over to another process waiting in server_resume() at path, such as
+// a newer build of the same program, without disconnecting its clients. The listen
+// socket and the socket of every client are passed to the other process along with the
+// state of each client, after which SERVER_FINISH is raised as with server_shutdown().
+// Links to other servers and proxy connections are closed beforehand, and must be
+// established again by the other process. Virtual servers cannot be handed off. Returns
+// false if the hand-off failed, in which case the server keeps serving its clients.
+BULB_API bool server_hand_off(struct bulb_server* server, const char* path);
+
 // Get the number of connected clients on the server. Returns -1 on failure.
 BULB_API int server_num_connected(struct bulb_server* server);
 
@@ -4,9 +4,41 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "bulb_macros.h"
 
+// Handling of messages sent faster than a server's flood control limits allow.
+enum bulb_flood_policy
+{
+    // Hold messages back until the client's limits allow them, dropping them once too
+    // many are held back.
+    BULB_FLOOD_DELAY = 0,
+
+    // Discard messages.
+    BULB_FLOOD_DROP,
+
+    // Kick the client.
+    BULB_FLOOD_KICK
+};
+
+// Backpressure applied to clients whose send queue is congested. These flags can be
+// combined.
+enum bulb_send_queue_policy
+{
+    // Discard chat messages and presence updates rather than queueing them.
+    BULB_SEND_QUEUE_DROP = 1 << 0,
+
+    // Replace a client's queued presence update with a newer presence update for the
+    // same client, rather than queueing both.
+    BULB_SEND_QUEUE_CONFLATE = 1 << 1,
+
+    // Disconnect clients that stay congested for longer than their send queue timeout,
+    // or whose send queue grows to twice its high-water mark.
+    BULB_SEND_QUEUE_DISCONNECT = 1 << 2
+};
+
 struct bulb_userinfo
 {
     char name[MAX_NAME_LENGTH + 1];
@@ -20,6 +52,9 @@ struct bulb_userinfo
     // Settings applicable to both client or server.
     unsigned timeout_s;                 // Set timeout duration for data to be sent to the other end.
 
+    // Client-only settings.
+    char server_name[MAX_NAME_LENGTH + 1];  // Virtual server to join on a host, see bulb_host.h. Leave empty for the port's own server.
+
     // Server-only settings.
     bool is_server;
     bool ping_clients;
@@ -27,9 +62,38 @@ struct bulb_userinfo
     bool print_ban_message_to_all;      // Print ban message to all clients if banned address connects.
     unsigned server_shutdown_timeout_s; // Time spent waiting for clients to exit on called server exit.
     unsigned max_clients;               // Max client count supported by server. Set to 0 for no limit.
+    unsigned max_connections_per_ip;    // Max open connections from one address. Set to 0 for no limit.
+    unsigned connection_rate_per_ip;    // New connections per minute from one address. Set to 0 for no limit.
+    unsigned connection_burst_per_ip;   // New connections one address can open at once before being rate limited.
+    unsigned messages_per_second;       // Messages per second from each client. Set to 0 for no limit.
+    unsigned message_burst;             // Messages each client can send at once before being throttled.
+    unsigned message_bytes_per_second;  // Message bytes per second from each client. Set to 0 for no limit.
+    unsigned message_bytes_burst;       // Message bytes each client can send at once before being throttled.
+    enum bulb_flood_policy flood_policy;// Handling of messages sent over the limits above.
+    unsigned send_queue_high_bytes;     // Queued bytes at which a client becomes congested. Set to 0 for no limit.
+    unsigned send_queue_low_bytes;      // Queued bytes below which a client is no longer congested.
+    unsigned send_queue_high_objects;   // Queued objects at which a client becomes congested. Set to 0 for no limit.
+    unsigned send_queue_low_objects;    // Queued objects below which a client is no longer congested.
+    unsigned send_queue_policy;         // Combination of bulb_send_queue_policy flags.
+    unsigned send_queue_timeout_s;      // Time a client can stay congested before being disconnected.
+    unsigned send_queue_budget_mb;      // Most memory held in all send queues together. Set to 0 for no limit.
+    bool spill_send_queues;             // Spill lagging clients' send queues to disk above the budget.
+    unsigned overload_lag_ms;           // Processing lag at which new clients are held back. Set to 0 for no limit.
+    unsigned overload_ready_sockets;    // Sockets awaiting processing at which new clients are held back. Set to 0 for no limit.
+    unsigned admission_queue_size;      // New clients held back while overloaded. Set to 0 to refuse them at once.
+    unsigned admission_timeout_s;       // Time a held back client can wait before being refused.
+    char link_key[MAX_LINK_KEY_LENGTH + 1]; // Key shared by linked servers. Leave empty to refuse links.
+    unsigned link_batch_ms;             // Time events are batched for before being sent to linked servers.
+    bool relay;                         // Relay a single core server's network to local clients, see server_link().
+    char mux_key[MAX_MUX_KEY_LENGTH + 1];   // Key shared with bulb_mux proxies. Leave empty to refuse them.
+    unsigned history_size;              // Recent messages shown to clients entering a room. Set to 0 to keep none.
+    bool warm_start;                    // Keep recent messages and users seen across restarts in a snapshot file.
+    unsigned snapshot_interval_s;       // Time between snapshots, which are also saved on shutdown. Set to 0 to only save on shutdown.
 
     // Variables modified by the running server instance.
     unsigned ping_ms;
+    unsigned delayed_messages;          // Messages from this client held back by flood control.
+    unsigned dropped_messages;          // Messages from this client discarded by flood control.
     char ip_addr[IPV4_ADDRESS_STRLEN];
 
     // bulb_userinfo objects can be linked together. This is the mechanism
@@ -53,6 +117,52 @@ struct bulb_message
     bool is_server;
 };
 
+// The outcome of a direct message sent to another client.
+enum bulb_direct_status
+{
+    BULB_DIRECT_DELIVERED = 1,  // The message was routed to the recipient.
+    BULB_DIRECT_NOT_FOUND,      // No client is connected with the recipient's name.
+    BULB_DIRECT_THROTTLED       // The message was discarded by flood control.
+};
+
+struct bulb_direct_result
+{
+    const char* name;           // Name of the recipient.
+    uint32_t id;                // ID returned when the message was sent.
+    enum bulb_direct_status status;
+};
+
+// A stream of data being received from another client.
+struct bulb_stream
+{
+    const char* name;       // Name of the sending client.
+    const char* title;
+    uint64_t size;          // Size announced by the sender, or 0 if unknown.
+    uint64_t transferred;   // Bytes received so far, including data.
+
+    // The chunk of data just received, for CLIENT_STREAM_DATA only.
+    const char* data;
+    size_t len;
+
+    // Whether the stream ended before the sender finished, for CLIENT_STREAM_CLOSED only.
+    bool aborted;
+};
+
+// The source of a stream of data being sent to other clients. Both functions are
+// called from the client's management thread, so they should not block for long.
+struct bulb_stream_source
+{
+    // Read up to len bytes of the payload into buffer. Returns the number of bytes
+    // read, 0 once the whole payload has been read, or -1 on failure.
+    long (*read_func)(void* ctx, char* buffer, size_t len);
+
+    // Called exactly once when the stream ends, whether or not it was sent in full.
+    // Can be NULL.
+    void (*close_func)(void* ctx, bool aborted);
+
+    void* ctx;
+};
+
 struct bulb_ban
 {
     // Information describing who to ban and why.
@@ -76,6 +186,30 @@ static inline void bulb_userinfo_defaults(struct bulb_userinfo* userinfo)
         userinfo->timeout_s = 300;
         userinfo->server_shutdown_timeout_s = 5;
         userinfo->max_clients = 63;
+        userinfo->max_connections_per_ip = 16;
+        userinfo->connection_rate_per_ip = 60;
+        userinfo->connection_burst_per_ip = 16;
+        userinfo->messages_per_second = 5;
+        userinfo->message_burst = 10;
+        userinfo->message_bytes_per_second = 4096;
+        userinfo->message_bytes_burst = 8192;
+        userinfo->flood_policy = BULB_FLOOD_DELAY;
+        userinfo->send_queue_high_bytes = 256 * 1024;
+        userinfo->send_queue_low_bytes = 64 * 1024;
+        userinfo->send_queue_high_objects = 256;
+        userinfo->send_queue_low_objects = 64;
+        userinfo->send_queue_policy = BULB_SEND_QUEUE_DROP | BULB_SEND_QUEUE_CONFLATE 
+            | BULB_SEND_QUEUE_DISCONNECT;
+        userinfo->send_queue_timeout_s = 30;
+        userinfo->send_queue_budget_mb = 256;
+        userinfo->overload_lag_ms = 250;
+        userinfo->overload_ready_sockets = 256;
+        userinfo->admission_queue_size = 64;
+        userinfo->admission_timeout_s = 10;
+        userinfo->link_batch_ms = 20;
+        userinfo->history_size = 32;
+        userinfo->warm_start = false;
+        userinfo->snapshot_interval_s = 60;
     }
     else
     {
@@ -0,0 +1,141 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "util.h"
+#include "alloc.h"
+
+// Prefixed to every accounted allocation so that alloc_free() can attribute the
+// released memory to the correct subsystem.
+struct alloc_header
+{
+    uint32_t tag;
+    uint32_t _reserved;
+    size_t size;
+    max_align_t data[];
+};
+
+struct alloc_counters
+{
+    atomic_int_fast64_t live_bytes;
+    atomic_int_fast64_t live_allocs;
+    atomic_uint_fast64_t total_bytes;
+    atomic_uint_fast64_t total_allocs;
+};
+
+static const char* alloc_tag_names[BULB_ALLOC_TAG_COUNT] = 
+{
+    "general", "networking", "objects", "trie", "banlist", "roster", "history"
+};
+
+static struct bulb_allocator allocator;
+static atomic_bool allocator_used;
+static struct alloc_counters alloc_counters[BULB_ALLOC_TAG_COUNT];
+
+// Install a custom allocator. Passing NULL restores the system allocator. Returns
+// false if any memory has already been allocated through the current allocator.
+bool alloc_set_allocator(const struct bulb_allocator* new_allocator)
+{
+    // Memory must always be released by the allocator that it was requested from,
+    // so the allocator cannot be swapped once it is in use.
+    if (atomic_load(&allocator_used))
+        return false;
+
+    if (new_allocator != NULL)
+    {
+        ASSERT(new_allocator->malloc_func != NULL && new_allocator->free_func != NULL, return false,
+            "A custom allocator must implement both malloc_func and free_func\n");
+        allocator = *new_allocator;
+    }
+    else
+        memset(&allocator, 0, sizeof(allocator));
+    return true;
+}
+
+// Allocate size bytes from the installed allocator without accounting for them.
+// This is intended for allocators layered on top of Bulb's, such as the slab pools.
+void* alloc_raw(size_t size)
+{
+    if (!atomic_load_explicit(&allocator_used, memory_order_relaxed))
+        atomic_store(&allocator_used, true);
+    if (allocator.malloc_func != NULL)
+        return allocator.malloc_func(size, allocator.user_data);
+    return malloc(size);
+}
+
+// Release memory returned by alloc_raw().
+void alloc_raw_free(void* ptr)
+{
+    if (allocator.free_func != NULL)
+        allocator.free_func(ptr, allocator.user_data);
+    else
+        free(ptr);
+}
+
+// Account for an allocation served by a layered allocator.
+void alloc_account(enum bulb_alloc_tag tag, size_t size)
+{
+    struct alloc_counters* counters = &alloc_counters[tag];
+    atomic_fetch_add_explicit(&counters->live_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->live_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->total_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->total_allocs, 1, memory_order_relaxed);
+}
+
+// Account for the release of an allocation served by a layered allocator.
+void alloc_unaccount(enum bulb_alloc_tag tag, size_t size)
+{
+    struct alloc_counters* counters = &alloc_counters[tag];
+    atomic_fetch_sub_explicit(&counters->live_bytes, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&counters->live_allocs, 1, memory_order_relaxed);
+}
+
+// Allocate size bytes attributed to the given subsystem. Returns NULL on failure.
+void* alloc_tagged(size_t size, enum bulb_alloc_tag tag)
+{
+    ASSERT(tag < BULB_ALLOC_TAG_COUNT, return NULL, "Invalid allocation tag %d\n", tag);
+
+    struct alloc_header* header = (struct alloc_header*)alloc_raw(sizeof(struct alloc_header) + size);
+    if (header == NULL)
+        return NULL;
+    header->tag = tag;
+    header->size = size;
+    alloc_account(tag, size);
+    return header->data;
+}
+
+// Release memory returned by alloc_tagged(). ptr can be NULL.
+void alloc_free(void* ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    struct alloc_header* header = (struct alloc_header*)((char*)ptr - offsetof(struct alloc_header, data));
+    alloc_unaccount(header->tag, header->size);
+    alloc_raw_free(header);
+}
+
+// Get the allocation statistics of a subsystem. Returns false if the tag is invalid.
+bool alloc_get_stats(enum bulb_alloc_tag tag, struct bulb_alloc_stats* stats)
+{
+    if (tag >= BULB_ALLOC_TAG_COUNT)
+        return false;
+
+    struct alloc_counters* counters = &alloc_counters[tag];
+    stats->live_bytes = MAX(atomic_load_explicit(&counters->live_bytes, memory_order_relaxed), 0);
+    stats->live_allocs = MAX(atomic_load_explicit(&counters->live_allocs, memory_order_relaxed), 0);
+    stats->total_bytes = atomic_load_explicit(&counters->total_bytes, memory_order_relaxed);
+    stats->total_allocs = atomic_load_explicit(&counters->total_allocs, memory_order_relaxed);
+    return true;
+}
+
+// Get the display name of a subsystem.
+const char* alloc_tag_name(enum bulb_alloc_tag tag)
+{
+    return (tag < BULB_ALLOC_TAG_COUNT) ? alloc_tag_names[tag] : "unknown";
+}
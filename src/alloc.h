@@ -0,0 +1,43 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Every allocation made by Bulb is routed through the functions declared here,
+// so that an embedder can install a custom allocator and so that the memory held
+// by each subsystem can be accounted for at runtime.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bulb_alloc.h"
+
+// Install a custom allocator. Passing NULL restores the system allocator. Returns
+// false if any memory has already been allocated through the current allocator.
+bool alloc_set_allocator(const struct bulb_allocator* allocator);
+
+// Allocate size bytes attributed to the given subsystem. Returns NULL on failure.
+void* alloc_tagged(size_t size, enum bulb_alloc_tag tag);
+
+// Release memory returned by alloc_tagged(). ptr can be NULL.
+void alloc_free(void* ptr);
+
+// Allocate size bytes from the installed allocator without accounting for them.
+// This is intended for allocators layered on top of Bulb's, such as the slab pools.
+void* alloc_raw(size_t size);
+
+// Release memory returned by alloc_raw().
+void alloc_raw_free(void* ptr);
+
+// Account for an allocation served by a layered allocator.
+void alloc_account(enum bulb_alloc_tag tag, size_t size);
+
+// Account for the release of an allocation served by a layered allocator.
+void alloc_unaccount(enum bulb_alloc_tag tag, size_t size);
+
+// Get the allocation statistics of a subsystem. Returns false if the tag is invalid.
+bool alloc_get_stats(enum bulb_alloc_tag tag, struct bulb_alloc_stats* stats);
+
+// Get the display name of a subsystem.
+const char* alloc_tag_name(enum bulb_alloc_tag tag);
@@ -0,0 +1,143 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Compares the memory used per key and the lookup latency of the adaptive radix
+// tree in trie.c against the original character-per-node trie. Usage:
+//   bulb_bench_trie [key count] [lookup count]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "util.h"
+#include "alloc.h"
+#include "trie.h"
+#include "trie_legacy.h"
+
+#define BENCH_MAX_KEY_LENGTH    32
+
+typedef void* (*bench_find_func)(void* trie, const char* key);
+
+// Prevents the compiler from discarding lookups whose results are unused.
+static volatile uintptr_t bench_sink;
+static uint64_t bench_seed = 0x2545F4914F6CDD1DULL;
+
+// Generate a pseudo-random number using xorshift64, so that every platform is
+// benchmarked against the same keys.
+static uint64_t _bench_random()
+{
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 7;
+    bench_seed ^= bench_seed << 17;
+    return bench_seed;
+}
+
+// Generate keys resembling the IPv4 addresses stored in the banlist.
+static void _bench_gen_ipv4(char* key)
+{
+    uint64_t r = _bench_random();
+    snprintf(key, BENCH_MAX_KEY_LENGTH, "%u.%u.%u.%u", (unsigned)(r & 0xFF), (unsigned)((r >> 8) & 0xFF),
+        (unsigned)((r >> 16) & 0xFF), (unsigned)((r >> 24) & 0xFF));
+}
+
+// Generate keys resembling client names.
+static void _bench_gen_name(char* key)
+{
+    unsigned len = 4 + (unsigned)(_bench_random() % 13);
+    for (unsigned i = 0; i < len; i++)
+        key[i] = "abcdefghijklmnopqrstuvwxyz0123456789_"[_bench_random() % 37];
+    key[len] = '\0';
+}
+
+static void* _bench_find(void* trie, const char* key)
+{
+    return trie_find((struct trie*)trie, key);
+}
+
+static void* _bench_legacy_find(void* trie, const char* key)
+{
+    return legacy_trie_find((struct legacy_trie*)trie, key);
+}
+
+// Get the live memory attributed to tries.
+static uint64_t _bench_trie_bytes()
+{
+    struct bulb_alloc_stats stats;
+    alloc_get_stats(BULB_ALLOC_TRIE, &stats);
+    return stats.live_bytes;
+}
+
+// Time lookup_count lookups cycling through keys. Returns the mean latency in ns.
+static double _bench_lookups(void* trie, bench_find_func find, char (*keys)[BENCH_MAX_KEY_LENGTH],
+    unsigned key_count, unsigned lookup_count)
+{
+    struct timespec start, end;
+    timespec_get(&start, TIME_UTC);
+    for (unsigned i = 0; i < lookup_count; i++)
+        bench_sink += (uintptr_t)find(trie, keys[i % key_count]);
+    timespec_get(&end, TIME_UTC);
+    return (double)timespec_diff(&end, &start, 9) / lookup_count;
+}
+
+// Benchmark both trie implementations against a set of keys.
+static void _bench_run(const char* name, void (*gen)(char*), unsigned key_count, unsigned lookup_count)
+{
+    char (*keys)[BENCH_MAX_KEY_LENGTH] = malloc(sizeof(*keys) * key_count);
+    char (*misses)[BENCH_MAX_KEY_LENGTH] = malloc(sizeof(*misses) * key_count);
+
+    // Both tries are filled with the same unique keys. Each missing key is a stored
+    // key with an extra character, which must be walked to its end.
+    struct trie* trie = trie_new();
+    struct legacy_trie* legacy = legacy_trie_new();
+    unsigned count = 0;
+    uint64_t base_bytes = _bench_trie_bytes();
+    while (count < key_count)
+    {
+        gen(keys[count]);
+        if (trie_add(trie, keys[count], keys[count]) != NULL)
+            count++;
+    }
+    uint64_t trie_bytes = _bench_trie_bytes() - base_bytes;
+    for (unsigned i = 0; i < count; i++)
+        legacy_trie_add(legacy, keys[i], keys[i]);
+    uint64_t legacy_bytes = _bench_trie_bytes() - base_bytes - trie_bytes;
+    for (unsigned i = 0; i < count; i++)
+        snprintf(misses[i], BENCH_MAX_KEY_LENGTH, "%s~", keys[(i * 7919u) % count]);
+
+    // Lookups are made in a different order to insertion to defeat any locality
+    // between neighbouring keys.
+    for (unsigned i = count - 1; i > 0; i--)
+    {
+        unsigned j = (unsigned)(_bench_random() % (i + 1));
+        char temp[BENCH_MAX_KEY_LENGTH];
+        memcpy(temp, keys[i], BENCH_MAX_KEY_LENGTH);
+        memcpy(keys[i], keys[j], BENCH_MAX_KEY_LENGTH);
+        memcpy(keys[j], temp, BENCH_MAX_KEY_LENGTH);
+    }
+
+    printf("%-8s %-8s %10u %12.1f %12.1f %12.1f\n", name, "art", count, (double)trie_bytes / count,
+        _bench_lookups(trie, _bench_find, keys, count, lookup_count),
+        _bench_lookups(trie, _bench_find, misses, count, lookup_count));
+    printf("%-8s %-8s %10u %12.1f %12.1f %12.1f\n", name, "legacy", count, (double)legacy_bytes / count,
+        _bench_lookups(legacy, _bench_legacy_find, keys, count, lookup_count),
+        _bench_lookups(legacy, _bench_legacy_find, misses, count, lookup_count));
+
+    trie_free(trie);
+    legacy_trie_free(legacy);
+    free(keys);
+    free(misses);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned key_count = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 10) : 100000;
+    unsigned lookup_count = (argc > 2) ? (unsigned)strtoul(argv[2], NULL, 10) : 2000000;
+    ASSERT(key_count > 0 && lookup_count > 0, return 1, "Key and lookup counts must be positive\n");
+
+    printf("%-8s %-8s %10s %12s %12s %12s\n", "keys", "trie", "count", "bytes/key", "hit ns", "miss ns");
+    _bench_run("ipv4", _bench_gen_ipv4, key_count, lookup_count);
+    _bench_run("names", _bench_gen_name, key_count, lookup_count);
+    return 0;
+}
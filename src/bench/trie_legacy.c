@@ -0,0 +1,164 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// The original character-per-node trie that trie.c replaced, kept only so that its
+// memory usage and lookup latency can be compared against in trie_bench.c.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "trie_legacy.h"
+#include "util.h"
+
+// Internal function for searching for a trie node.
+static struct legacy_trie* _legacy_trie_find(struct legacy_trie* trie, const char* key)
+{
+    ASSERT(trie, return NULL);
+
+    int len = strlen(key);
+    if (len == 0)
+        return NULL;
+
+    struct legacy_trie* child = trie->children;
+    for (int i = 0; i < len; i++)
+    {
+        while (child)
+        {
+            if (child->prefix == key[i])
+            {
+                if (i + 1 == len)
+                    return child;
+                else
+                {
+                    child = child->children;
+                    break;
+                }
+            }
+            else
+                child = child->next;
+        }
+    }
+
+    return (child && child->value != NULL) ? child : NULL;
+}
+
+// Create a new trie.
+struct legacy_trie* legacy_trie_new()
+{
+    return (struct legacy_trie*)quick_malloc(sizeof(struct legacy_trie), BULB_ALLOC_TRIE);
+}
+
+// Add a new entry to the trie. Returns NULL if the key already exists, or on 
+// failure.
+struct legacy_trie* legacy_trie_add(struct legacy_trie* trie, const char* key, void* value)
+{
+    ASSERT(trie, return NULL);
+
+    int len = strlen(key);
+    ASSERT(len > 0, return NULL);
+
+    struct legacy_trie* parent = trie;
+    struct legacy_trie* child = parent->children;
+    for (int i = 0; i < len; i++)
+    {
+        if (child != NULL)
+        {
+            for (;;)
+            {
+                if (child->prefix == key[i])
+                    goto next_index;
+                else if (child->next != NULL)
+                    child = child->next;
+                else
+                    break;
+            }
+            child->next = legacy_trie_new();
+            child->next->prev = child;
+            child = child->next;
+        }
+        else
+            child = parent->children = legacy_trie_new();
+        child->prefix = key[i];
+        child->parent = parent;
+
+next_index:
+        parent = child;
+        child = child->children;
+    }
+
+    if (parent->value != NULL)
+        return NULL;
+    parent->value = value;
+    return parent;
+}
+
+// Add a new entry to the trie by copying its value instead of referencing it. 
+// Returns NULL if the key already exists, or on failure.
+struct legacy_trie* legacy_trie_add_copy(struct legacy_trie* trie, const char* key, void* value, size_t size)
+{
+    ASSERT(trie, return NULL);
+    ASSERT(strlen(key) > 0, return NULL);
+
+    void* new_value = quick_malloc(size, BULB_ALLOC_TRIE);
+    memcpy(new_value, value, size);
+
+    struct legacy_trie* node = legacy_trie_add(trie, key, new_value);
+    if (node == NULL)
+        return NULL;
+
+    node->value_copied = true;
+    return node;
+}
+
+// Search for an entry in the trie. Returns NULL if the key is not found,
+// or on failure.
+void* legacy_trie_find(struct legacy_trie* trie, const char* key)
+{
+    struct legacy_trie* node = _legacy_trie_find(trie, key);
+    return node ? node->value : NULL;
+}
+
+// Delete an entry in the trie. Returns false if the key is not found,
+// or on failure.
+bool legacy_trie_delete(struct legacy_trie* trie, const char* key)
+{
+    struct legacy_trie* node = _legacy_trie_find(trie, key);
+    if (node == NULL)
+        return false;
+
+    if (node->value_copied)
+        quick_free(node->value);
+    node->value = NULL;
+    
+    // Iteratively walk through the node's chain of parents to cleanup any
+    // unused nodes.
+    while (node != NULL && node->parent != NULL && node->value == NULL && node->children == NULL)
+    {
+        struct legacy_trie* parent = node->parent;
+
+        if (node->next != NULL)
+            node->next->prev = node->prev;
+        
+        if (node->prev != NULL)
+            node->prev->next = node->next;
+        else
+            parent->children = node->next;
+
+        quick_free(node);
+        node = parent;
+    }
+    
+    return true;
+}
+
+// Delete a trie.
+void legacy_trie_free(struct legacy_trie* trie)
+{
+    if (trie->next)
+        legacy_trie_free(trie->next);
+    if (trie->children)
+        legacy_trie_free(trie->children);
+    if (trie->value_copied)
+        quick_free(trie->value);
+    quick_free(trie);
+}
\ No newline at end of file
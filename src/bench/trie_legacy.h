@@ -0,0 +1,42 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct legacy_trie
+{
+    char prefix;
+    void* value;
+    bool value_copied;
+    struct legacy_trie* parent;
+    struct legacy_trie* children;
+
+    // Used for linking children together in a doubly-linked list.
+    struct legacy_trie* next;
+    struct legacy_trie* prev;
+};
+
+// Create a new trie.
+struct legacy_trie* legacy_trie_new();
+
+// Add a new entry to the trie. Returns NULL if the key already exists, or on 
+// failure.
+struct legacy_trie* legacy_trie_add(struct legacy_trie* trie, const char* key, void* value);
+
+// Add a new entry to the trie by copying its value instead of referencing it. 
+// Returns NULL if the key already exists, or on failure.
+struct legacy_trie* legacy_trie_add_copy(struct legacy_trie* trie, const char* key, void* value, size_t size);
+
+// Search for an entry in the trie. Returns NULL if the value is not found,
+// or on failure.
+void* legacy_trie_find(struct legacy_trie* trie, const char* key);
+
+// Delete an entry in the trie. Returns false if the key is not found,
+// or on failure.
+bool legacy_trie_delete(struct legacy_trie* trie, const char* key);
+
+// Delete a trie.
+void legacy_trie_free(struct legacy_trie* trie);
@@ -55,6 +55,32 @@ static bool _client_exception_handler(struct bulb_client* client,
             print_message(buffer, STDOUT_GENERIC);
             return true;
         }
+        case CLIENT_RECEIVED_DIRECT:
+        {
+            // <SEQ>NAME (direct)<SEQ>: MSG\n\0
+            char buffer[COLOR_LENGTH + MAX_NAME_LENGTH + 9 + COLOR_LENGTH + 2 + MAX_MESSAGE_LENGTH + 2];
+            struct bulb_message* msg = (struct bulb_message*)data;
+            snprintf(buffer, sizeof(buffer), "%s%s (direct)%s: %s\n", 
+                COLOR_GREEN, 
+                msg->name, 
+                COLOR_DEFAULT,
+                msg->message);
+            print_message(buffer, STDOUT_GENERIC);
+            return true;
+        }
+        case CLIENT_DIRECT_RESULT:
+        {
+            // Only undelivered messages are reported.
+            char buffer[128 + MAX_NAME_LENGTH];
+            struct bulb_direct_result* result = (struct bulb_direct_result*)data;
+            if (result->status == BULB_DIRECT_DELIVERED)
+                return true;
+            snprintf(buffer, sizeof(buffer), "Your message to \"%s\" was not delivered: %s\n", result->name,
+                (result->status == BULB_DIRECT_NOT_FOUND ? "no such client is connected." 
+                                                         : "you are sending messages too quickly."));
+            print_message(buffer, STDOUT_GENERIC);
+            return true;
+        }
         case CLIENT_PRINT_STDOUT:
         {
             struct bulb_stdout* obj = (struct bulb_stdout*)data;
@@ -62,6 +88,33 @@ static bool _client_exception_handler(struct bulb_client* client,
             return true;
         }
 
+        // Streams are only reported, as the CLI does not store their payloads.
+        case CLIENT_STREAM_OPENED:
+        case CLIENT_STREAM_CLOSED:
+        {
+            char buffer[128 + MAX_NAME_LENGTH + MAX_STREAM_TITLE_LENGTH];
+            struct bulb_stream* stream = (struct bulb_stream*)data;
+            if (error == CLIENT_STREAM_OPENED)
+                snprintf(buffer, sizeof(buffer), "\"%s\" is streaming \"%s\" (%llu bytes)\n", 
+                    stream->name, stream->title, (unsigned long long)stream->size);
+            else
+                snprintf(buffer, sizeof(buffer), "%s \"%s\" from \"%s\" (%llu bytes)\n", 
+                    (stream->aborted ? "Aborted receiving" : "Received"), stream->title, stream->name, 
+                    (unsigned long long)stream->transferred);
+            print_message(buffer, STDOUT_GENERIC);
+            return true;
+        }
+        case CLIENT_STREAM_DATA:
+            return true;
+
+        case CLIENT_ROOM_CHANGED:
+        {
+            char buffer[64 + MAX_ROOM_NAME_LENGTH];
+            snprintf(buffer, sizeof(buffer), "You are now in room \"%s\"\n", (const char*)data);
+            print_message(buffer, STDOUT_GENERIC);
+            return true;
+        }
+
         // Evaluate the status command.
         case CLIENT_STATUS_CMD:
             evaluate_status_cmd((struct bulb_userinfo*)data);
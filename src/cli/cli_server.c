@@ -81,12 +81,18 @@ static bool _cli_server_exception_handler(struct bulb_server* server,
     }
 }
 
-struct bulb_server* cli_server_init(uint16_t custom_port)
+struct bulb_server* cli_server_init(uint16_t custom_port, const char* resume_path)
 {
     struct bulb_server* server;
 
     uint16_t port = custom_port;
-    if (custom_port == BULB_USE_DEFAULT_PORT)
+    if (resume_path != NULL)
+    {
+        // The server handed over keeps its own listen socket, and thus its port.
+        printf("Waiting for a server to be handed over at %s...\n", resume_path);
+        server = server_resume(resume_path, NULL);
+    }
+    else if (custom_port == BULB_USE_DEFAULT_PORT)
     {
         enum server_error_state error_state;
         port = BULB_FIRST_PORT;
@@ -107,7 +113,10 @@ struct bulb_server* cli_server_init(uint16_t custom_port)
     ASSERT(server_listen(server), return NULL);
 
     // Disable stdin line buffering at this point.
-    printf("Listening on port %hu\n", port);
+    if (resume_path != NULL)
+        printf("Resumed the server handed over at %s\n", resume_path);
+    else
+        printf("Listening on port %hu\n", port);
     enable_console_io_functions();
     return server;
 }
@@ -3,6 +3,6 @@
 
 #include "bulb_server.h"
 
-struct bulb_server* cli_server_init(uint16_t custom_port);
+struct bulb_server* cli_server_init(uint16_t custom_port, const char* resume_path);
 
 void cli_server_cleanup(struct bulb_server* server);
\ No newline at end of file
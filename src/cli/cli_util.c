@@ -53,7 +53,7 @@ void print_message(const char* message, enum stdout_type msg_type)
         return;
 
     // Disable this function for future uses if the client was kicked from the server.
-    if (msg_type == STDOUT_KICK_MSG || msg_type == STDOUT_BAN_MSG || msg_type == STDOUT_SERVER_SHUTDOWN)
+    if (msg_type >= STDOUT_KICK_MSG)
     {
         server_exit = true;
         waiting_for_input = false;
@@ -78,7 +78,7 @@ void print_message(const char* message, enum stdout_type msg_type)
     }
 
     // Always print the message first, which should already be terminated with a newline.
-    bool print_red = (msg_type == STDOUT_KICK_MSG || msg_type == STDOUT_SERVER_SHUTDOWN);
+    bool print_red = (msg_type >= STDOUT_KICK_MSG && msg_type != STDOUT_BAN_MSG);
     printf("%s%s%s", (print_red ? COLOR_RED "\n" : ""), message, COLOR_DEFAULT);
 
     // If we had to do some console cleanup beforehand, print the current 
@@ -120,6 +120,8 @@ void evaluate_status_cmd(struct bulb_userinfo* info)
         if (userinfo.is_server)
             printf(" (%s)", info->ip_addr);
         printf("\n   - desc \"%s\"\n   - ping %ums\n", info->description, info->ping_ms);
+        if (userinfo.is_server && (info->delayed_messages > 0 || info->dropped_messages > 0))
+            printf("   - throttled %u delayed, %u dropped\n", info->delayed_messages, info->dropped_messages);
     }
 
     mtx_unlock(&print_message_lock);
@@ -47,6 +47,9 @@
 
 static const char* custom_host = NULL;
 static uint16_t port = BULB_USE_DEFAULT_PORT;
+static char link_host[256];
+static uint16_t link_port = BULB_FIRST_PORT;
+static const char* resume_path = NULL;
 
 struct cli_cmd;
 
@@ -71,34 +74,54 @@ static void _cli_add_cmd(const char* name, const char* desc, cli_cmd_func func,
     max_cmd_len = MAX(max_cmd_len, strlen(name) + ((arg_name != NULL) ? (strlen(arg_name) + 1) : 0));
 }
 
+static void _cli_print_cmd(struct cli_cmd* cmd)
+{
+    // -o            description
+    // --option      description
+    // --option arg  description
+    printf(" %s", cmd->name);
+    if (cmd->arg_name != NULL)
+        printf(" %s", cmd->arg_name);
+    printf("%*c %s\n", 
+        (int)(max_cmd_len 
+            - strlen(cmd->name) 
+            - ((cmd->arg_name != NULL) ? (strlen(cmd->arg_name) + 1) : 0) 
+            + 1), 
+        ' ', 
+        cmd->desc);
+}
+
 static bool _cli_cmd_help(struct cli_cmd* cmd, const char* argument)
 {
     printf("[BULB CLI] ");
     bulb_printver();
     printf("usage: bulb [option] ... [--server [server_option] ...]\n\noptions:\n");
     
+    // Commands are listed in key order, so each group of mode-specific commands must
+    // be listed separately.
     TRIE_DFS(cli_cmds, node, 
     {
-        // Separate into separate categories for different groups of commands.
         struct cli_cmd* cmd = (struct cli_cmd*)node;
-        if (strcmp(cmd->name, "--server") == 0)
+        if (strncmp(cmd->name, "--server", 8) != 0 && strncmp(cmd->name, "--client", 8) != 0)
+            _cli_print_cmd(cmd);
+    });
+
+    bool printed_header = false;
+    TRIE_PREFIX_DFS(cli_cmds, "--server", node,
+    {
+        if (!printed_header)
             printf("\nserver mode:\n");
-        else if (strncmp(cmd->name, "--client", 8) == 0)
-            printf("\nclient mode:\n");
+        printed_header = true;
+        _cli_print_cmd((struct cli_cmd*)node);
+    });
 
-        // -o            description
-        // --option      description
-        // --option arg  description
-        printf(" %s", cmd->name);
-        if (cmd->arg_name != NULL)
-            printf(" %s", cmd->arg_name);
-        printf("%*c %s\n", 
-            (int)(max_cmd_len 
-                - strlen(cmd->name) 
-                - ((cmd->arg_name != NULL) ? (strlen(cmd->arg_name) + 1) : 0) 
-                + 1), 
-            ' ', 
-            cmd->desc);
+    printed_header = false;
+    TRIE_PREFIX_DFS(cli_cmds, "--client", node,
+    {
+        if (!printed_header)
+            printf("\nclient mode:\n");
+        printed_header = true;
+        _cli_print_cmd((struct cli_cmd*)node);
     });
     
     return false;
@@ -134,6 +157,14 @@ static bool _cli_cmd_host(struct cli_cmd* cmd, const char* argument)
     return true;
 }
 
+static bool _cli_cmd_join(struct cli_cmd* cmd, const char* argument)
+{
+    if (strlen(argument) > MAX_NAME_LENGTH)
+        CLI_PRINT_CMD_ERROR("Server name is too long");
+    strncpy(userinfo.server_name, argument, MAX_NAME_LENGTH);
+    return true;
+}
+
 static bool _cli_cmd_disable_input(struct cli_cmd* cmd, const char* argument)
 {
     echo_input = false;
@@ -161,6 +192,246 @@ static bool _cli_cmd_server_max_clients(struct cli_cmd* cmd, const char* argumen
     return true;
 }
 
+static bool _cli_cmd_server_max_connections_per_ip(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.max_connections_per_ip, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_connection_rate_per_ip(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.connection_rate_per_ip, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_connection_burst_per_ip(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.connection_burst_per_ip, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_message_rate(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.messages_per_second, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_message_burst(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.message_burst, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_message_byte_rate(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.message_bytes_per_second, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_message_byte_burst(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.message_bytes_burst, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_flood_policy(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    if (strcmp(argument, "delay") == 0)
+        userinfo.flood_policy = BULB_FLOOD_DELAY;
+    else if (strcmp(argument, "drop") == 0)
+        userinfo.flood_policy = BULB_FLOOD_DROP;
+    else if (strcmp(argument, "kick") == 0)
+        userinfo.flood_policy = BULB_FLOOD_KICK;
+    else
+        CLI_PRINT_CMD_ERROR("Expected delay, drop or kick");
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_high_bytes(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.send_queue_high_bytes, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_low_bytes(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.send_queue_low_bytes, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_high_objects(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.send_queue_high_objects, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_low_objects(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.send_queue_low_objects, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_timeout(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.send_queue_timeout_s, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_policy(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+
+    // The policy is given as a comma-separated list of flags.
+    char buffer[64];
+    strncpy(buffer, argument, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    userinfo.send_queue_policy = 0;
+    for (char* flag = strtok(buffer, ","); flag != NULL; flag = strtok(NULL, ","))
+    {
+        if (strcmp(flag, "drop") == 0)
+            userinfo.send_queue_policy |= BULB_SEND_QUEUE_DROP;
+        else if (strcmp(flag, "conflate") == 0)
+            userinfo.send_queue_policy |= BULB_SEND_QUEUE_CONFLATE;
+        else if (strcmp(flag, "disconnect") == 0)
+            userinfo.send_queue_policy |= BULB_SEND_QUEUE_DISCONNECT;
+        else if (strcmp(flag, "none") != 0)
+            CLI_PRINT_CMD_ERROR("Expected drop, conflate, disconnect or none");
+    }
+    return true;
+}
+
+static bool _cli_cmd_server_send_queue_budget(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.send_queue_budget_mb, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_spill_send_queues(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    userinfo.spill_send_queues = true;
+    return true;
+}
+
+static bool _cli_cmd_server_overload_lag(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.overload_lag_ms, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_overload_ready_sockets(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.overload_ready_sockets, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_admission_queue(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.admission_queue_size, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_admission_timeout(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.admission_timeout_s, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_link_key(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    if (strlen(argument) > MAX_LINK_KEY_LENGTH)
+        CLI_PRINT_CMD_ERROR("Link key is too long");
+    strncpy(userinfo.link_key, argument, MAX_LINK_KEY_LENGTH);
+    return true;
+}
+
+static bool _cli_cmd_server_link_batch(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.link_batch_ms, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_relay(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    userinfo.relay = true;
+    return true;
+}
+
+static bool _cli_cmd_server_mux_key(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    if (strlen(argument) > MAX_MUX_KEY_LENGTH)
+        CLI_PRINT_CMD_ERROR("Mux key is too long");
+    strncpy(userinfo.mux_key, argument, MAX_MUX_KEY_LENGTH);
+    return true;
+}
+
+static bool _cli_cmd_server_link(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    if (strlen(argument) >= sizeof(link_host))
+        CLI_PRINT_CMD_ERROR("Host address is too long");
+    strcpy(link_host, argument);
+
+    // The port may follow the host address, separated by a colon.
+    char* separator = strrchr(link_host, ':');
+    if (separator != NULL)
+    {
+        *separator = '\0';
+        CLI_CONVERT_ARG_TO_INT(link_port, separator + 1);
+    }
+    return true;
+}
+
+static bool _cli_cmd_server_history_size(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.history_size, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_warm_start(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    userinfo.warm_start = true;
+    return true;
+}
+
+static bool _cli_cmd_server_snapshot_interval(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    CLI_CONVERT_ARG_TO_INT(userinfo.snapshot_interval_s, argument);
+    return true;
+}
+
+static bool _cli_cmd_server_resume(struct cli_cmd* cmd, const char* argument)
+{
+    CLI_SERVER_ONLY();
+    resume_path = argument;
+    return true;
+}
+
 CREATE_CONSOLE_EXIT_FUNCTION(_cli_exit,
 {
     mtx_lock(&print_message_lock);
@@ -187,6 +458,8 @@ int main(int argc, char** argv)
     _cli_add_cmd("-t", "set timeout (default: 300s on server, 30s on client)", _cli_cmd_timeout, 
         "duration");
     _cli_add_cmd("--host", "connect to specific host address", _cli_cmd_host, "address");
+    _cli_add_cmd("--join", "join a named server on a host of many servers (default: the port's own server)",
+        _cli_cmd_join, "name");
     _cli_add_cmd("--disable-echo-input", "do not display input while typing (default: echoing on)",
         _cli_cmd_disable_input, NULL);
     _cli_add_cmd("--server", "launch Bulb CLI in server mode (default: client mode)", _cli_cmd_server, 
@@ -195,6 +468,93 @@ int main(int argc, char** argv)
         _cli_cmd_server_shutdown_timeout, "duration");
     _cli_add_cmd("--server_max_clients", "set max clients (default: 63, set to 0 for no limit)",
         _cli_cmd_server_max_clients, "count");
+    _cli_add_cmd("--server_max_connections_per_ip", 
+        "set max open connections from one address (default: 16, set to 0 for no limit)",
+        _cli_cmd_server_max_connections_per_ip, "count");
+    _cli_add_cmd("--server_connection_rate_per_ip", 
+        "set new connections per minute from one address (default: 60, set to 0 for no limit)",
+        _cli_cmd_server_connection_rate_per_ip, "count");
+    _cli_add_cmd("--server_connection_burst_per_ip", 
+        "set new connections one address can open at once (default: 16)",
+        _cli_cmd_server_connection_burst_per_ip, "count");
+    _cli_add_cmd("--server_message_rate", 
+        "set messages per second from each client (default: 5, set to 0 for no limit)",
+        _cli_cmd_server_message_rate, "count");
+    _cli_add_cmd("--server_message_burst", 
+        "set messages each client can send at once (default: 10)",
+        _cli_cmd_server_message_burst, "count");
+    _cli_add_cmd("--server_message_byte_rate", 
+        "set message bytes per second from each client (default: 4096, set to 0 for no limit)",
+        _cli_cmd_server_message_byte_rate, "bytes");
+    _cli_add_cmd("--server_message_byte_burst", 
+        "set message bytes each client can send at once (default: 8192)",
+        _cli_cmd_server_message_byte_burst, "bytes");
+    _cli_add_cmd("--server_flood_policy", 
+        "set handling of messages over the limits: delay, drop or kick (default: delay)",
+        _cli_cmd_server_flood_policy, "policy");
+    _cli_add_cmd("--server_send_queue_high_bytes", 
+        "set queued bytes at which a client is congested (default: 262144, set to 0 for no limit)",
+        _cli_cmd_server_send_queue_high_bytes, "bytes");
+    _cli_add_cmd("--server_send_queue_low_bytes", 
+        "set queued bytes below which a client is no longer congested (default: 65536)",
+        _cli_cmd_server_send_queue_low_bytes, "bytes");
+    _cli_add_cmd("--server_send_queue_high_objects", 
+        "set queued objects at which a client is congested (default: 256, set to 0 for no limit)",
+        _cli_cmd_server_send_queue_high_objects, "count");
+    _cli_add_cmd("--server_send_queue_low_objects", 
+        "set queued objects below which a client is no longer congested (default: 64)",
+        _cli_cmd_server_send_queue_low_objects, "count");
+    _cli_add_cmd("--server_send_queue_policy", 
+        "set handling of congested clients: any of drop,conflate,disconnect or none (default: all)",
+        _cli_cmd_server_send_queue_policy, "policy");
+    _cli_add_cmd("--server_send_queue_timeout", 
+        "set time a client can stay congested before being disconnected (default: 30s)",
+        _cli_cmd_server_send_queue_timeout, "duration");
+    _cli_add_cmd("--server_send_queue_budget", 
+        "set most memory held in all send queues, in MiB (default: 256, set to 0 for no limit)",
+        _cli_cmd_server_send_queue_budget, "size");
+    _cli_add_cmd("--server_spill_send_queues", 
+        "spill lagging clients' send queues to disk above the budget (default: off)",
+        _cli_cmd_server_spill_send_queues, NULL);
+    _cli_add_cmd("--server_overload_lag", 
+        "set processing lag at which new clients are held back, in ms (default: 250, set to 0 for no limit)",
+        _cli_cmd_server_overload_lag, "duration");
+    _cli_add_cmd("--server_overload_ready_sockets", 
+        "set sockets awaiting processing at which new clients are held back (default: 256, set to 0 for no limit)",
+        _cli_cmd_server_overload_ready_sockets, "count");
+    _cli_add_cmd("--server_admission_queue", 
+        "set new clients held back while overloaded (default: 64, set to 0 to refuse them at once)",
+        _cli_cmd_server_admission_queue, "count");
+    _cli_add_cmd("--server_admission_timeout", 
+        "set time a held back client can wait before being refused (default: 10s)",
+        _cli_cmd_server_admission_timeout, "duration");
+    _cli_add_cmd("--server_link_key", 
+        "set key shared by linked servers, which must each be named with -n (default: links refused)",
+        _cli_cmd_server_link_key, "key");
+    _cli_add_cmd("--server_link_batch", 
+        "set time events are batched for before being sent to linked servers, in ms (default: 20)",
+        _cli_cmd_server_link_batch, "duration");
+    _cli_add_cmd("--server_link", 
+        "link to another server on start-up (default port: 32765)",
+        _cli_cmd_server_link, "host[:port]");
+    _cli_add_cmd("--server_relay", 
+        "relay the network of the server given with --server_link to local clients (default: off)",
+        _cli_cmd_server_relay, NULL);
+    _cli_add_cmd("--server_mux_key", 
+        "set key shared with bulb_mux proxies, which carry many clients per connection (default: proxies refused)",
+        _cli_cmd_server_mux_key, "key");
+    _cli_add_cmd("--server_history_size", 
+        "set recent messages shown to clients entering a room (default: 32, set to 0 to keep none)",
+        _cli_cmd_server_history_size, "count");
+    _cli_add_cmd("--server_warm_start", 
+        "keep recent messages and users seen across restarts in a snapshot file (default: off)",
+        _cli_cmd_server_warm_start, NULL);
+    _cli_add_cmd("--server_snapshot_interval", 
+        "set time between snapshots with --server_warm_start (default: 60s, set to 0 to only save on exit)",
+        _cli_cmd_server_snapshot_interval, "duration");
+    _cli_add_cmd("--server_resume", 
+        "take over a server handed off with the handoff command at path, keeping its clients connected",
+        _cli_cmd_server_resume, "path");
 
     // Parse any given command line parameters.
     struct cli_cmd* identified_cmd = NULL;
@@ -240,7 +600,13 @@ int main(int argc, char** argv)
         // Running as a server.
         printf("[SERVER] ");
         bulb_printver();
-        ASSERT(server = cli_server_init(port), goto fail);
+        ASSERT(server = cli_server_init(port, resume_path), goto fail);
+        if (link_host[0] != '\0' && !server_link(server, link_host, link_port))
+        {
+            char buffer[sizeof(link_host) + 64];
+            snprintf(buffer, sizeof(buffer), "Could not link to server at %s:%hu\n", link_host, link_port);
+            print_message(buffer, STDOUT_GENERIC);
+        }
 
         // This is done after calling cli_server_init() so that the server name displayed
         // when using the status command is not "[SERVER]".
@@ -10,19 +10,41 @@
 #include "bulb_version.h"
 #include "bulb_client.h"
 #include "cmds.h"
+#include "pool.h"
+#include "alloc.h"
 #include "userinfo_obj.h"
 #include "message_obj.h"
+#include "stream_obj.h"
+#include "room_obj.h"
+#include "direct_obj.h"
+#include "rooms.h"
 
 #ifdef WIN32
     static WSADATA wsa_data;
 #endif
 
+// Install a custom allocator for the client library. This must be called before
+// any client instance is created. Passing NULL restores the system allocator.
+// Returns false if the client library has already allocated memory.
+bool client_set_allocator(const struct bulb_allocator* allocator)
+{
+    return alloc_set_allocator(allocator);
+}
+
+// Get the allocation statistics of one of the client library's subsystems. Returns
+// false if the tag is invalid.
+bool client_get_alloc_stats(enum bulb_alloc_tag tag, struct bulb_alloc_stats* stats)
+{
+    ASSERT(stats, return false);
+    return alloc_get_stats(tag, stats);
+}
+
 // Create a new client instance. Returns NULL on error.
 struct bulb_client* client_init(const char* host, 
                                 const char* port, 
                                 enum client_error_state* error_state)
 {
-    struct bulb_client* client = quick_malloc(sizeof(struct bulb_client));
+    struct bulb_client* client = quick_malloc(sizeof(struct bulb_client), BULB_ALLOC_GENERAL);
 
     // If Winsock is being used, Winsock must be initialized beforehand.
     int result = 0;
@@ -48,7 +70,7 @@ struct bulb_client* client_init(const char* host,
     }
 
     // Set up the local client node and instantiate its socket for server communication.
-    client->local_node = localclient = quick_malloc(sizeof(struct client_node));
+    client->local_node = localclient = quick_malloc(sizeof(struct client_node), BULB_ALLOC_ROSTER);
     client->local_node->bulb_client = client;
     client_shared_node_init(client->local_node);
     SOCKET sock = socket(client->addr_ptr->ai_family, client->addr_ptr->ai_socktype,
@@ -61,19 +83,20 @@ struct bulb_client* client_init(const char* host,
     
     client->local_node->mt_sock = mt_socket_new(sock);
     client->local_node->mt_sock->dealloc_func = client_set_ready_to_delete_from_sock;
-    client->server_node = client->local_node->server_node = server_shared_node_alloc();
+    client->server_node = client->local_node->server_node = server_shared_node_alloc(NULL);
 
     bulb_cmds_init();
+    bulb_register_client_cmds();
     return client;
 
 fail:
     if (error_state != NULL)
         *error_state = client->error_state;
     if (client->local_node != NULL)
-        free(client->local_node);
+        quick_free(client->local_node);
     if (client->addr_ptr != NULL)
         freeaddrinfo(client->addr_ptr);
-    free(client);
+    quick_free(client);
     return NULL;
 }
 
@@ -163,7 +186,7 @@ bool client_authenticate(struct bulb_client* client, struct bulb_userinfo* useri
         return false; 
     }
 
-    client->local_node->userinfo = quick_malloc(sizeof(struct userinfo_obj));
+    client->local_node->userinfo = pool_alloc(sizeof(struct userinfo_obj), BULB_ALLOC_ROSTER);
     memcpy(client->local_node->userinfo, &obj, sizeof(struct userinfo_obj));
 
     return true;
@@ -227,6 +250,70 @@ bool client_input(struct bulb_client* client, const char* msg, bool* cmd_success
     return false;
 }
 
+// Send a message to a single client by name, in whichever room it is. Its outcome is
+// reported through CLIENT_DIRECT_RESULT, with the ID optionally written to id. Returns 
+// false if the message could not be sent.
+bool client_direct_message(struct bulb_client* client, 
+                           const char* name, 
+                           const char* msg, 
+                           uint32_t* id)
+{
+    ASSERT(client, return false);
+    ASSERT(name, return false);
+    ASSERT(msg, return false);
+    if (strlen(name) == 0 || strlen(name) > MAX_NAME_LENGTH || strlen(msg) > MAX_MESSAGE_LENGTH 
+        || !str_isprint(msg))
+        return false;
+
+    // The ID is handed out before sending, as the outcome may be reported before this
+    // function returns.
+    uint32_t msg_id = (uint32_t)atomic_fetch_add(&client->server_node->next_direct_id, 1) + 1;
+    if (id != NULL)
+        *id = msg_id;
+    return direct_obj_write(client->local_node->mt_sock, msg_id, DIRECT_STATUS_MESSAGE, name, msg);
+}
+
+// Stream a payload of any size to every other member of the room, in chunks interleaved 
+// with other traffic. size is only informative and can be 0 if unknown. The source is 
+// read from as the server grants credit, and its close_func is called once the stream 
+// ends. Returns false, without calling close_func, if the stream could not be opened.
+bool client_stream_send(struct bulb_client* client, 
+                        const char* title, 
+                        uint64_t size, 
+                        const struct bulb_stream_source* source)
+{
+    ASSERT(client, return false);
+    ASSERT(title, return false);
+    ASSERT(source, return false);
+
+    // Streams are otherwise only accessed by the client management thread.
+    mtx_lock(&client->server_node->io->client_update_lock);
+    bool result = stream_obj_open(client->server_node, client->local_node, title, size, source);
+    mtx_unlock(&client->server_node->io->client_update_lock);
+    return result;
+}
+
+// Move the client into a room, creating the room if it does not exist yet. NULL or an
+// empty name returns the client to the lobby. The move is reported through 
+// CLIENT_ROOM_CHANGED. Returns false if the room name is invalid.
+bool client_join_room(struct bulb_client* client, const char* name)
+{
+    ASSERT(client, return false);
+    if (name == NULL)
+        name = "";
+    if (name[0] != '\0' && !room_name_valid(name))
+        return false;
+    return room_obj_write(client->local_node->mt_sock, name);
+}
+
+// Get the name of the room the client is in. Returns an empty string until the
+// client has been validated by the server.
+const char* client_get_room(struct bulb_client* client)
+{
+    ASSERT(client, return "");
+    return client->server_node->room;
+}
+
 // Free a client instance.
 void client_free(struct bulb_client* client)
 {
@@ -243,7 +330,7 @@ void client_free(struct bulb_client* client)
 
     if (client->addr_ptr != NULL)
         freeaddrinfo(client->addr_ptr);
-    free(client);
+    quick_free(client);
 
     bulb_cmds_cleanup();
 
@@ -0,0 +1,163 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <threads.h>
+
+#include "util.h"
+#include "epoch.h"
+
+// Objects retired during epoch e are kept in limbo list e % EPOCH_LIMBO_COUNT. As
+// a thread in a critical section can lag at most one epoch behind the global epoch,
+// the objects retired two epochs ago can be safely released once the global epoch
+// is advanced.
+#define EPOCH_LIMBO_COUNT       3
+
+// Every thread that has entered a critical section owns one of these records.
+// Records are never released, but are recycled once their owning thread exits.
+struct epoch_record
+{
+    struct epoch_record* next;
+    atomic_uint_fast64_t epoch;
+    atomic_bool active;
+    atomic_bool in_use;
+    unsigned nesting;
+};
+
+struct epoch_retired
+{
+    struct epoch_retired* next;
+    void* obj;
+    epoch_free_func free_func;
+};
+
+static _Atomic(struct epoch_record*) epoch_records;
+static _Atomic(struct epoch_retired*) epoch_limbo[EPOCH_LIMBO_COUNT];
+static atomic_uint_fast64_t global_epoch;
+static atomic_flag epoch_collecting = ATOMIC_FLAG_INIT;
+static once_flag epoch_init_flag = ONCE_FLAG_INIT;
+static tss_t epoch_record_key;
+static thread_local struct epoch_record* this_record;
+
+// Release a thread's record for use by another thread. This is invoked when a
+// thread exits.
+static void _epoch_record_release(void* obj)
+{
+    struct epoch_record* record = (struct epoch_record*)obj;
+    record->nesting = 0;
+    atomic_store(&record->active, false);
+    atomic_store(&record->in_use, false);
+}
+
+// Initialise the thread exit handler for epoch records.
+static void _epoch_init()
+{
+    tss_create(&epoch_record_key, _epoch_record_release);
+}
+
+// Get the calling thread's record, claiming or creating one if necessary.
+static struct epoch_record* _epoch_get_record()
+{
+    if (this_record != NULL)
+        return this_record;
+    call_once(&epoch_init_flag, _epoch_init);
+
+    // Attempt to recycle the record of a thread that has since exited.
+    struct epoch_record* record = atomic_load(&epoch_records);
+    for (; record != NULL; record = record->next)
+    {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&record->in_use, &expected, true))
+            break;
+    }
+
+    // Otherwise, publish a new record.
+    if (record == NULL)
+    {
+        record = (struct epoch_record*)quick_malloc(sizeof(struct epoch_record), BULB_ALLOC_GENERAL);
+        atomic_init(&record->in_use, true);
+        record->next = atomic_load(&epoch_records);
+        while (!atomic_compare_exchange_weak(&epoch_records, &record->next, record));
+    }
+
+    tss_set(epoch_record_key, record);
+    return this_record = record;
+}
+
+// Enter a critical section in which retired objects are not released.
+void epoch_enter()
+{
+    struct epoch_record* record = _epoch_get_record();
+    if (record->nesting++ > 0)
+        return;
+
+    // A stale epoch may be observed here if the global epoch advances concurrently,
+    // which only delays reclamation.
+    atomic_store(&record->epoch, atomic_load(&global_epoch));
+    atomic_store(&record->active, true);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+// Leave a critical section entered with epoch_enter().
+void epoch_exit()
+{
+    struct epoch_record* record = this_record;
+    ASSERT(record != NULL && record->nesting > 0, return, "epoch_exit() called outside a critical section\n");
+    if (--record->nesting == 0)
+        atomic_store(&record->active, false);
+}
+
+// Defer the release of an object that has already been unlinked from any shared
+// structure. free_func is invoked on the object once it is safe to do so.
+void epoch_retire(void* obj, epoch_free_func free_func)
+{
+    struct epoch_retired* retired = (struct epoch_retired*)quick_malloc(sizeof(struct epoch_retired),
+        BULB_ALLOC_GENERAL);
+    retired->obj = obj;
+    retired->free_func = free_func;
+
+    // Remaining in a critical section prevents the global epoch from advancing far
+    // enough for the selected limbo list to be released while it is being pushed to.
+    epoch_enter();
+    _Atomic(struct epoch_retired*)* limbo = &epoch_limbo[atomic_load(&global_epoch) % EPOCH_LIMBO_COUNT];
+    retired->next = atomic_load(limbo);
+    while (!atomic_compare_exchange_weak(limbo, &retired->next, retired));
+    epoch_exit();
+}
+
+// Attempt to advance the global epoch and release any objects that can no longer
+// be referenced. Returns true if the global epoch was advanced.
+bool epoch_collect()
+{
+    // Only one thread may advance the global epoch at once, otherwise a delayed
+    // collector could release a limbo list that is being reused.
+    if (atomic_flag_test_and_set(&epoch_collecting))
+        return false;
+
+    // The global epoch can only be advanced once every active thread has observed it.
+    uint_fast64_t epoch = atomic_load(&global_epoch);
+    for (struct epoch_record* record = atomic_load(&epoch_records); record != NULL; record = record->next)
+    {
+        if (atomic_load(&record->in_use) && atomic_load(&record->active)
+            && atomic_load(&record->epoch) != epoch)
+        {
+            atomic_flag_clear(&epoch_collecting);
+            return false;
+        }
+    }
+    atomic_store(&global_epoch, epoch + 1);
+
+    // Release everything that was retired two epochs ago.
+    struct epoch_retired* retired = atomic_exchange(&epoch_limbo[(epoch + 2) % EPOCH_LIMBO_COUNT], NULL);
+    atomic_flag_clear(&epoch_collecting);
+    while (retired != NULL)
+    {
+        struct epoch_retired* next = retired->next;
+        retired->free_func(retired->obj);
+        quick_free(retired);
+        retired = next;
+    }
+    return true;
+}
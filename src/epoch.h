@@ -0,0 +1,33 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Epoch-based reclamation for objects which may still be referenced by other
+// threads after being unlinked from a shared structure, such as client nodes
+// that are still visible to an in-flight LOOP_CLIENTS() iteration. Readers wrap
+// their accesses in epoch_enter()/epoch_exit(), which never block. Writers unlink
+// an object first and then hand it to epoch_retire(), which defers its release
+// until every thread that could have observed it has left its critical section.
+
+// Critical sections may be nested, but must not block indefinitely, as a thread
+// that never leaves its critical section prevents any memory from being reclaimed.
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef void (*epoch_free_func)(void* obj);
+
+// Enter a critical section in which retired objects are not released.
+void epoch_enter();
+
+// Leave a critical section entered with epoch_enter().
+void epoch_exit();
+
+// Defer the release of an object that has already been unlinked from any shared
+// structure. free_func is invoked on the object once it is safe to do so.
+void epoch_retire(void* obj, epoch_free_func free_func);
+
+// Attempt to advance the global epoch and release any objects that can no longer
+// be referenced. This must not be called from within a critical section. Returns
+// true if the global epoch was advanced.
+bool epoch_collect();
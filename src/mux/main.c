@@ -0,0 +1,591 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// bulb_mux accepts client connections on behalf of a server, and carries them as
+// sessions over a few connections to that server, so that the server only needs a
+// socket for each of those connections rather than for every client. Clients connect
+// to the proxy exactly as they would to the server. See src/server/mux.h. Usage:
+//   bulb_mux <server host[:port]> [-p listen port] [-l links] [-k mux key]
+//
+// The proxy runs on a single thread, and polls every socket that it holds at once.
+// Objects are only framed rather than processed, so the server remains responsible
+// for validating them. Each client is assigned to the link carrying the fewest
+// sessions when it connects.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "util.h"
+#include "bulb_macros.h"
+#include "bulb_structs.h"
+#include "bulb_obj.h"
+#include "stdout_obj.h"
+#include "mux_obj.h"
+
+#ifdef WIN32
+#   define poll WSAPoll
+#else
+#   include <poll.h>
+#endif
+
+#define MUX_DEFAULT_LINKS       4
+#define MUX_MAX_LINKS           64
+
+// Pending data for a link above which its clients are no longer read from, until the
+// server catches up.
+#define MUX_LINK_HIGH_WATER     (1024 * 1024)
+
+// Pending data for a client above which it is disconnected, as it cannot keep up.
+#define MUX_CLIENT_MAX_PENDING  (4 * 1024 * 1024)
+
+// Bytes received from a socket at once.
+#define MUX_RECV_SIZE           16384
+
+// A growable buffer of bytes received from or pending for a socket. Bytes before offset
+// have already been consumed.
+struct mux_buffer
+{
+    char* data;
+    size_t len;
+    size_t offset;
+    size_t capacity;
+};
+
+struct mux_link;
+
+struct mux_client
+{
+    SOCKET sock;
+    struct mux_link* link;      // NULL once the server has closed the session.
+    uint32_t session;
+    char ip_addr[IPV4_ADDRESS_STRLEN];
+    struct mux_buffer in;
+    struct mux_buffer out;
+};
+
+struct mux_link
+{
+    SOCKET sock;
+    bool authenticated;
+    bool closed;
+    struct mux_buffer in;
+    struct mux_buffer out;
+
+    // Clients carried by this link, indexed by their session ID. Session IDs are only
+    // reused once the server has closed them, so IDs that are neither in use nor free
+    // are waiting on the server.
+    struct mux_client** sessions;
+    uint32_t next_session;
+    uint32_t* free_sessions;
+    uint32_t free_count;
+    unsigned count;
+};
+
+static struct mux_link links[MUX_MAX_LINKS];
+static unsigned link_count = MUX_DEFAULT_LINKS;
+static struct mux_client** clients;
+static size_t client_count;
+static size_t client_capacity;
+static char mux_key[MAX_MUX_KEY_LENGTH + 1];
+
+// Make room for len more bytes at the end of a buffer.
+static void _mux_buffer_reserve(struct mux_buffer* buffer, size_t len)
+{
+    // Consumed bytes are discarded before growing the buffer.
+    if (buffer->offset > 0 && buffer->len + len > buffer->capacity)
+    {
+        memmove(buffer->data, buffer->data + buffer->offset, buffer->len - buffer->offset);
+        buffer->len -= buffer->offset;
+        buffer->offset = 0;
+    }
+    if (buffer->len + len <= buffer->capacity)
+        return;
+
+    size_t capacity = MAX(buffer->capacity, 4096);
+    while (capacity < buffer->len + len)
+        capacity *= 2;
+    char* data = quick_malloc(capacity, BULB_ALLOC_NETWORKING);
+    if (buffer->data != NULL)
+    {
+        memcpy(data, buffer->data, buffer->len);
+        quick_free(buffer->data);
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+// Append bytes to the end of a buffer.
+static void _mux_buffer_append(struct mux_buffer* buffer, const void* data, size_t len)
+{
+    _mux_buffer_reserve(buffer, len);
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+// Get the number of bytes in a buffer that have not been consumed.
+static inline size_t _mux_buffer_pending(struct mux_buffer* buffer)
+{
+    return buffer->len - buffer->offset;
+}
+
+// Free a buffer's bytes.
+static void _mux_buffer_free(struct mux_buffer* buffer)
+{
+    quick_free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// Receive up to MUX_RECV_SIZE bytes from a socket into a buffer. Returns false once the
+// connection has closed.
+static bool _mux_recv(SOCKET sock, struct mux_buffer* buffer)
+{
+    _mux_buffer_reserve(buffer, MUX_RECV_SIZE);
+    int result = recv(sock, buffer->data + buffer->len, MUX_RECV_SIZE, 0);
+    if (result > 0)
+    {
+        buffer->len += result;
+        return true;
+    }
+    return result < 0 && socket_errno() == SOCKET_AGAIN;
+}
+
+// Send as much of a buffer as a socket accepts. Returns false once the connection has
+// closed.
+static bool _mux_send(SOCKET sock, struct mux_buffer* buffer)
+{
+    while (_mux_buffer_pending(buffer) > 0)
+    {
+        int result = send(sock, buffer->data + buffer->offset, (int)MIN(_mux_buffer_pending(buffer), INT32_MAX),
+            MSG_NOSIGNAL);
+        if (result <= 0)
+            return result < 0 && socket_errno() == SOCKET_AGAIN;
+        buffer->offset += result;
+    }
+    buffer->len = buffer->offset = 0;
+    return true;
+}
+
+// Queue a mux_obj object for a link.
+static void _mux_write(struct mux_link* link, uint32_t session, enum mux_op op, const void* payload, size_t len)
+{
+    struct mux_obj obj = { .base.type = BULB_MUX, .base.size = sizeof(struct mux_obj) + len, .session = session,
+        .op = op };
+    _mux_buffer_append(&link->out, &obj, sizeof(obj));
+    _mux_buffer_append(&link->out, payload, len);
+}
+
+// Get the next complete object in a buffer, without consuming it. Returns NULL if the
+// object has not been received in full yet, or sets error if the object is malformed.
+static struct bulb_obj* _mux_next_obj(struct mux_buffer* buffer, size_t max_size, bool* error)
+{
+    *error = false;
+    if (_mux_buffer_pending(buffer) < sizeof(struct bulb_obj))
+        return NULL;
+
+    // Objects are copied to the start of the buffer first, so that they are aligned.
+    if (buffer->offset > 0)
+    {
+        memmove(buffer->data, buffer->data + buffer->offset, buffer->len - buffer->offset);
+        buffer->len -= buffer->offset;
+        buffer->offset = 0;
+    }
+    struct bulb_obj* obj = (struct bulb_obj*)buffer->data;
+    if (obj->size < sizeof(struct bulb_obj) || obj->size > max_size)
+    {
+        *error = true;
+        return NULL;
+    }
+    return (buffer->len >= obj->size) ? obj : NULL;
+}
+
+// Close a client's connection and free it. The server is told that its session has
+// ended, unless the server closed it first.
+static void _mux_client_close(size_t index)
+{
+    struct mux_client* client = clients[index];
+    if (client->link != NULL)
+    {
+        client->link->sessions[client->session] = NULL;
+        client->link->count--;
+        _mux_write(client->link, client->session, MUX_CLOSE, "", 0);
+    }
+    closesocket(client->sock);
+    _mux_buffer_free(&client->in);
+    _mux_buffer_free(&client->out);
+    quick_free(client);
+    clients[index] = clients[--client_count];
+}
+
+// Connect and authenticate a link to the server. Returns false on failure.
+static bool _mux_link_open(struct mux_link* link, struct addrinfo* addr)
+{
+    link->sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (link->sock == INVALID_SOCKET)
+        return false;
+    if (connect(link->sock, addr->ai_addr, (int)addr->ai_addrlen) == SOCKET_ERROR)
+    {
+        closesocket(link->sock);
+        return false;
+    }
+    set_socket_non_blocking(link->sock);
+    set_socket_no_delay(link->sock);
+    _mux_write(link, 0, MUX_HELLO, mux_key, strlen(mux_key));
+    return true;
+}
+
+// Close a link. Every client that it carries is disconnected once everything sent to it
+// has been sent.
+static void _mux_link_close(struct mux_link* link)
+{
+    printf("Link to the server has closed (%u clients were carried)\n", link->count);
+    link->closed = true;
+    closesocket(link->sock);
+    for (size_t i = 0; i < client_count; i++)
+    {
+        if (clients[i]->link == link)
+            clients[i]->link = NULL;
+    }
+}
+
+// Assign a session of the least loaded link to a newly connected client. Returns false
+// if no link is available.
+static bool _mux_assign(struct mux_client* client)
+{
+    struct mux_link* link = NULL;
+    for (unsigned i = 0; i < link_count; i++)
+    {
+        if (!links[i].closed && links[i].authenticated && (link == NULL || links[i].count < link->count))
+            link = &links[i];
+    }
+    if (link == NULL)
+        return false;
+
+    uint32_t session;
+    if (link->free_count > 0)
+        session = link->free_sessions[--link->free_count];
+    else if (link->next_session < MUX_MAX_SESSIONS)
+        session = link->next_session++;
+    else
+        return false;
+
+    // Every session ID that the link may use is allocated upfront on first use.
+    if (link->sessions == NULL)
+    {
+        link->sessions = quick_calloc(MUX_MAX_SESSIONS, sizeof(struct mux_client*), BULB_ALLOC_NETWORKING);
+        link->free_sessions = quick_calloc(MUX_MAX_SESSIONS, sizeof(uint32_t), BULB_ALLOC_NETWORKING);
+    }
+    link->sessions[session] = client;
+    link->count++;
+    client->link = link;
+    client->session = session;
+    _mux_write(link, session, MUX_OPEN, client->ip_addr, strlen(client->ip_addr));
+    return true;
+}
+
+// Accept every pending client connection.
+static void _mux_accept(SOCKET listen_sock)
+{
+    for (;;)
+    {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        SOCKET sock = accept(listen_sock, (struct sockaddr*)&addr, &addr_len);
+        if (sock == INVALID_SOCKET)
+            return;
+        set_socket_non_blocking(sock);
+        set_socket_no_delay(sock);
+
+        struct mux_client* client = quick_malloc(sizeof(struct mux_client), BULB_ALLOC_NETWORKING);
+        client->sock = sock;
+        inet_ntop(AF_INET, &addr.sin_addr, client->ip_addr, sizeof(client->ip_addr));
+        if (!_mux_assign(client))
+        {
+            closesocket(sock);
+            quick_free(client);
+            continue;
+        }
+
+        if (client_count == client_capacity)
+        {
+            client_capacity = MAX(client_capacity * 2, 64);
+            struct mux_client** array = quick_calloc(client_capacity, sizeof(struct mux_client*),
+                BULB_ALLOC_NETWORKING);
+            if (clients != NULL)
+            {
+                memcpy(array, clients, sizeof(struct mux_client*) * client_count);
+                quick_free(clients);
+            }
+            clients = array;
+        }
+        clients[client_count++] = client;
+    }
+}
+
+// Process every complete object received from the server through a link. Returns false
+// if the link must be closed.
+static bool _mux_link_process(struct mux_link* link)
+{
+    struct bulb_obj* obj;
+    bool error;
+    while ((obj = _mux_next_obj(&link->in, sizeof(struct mux_obj) + MUX_MAX_PAYLOAD, &error)) != NULL)
+    {
+        size_t size = obj->size;
+        if (obj->type == BULB_STDOUT && size > sizeof(struct stdout_obj))
+        {
+            // The server only reports to the proxy itself why a link was closed.
+            link->in.data[size - 1] = '\0';
+            printf("%s", ((struct stdout_obj*)obj)->buffer);
+        }
+        else if (obj->type == BULB_MUX && size >= sizeof(struct mux_obj))
+        {
+            struct mux_obj* mux = (struct mux_obj*)obj;
+            struct mux_client* client = (mux->session < link->next_session && link->sessions != NULL)
+                ? link->sessions[mux->session] : NULL;
+            switch (mux->op)
+            {
+                case MUX_HELLO:
+                    link->authenticated = true;
+                    break;
+                case MUX_DATA:
+                    if (client != NULL)
+                        _mux_buffer_append(&client->out, mux->payload, size - sizeof(struct mux_obj));
+                    break;
+                case MUX_CLOSE:
+                    // The client is disconnected once everything sent to it has been
+                    // sent, and its session ID may now be reused.
+                    if (mux->session >= link->next_session)
+                        return false;
+                    if (client != NULL)
+                    {
+                        client->link = NULL;
+                        link->count--;
+                    }
+                    link->sessions[mux->session] = NULL;
+                    link->free_sessions[link->free_count++] = mux->session;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        else
+            return false;
+        link->in.offset += size;
+    }
+    return !error;
+}
+
+// Frame every complete object received from a client for its link. Returns false if
+// the client must be disconnected.
+static bool _mux_client_process(struct mux_client* client)
+{
+    struct bulb_obj* obj;
+    bool error;
+    while ((obj = _mux_next_obj(&client->in, MUX_MAX_PAYLOAD, &error)) != NULL)
+    {
+        size_t size = obj->size;
+        _mux_write(client->link, client->session, MUX_DATA, obj, size);
+        client->in.offset += size;
+    }
+    return !error;
+}
+
+// Parse a host[:port] argument. Returns false if the port is invalid.
+static bool _mux_parse_host(char* argument, uint16_t* port)
+{
+    *port = BULB_FIRST_PORT;
+    char* separator = strrchr(argument, ':');
+    if (separator == NULL)
+        return true;
+    *separator = '\0';
+    char* end;
+    unsigned long value = strtoul(separator + 1, &end, 10);
+    if (*end != '\0' || value == 0 || value > UINT16_MAX)
+        return false;
+    *port = (uint16_t)value;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    char* host = NULL;
+    uint16_t upstream_port;
+    unsigned long listen_port = BULB_FIRST_PORT;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            listen_port = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            link_count = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+        {
+            if (strlen(argv[++i]) > MAX_MUX_KEY_LENGTH)
+            {
+                fprintf(stderr, "Mux key is too long\n");
+                return 1;
+            }
+            strcpy(mux_key, argv[i]);
+        }
+        else if (host == NULL && argv[i][0] != '-')
+            host = argv[i];
+        else
+            usage = true;
+    }
+    if (usage || host == NULL || !_mux_parse_host(host, &upstream_port) || listen_port == 0 || listen_port > UINT16_MAX
+        || link_count == 0 || link_count > MUX_MAX_LINKS)
+    {
+        fprintf(stderr, "Usage: %s <server host[:port]> [-p listen port] [-l links (1-%d)] [-k mux key]\n",
+            argv[0], MUX_MAX_LINKS);
+        return 1;
+    }
+
+#ifdef WIN32
+    WSADATA wsa_data;
+    ASSERT(WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0, return 1, "WSAStartup() failed\n");
+#endif
+
+    // Open every link to the server before accepting any client.
+    char port_buffer[6] = { 0 };
+    snprintf(port_buffer, sizeof(port_buffer), "%hu", upstream_port);
+    struct addrinfo* addr = NULL;
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    if (getaddrinfo(host, port_buffer, &hints, &addr) != 0)
+    {
+        fprintf(stderr, "Could not resolve %s\n", host);
+        return 1;
+    }
+    for (unsigned i = 0; i < link_count; i++)
+    {
+        if (!_mux_link_open(&links[i], addr))
+        {
+            fprintf(stderr, "Could not connect to server at %s:%hu\n", host, upstream_port);
+            return 1;
+        }
+    }
+    freeaddrinfo(addr);
+
+    SOCKET listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int reuse = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    struct sockaddr_in listen_addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)listen_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if (listen_sock == INVALID_SOCKET
+        || bind(listen_sock, (struct sockaddr*)&listen_addr, sizeof(listen_addr)) == SOCKET_ERROR
+        || listen(listen_sock, SOMAXCONN) == SOCKET_ERROR)
+    {
+        fprintf(stderr, "Could not listen on port %lu\n", listen_port);
+        return 1;
+    }
+    set_socket_non_blocking(listen_sock);
+    printf("Carrying clients on port %lu to %s:%hu over %u links\n", listen_port, host, upstream_port, link_count);
+
+    struct pollfd* pfds = NULL;
+    size_t pfd_capacity = 0;
+    for (;;)
+    {
+        // The proxy exits once no link to the server remains.
+        unsigned open_links = 0;
+        for (unsigned i = 0; i < link_count; i++)
+            open_links += !links[i].closed;
+        if (open_links == 0)
+            break;
+
+        if (pfd_capacity < 1 + link_count + client_count)
+        {
+            pfd_capacity = 2 * (1 + link_count + client_count);
+            quick_free(pfds);
+            pfds = quick_calloc(pfd_capacity, sizeof(struct pollfd), BULB_ALLOC_NETWORKING);
+        }
+        // Clients are only accepted once a link has been authenticated by the server.
+        bool accepting = false;
+        for (unsigned i = 0; i < link_count; i++)
+            accepting |= !links[i].closed && links[i].authenticated;
+        pfds[0] = (struct pollfd) { .fd = listen_sock, .events = accepting ? POLLIN : 0 };
+        for (unsigned i = 0; i < link_count; i++)
+        {
+            pfds[1 + i] = (struct pollfd) { .fd = links[i].closed ? INVALID_SOCKET : links[i].sock,
+                .events = POLLIN | (_mux_buffer_pending(&links[i].out) > 0 ? POLLOUT : 0) };
+        }
+
+        // Clients whose link is backed up are not read from, so that the server's
+        // backlog does not grow without bound.
+        for (size_t i = 0; i < client_count; i++)
+        {
+            struct mux_client* client = clients[i];
+            bool readable = client->link != NULL && _mux_buffer_pending(&client->link->out) < MUX_LINK_HIGH_WATER;
+            pfds[1 + link_count + i] = (struct pollfd) { .fd = client->sock,
+                .events = (readable ? POLLIN : 0) | (_mux_buffer_pending(&client->out) > 0 ? POLLOUT : 0) };
+        }
+        size_t polled_clients = client_count;
+        if (poll(pfds, (unsigned)(1 + link_count + polled_clients), -1) < 0)
+            continue;
+
+        for (unsigned i = 0; i < link_count; i++)
+        {
+            struct mux_link* link = &links[i];
+            short revents = pfds[1 + i].revents;
+            if (link->closed || revents == 0)
+                continue;
+
+            // Anything received before the link closed is still processed, such as the
+            // reason why the server closed it.
+            bool open = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                open = _mux_recv(link->sock, &link->in);
+                open = _mux_link_process(link) && open;
+            }
+            if (open && (revents & POLLOUT))
+                open = _mux_send(link->sock, &link->out);
+            if (!open)
+                _mux_link_close(link);
+        }
+
+        // Clients are visited in reverse, as closing a client moves the last client into
+        // its place. Clients accepted during this iteration have not been polled yet.
+        for (size_t i = polled_clients; i-- > 0;)
+        {
+            struct mux_client* client = clients[i];
+            short revents = pfds[1 + link_count + i].revents;
+            bool open = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                open = _mux_recv(client->sock, &client->in);
+                if (open && client->link != NULL)
+                    open = _mux_client_process(client);
+            }
+            if (open && _mux_buffer_pending(&client->out) > 0)
+            {
+                open = _mux_send(client->sock, &client->out)
+                    && _mux_buffer_pending(&client->out) < MUX_CLIENT_MAX_PENDING;
+            }
+
+            // Clients whose session was closed by the server are disconnected once
+            // everything sent to them has been sent.
+            if (!open || (client->link == NULL && _mux_buffer_pending(&client->out) == 0))
+                _mux_client_close(i);
+        }
+
+        if (pfds[0].revents & POLLIN)
+            _mux_accept(listen_sock);
+    }
+
+    // Clients still waiting on their pending data are dropped, as every link has closed.
+    for (size_t i = client_count; i-- > 0;)
+        _mux_client_close(i);
+    for (unsigned i = 0; i < link_count; i++)
+    {
+        _mux_buffer_free(&links[i].in);
+        _mux_buffer_free(&links[i].out);
+        quick_free(links[i].sessions);
+        quick_free(links[i].free_sessions);
+    }
+    quick_free(clients);
+    quick_free(pfds);
+    closesocket(listen_sock);
+    return 0;
+}
@@ -0,0 +1,295 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <threads.h>
+
+#include "util.h"
+#include "alloc.h"
+#include "pool.h"
+
+#if defined BULB_POOL_HUGE_PAGES && defined __linux__
+#   include <sys/mman.h>
+#   define POOL_SLAB_SIZE       (2 * 1024 * 1024)
+#else
+#   define POOL_SLAB_SIZE       (64 * 1024)
+#endif
+
+// Number of chunks moved between a thread cache and the shared depot at once,
+// and the number of free chunks a thread cache may hold per size class before
+// surplus chunks are drained back into the depot.
+#define POOL_BATCH_SIZE         32
+#define POOL_CACHE_LIMIT        (POOL_BATCH_SIZE * 2)
+
+// Oversize allocations are tagged with this size class index.
+#define POOL_OVERSIZE           POOL_CLASS_COUNT
+
+// The size classes are chosen around Bulb's own objects: 64 bytes fits timeout
+// nodes and object headers, 640 bytes fits a full recv() data node and 2304
+// bytes fits a data node carrying a full message_obj object.
+static const size_t pool_class_sizes[POOL_CLASS_COUNT] = { 64, 128, 256, 640, 1024, 2304 };
+
+// Every chunk is prefixed with this header. next is only used while the chunk
+// is free, whereas the remaining fields persist so that pool_free() can find the
+// size class of the chunk and account for its release without being given its
+// size.
+struct pool_chunk
+{
+    struct pool_chunk* next;
+    uint16_t class_index;
+    uint16_t tag;
+    uint32_t size;
+    max_align_t data[];
+};
+
+struct pool_depot
+{
+    mtx_t lock;
+    struct pool_chunk* free;
+    size_t count;
+
+    atomic_uint_fast64_t allocs;
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t refills;
+    atomic_uint_fast64_t slabs;
+};
+
+struct pool_cache
+{
+    struct pool_chunk* free[POOL_CLASS_COUNT];
+    unsigned count[POOL_CLASS_COUNT];
+};
+
+static struct pool_depot pool_depots[POOL_CLASS_COUNT];
+static atomic_uint_fast64_t pool_oversize;
+static once_flag pool_init_flag = ONCE_FLAG_INIT;
+static tss_t pool_cache_key;
+static thread_local struct pool_cache* this_cache;
+
+// Get the stride between two chunks of a given size class.
+static inline size_t _pool_chunk_stride(unsigned index)
+{
+    return sizeof(struct pool_chunk) + pool_class_sizes[index];
+}
+
+// Push a list of chunks into a size class's shared depot.
+static void _pool_depot_push(unsigned index, struct pool_chunk* head, struct pool_chunk* tail,
+                             unsigned count)
+{
+    struct pool_depot* depot = &pool_depots[index];
+    mtx_lock(&depot->lock);
+    tail->next = depot->free;
+    depot->free = head;
+    depot->count += count;
+    mtx_unlock(&depot->lock);
+}
+
+// Drain a thread's cache back into the shared depots. This is invoked when a
+// thread exits, so that its cached chunks are not stranded.
+static void _pool_cache_release(void* obj)
+{
+    struct pool_cache* cache = (struct pool_cache*)obj;
+    for (unsigned i = 0; i < POOL_CLASS_COUNT; i++)
+    {
+        struct pool_chunk* tail = cache->free[i];
+        if (tail == NULL)
+            continue;
+        while (tail->next != NULL)
+            tail = tail->next;
+        _pool_depot_push(i, cache->free[i], tail, cache->count[i]);
+    }
+    quick_free(cache);
+}
+
+// Initialise every shared depot.
+static void _pool_init()
+{
+    for (unsigned i = 0; i < POOL_CLASS_COUNT; i++)
+        mtx_init(&pool_depots[i].lock, mtx_plain);
+    tss_create(&pool_cache_key, _pool_cache_release);
+}
+
+// Get the calling thread's cache, creating it if necessary.
+static inline struct pool_cache* _pool_get_cache()
+{
+    if (this_cache == NULL)
+    {
+        call_once(&pool_init_flag, _pool_init);
+        this_cache = (struct pool_cache*)quick_malloc(sizeof(struct pool_cache), BULB_ALLOC_GENERAL);
+        tss_set(pool_cache_key, this_cache);
+    }
+    return this_cache;
+}
+
+// Allocate the memory backing a new slab.
+static void* _pool_slab_new()
+{
+#if defined BULB_POOL_HUGE_PAGES && defined __linux__
+    // Prefer explicitly reserved huge pages, then transparent huge pages, before
+    // finally falling back to the system allocator.
+    void* slab = mmap(NULL, POOL_SLAB_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (slab != MAP_FAILED)
+        return slab;
+
+    slab = mmap(NULL, POOL_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slab != MAP_FAILED)
+    {
+        madvise(slab, POOL_SLAB_SIZE, MADV_HUGEPAGE);
+        return slab;
+    }
+#endif
+
+    void* ptr = alloc_raw(POOL_SLAB_SIZE);
+    if (!ptr)
+        abort();
+    return ptr;
+}
+
+// Refill a thread cache's size class, either from the shared depot or by
+// carving a new slab if the depot is empty.
+static void _pool_refill(struct pool_cache* cache, unsigned index)
+{
+    struct pool_depot* depot = &pool_depots[index];
+    atomic_fetch_add_explicit(&depot->refills, 1, memory_order_relaxed);
+
+    // Take up to a batch of chunks from the shared depot.
+    mtx_lock(&depot->lock);
+    unsigned taken = 0;
+    while (depot->free != NULL && taken < POOL_BATCH_SIZE)
+    {
+        struct pool_chunk* chunk = depot->free;
+        depot->free = chunk->next;
+        chunk->next = cache->free[index];
+        cache->free[index] = chunk;
+        taken++;
+    }
+    depot->count -= taken;
+    mtx_unlock(&depot->lock);
+    cache->count[index] += taken;
+    if (taken > 0)
+        return;
+
+    // Carve an entire slab into the thread cache. Slabs are never returned to the
+    // system, as their chunks may be cached by any thread.
+    atomic_fetch_add_explicit(&depot->slabs, 1, memory_order_relaxed);
+    char* slab = (char*)_pool_slab_new();
+    size_t stride = _pool_chunk_stride(index);
+    for (size_t offset = 0; offset + stride <= POOL_SLAB_SIZE; offset += stride)
+    {
+        struct pool_chunk* chunk = (struct pool_chunk*)(slab + offset);
+        chunk->class_index = index;
+        chunk->next = cache->free[index];
+        cache->free[index] = chunk;
+        cache->count[index]++;
+    }
+}
+
+// Allocate a chunk of at least size bytes attributed to the given subsystem. This
+// never returns NULL.
+void* pool_alloc(size_t size, enum bulb_alloc_tag tag)
+{
+    ASSERT(size <= UINT32_MAX, abort(), "pool_alloc() request of %zu bytes is too large\n", size);
+    alloc_account(tag, size);
+
+    // Select the smallest size class that can accommodate the request.
+    unsigned index = 0;
+    while (index < POOL_CLASS_COUNT && pool_class_sizes[index] < size)
+        index++;
+
+    if (index == POOL_OVERSIZE)
+    {
+        atomic_fetch_add_explicit(&pool_oversize, 1, memory_order_relaxed);
+        struct pool_chunk* chunk = (struct pool_chunk*)alloc_raw(sizeof(struct pool_chunk) + size);
+        if (!chunk)
+            abort();
+        chunk->class_index = POOL_OVERSIZE;
+        chunk->tag = tag;
+        chunk->size = (uint32_t)size;
+        return chunk->data;
+    }
+
+    struct pool_cache* cache = _pool_get_cache();
+    struct pool_depot* depot = &pool_depots[index];
+    atomic_fetch_add_explicit(&depot->allocs, 1, memory_order_relaxed);
+    if (cache->free[index] != NULL)
+        atomic_fetch_add_explicit(&depot->hits, 1, memory_order_relaxed);
+    else
+        _pool_refill(cache, index);
+
+    struct pool_chunk* chunk = cache->free[index];
+    cache->free[index] = chunk->next;
+    cache->count[index]--;
+    chunk->tag = tag;
+    chunk->size = (uint32_t)size;
+    return chunk->data;
+}
+
+// Release a chunk returned by pool_alloc(). The chunk may be released from a
+// different thread than the thread which allocated it. ptr can be NULL.
+void pool_free(void* ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    struct pool_chunk* chunk = (struct pool_chunk*)((char*)ptr - offsetof(struct pool_chunk, data));
+    unsigned index = chunk->class_index;
+    alloc_unaccount(chunk->tag, chunk->size);
+    if (index == POOL_OVERSIZE)
+    {
+        alloc_raw_free(chunk);
+        return;
+    }
+    ASSERT(index < POOL_CLASS_COUNT, return, "pool_free() given a chunk with an invalid size class\n");
+
+    // Return the chunk to the calling thread's cache. If the cache has grown too
+    // large, drain a batch of its chunks back into the shared depot.
+    struct pool_cache* cache = _pool_get_cache();
+    chunk->next = cache->free[index];
+    cache->free[index] = chunk;
+    if (++cache->count[index] >= POOL_CACHE_LIMIT)
+    {
+        struct pool_chunk* head = cache->free[index];
+        struct pool_chunk* tail = head;
+        for (unsigned i = 1; i < POOL_BATCH_SIZE; i++)
+            tail = tail->next;
+        cache->free[index] = tail->next;
+        cache->count[index] -= POOL_BATCH_SIZE;
+        _pool_depot_push(index, head, tail, POOL_BATCH_SIZE);
+    }
+}
+
+// Attribute a chunk to a different subsystem, e.g. when an object read from a
+// socket stream is kept as part of a client node.
+void pool_retag(void* ptr, enum bulb_alloc_tag tag)
+{
+    struct pool_chunk* chunk = (struct pool_chunk*)((char*)ptr - offsetof(struct pool_chunk, data));
+    alloc_unaccount(chunk->tag, chunk->size);
+    alloc_account(tag, chunk->size);
+    chunk->tag = tag;
+}
+
+// Get the statistics of a given size class. Returns false if index is out of
+// range.
+bool pool_get_stats(unsigned index, struct pool_stats* stats)
+{
+    if (index >= POOL_CLASS_COUNT)
+        return false;
+
+    struct pool_depot* depot = &pool_depots[index];
+    stats->chunk_size = pool_class_sizes[index];
+    stats->allocs = atomic_load_explicit(&depot->allocs, memory_order_relaxed);
+    stats->hits = atomic_load_explicit(&depot->hits, memory_order_relaxed);
+    stats->refills = atomic_load_explicit(&depot->refills, memory_order_relaxed);
+    stats->slabs = atomic_load_explicit(&depot->slabs, memory_order_relaxed);
+    return true;
+}
+
+// Get the number of allocations which were too large for any size class.
+uint64_t pool_oversize_allocs()
+{
+    return atomic_load_explicit(&pool_oversize, memory_order_relaxed);
+}
@@ -0,0 +1,49 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Size-classed slab pools for the fixed and bounded-size allocations made on
+// Bulb's hot path, such as socket data nodes, timeout nodes and objects read
+// from a socket stream. Each thread keeps a small cache of free chunks for
+// every size class, which is refilled from and drained into a shared depot
+// in batches. Requests larger than the largest size class fall back to the
+// system allocator, but must still be released with pool_free().
+
+// Unlike calloc(), chunks returned by pool_alloc() are NOT zeroed.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bulb_alloc.h"
+
+#define POOL_CLASS_COUNT    6
+
+struct pool_stats
+{
+    size_t chunk_size;  // Usable size of each chunk in this size class.
+    uint64_t allocs;    // Total number of allocations served by this size class.
+    uint64_t hits;      // Allocations served from a thread cache without locking.
+    uint64_t refills;   // Number of thread cache refills from the shared depot.
+    uint64_t slabs;     // Number of slabs carved for this size class.
+};
+
+// Allocate a chunk of at least size bytes attributed to the given subsystem. This
+// never returns NULL.
+void* pool_alloc(size_t size, enum bulb_alloc_tag tag);
+
+// Release a chunk returned by pool_alloc(). The chunk may be released from a
+// different thread than the thread which allocated it. ptr can be NULL.
+void pool_free(void* ptr);
+
+// Attribute a chunk to a different subsystem, e.g. when an object read from a
+// socket stream is kept as part of a client node.
+void pool_retag(void* ptr, enum bulb_alloc_tag tag);
+
+// Get the statistics of a given size class. Returns false if index is out of
+// range.
+bool pool_get_stats(unsigned index, struct pool_stats* stats);
+
+// Get the number of allocations which were too large for any size class.
+uint64_t pool_oversize_allocs();
@@ -1,159 +1,1267 @@
 // floason (C) 2026
 // Licensed under the MIT License.
 
+// The banlist is keyed on IPv4 prefixes, so that whole CIDR ranges can be banned
+// with a single record and an address is matched against the longest banned prefix
+// that contains it. Most bans are held by a memory-mapped banlist file (see
+// banlist_file.h), which is searched in place. Bans and unbans made since the file
+// was written are appended to a journal, and are held in memory by a binary radix
+// (Patricia) tree that overlays the file.
+
+// The journal and banlist file are only touched by the banlist's persistence thread,
+// so that bans and unbans never block on disk I/O. Writers queue journal records
+// in memory, which the persistence thread writes in periodic batches. Once the
+// journal grows long enough, the persistence thread compacts it into a new banlist
+// file.
+
+// Before searching the banlist, addresses are checked against an admission filter:
+// a bitmap marking each /16 block that overlaps any ban. Most addresses that are not
+// banned can be turned away by a single bit, which matters most as the banlist is
+// checked for every accepted connection. Bits are set as bans are added, and are
+// only cleared when the filter is rebuilt by a compaction.
+
+// Readers traverse the overlay without locking inside an epoch critical section.
+// Writers are serialised, and copy each node along the path that they modify before
+// publishing the new overlay, retiring the replaced nodes through epoch_retire().
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <threads.h>
 
 #include "util.h"
+#include "epoch.h"
+#include "banlist_file.h"
 #include "bulb_macros.h"
 #include "bulb_banlist.h"
-#include "trie.h"
+#include "server_node.h"
+
+// xxx.xxx.xxx.xxx/xx\0
+#define BANLIST_PREFIX_STRLEN       (IPV4_ADDRESS_STRLEN + 3)
+
+// Interval at which queued journal records are written, in seconds.
+#define BANLIST_FLUSH_INTERVAL_S    1
+
+// Size of queued journal records after which they are written early, in bytes.
+#define BANLIST_FLUSH_SIZE          (64 * 1024)
+
+// Size of the journal after which it is compacted, in bytes.
+#define BANLIST_COMPACT_SIZE        (256 * 1024)
+
+// Number of lines imported from a banlist text file at a time.
+#define BANLIST_IMPORT_BATCH        256
+
+// Number of leading address bits that index the admission filter.
+#define BANLIST_FILTER_BITS         16
+#define BANLIST_FILTER_WORDS        ((1u << BANLIST_FILTER_BITS) / 64)
+
+// Nodes are immutable once they have been published.
+struct banlist_node
+{
+    uint32_t prefix;
+    uint8_t prefix_len;
+    char* reason;       // NULL for nodes that only join two branches.
+    struct banlist_node* children[2];
+};
 
-struct banlist_record
-{   
-    char ip_addr[IPV4_ADDRESS_STRLEN];
-    char reason[MAX_BANLIST_REASON_LENGTH + 1];
+// The state of the banlist visible to readers. Views are replaced as a whole, so
+// that a compaction can swap the banlist file and the overlay at once.
+struct banlist_view
+{
+    struct banlist_base* base;
+    struct banlist_node* root;
 };
 
-// Read from a banlist database text file into memory. This will create a new
-// database if the file is not present. Returns false on failure.
-bool server_banlist_load(struct bulb_server* server)
+// An import or export queued for the persistence thread.
+struct banlist_task
 {
-    ASSERT(server != NULL, return false);
-    server_banlist_close(server);
+    struct banlist_task* next;
+    bool is_import;
+    char path[];
+};
+
+// Paths of each file of a banlist database.
+struct banlist_paths
+{
+    char file[BANLIST_PATH_LENGTH];
+    char text[BANLIST_PATH_LENGTH];
+    char journal[BANLIST_PATH_LENGTH];
+    char old_journal[BANLIST_PATH_LENGTH];
+};
+
+struct banlist
+{
+    _Atomic(struct banlist_view*) view;
+    struct banlist_paths paths;
+    _Atomic(uint64_t) filter[BANLIST_FILTER_WORDS];
+
+    // Journal records that have yet to be written are guarded by write_lock.
+    mtx_t write_lock;
+    char* pending;
+    size_t pending_size;
+    size_t pending_capacity;
+
+    // The journal is only accessed by the persistence thread.
+    FILE* journal;
+    size_t journal_size;
+    thrd_t persist_thread;
+
+    // Requests for the persistence thread are guarded by persist_lock.
+    mtx_t persist_lock;
+    cnd_t persist_cond;
+    bool compact_requested;
+    bool stop_requested;
+    struct banlist_task* tasks;
+    struct banlist_task* tasks_tail;
+};
+
+// A change to the banlist file, flattened from the overlay.
+struct banlist_change
+{
+    uint32_t prefix;
+    uint8_t prefix_len;
+    char* reason;       // NULL for unbans.
+};
+
+// State passed to _banlist_replay().
+struct banlist_replay
+{
+    struct banlist_base* base;
+    struct banlist_node* root;
+};
+
+typedef bool (*banlist_sink_func)(void* data, uint32_t prefix, uint8_t prefix_len, const char* reason);
+
+// Overlay nodes holding this reason unban a prefix held by the banlist file.
+static char banlist_tombstone[1];
+
+// Ban reasons are copied here by server_banlist_isbanned(), as a reason may be
+// released as soon as the reading thread leaves its critical section.
+static thread_local char banlist_reason_buffer[MAX_BANLIST_REASON_LENGTH + 1];
+
+// Get the network mask of a prefix length.
+static inline uint32_t _banlist_mask(unsigned prefix_len)
+{
+    return (prefix_len == 0) ? 0 : (UINT32_MAX << (32 - prefix_len));
+}
+
+// Get the bit of an address following the first prefix_len bits.
+static inline unsigned _banlist_bit(uint32_t addr, unsigned prefix_len)
+{
+    return (addr >> (31 - prefix_len)) & 1;
+}
+
+// Parse an address, optionally followed by a CIDR prefix length. Any host bits are
+// cleared. Returns false if the address is malformed.
+static bool _banlist_parse(const char* str, uint32_t* prefix, uint8_t* prefix_len)
+{
+    uint32_t addr = 0;
+    for (int octet = 0; octet < 4; octet++)
+    {
+        if (octet > 0 && *str++ != '.')
+            return false;
+        if (!isdigit((unsigned char)*str))
+            return false;
+
+        unsigned value = 0;
+        for (int digits = 0; isdigit((unsigned char)*str); digits++, str++)
+        {
+            value = value * 10 + (*str - '0');
+            if (digits >= 3 || value > 255)
+                return false;
+        }
+        addr = (addr << 8) | value;
+    }
+
+    unsigned len = 32;
+    if (*str == '/')
+    {
+        str++;
+        if (!isdigit((unsigned char)*str))
+            return false;
+        for (len = 0; isdigit((unsigned char)*str); str++)
+        {
+            len = len * 10 + (*str - '0');
+            if (len > 32)
+                return false;
+        }
+    }
+    if (*str != '\0')
+        return false;
+
+    *prefix = addr & _banlist_mask(len);
+    *prefix_len = (uint8_t)len;
+    return true;
+}
+
+// Format a prefix as text. The prefix length is omitted for single addresses.
+static void _banlist_format(char* buffer, uint32_t prefix, unsigned prefix_len)
+{
+    int len = snprintf(buffer, BANLIST_PREFIX_STRLEN, "%u.%u.%u.%u", (prefix >> 24) & 0xFF,
+        (prefix >> 16) & 0xFF, (prefix >> 8) & 0xFF, prefix & 0xFF);
+    if (prefix_len < 32)
+        snprintf(buffer + len, BANLIST_PREFIX_STRLEN - len, "/%u", prefix_len);
+}
+
+// Copy a ban reason, truncating it if necessary.
+static char* _banlist_reason_new(const char* reason)
+{
+    size_t len = MIN(strlen(reason), MAX_BANLIST_REASON_LENGTH);
+    char* copy = quick_malloc(len + 1, BULB_ALLOC_BANLIST);
+    memcpy(copy, reason, len);
+    return copy;
+}
+
+// Release a ban reason. This can be passed to epoch_retire().
+static void _banlist_reason_free(void* reason)
+{
+    if (reason != banlist_tombstone)
+        quick_free(reason);
+}
+
+// Allocate a new node.
+static struct banlist_node* _banlist_node_new(uint32_t prefix, uint8_t prefix_len, char* reason)
+{
+    struct banlist_node* node = quick_malloc(sizeof(struct banlist_node), BULB_ALLOC_BANLIST);
+    node->prefix = prefix;
+    node->prefix_len = prefix_len;
+    node->reason = reason;
+    return node;
+}
+
+// Copy a node so that it can be modified before being published. The original
+// node is retired.
+static struct banlist_node* _banlist_node_copy(struct banlist_node* node)
+{
+    struct banlist_node* copy = quick_malloc(sizeof(struct banlist_node), BULB_ALLOC_BANLIST);
+    *copy = *node;
+    epoch_retire(node, quick_free);
+    return copy;
+}
+
+// Find the node holding exactly the given prefix, which may be a tombstone. Returns
+// NULL if not found.
+static struct banlist_node* _banlist_find_exact(struct banlist_node* node, uint32_t prefix, uint8_t prefix_len)
+{
+    while (node != NULL && node->prefix_len <= prefix_len)
+    {
+        if ((prefix & _banlist_mask(node->prefix_len)) != node->prefix)
+            return NULL;
+        if (node->prefix_len == prefix_len)
+            return (node->reason != NULL) ? node : NULL;
+        node = node->children[_banlist_bit(prefix, node->prefix_len)];
+    }
+    return NULL;
+}
+
+// Find the ban reason of the longest banned prefix containing the given prefix.
+// Returns NULL if not found.
+static const char* _banlist_find_longest(struct banlist_view* view, uint32_t prefix, uint8_t prefix_len)
+{
+    // Gather the overlay's bans and unbans along the path to the prefix.
+    const char* overlay[33] = { 0 };
+    uint64_t lengths = view->base->length_mask & ((2ULL << prefix_len) - 1);
+    for (struct banlist_node* node = view->root; node != NULL && node->prefix_len <= prefix_len; )
+    {
+        if ((prefix & _banlist_mask(node->prefix_len)) != node->prefix)
+            break;
+        if (node->reason != NULL)
+        {
+            overlay[node->prefix_len] = node->reason;
+            lengths |= 1ULL << node->prefix_len;
+        }
+        if (node->prefix_len == 32)
+            break;
+        node = node->children[_banlist_bit(prefix, node->prefix_len)];
+    }
+
+    // Then search each prefix length that holds a ban, from the longest down. The
+    // overlay takes precedence over the banlist file.
+    for (int len = prefix_len; len >= 0; len--)
+    {
+        if (!(lengths & (1ULL << len)))
+            continue;
+        if (overlay[len] != NULL)
+        {
+            if (overlay[len] != banlist_tombstone)
+                return overlay[len];
+            continue;
+        }
+        const char* reason = banlist_base_find(view->base, prefix & _banlist_mask(len), (uint8_t)len);
+        if (reason != NULL)
+            return reason;
+    }
+    return NULL;
+}
+
+// Insert a ban into the subtree rooted at node, which must not already hold the
+// prefix. Returns the new root of the subtree.
+static struct banlist_node* _banlist_insert(struct banlist_node* node, uint32_t prefix, uint8_t prefix_len,
+                                            char* reason)
+{
+    if (node == NULL)
+        return _banlist_node_new(prefix, prefix_len, reason);
+
+    // Count the leading bits shared by the node's prefix and the new prefix.
+    uint8_t common = 0;
+    uint32_t diff = prefix ^ node->prefix;
+    while (common < MIN(prefix_len, node->prefix_len) && _banlist_bit(diff, common) == 0)
+        common++;
+
+    // The new prefix lies within the node's prefix, so insert below it.
+    if (common == node->prefix_len && common < prefix_len)
+    {
+        struct banlist_node* copy = _banlist_node_copy(node);
+        unsigned bit = _banlist_bit(prefix, common);
+        copy->children[bit] = _banlist_insert(copy->children[bit], prefix, prefix_len, reason);
+        return copy;
+    }
+
+    // The node only joins two branches at the new prefix, so it gains its reason.
+    if (common == node->prefix_len)
+    {
+        struct banlist_node* copy = _banlist_node_copy(node);
+        copy->reason = reason;
+        return copy;
+    }
+
+    // The node's prefix lies within the new prefix, so the node is placed below it.
+    if (common == prefix_len)
+    {
+        struct banlist_node* new_node = _banlist_node_new(prefix, prefix_len, reason);
+        new_node->children[_banlist_bit(node->prefix, common)] = node;
+        return new_node;
+    }
+
+    // Otherwise, both prefixes diverge, so join them under a new branch node.
+    struct banlist_node* branch = _banlist_node_new(prefix & _banlist_mask(common), common, NULL);
+    struct banlist_node* leaf = _banlist_node_new(prefix, prefix_len, reason);
+    unsigned bit = _banlist_bit(prefix, common);
+    branch->children[bit] = leaf;
+    branch->children[!bit] = node;
+    return branch;
+}
+
+// Remove the ban of a prefix from the subtree rooted at node, which must hold the
+// prefix. Returns the new root of the subtree.
+static struct banlist_node* _banlist_remove(struct banlist_node* node, uint32_t prefix, uint8_t prefix_len)
+{
+    struct banlist_node* copy;
+    if (node->prefix_len == prefix_len)
+    {
+        // Nodes without a reason are only kept while they branch into two subtrees.
+        if (node->children[0] != NULL && node->children[1] != NULL)
+        {
+            copy = _banlist_node_copy(node);
+            copy->reason = NULL;
+            return copy;
+        }
+        epoch_retire(node, quick_free);
+        return (node->children[0] != NULL) ? node->children[0] : node->children[1];
+    }
+
+    copy = _banlist_node_copy(node);
+    unsigned bit = _banlist_bit(prefix, node->prefix_len);
+    copy->children[bit] = _banlist_remove(copy->children[bit], prefix, prefix_len);
+    if (copy->reason == NULL && (copy->children[0] == NULL || copy->children[1] == NULL))
+    {
+        struct banlist_node* child = (copy->children[0] != NULL) ? copy->children[0] : copy->children[1];
+        quick_free(copy);
+        return child;
+    }
+    return copy;
+}
+
+// Ban a prefix in an overlay of the given banlist file. Returns false if the prefix
+// is already banned.
+static bool _banlist_apply_ban(struct banlist_base* base, struct banlist_node** root, uint32_t prefix,
+                               uint8_t prefix_len, const char* reason)
+{
+    struct banlist_node* node = _banlist_find_exact(*root, prefix, prefix_len);
+    if (node != NULL && node->reason != banlist_tombstone)
+        return false;
+    if (node == NULL && banlist_base_find(base, prefix, prefix_len) != NULL)
+        return false;
+
+    // A ban that replaces an unban is reinserted with its new reason.
+    if (node != NULL)
+        *root = _banlist_remove(*root, prefix, prefix_len);
+    *root = _banlist_insert(*root, prefix, prefix_len, _banlist_reason_new(reason));
+    return true;
+}
+
+// Unban a prefix in an overlay of the given banlist file. Returns false if the
+// prefix was not banned.
+static bool _banlist_apply_unban(struct banlist_base* base, struct banlist_node** root, uint32_t prefix,
+                                 uint8_t prefix_len)
+{
+    struct banlist_node* node = _banlist_find_exact(*root, prefix, prefix_len);
+    if (node != NULL && node->reason == banlist_tombstone)
+        return false;
+    bool in_base = (banlist_base_find(base, prefix, prefix_len) != NULL);
+    if (node == NULL && !in_base)
+        return false;
+
+    // Bans held by the banlist file are masked by a tombstone.
+    if (node != NULL)
+    {
+        epoch_retire(node->reason, _banlist_reason_free);
+        *root = _banlist_remove(*root, prefix, prefix_len);
+    }
+    if (in_base)
+        *root = _banlist_insert(*root, prefix, prefix_len, banlist_tombstone);
+    return true;
+}
+
+// Apply a journal record to an overlay. This is invoked by banlist_journal_replay().
+static void _banlist_replay(void* data, enum banlist_journal_op op, uint32_t prefix, uint8_t prefix_len,
+                            const char* reason)
+{
+    struct banlist_replay* replay = (struct banlist_replay*)data;
+    if (op == BANLIST_JOURNAL_BAN)
+        _banlist_apply_ban(replay->base, &replay->root, prefix, prefix_len, reason);
+    else
+        _banlist_apply_unban(replay->base, &replay->root, prefix, prefix_len);
+}
+
+// Free every node and ban reason in an overlay. This can be passed to epoch_retire().
+static void _banlist_tree_free(void* root)
+{
+    // Each node is freed once its children are pushed onto the stack, whose depth is
+    // bounded by the 33 possible prefix lengths.
+    struct banlist_node* stack[66];
+    unsigned depth = 0;
+    if (root != NULL)
+        stack[depth++] = root;
+    while (depth > 0)
+    {
+        struct banlist_node* node = stack[--depth];
+        for (int i = 0; i < 2; i++)
+            if (node->children[i] != NULL)
+                stack[depth++] = node->children[i];
+        _banlist_reason_free(node->reason);
+        quick_free(node);
+    }
+}
+
+// Unmap a banlist file. This can be passed to epoch_retire().
+static void _banlist_base_release(void* base)
+{
+    banlist_base_unmap((struct banlist_base*)base);
+}
+
+// Publish a new view of the banlist. The write lock must be held. The previous view
+// is retired, but not its banlist file or overlay.
+static void _banlist_publish(struct banlist* banlist, struct banlist_base* base, struct banlist_node* root)
+{
+    struct banlist_view* view = quick_malloc(sizeof(struct banlist_view), BULB_ALLOC_BANLIST);
+    view->base = base;
+    view->root = root;
+    struct banlist_view* old_view = atomic_exchange(&banlist->view, view);
+    if (old_view != NULL)
+        epoch_retire(old_view, quick_free);
+}
+
+// Get the range of admission filter blocks overlapping a prefix.
+static inline uint32_t _banlist_filter_range(uint32_t prefix, uint8_t prefix_len, uint32_t* count)
+{
+    *count = (prefix_len >= BANLIST_FILTER_BITS) ? 1 : (1u << (BANLIST_FILTER_BITS - prefix_len));
+    return prefix >> (32 - BANLIST_FILTER_BITS);
+}
+
+// Mark the admission filter blocks overlapping a ban. This must happen before the
+// ban is published.
+static void _banlist_filter_mark(struct banlist* banlist, uint32_t prefix, uint8_t prefix_len)
+{
+    uint32_t count;
+    uint32_t first = _banlist_filter_range(prefix, prefix_len, &count);
+    for (uint32_t block = first; block < first + count; block++)
+        atomic_fetch_or(&banlist->filter[block / 64], 1ULL << (block % 64));
+}
+
+// Check if any ban may overlap an address.
+static inline bool _banlist_filter_test(struct banlist* banlist, uint32_t addr)
+{
+    uint32_t block = addr >> (32 - BANLIST_FILTER_BITS);
+    return (atomic_load(&banlist->filter[block / 64]) & (1ULL << (block % 64))) != 0;
+}
+
+// Mark the admission filter blocks overlapping each ban of a banlist file, or of an
+// overlay if base is NULL.
+static void _banlist_filter_build(uint64_t* filter, struct banlist_base* base, struct banlist_node* root)
+{
+    uint32_t first;
+    uint32_t count;
+    if (base != NULL)
+    {
+        uint32_t base_count = (base->header != NULL) ? base->header->count : 0;
+        for (uint32_t i = 0; i < base_count; i++)
+        {
+            first = _banlist_filter_range(base->entries[i].prefix, base->entries[i].prefix_len, &count);
+            for (uint32_t block = first; block < first + count; block++)
+                filter[block / 64] |= 1ULL << (block % 64);
+        }
+        return;
+    }
+
+    struct banlist_node* stack[66];
+    unsigned depth = 0;
+    if (root != NULL)
+        stack[depth++] = root;
+    while (depth > 0)
+    {
+        struct banlist_node* node = stack[--depth];
+        for (int i = 0; i < 2; i++)
+            if (node->children[i] != NULL)
+                stack[depth++] = node->children[i];
+        if (node->reason == NULL || node->reason == banlist_tombstone)
+            continue;
+        first = _banlist_filter_range(node->prefix, node->prefix_len, &count);
+        for (uint32_t block = first; block < first + count; block++)
+            filter[block / 64] |= 1ULL << (block % 64);
+    }
+}
+
+// Replace the admission filter. The write lock must be held, and the filter must
+// cover every ban of the published view.
+static void _banlist_filter_store(struct banlist* banlist, const uint64_t* filter)
+{
+    for (unsigned i = 0; i < BANLIST_FILTER_WORDS; i++)
+        atomic_store(&banlist->filter[i], filter[i]);
+}
+
+// Wake the persistence thread, optionally requesting that it compacts the journal.
+static void _banlist_persist_signal(struct banlist* banlist, bool compact)
+{
+    mtx_lock(&banlist->persist_lock);
+    banlist->compact_requested |= compact;
+    cnd_signal(&banlist->persist_cond);
+    mtx_unlock(&banlist->persist_lock);
+}
+
+// Queue a journal record to be written by the persistence thread. The write lock
+// must be held.
+static void _banlist_journal(struct banlist* banlist, enum banlist_journal_op op, uint32_t prefix,
+                             uint8_t prefix_len, const char* reason)
+{
+    if (banlist->pending_capacity - banlist->pending_size < BANLIST_JOURNAL_MAX_RECORD)
+    {
+        size_t capacity = MAX(banlist->pending_capacity * 2, banlist->pending_size + BANLIST_JOURNAL_MAX_RECORD);
+        char* pending = quick_malloc(capacity, BULB_ALLOC_BANLIST);
+        if (banlist->pending != NULL)
+            memcpy(pending, banlist->pending, banlist->pending_size);
+        quick_free(banlist->pending);
+        banlist->pending = pending;
+        banlist->pending_capacity = capacity;
+    }
+    banlist->pending_size += banlist_journal_encode(banlist->pending + banlist->pending_size, op, prefix,
+        prefix_len, reason);
 
-    // xxx.xxx.xxx.xxx [reason]\0
-    char line_buffer[IPV4_ADDRESS_STRLEN + 1 + MAX_BANLIST_REASON_LENGTH + 1]; 
+    // Large batches of changes are written without waiting for the next interval.
+    if (banlist->pending_size >= BANLIST_FLUSH_SIZE)
+        _banlist_persist_signal(banlist, false);
+}
+
+// Take every queued journal record. The write lock must be held.
+static char* _banlist_take_pending(struct banlist* banlist, size_t* size)
+{
+    char* pending = banlist->pending;
+    *size = banlist->pending_size;
+    banlist->pending = NULL;
+    banlist->pending_size = 0;
+    banlist->pending_capacity = 0;
+    return pending;
+}
+
+// Add a ban to the banlist. Returns false if the prefix is already banned.
+static bool _banlist_add(struct banlist* banlist, uint32_t prefix, uint8_t prefix_len, const char* reason)
+{
+    mtx_lock(&banlist->write_lock);
+    epoch_enter();
+    struct banlist_view* view = atomic_load(&banlist->view);
+    struct banlist_node* root = view->root;
+    bool result = _banlist_apply_ban(view->base, &root, prefix, prefix_len, reason);
+    if (result)
+    {
+        _banlist_filter_mark(banlist, prefix, prefix_len);
+        _banlist_publish(banlist, view->base, root);
+        _banlist_journal(banlist, BANLIST_JOURNAL_BAN, prefix, prefix_len, reason);
+    }
+    epoch_exit();
+    mtx_unlock(&banlist->write_lock);
+    return result;
+}
+
+// Remove a ban from the banlist. Returns false if the prefix was not banned.
+static bool _banlist_delete(struct banlist* banlist, uint32_t prefix, uint8_t prefix_len)
+{
+    mtx_lock(&banlist->write_lock);
+    epoch_enter();
+    struct banlist_view* view = atomic_load(&banlist->view);
+    struct banlist_node* root = view->root;
+    bool result = _banlist_apply_unban(view->base, &root, prefix, prefix_len);
+    if (result)
+    {
+        _banlist_publish(banlist, view->base, root);
+        _banlist_journal(banlist, BANLIST_JOURNAL_UNBAN, prefix, prefix_len, NULL);
+    }
+    epoch_exit();
+    mtx_unlock(&banlist->write_lock);
+    return result;
+}
+
+// Order changes by prefix length, and then by prefix, as in a banlist file.
+static int _banlist_change_compare(const void* a, const void* b)
+{
+    const struct banlist_change* x = (const struct banlist_change*)a;
+    const struct banlist_change* y = (const struct banlist_change*)b;
+    if (x->prefix_len != y->prefix_len)
+        return (x->prefix_len < y->prefix_len) ? -1 : 1;
+    return (x->prefix < y->prefix) ? -1 : (x->prefix > y->prefix);
+}
+
+// Copy every ban and unban held by an overlay into a sorted array. The write lock
+// must be held. Returns the number of changes.
+static size_t _banlist_flatten(struct banlist_node* root, struct banlist_change** changes)
+{
+    size_t count = 0;
+    size_t capacity = 64;
+    *changes = quick_malloc(sizeof(struct banlist_change) * capacity, BULB_ALLOC_BANLIST);
+
+    struct banlist_node* stack[66];
+    unsigned depth = 0;
+    if (root != NULL)
+        stack[depth++] = root;
+    while (depth > 0)
+    {
+        struct banlist_node* node = stack[--depth];
+        for (int i = 0; i < 2; i++)
+            if (node->children[i] != NULL)
+                stack[depth++] = node->children[i];
+        if (node->reason == NULL)
+            continue;
+
+        if (count == capacity)
+        {
+            struct banlist_change* grown = quick_malloc(sizeof(struct banlist_change) * capacity * 2,
+                BULB_ALLOC_BANLIST);
+            memcpy(grown, *changes, sizeof(struct banlist_change) * count);
+            quick_free(*changes);
+            *changes = grown;
+            capacity *= 2;
+        }
+        (*changes)[count++] = (struct banlist_change){
+            .prefix = node->prefix,
+            .prefix_len = node->prefix_len,
+            .reason = (node->reason != banlist_tombstone) ? _banlist_reason_new(node->reason) : NULL
+        };
+    }
+
+    qsort(*changes, count, sizeof(struct banlist_change), _banlist_change_compare);
+    return count;
+}
+
+// Release the changes returned by _banlist_flatten().
+static void _banlist_changes_free(struct banlist_change* changes, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        quick_free(changes[i].reason);
+    quick_free(changes);
+}
+
+// Pass every ban of a banlist file with a set of changes applied to sink, in the
+// order they are stored in a banlist file. Returns false if sink fails.
+static bool _banlist_merge(struct banlist_base* base, struct banlist_change* changes, size_t count,
+                           banlist_sink_func sink, void* data)
+{
+    uint32_t base_count = (base->header != NULL) ? base->header->count : 0;
+    uint32_t i = 0;
+    size_t j = 0;
+    while (i < base_count || j < count)
+    {
+        const struct banlist_file_entry* entry = (i < base_count) ? &base->entries[i] : NULL;
+        int order = (entry == NULL) ? 1 : (j == count) ? -1 : _banlist_change_compare(
+            &(struct banlist_change){ .prefix = entry->prefix, .prefix_len = entry->prefix_len }, &changes[j]);
+
+        // Changes replace any ban of the same prefix held by the banlist file.
+        bool result = true;
+        if (order < 0)
+            result = sink(data, entry->prefix, entry->prefix_len, banlist_base_reason(base, entry));
+        else if (changes[j].reason != NULL)
+            result = sink(data, changes[j].prefix, changes[j].prefix_len, changes[j].reason);
+        if (!result)
+            return false;
+
+        if (order <= 0)
+            i++;
+        if (order >= 0)
+            j++;
+    }
+    return true;
+}
+
+// Write a ban to a banlist file. This is passed to _banlist_merge().
+static bool _banlist_sink_file(void* data, uint32_t prefix, uint8_t prefix_len, const char* reason)
+{
+    return banlist_file_writer_add((struct banlist_file_writer*)data, prefix, prefix_len, reason);
+}
+
+// Write a ban to a banlist text file. This is passed to _banlist_merge().
+static bool _banlist_sink_text(void* data, uint32_t prefix, uint8_t prefix_len, const char* reason)
+{
+    char buffer[BANLIST_PREFIX_STRLEN];
+    _banlist_format(buffer, prefix, prefix_len);
+    return fprintf((FILE*)data, "%s %s\n", buffer, reason) >= 0;
+}
+
+// Write journal records to the journal and flush them to permanent storage. The
+// records are freed. Returns false on failure.
+static bool _banlist_write_journal(struct banlist* banlist, char* records, size_t size)
+{
+    bool result = true;
+    if (size > 0)
+    {
+        result = (banlist->journal != NULL) && (fwrite(records, 1, size, banlist->journal) == size)
+            && banlist_file_sync(banlist->journal);
+        banlist->journal_size += size;
+        ASSERT(result, (void)0, "Failed to write to the banlist journal\n");
+    }
+    quick_free(records);
+    return result;
+}
+
+// Write every queued journal record. Returns false on failure.
+static bool _banlist_flush(struct banlist* banlist)
+{
+    size_t size;
+    mtx_lock(&banlist->write_lock);
+    char* records = _banlist_take_pending(banlist, &size);
+    mtx_unlock(&banlist->write_lock);
+    return _banlist_write_journal(banlist, records, size);
+}
+
+// Move the journal aside so that its records can be compacted, and start a new
+// journal. Returns false on failure.
+static bool _banlist_rotate_journal(struct banlist* banlist)
+{
+    if (banlist->journal != NULL)
+        fclose(banlist->journal);
+    banlist->journal = NULL;
+    banlist->journal_size = 0;
+
+    // If a previous compaction failed, its journal is still waiting to be compacted,
+    // so the current journal is appended to it.
+    FILE* old_journal = fopen(banlist->paths.old_journal, "rb");
+    bool result = true;
+    if (old_journal == NULL)
+    {
+        FILE* journal = fopen(banlist->paths.journal, "rb");
+        if (journal != NULL)
+        {
+            fclose(journal);
+            result = banlist_file_replace(banlist->paths.journal, banlist->paths.old_journal);
+        }
+    }
+    else
+    {
+        fclose(old_journal);
+        old_journal = fopen(banlist->paths.old_journal, "ab");
+        FILE* journal = fopen(banlist->paths.journal, "rb");
+        result = (old_journal != NULL);
+        if (result && journal != NULL)
+        {
+            char buffer[4096];
+            size_t len;
+            while ((len = fread(buffer, 1, sizeof(buffer), journal)) > 0)
+                result = result && (fwrite(buffer, 1, len, old_journal) == len);
+            result = result && banlist_file_sync(old_journal);
+        }
+        if (old_journal != NULL)
+            fclose(old_journal);
+        if (journal != NULL)
+            fclose(journal);
+        if (result)
+            remove(banlist->paths.journal);
+    }
+
+    banlist->journal = fopen(banlist->paths.journal, "ab");
+    ASSERT(banlist->journal != NULL, return false, "Failed to open the banlist journal\n");
+    return result;
+}
 
-    FILE* file = fopen("banlist.txt", "a+");
-    ASSERT(file != NULL, return false);
-    
-    server->banlist = trie_new();
-    while (fgets(line_buffer, sizeof(line_buffer), file) != NULL)
+// Compact the journal into a new banlist file. Bans and unbans made while the file
+// is being written are kept in a new journal. Returns false on failure.
+static bool _banlist_compact(struct banlist* banlist)
+{
+    // Take a consistent snapshot of the overlay, along with every journal record
+    // leading up to it.
+    mtx_lock(&banlist->write_lock);
+    struct banlist_view* view = atomic_load(&banlist->view);
+    struct banlist_base* base = view->base;
+    if (view->root == NULL && banlist->pending_size == 0 && banlist->journal_size == 0)
+    {
+        // There is nothing to compact.
+        mtx_unlock(&banlist->write_lock);
+        return true;
+    }
+    size_t size;
+    char* records = _banlist_take_pending(banlist, &size);
+    struct banlist_change* changes;
+    size_t count = _banlist_flatten(view->root, &changes);
+    mtx_unlock(&banlist->write_lock);
+
+    // The banlist file is only replaced by this thread, so it is written without
+    // blocking writers.
+    bool result = _banlist_write_journal(banlist, records, size) && _banlist_rotate_journal(banlist);
+    struct banlist_base* new_base = NULL;
+    if (result)
     {
-        // Read the address for this record.
-        char ip_addr[IPV4_ADDRESS_STRLEN] = { 0 };
-        size_t i = 0;
-        size_t line_buffer_len = strlen(line_buffer);
-        for (; i < sizeof(ip_addr) && i < line_buffer_len; i++)
+        struct banlist_file_writer* writer = banlist_file_writer_open(banlist->paths.file);
+        result = (writer != NULL);
+        if (result && !_banlist_merge(base, changes, count, _banlist_sink_file, writer))
+        {
+            banlist_file_writer_abort(writer);
+            result = false;
+        }
+        else if (result)
         {
-            if (isspace(line_buffer[i]))
-                break;
-            ip_addr[strlen(ip_addr)] = line_buffer[i];
+            result = banlist_file_writer_commit(writer);
         }
+        if (result)
+            result = ((new_base = banlist_base_map(banlist->paths.file)) != NULL);
+    }
+    _banlist_changes_free(changes, count);
+
+    // Rebuild the overlay from the changes made since the snapshot, which are still
+    // queued to be written to the new journal. The admission filter is rebuilt too,
+    // dropping the blocks of any bans that have since been removed.
+    if (result)
+    {
+        uint64_t* filter = quick_malloc(sizeof(uint64_t) * BANLIST_FILTER_WORDS, BULB_ALLOC_BANLIST);
+        _banlist_filter_build(filter, new_base, NULL);
+
+        mtx_lock(&banlist->write_lock);
+        struct banlist_replay replay = { .base = new_base };
+        banlist_journal_decode(banlist->pending, banlist->pending_size, _banlist_replay, &replay);
+        _banlist_filter_build(filter, NULL, replay.root);
+
+        struct banlist_node* old_root = atomic_load(&banlist->view)->root;
+        _banlist_publish(banlist, new_base, replay.root);
+        _banlist_filter_store(banlist, filter);
+        epoch_retire(old_root, _banlist_tree_free);
+        epoch_retire(base, _banlist_base_release);
+        mtx_unlock(&banlist->write_lock);
+        remove(banlist->paths.old_journal);
+        quick_free(filter);
+    }
+    return result;
+}
+
+// Parse a line of a banlist text file. Returns false if the line does not hold a ban.
+static bool _banlist_parse_line(char* line, struct banlist_change* change)
+{
+    // Read the address for this record.
+    char ip_addr[BANLIST_PREFIX_STRLEN] = { 0 };
+    size_t i = 0;
+    size_t line_len = strlen(line);
+    for (; i < sizeof(ip_addr) - 1 && i < line_len; i++)
+    {
+        if (isspace(line[i]))
+            break;
+        ip_addr[i] = line[i];
+    }
+    if (!_banlist_parse(ip_addr, &change->prefix, &change->prefix_len))
+        return false;
+
+    // Optionally read the record's ban reason, if one is specified.
+    const char* reason = "";
+    if (i + 1 < line_len)
+    {
+        reason = line + i + 1;
+        line[strcspn(line, "\r\n")] = '\0';
+    }
+    change->reason = _banlist_reason_new(reason);
+    return true;
+}
+
+// Add every ban of a banlist text file. Returns false on failure.
+static bool _banlist_import(struct banlist* banlist, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    ASSERT(file != NULL, return false, "Failed to open banlist text file \"%s\"\n", path);
 
-        // If the address for this record already exists, filter it out.
-        if (trie_find(server->banlist, ip_addr) != NULL)
+    // Lines are read in batches without holding the write lock, so that writers are
+    // not blocked on reading the file.
+    struct banlist_change* batch = quick_malloc(sizeof(struct banlist_change) * BANLIST_IMPORT_BATCH,
+        BULB_ALLOC_BANLIST);
+    bool eof = false;
+    while (!eof)
+    {
+        // xxx.xxx.xxx.xxx/xx [reason]\0
+        char line_buffer[BANLIST_PREFIX_STRLEN + 1 + MAX_BANLIST_REASON_LENGTH + 1];
+        size_t count = 0;
+        while (count < BANLIST_IMPORT_BATCH && !(eof = (fgets(line_buffer, sizeof(line_buffer), file) == NULL)))
+            if (_banlist_parse_line(line_buffer, &batch[count]))
+                count++;
+        if (count == 0)
             continue;
 
-        // Create a new banlist record and optionally read into its reason field,
-        // if a ban reason is specified.
-        struct banlist_record* record = quick_malloc(sizeof(struct banlist_record));
-        strncpy(record->ip_addr, ip_addr, sizeof(record->ip_addr));
-        if (i + 1 < line_buffer_len)
+        mtx_lock(&banlist->write_lock);
+        epoch_enter();
+        struct banlist_view* view = atomic_load(&banlist->view);
+        struct banlist_node* root = view->root;
+        for (size_t i = 0; i < count; i++)
         {
-            strncpy(record->reason, line_buffer + i + 1, sizeof(record->reason));
-            size_t len = strlen(record->reason);
-            if (record->reason[len - 1] == '\n')
-                record->reason[len - 1] = '\0';
+            // Any duplicate records are filtered out.
+            if (_banlist_apply_ban(view->base, &root, batch[i].prefix, batch[i].prefix_len, batch[i].reason))
+            {
+                _banlist_filter_mark(banlist, batch[i].prefix, batch[i].prefix_len);
+                _banlist_journal(banlist, BANLIST_JOURNAL_BAN, batch[i].prefix, batch[i].prefix_len,
+                    batch[i].reason);
+            }
+            quick_free(batch[i].reason);
         }
+        _banlist_publish(banlist, view->base, root);
+        bool flush = (banlist->pending_size >= BANLIST_FLUSH_SIZE);
+        epoch_exit();
+        mtx_unlock(&banlist->write_lock);
 
-        // Add this record to the banlist dictionary.
-        if (trie_add(server->banlist, record->ip_addr, record) == NULL)
-            free(record);
+        if (flush)
+            _banlist_flush(banlist);
     }
 
+    quick_free(batch);
     fclose(file);
     return true;
 }
 
-// Add a new IP address to the banlist database. Returns false if the address
-// is already present, or on failure.
-bool server_banlist_addip(struct bulb_server* server, 
-                          const char* ip_addr, 
-                          const char* reason, 
-                          bool* already_banned)
+// Write every ban to a banlist text file, which is replaced atomically. Returns
+// false on failure.
+static bool _banlist_export(struct banlist* banlist, const char* path)
+{
+    // The banlist file is only replaced by this thread, so it can be read once the
+    // overlay has been copied.
+    mtx_lock(&banlist->write_lock);
+    struct banlist_base* base = atomic_load(&banlist->view)->base;
+    struct banlist_change* changes;
+    size_t count = _banlist_flatten(atomic_load(&banlist->view)->root, &changes);
+    mtx_unlock(&banlist->write_lock);
+
+    size_t path_len = strlen(path);
+    char* temp_path = quick_malloc(path_len + sizeof(".tmp"), BULB_ALLOC_BANLIST);
+    memcpy(temp_path, path, path_len);
+    strcpy(temp_path + path_len, ".tmp");
+
+    FILE* file = fopen(temp_path, "w");
+    bool result = (file != NULL) && _banlist_merge(base, changes, count, _banlist_sink_text, file)
+        && banlist_file_sync(file);
+    if (file != NULL)
+        result = (fclose(file) == 0) && result;
+    result = result && banlist_file_replace(temp_path, path);
+    if (!result)
+        remove(temp_path);
+    ASSERT(result, (void)0, "Failed to write banlist text file \"%s\"\n", path);
+
+    _banlist_changes_free(changes, count);
+    quick_free(temp_path);
+    return result;
+}
+
+// Write queued journal records periodically, compacting the journal once it grows
+// long enough, and run any queued imports and exports.
+static int _banlist_persist_thread(void* data)
+{
+    struct banlist* banlist = (struct banlist*)data;
+    mtx_lock(&banlist->persist_lock);
+    for (;;)
+    {
+        if (!banlist->stop_requested && !banlist->compact_requested && banlist->tasks == NULL)
+        {
+            struct timespec deadline;
+            timespec_get(&deadline, TIME_UTC);
+            deadline.tv_sec += BANLIST_FLUSH_INTERVAL_S;
+            cnd_timedwait(&banlist->persist_cond, &banlist->persist_lock, &deadline);
+        }
+
+        // The journal is compacted one last time before the thread terminates.
+        bool stop = banlist->stop_requested;
+        bool compact = banlist->compact_requested || stop;
+        struct banlist_task* tasks = banlist->tasks;
+        banlist->compact_requested = false;
+        banlist->tasks = banlist->tasks_tail = NULL;
+        mtx_unlock(&banlist->persist_lock);
+
+        while (tasks != NULL)
+        {
+            struct banlist_task* next = tasks->next;
+            if (tasks->is_import)
+                _banlist_import(banlist, tasks->path);
+            else
+                _banlist_export(banlist, tasks->path);
+            quick_free(tasks);
+            tasks = next;
+        }
+
+        _banlist_flush(banlist);
+        if (compact || banlist->journal_size >= BANLIST_COMPACT_SIZE)
+            _banlist_compact(banlist);
+        if (stop)
+            return 0;
+        mtx_lock(&banlist->persist_lock);
+    }
+}
+
+// Queue an import or export for the persistence thread.
+static void _banlist_queue_task(struct banlist* banlist, const char* path, bool is_import)
+{
+    size_t path_len = strlen(path);
+    struct banlist_task* task = quick_malloc(sizeof(struct banlist_task) + path_len + 1, BULB_ALLOC_BANLIST);
+    task->is_import = is_import;
+    memcpy(task->path, path, path_len + 1);
+
+    mtx_lock(&banlist->persist_lock);
+    if (banlist->tasks_tail != NULL)
+        banlist->tasks_tail->next = task;
+    else
+        banlist->tasks = task;
+    banlist->tasks_tail = task;
+    cnd_signal(&banlist->persist_cond);
+    mtx_unlock(&banlist->persist_lock);
+}
+
+// Free the banlist. No other thread may still be reading from it.
+static void _banlist_free(struct banlist* banlist)
+{
+    struct banlist_view* view = atomic_load(&banlist->view);
+    if (view != NULL)
+    {
+        _banlist_tree_free(view->root);
+        banlist_base_unmap(view->base);
+        quick_free(view);
+    }
+    while (banlist->tasks != NULL)
+    {
+        struct banlist_task* next = banlist->tasks->next;
+        quick_free(banlist->tasks);
+        banlist->tasks = next;
+    }
+    if (banlist->journal != NULL)
+        fclose(banlist->journal);
+    quick_free(banlist->pending);
+    mtx_destroy(&banlist->write_lock);
+    mtx_destroy(&banlist->persist_lock);
+    cnd_destroy(&banlist->persist_cond);
+    quick_free(banlist);
+}
+
+// Get the path of each file of a server's banlist database. The virtual servers of a
+// host each keep a banlist database of their own, whose files are prefixed with the
+// virtual server's name.
+static void _banlist_paths_init(struct banlist_paths* paths, struct bulb_server* server)
+{
+    const char* prefix = "";
+    const char* separator = "";
+    if (server->host != NULL && server->server_node->info.name[0] != '\0')
+    {
+        prefix = server->server_node->info.name;
+        separator = ".";
+    }
+    snprintf(paths->file, sizeof(paths->file), "%s%s%s", prefix, separator, BANLIST_FILE_NAME);
+    snprintf(paths->text, sizeof(paths->text), "%s%s%s", prefix, separator, BANLIST_TEXT_FILE_NAME);
+    snprintf(paths->journal, sizeof(paths->journal), "%s%s%s", prefix, separator, BANLIST_JOURNAL_NAME);
+    snprintf(paths->old_journal, sizeof(paths->old_journal), "%s%s%s", prefix, separator, 
+        BANLIST_OLD_JOURNAL_NAME);
+}
+
+// Read the banlist database from its file and journal, and start its persistence
+// thread. If no database file exists, any banlist text file is imported. Returns
+// false on failure.
+bool server_banlist_load(struct bulb_server* server)
 {
     ASSERT(server != NULL, return false);
-    if (server->banlist == NULL)
+    server_banlist_close(server);
+
+    struct banlist_paths paths;
+    _banlist_paths_init(&paths, server);
+    struct banlist_base* base = banlist_base_map(paths.file);
+    if (base == NULL)
         return false;
 
-    bool found = (trie_find(server->banlist, ip_addr) != NULL);
-    if (already_banned != NULL)
-        *already_banned = found;
-    if (found)
+    // Replay any journal left by an interrupted compaction, followed by the journal.
+    struct banlist_replay replay = { .base = base };
+    banlist_journal_replay(paths.old_journal, _banlist_replay, &replay);
+    banlist_journal_replay(paths.journal, _banlist_replay, &replay);
+
+    struct banlist* banlist = quick_malloc(sizeof(struct banlist), BULB_ALLOC_BANLIST);
+    banlist->paths = paths;
+    mtx_init(&banlist->write_lock, mtx_plain);
+    mtx_init(&banlist->persist_lock, mtx_plain);
+    cnd_init(&banlist->persist_cond);
+    _banlist_publish(banlist, base, replay.root);
+    uint64_t* filter = quick_malloc(sizeof(uint64_t) * BANLIST_FILTER_WORDS, BULB_ALLOC_BANLIST);
+    _banlist_filter_build(filter, base, NULL);
+    _banlist_filter_build(filter, NULL, replay.root);
+    _banlist_filter_store(banlist, filter);
+    quick_free(filter);
+    banlist->journal = fopen(banlist->paths.journal, "ab");
+    ASSERT(banlist->journal != NULL,
+    {
+        _banlist_free(banlist);
         return false;
+    }, "Failed to open the banlist journal\n");
+    fseek(banlist->journal, 0, SEEK_END);
+    banlist->journal_size = (size_t)MAX(ftell(banlist->journal), 0);
+
+    // Migrate from the text format used by earlier versions of Bulb.
+    FILE* text = (base->header == NULL) ? fopen(banlist->paths.text, "r") : NULL;
+    if (text != NULL)
+    {
+        fclose(text);
+        _banlist_queue_task(banlist, banlist->paths.text, true);
+    }
 
-    struct banlist_record* record = quick_malloc(sizeof(struct banlist_record));
-    strncpy(record->ip_addr, ip_addr, sizeof(record->ip_addr));
-    strncpy(record->reason, reason, sizeof(record->reason));
-    return trie_add(server->banlist, ip_addr, record);
+    ASSERT(thrd_create(&banlist->persist_thread, _banlist_persist_thread, banlist) == thrd_success,
+    {
+        _banlist_free(banlist);
+        return false;
+    }, "Failed to start the banlist persistence thread\n");
+    server->banlist = banlist;
+    return true;
 }
 
-// Remove an IP address from the banlist database. Returns false if the address
-// was not already present, or on failure.
-bool server_banlist_removeip(struct bulb_server* server, 
-                             const char* ip_addr, 
-                             bool* already_banned)
+// Add a new IP address or CIDR range to the banlist database. Returns false if the
+// address is already present, or on failure.
+bool server_banlist_addip(struct bulb_server* server,
+                          const char* ip_addr,
+                          const char* reason,
+                          bool* already_banned)
 {
     ASSERT(server != NULL, return false);
+    if (already_banned != NULL)
+        *already_banned = false;
     if (server->banlist == NULL)
         return false;
 
-    struct banlist_record* record = trie_find(server->banlist, ip_addr);
+    uint32_t prefix;
+    uint8_t prefix_len;
+    ASSERT(_banlist_parse(ip_addr, &prefix, &prefix_len), return false,
+        "Invalid banlist address \"%s\"\n", ip_addr);
+
+    bool result = _banlist_add(server->banlist, prefix, prefix_len, (reason != NULL) ? reason : "");
     if (already_banned != NULL)
-        *already_banned = (record != NULL);
-    if (record == NULL)
+        *already_banned = !result;
+    return result;
+}
+
+// Remove an IP address or CIDR range from the banlist database. Returns false if
+// the address was not already present, or on failure.
+bool server_banlist_removeip(struct bulb_server* server,
+                             const char* ip_addr,
+                             bool* already_banned)
+{
+    ASSERT(server != NULL, return false);
+    if (already_banned != NULL)
+        *already_banned = false;
+    if (server->banlist == NULL)
         return false;
 
-    return trie_delete(server->banlist, ip_addr);
+    uint32_t prefix;
+    uint8_t prefix_len;
+    ASSERT(_banlist_parse(ip_addr, &prefix, &prefix_len), return false,
+        "Invalid banlist address \"%s\"\n", ip_addr);
+
+    bool result = _banlist_delete(server->banlist, prefix, prefix_len);
+    if (already_banned != NULL)
+        *already_banned = result;
+    return result;
 }
 
-// Check if an IP address is already included in the banlist database.
-bool server_banlist_isbanned(struct bulb_server* server, 
-                             const char* ip_addr, 
+// Check if an IP address, or every address of a CIDR range, is included in the
+// banlist database. reason remains valid until the calling thread next checks the
+// banlist.
+bool server_banlist_isbanned(struct bulb_server* server,
+                             const char* ip_addr,
                              const char** reason)
 {
     ASSERT(server != NULL, return false);
     if (server->banlist == NULL)
         return false;
-    
-    struct banlist_record* record = trie_find(server->banlist, ip_addr);
-    if (record == NULL)
+
+    uint32_t prefix;
+    uint8_t prefix_len;
+    if (!_banlist_parse(ip_addr, &prefix, &prefix_len))
+        return false;
+
+    // Most addresses that are not banned are turned away by the admission filter.
+    struct banlist* banlist = (struct banlist*)server->banlist;
+    if (prefix_len >= BANLIST_FILTER_BITS && !_banlist_filter_test(banlist, prefix))
+        return false;
+
+    epoch_enter();
+    const char* found = _banlist_find_longest(atomic_load(&banlist->view), prefix, prefix_len);
+    if (found != NULL && reason != NULL)
+    {
+        strcpy(banlist_reason_buffer, found);
+        *reason = banlist_reason_buffer;
+    }
+    epoch_exit();
+    return found != NULL;
+}
+
+// Queue every ban of a banlist text file to be added to the banlist database. Each
+// line holds an address or CIDR range, optionally followed by a ban reason. Returns
+// false on failure.
+bool server_banlist_import(struct bulb_server* server, const char* path)
+{
+    ASSERT(server != NULL && path != NULL, return false);
+    if (server->banlist == NULL)
+        return false;
+    _banlist_queue_task(server->banlist, path, true);
+    return true;
+}
+
+// Queue every ban in the banlist database to be written to a banlist text file.
+// Returns false on failure.
+bool server_banlist_export(struct bulb_server* server, const char* path)
+{
+    ASSERT(server != NULL && path != NULL, return false);
+    if (server->banlist == NULL)
         return false;
-    if (reason != NULL)
-        *reason = record->reason;
+    _banlist_queue_task(server->banlist, path, false);
     return true;
 }
 
-// Store the banlist database text file onto permanent storage. Returns false
-// on failure.
+// Request that the banlist database's journal is compacted into its file on
+// permanent storage. Returns false on failure.
 bool server_banlist_store(struct bulb_server* server)
 {
     ASSERT(server != NULL, return false);
     if (server->banlist == NULL)
         return false;
-
-    FILE* file = fopen("banlist.txt", "w");
-    ASSERT(file, return false);
-    TRIE_DFS(server->banlist, node,
-    {
-        struct banlist_record* record = (struct banlist_record*)node;
-        fprintf(file, "%s %s\n", record->ip_addr, record->reason);
-    });
-
-    fclose(file);
+    _banlist_persist_signal(server->banlist, true);
     return true;
 }
 
-// De-allocate the loaded banlist database from memory.
+// Write any outstanding changes to the loaded banlist database, and de-allocate it
+// from memory.
 BULB_API void server_banlist_close(struct bulb_server* server)
 {
     ASSERT(server, return);
     if (server->banlist)
     {
-        server_banlist_store(server);
-        trie_free(server->banlist);
+        struct banlist* banlist = (struct banlist*)server->banlist;
+        mtx_lock(&banlist->persist_lock);
+        banlist->stop_requested = true;
+        cnd_signal(&banlist->persist_cond);
+        mtx_unlock(&banlist->persist_lock);
+        thrd_join(banlist->persist_thread, NULL);
+
+        _banlist_free(banlist);
+        server->banlist = NULL;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,377 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+#include "alloc.h"
+#include "bulb_banlist.h"
+#include "banlist_file.h"
+
+#if defined WIN32
+#   include <windows.h>
+#   include <io.h>
+#elif defined __UNIX__
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+// Journal records are followed by reason_len bytes of their ban reason.
+struct banlist_journal_record
+{
+    uint32_t prefix;
+    uint16_t reason_len;
+    uint8_t prefix_len;
+    uint8_t op;
+};
+
+struct banlist_file_writer
+{
+    FILE* file;
+    char* path;
+    char* temp_path;
+    struct banlist_file_header header;
+    unsigned next_len;          // Lengths below this have their length_start set.
+    uint32_t last_prefix;
+
+    // Reasons are gathered in memory, as their offset in the file is only known
+    // once every entry has been written.
+    char* reasons;
+    size_t reasons_size;
+    size_t reasons_capacity;
+    size_t last_reason;
+};
+
+// Copy a string onto the heap.
+static char* _banlist_file_strdup(const char* str, const char* suffix)
+{
+    size_t len = strlen(str);
+    char* copy = quick_malloc(len + strlen(suffix) + 1, BULB_ALLOC_BANLIST);
+    memcpy(copy, str, len);
+    strcpy(copy + len, suffix);
+    return copy;
+}
+
+// Check that a banlist file's header and entries lie within the file.
+static bool _banlist_base_validate(struct banlist_base* base)
+{
+    const struct banlist_file_header* header = base->data;
+    if (base->size < sizeof(*header) || memcmp(header->magic, BANLIST_FILE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != BANLIST_FILE_VERSION)
+        return false;
+
+    uint64_t entries_end = sizeof(*header) + (uint64_t)header->count * sizeof(struct banlist_file_entry);
+    if (header->reasons_offset != entries_end || header->reasons_size == 0
+        || header->reasons_offset + header->reasons_size > base->size)
+        return false;
+
+    base->header = header;
+    base->entries = (const struct banlist_file_entry*)((const char*)base->data + sizeof(*header));
+    base->reasons = (const char*)base->data + header->reasons_offset;
+    if (base->reasons[header->reasons_size - 1] != '\0')
+        return false;
+
+    if (header->length_start[0] != 0 || header->length_start[33] != header->count)
+        return false;
+    for (int len = 0; len <= 32; len++)
+    {
+        if (header->length_start[len] > header->length_start[len + 1])
+            return false;
+        if (header->length_start[len] < header->length_start[len + 1])
+            base->length_mask |= 1ULL << len;
+    }
+    return true;
+}
+
+// Map a banlist file into memory. Returns NULL if the file is malformed.
+struct banlist_base* banlist_base_map(const char* path)
+{
+    ASSERT(path != NULL, return NULL);
+    struct banlist_base* base = quick_malloc(sizeof(struct banlist_base), BULB_ALLOC_BANLIST);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return base;
+
+#if defined WIN32
+    // Read the whole file into memory.
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0)
+    {
+        base->data = quick_malloc((size_t)size, BULB_ALLOC_BANLIST);
+        base->size = (size_t)size;
+        if (fread(base->data, 1, base->size, file) != base->size)
+            base->size = 0;
+    }
+#elif defined __UNIX__
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0)
+    {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (data != MAP_FAILED)
+        {
+            base->data = data;
+            base->size = (size_t)st.st_size;
+        }
+    }
+#endif
+    fclose(file);
+
+    ASSERT(_banlist_base_validate(base),
+    {
+        banlist_base_unmap(base);
+        return NULL;
+    }, "Banlist file \"%s\" is malformed\n", path);
+    return base;
+}
+
+// Unmap a banlist file from memory.
+void banlist_base_unmap(struct banlist_base* base)
+{
+    if (base == NULL)
+        return;
+    if (base->data != NULL)
+    {
+#if defined WIN32
+        quick_free(base->data);
+#elif defined __UNIX__
+        munmap(base->data, base->size);
+#endif
+    }
+    quick_free(base);
+}
+
+// Search a banlist file for an exact prefix. Returns its ban reason, or NULL if
+// the prefix is not present.
+const char* banlist_base_find(const struct banlist_base* base, uint32_t prefix, uint8_t prefix_len)
+{
+    if (!(base->length_mask & (1ULL << prefix_len)))
+        return NULL;
+
+    // Entries of the same prefix length are sorted by their prefix.
+    uint32_t low = base->header->length_start[prefix_len];
+    uint32_t high = base->header->length_start[prefix_len + 1];
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        const struct banlist_file_entry* entry = &base->entries[mid];
+        if (entry->prefix == prefix)
+            return banlist_base_reason(base, entry);
+        if (entry->prefix < prefix)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NULL;
+}
+
+// Get the ban reason of an entry in a banlist file.
+const char* banlist_base_reason(const struct banlist_base* base, const struct banlist_file_entry* entry)
+{
+    // The reasons blob is known to end with a NUL character.
+    return (entry->reason_offset < base->header->reasons_size) ? base->reasons + entry->reason_offset : "";
+}
+
+// Begin writing a new banlist file, which replaces path once it is committed.
+// Returns NULL on failure.
+struct banlist_file_writer* banlist_file_writer_open(const char* path)
+{
+    ASSERT(path != NULL, return NULL);
+    struct banlist_file_writer* writer = quick_malloc(sizeof(struct banlist_file_writer), BULB_ALLOC_BANLIST);
+    writer->path = _banlist_file_strdup(path, "");
+    writer->temp_path = _banlist_file_strdup(path, ".tmp");
+    writer->file = fopen(writer->temp_path, "wb");
+    ASSERT(writer->file != NULL,
+    {
+        banlist_file_writer_abort(writer);
+        return NULL;
+    }, "Failed to create banlist file \"%s\"\n", writer->temp_path);
+
+    // The header is written once every entry is known. Empty reasons all share the
+    // first byte of the reasons blob.
+    memcpy(writer->header.magic, BANLIST_FILE_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = BANLIST_FILE_VERSION;
+    fwrite(&writer->header, sizeof(writer->header), 1, writer->file);
+    writer->reasons_capacity = 4096;
+    writer->reasons = quick_malloc(writer->reasons_capacity, BULB_ALLOC_BANLIST);
+    writer->reasons_size = 1;
+    return writer;
+}
+
+// Append an entry to a banlist file being written. Entries must be appended in
+// the order they are stored in. Returns false on failure.
+bool banlist_file_writer_add(struct banlist_file_writer* writer, uint32_t prefix, uint8_t prefix_len,
+                             const char* reason)
+{
+    ASSERT(writer != NULL && prefix_len <= 32, return false);
+    ASSERT(writer->header.count == 0 || prefix_len >= writer->next_len
+        || (prefix_len == writer->next_len - 1 && prefix > writer->last_prefix), return false,
+        "Banlist file entries must be written in order\n");
+
+    while (writer->next_len <= prefix_len)
+        writer->header.length_start[writer->next_len++] = writer->header.count;
+    writer->last_prefix = prefix;
+
+    // Consecutive entries frequently share a reason, so it is only stored once.
+    struct banlist_file_entry entry = { .prefix = prefix, .prefix_len = prefix_len };
+    if (*reason != '\0')
+    {
+        if (strcmp(writer->reasons + writer->last_reason, reason) != 0)
+        {
+            size_t len = strlen(reason) + 1;
+            if (writer->reasons_size + len > writer->reasons_capacity)
+            {
+                writer->reasons_capacity = MAX(writer->reasons_capacity * 2, writer->reasons_size + len);
+                char* reasons = quick_malloc(writer->reasons_capacity, BULB_ALLOC_BANLIST);
+                memcpy(reasons, writer->reasons, writer->reasons_size);
+                quick_free(writer->reasons);
+                writer->reasons = reasons;
+            }
+            memcpy(writer->reasons + writer->reasons_size, reason, len);
+            writer->last_reason = writer->reasons_size;
+            writer->reasons_size += len;
+        }
+        entry.reason_offset = (uint32_t)writer->last_reason;
+    }
+
+    writer->header.count++;
+    return fwrite(&entry, sizeof(entry), 1, writer->file) == 1;
+}
+
+// Finish writing a banlist file, flushing it to permanent storage before atomically
+// replacing the previous banlist file. The writer is freed. Returns false on failure.
+bool banlist_file_writer_commit(struct banlist_file_writer* writer)
+{
+    ASSERT(writer != NULL, return false);
+    while (writer->next_len <= 33)
+        writer->header.length_start[writer->next_len++] = writer->header.count;
+    writer->header.reasons_offset = sizeof(writer->header)
+        + (uint64_t)writer->header.count * sizeof(struct banlist_file_entry);
+    writer->header.reasons_size = writer->reasons_size;
+
+    bool result = fwrite(writer->reasons, 1, writer->reasons_size, writer->file) == writer->reasons_size
+        && fseek(writer->file, 0, SEEK_SET) == 0
+        && fwrite(&writer->header, sizeof(writer->header), 1, writer->file) == 1
+        && banlist_file_sync(writer->file);
+    result = (fclose(writer->file) == 0) && result;
+    writer->file = NULL;
+    if (result)
+        result = banlist_file_replace(writer->temp_path, writer->path);
+    ASSERT(result, (void)0, "Failed to write banlist file \"%s\"\n", writer->path);
+
+    banlist_file_writer_abort(writer);
+    return result;
+}
+
+// Discard a banlist file being written. The writer is freed.
+void banlist_file_writer_abort(struct banlist_file_writer* writer)
+{
+    if (writer == NULL)
+        return;
+    if (writer->file != NULL)
+        fclose(writer->file);
+    if (writer->temp_path != NULL)
+        remove(writer->temp_path);
+    quick_free(writer->reasons);
+    quick_free(writer->path);
+    quick_free(writer->temp_path);
+    quick_free(writer);
+}
+
+// Encode a ban or unban as a journal record. buffer must hold at least
+// BANLIST_JOURNAL_MAX_RECORD bytes. Returns the size of the record.
+size_t banlist_journal_encode(char* buffer, enum banlist_journal_op op, uint32_t prefix, uint8_t prefix_len,
+                              const char* reason)
+{
+    struct banlist_journal_record record = {
+        .prefix = prefix,
+        .reason_len = (uint16_t)((reason != NULL) ? MIN(strlen(reason), MAX_BANLIST_REASON_LENGTH) : 0),
+        .prefix_len = prefix_len,
+        .op = (uint8_t)op
+    };
+    memcpy(buffer, &record, sizeof(record));
+    if (record.reason_len > 0)
+        memcpy(buffer + sizeof(record), reason, record.reason_len);
+    return sizeof(record) + record.reason_len;
+}
+
+// Invoke func on each record of an encoded journal in order. Returns the number of
+// bytes decoded, which excludes any truncated or malformed record at the end.
+size_t banlist_journal_decode(const char* journal, size_t size, banlist_journal_func func, void* data)
+{
+    char reason[MAX_BANLIST_REASON_LENGTH + 1];
+    struct banlist_journal_record record;
+    size_t offset = 0;
+    while (size - offset >= sizeof(record))
+    {
+        memcpy(&record, journal + offset, sizeof(record));
+        if ((record.op != BANLIST_JOURNAL_BAN && record.op != BANLIST_JOURNAL_UNBAN) || record.prefix_len > 32
+            || record.reason_len > MAX_BANLIST_REASON_LENGTH)
+            break;
+        if (size - offset - sizeof(record) < record.reason_len)
+            break;
+        memcpy(reason, journal + offset + sizeof(record), record.reason_len);
+        reason[record.reason_len] = '\0';
+        func(data, (enum banlist_journal_op)record.op, record.prefix, record.prefix_len, reason);
+        offset += sizeof(record) + record.reason_len;
+    }
+    return offset;
+}
+
+// Invoke func on each record of a journal file in order. Any truncated record at
+// the end of the journal is ignored. Returns false if the journal cannot be read.
+bool banlist_journal_replay(const char* path, banlist_journal_func func, void* data)
+{
+    ASSERT(path != NULL && func != NULL, return false);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return true;
+
+    // Journals are compacted once they grow long, so they are read whole.
+    bool result = (fseek(file, 0, SEEK_END) == 0);
+    long size = result ? ftell(file) : -1;
+    result = (size >= 0) && (fseek(file, 0, SEEK_SET) == 0);
+    if (result && size > 0)
+    {
+        char* journal = quick_malloc((size_t)size, BULB_ALLOC_BANLIST);
+        result = (fread(journal, 1, (size_t)size, file) == (size_t)size);
+        if (result)
+            banlist_journal_decode(journal, (size_t)size, func, data);
+        quick_free(journal);
+    }
+
+    fclose(file);
+    return result;
+}
+
+// Flush a file to permanent storage. Returns false on failure.
+bool banlist_file_sync(FILE* file)
+{
+    ASSERT(file != NULL, return false);
+    if (fflush(file) != 0)
+        return false;
+#if defined WIN32
+    return _commit(_fileno(file)) == 0;
+#elif defined __UNIX__
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// Atomically replace a file. Returns false on failure.
+bool banlist_file_replace(const char* from, const char* to)
+{
+#if defined WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return rename(from, to) == 0;
+#endif
+}
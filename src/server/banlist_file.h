@@ -0,0 +1,131 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// The banlist is persisted as a compact binary file which is memory-mapped and
+// searched in place, alongside an append-only journal of every ban and unban made
+// since the binary file was last written.
+
+// A banlist file consists of a header, followed by an array of entries sorted by
+// prefix length and then by prefix, followed by a blob of NUL-terminated ban
+// reasons. All integers are stored in host byte order.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bulb_banlist.h"
+
+#define BANLIST_FILE_NAME           "banlist.bin"
+#define BANLIST_TEXT_FILE_NAME      "banlist.txt"
+#define BANLIST_JOURNAL_NAME        "banlist.journal"
+
+// Journals are renamed to this while their changes are being compacted into the
+// banlist file, so that they can be replayed if the compaction is interrupted.
+#define BANLIST_OLD_JOURNAL_NAME    "banlist.journal.old"
+
+// Longest path of any banlist database file. The files of a virtual server are
+// prefixed with its name, see bulb_host.h.
+#define BANLIST_PATH_LENGTH         (MAX_NAME_LENGTH + sizeof(BANLIST_OLD_JOURNAL_NAME) + 1)
+
+#define BANLIST_FILE_MAGIC          "BULBBAN1"
+#define BANLIST_FILE_VERSION        1
+
+// Journal records hold an 8-byte header followed by their ban reason.
+#define BANLIST_JOURNAL_MAX_RECORD  (8 + MAX_BANLIST_REASON_LENGTH)
+
+struct banlist_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+
+    // Entries with a prefix length of n are stored from length_start[n] up to
+    // length_start[n + 1].
+    uint32_t length_start[34];
+
+    uint64_t reasons_offset;
+    uint64_t reasons_size;
+};
+
+struct banlist_file_entry
+{
+    uint32_t prefix;
+    uint32_t reason_offset;
+    uint8_t prefix_len;
+    uint8_t reserved[3];
+};
+
+// A memory-mapped banlist file. An absent banlist file is mapped as an empty base.
+// Windows cannot replace a file while a view of it is mapped, so the file is read
+// into memory there instead.
+struct banlist_base
+{
+    const struct banlist_file_header* header;
+    const struct banlist_file_entry* entries;
+    const char* reasons;
+    uint64_t length_mask;       // Bit n is set if any entry has a prefix length of n.
+    void* data;
+    size_t size;
+};
+
+enum banlist_journal_op
+{
+    BANLIST_JOURNAL_BAN = 1,
+    BANLIST_JOURNAL_UNBAN = 2
+};
+
+typedef void (*banlist_journal_func)(void* data, enum banlist_journal_op op, uint32_t prefix,
+                                     uint8_t prefix_len, const char* reason);
+
+struct banlist_file_writer;
+
+// Map a banlist file into memory. Returns NULL if the file is malformed.
+struct banlist_base* banlist_base_map(const char* path);
+
+// Unmap a banlist file from memory.
+void banlist_base_unmap(struct banlist_base* base);
+
+// Search a banlist file for an exact prefix. Returns its ban reason, or NULL if
+// the prefix is not present.
+const char* banlist_base_find(const struct banlist_base* base, uint32_t prefix, uint8_t prefix_len);
+
+// Get the ban reason of an entry in a banlist file.
+const char* banlist_base_reason(const struct banlist_base* base, const struct banlist_file_entry* entry);
+
+// Begin writing a new banlist file, which replaces path once it is committed.
+// Returns NULL on failure.
+struct banlist_file_writer* banlist_file_writer_open(const char* path);
+
+// Append an entry to a banlist file being written. Entries must be appended in
+// the order they are stored in. Returns false on failure.
+bool banlist_file_writer_add(struct banlist_file_writer* writer, uint32_t prefix, uint8_t prefix_len,
+                             const char* reason);
+
+// Finish writing a banlist file, flushing it to permanent storage before atomically
+// replacing the previous banlist file. The writer is freed. Returns false on failure.
+bool banlist_file_writer_commit(struct banlist_file_writer* writer);
+
+// Discard a banlist file being written. The writer is freed.
+void banlist_file_writer_abort(struct banlist_file_writer* writer);
+
+// Encode a ban or unban as a journal record. buffer must hold at least
+// BANLIST_JOURNAL_MAX_RECORD bytes. Returns the size of the record.
+size_t banlist_journal_encode(char* buffer, enum banlist_journal_op op, uint32_t prefix, uint8_t prefix_len,
+                              const char* reason);
+
+// Invoke func on each record of an encoded journal in order. Returns the number of
+// bytes decoded, which excludes any truncated or malformed record at the end.
+size_t banlist_journal_decode(const char* journal, size_t size, banlist_journal_func func, void* data);
+
+// Invoke func on each record of a journal file in order. Any truncated record at
+// the end of the journal is ignored. Returns false if the journal cannot be read.
+bool banlist_journal_replay(const char* path, banlist_journal_func func, void* data);
+
+// Flush a file to permanent storage. Returns false on failure.
+bool banlist_file_sync(FILE* file);
+
+// Atomically replace a file. Returns false on failure.
+bool banlist_file_replace(const char* from, const char* to);
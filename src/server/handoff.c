@@ -0,0 +1,913 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// See handoff.h for how a server is handed over to another process.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "util.h"
+#include "pool.h"
+#include "bulb_structs.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "userinfo_obj.h"
+#include "message_obj.h"
+#include "stream_obj.h"
+#include "rooms.h"
+#include "ip_limiter.h"
+#include "shared_interface.h"
+#include "handoff.h"
+
+#ifdef __UNIX__
+#   include <sys/uio.h>
+#   include <sys/un.h>
+#   include <sys/stat.h>
+#endif
+
+#define HANDOFF_MAGIC       0x424C4248
+#define HANDOFF_VERSION     1
+
+#ifdef __UNIX__
+// Precedes every record, and carries its socket if it has one.
+struct handoff_header
+{
+    uint32_t type;
+    uint32_t has_socket;
+    uint64_t size;
+};
+
+// Sent first by the old process, so that the new process can check that both processes
+// lay out every record in the same way.
+struct handoff_hello
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t userinfo_size;
+    uint32_t client_size;
+};
+
+// Sent along with the listen socket.
+struct handoff_server
+{
+    uint64_t accepted_connections;
+    uint64_t rejected_connections;
+    uint64_t limited_connections;
+    uint64_t dropped_objects;
+    uint64_t conflated_objects;
+    uint64_t congestion_disconnects;
+    uint64_t busy_connections;
+};
+
+// Sent along with the socket of a client. This is followed by the client's userinfo if
+// it is validated, the part of the object being read from the client that has been
+// read so far, and then each of the counted sections in the order they are declared.
+struct handoff_client
+{
+    struct sockaddr_in addr;
+    uint32_t validated;
+    uint32_t ready_to_ping;
+    char room[MAX_ROOM_NAME_LENGTH + 1];
+    uint32_t room_moves;
+
+    // The header of the object being read from the client, if reading is set.
+    uint32_t reading;
+    struct bulb_obj header;
+    uint64_t read_offset;
+
+    uint32_t control_streak;
+    uint32_t send_nodes;        // Data nodes queued for sending, in the order of their lanes.
+    uint32_t timeouts;          // Objects sent that are yet to be acknowledged.
+    uint32_t streams;           // Streams being sent.
+    uint32_t delayed;           // Messages held back by flood control, in order.
+};
+
+// Precedes the data of a data node queued for sending.
+struct handoff_data_node
+{
+    uint32_t lane;
+    uint32_t send_offset;
+    uint64_t len;
+};
+
+// Precedes the recipients of a stream.
+struct handoff_stream
+{
+    uint32_t id;
+    uint32_t chunks;
+    uint32_t granted;
+    uint32_t recipient_count;
+};
+
+struct handoff_recipient
+{
+    char name[MAX_NAME_LENGTH + 1];
+    uint32_t room_moves;
+    uint32_t acked;
+    uint32_t active;
+};
+
+// A growable buffer in which the record of a client is built.
+struct handoff_buffer
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+};
+
+// Reads the sections of a client's record in turn.
+struct handoff_reader
+{
+    const char* data;
+    size_t left;
+};
+
+// Append data to a buffer.
+static void _handoff_append(struct handoff_buffer* buffer, const void* data, size_t size)
+{
+    if (buffer->capacity - buffer->size < size)
+    {
+        size_t capacity = MAX(buffer->capacity * 2, buffer->size + size);
+        char* grown = quick_malloc(capacity, BULB_ALLOC_NETWORKING);
+        if (buffer->data != NULL)
+        {
+            memcpy(grown, buffer->data, buffer->size);
+            quick_free(buffer->data);
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+// Take the next size bytes from a reader. Returns NULL if fewer bytes are left.
+static const char* _handoff_take(struct handoff_reader* reader, size_t size)
+{
+    if (size > reader->left)
+        return NULL;
+    const char* data = reader->data;
+    reader->data += size;
+    reader->left -= size;
+    return data;
+}
+
+// Copy the next size bytes from a reader. Returns false if fewer bytes are left.
+static bool _handoff_read(struct handoff_reader* reader, void* out, size_t size)
+{
+    const char* data = _handoff_take(reader, size);
+    if (data == NULL)
+        return false;
+    memcpy(out, data, size);
+    return true;
+}
+
+// Bound how long a hand-off waits on the other process.
+static void _handoff_set_timeouts(SOCKET conn)
+{
+    struct timeval timeout = { .tv_sec = HANDOFF_TIMEOUT_S };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// Send the whole of a buffer. Returns false on failure.
+static bool _handoff_send_all(SOCKET conn, const void* data, size_t size)
+{
+    const char* it = (const char*)data;
+    while (size > 0)
+    {
+        ssize_t sent = send(conn, it, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        it += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Receive the whole of a buffer. Returns false on failure.
+static bool _handoff_recv_all(SOCKET conn, void* data, size_t size)
+{
+    char* it = (char*)data;
+    while (size > 0)
+    {
+        ssize_t received = recv(conn, it, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        it += received;
+        size -= received;
+    }
+    return true;
+}
+
+// Send a record, passing sock along with it unless it is INVALID_SOCKET. Returns false
+// on failure.
+static bool _handoff_send_record(SOCKET conn, enum handoff_record_type type, SOCKET sock,
+                                 const void* data, size_t size)
+{
+    struct handoff_header header = { .type = type, .has_socket = (sock != INVALID_SOCKET), .size = size };
+    struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    union
+    {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    if (sock != INVALID_SOCKET)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &sock, sizeof(int));
+    }
+
+    // The socket is passed with the first byte of the header, so only the rest of the
+    // header is sent again should sendmsg() send part of it.
+    ssize_t sent;
+    while ((sent = sendmsg(conn, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    if (sent <= 0)
+        return false;
+    return _handoff_send_all(conn, (char*)&header + sent, sizeof(header) - sent)
+        && _handoff_send_all(conn, data, size);
+}
+
+// Receive the header of a record, along with its socket if it has one. Returns false
+// on failure.
+static bool _handoff_recv_header(SOCKET conn, struct handoff_header* header, SOCKET* sock)
+{
+    *sock = INVALID_SOCKET;
+    struct iovec iov = { .iov_base = header, .iov_len = sizeof(*header) };
+    union
+    {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer,
+                          .msg_controllen = sizeof(control.buffer) };
+    ssize_t received;
+    while ((received = recvmsg(conn, &msg, 0)) < 0 && errno == EINTR);
+    if (received <= 0)
+        return false;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+        && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+        memcpy(sock, CMSG_DATA(cmsg), sizeof(int));
+    if ((msg.msg_flags & MSG_CTRUNC)
+        || !_handoff_recv_all(conn, (char*)header + received, sizeof(*header) - received)
+        || header->has_socket != (*sock != INVALID_SOCKET))
+    {
+        if (*sock != INVALID_SOCKET)
+            closesocket(*sock);
+        *sock = INVALID_SOCKET;
+        return false;
+    }
+    return true;
+}
+
+// Build the record of a client. Spilled write data is loaded back first, as spill
+// files are not handed over. The client's write lock must be held. Returns false on
+// failure.
+static bool _handoff_pack_client(struct handoff_buffer* buffer, struct client_node* client)
+{
+    struct mt_socket* sock = client->mt_sock;
+    mt_socket_unspill(sock, SIZE_MAX);
+    if (sock->spill_nodes > 0)
+        return false;
+
+    struct handoff_client state = { .addr = client->addr,
+                                    .validated = (client->status == CLIENT_VALIDATED && client->userinfo != NULL),
+                                    .ready_to_ping = client->ready_to_ping,
+                                    .room_moves = client->room_moves,
+                                    .reading = (client->next_obj_header != NULL),
+                                    .read_offset = client->read_offset,
+                                    .control_streak = sock->control_streak,
+                                    .delayed = client->delayed_count };
+    if (state.validated && client->room != NULL)
+        strcpy(state.room, client->room->name);
+    if (state.reading)
+        state.header = *client->next_obj_header;
+    else
+        state.read_offset = 0;
+    for (int i = 0; i < MT_SOCKET_LANES; i++)
+    {
+        for (struct mt_socket_data_node* node = sock->data_send_queue[i]; node != NULL; node = node->next)
+            state.send_nodes++;
+    }
+    for (struct mt_socket_timeout_node* node = sock->data_send_timeout_queue; node != NULL; node = node->next)
+        state.timeouts++;
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+        state.streams += client->streams[i].open;
+    _handoff_append(buffer, &state, sizeof(state));
+
+    if (state.validated)
+        _handoff_append(buffer, client->userinfo, sizeof(struct userinfo_obj));
+
+    // Only the part of the current object read so far is left in the read data queue.
+    size_t read = 0;
+    for (struct mt_socket_data_node* node = sock->data_recv_queue; state.reading && node != NULL; node = node->next)
+    {
+        _handoff_append(buffer, node->data, node->len);
+        read += node->len;
+    }
+    ASSERT(read == state.read_offset, return false, "Read data queue does not match read offset\n");
+
+    for (int i = 0; i < MT_SOCKET_LANES; i++)
+    {
+        for (struct mt_socket_data_node* node = sock->data_send_queue[i]; node != NULL; node = node->next)
+        {
+            struct handoff_data_node header = { .lane = i, .send_offset = node->send_offset, .len = node->len };
+            _handoff_append(buffer, &header, sizeof(header));
+            _handoff_append(buffer, node->data, node->len);
+        }
+    }
+    for (struct mt_socket_timeout_node* node = sock->data_send_timeout_queue; node != NULL; node = node->next)
+        _handoff_append(buffer, &node->send_timestamp, sizeof(node->send_timestamp));
+
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        struct client_stream* stream = &client->streams[i];
+        if (!stream->open)
+            continue;
+        struct handoff_stream header = { .id = stream->id, .chunks = stream->chunks, .granted = stream->granted,
+                                         .recipient_count = stream->recipient_count };
+        _handoff_append(buffer, &header, sizeof(header));
+        for (unsigned j = 0; j < stream->recipient_count; j++)
+        {
+            struct stream_recipient* recipient = &stream->recipients[j];
+            struct handoff_recipient wire = { .room_moves = recipient->room_moves, .acked = recipient->acked,
+                                              .active = recipient->active };
+            strcpy(wire.name, recipient->name);
+            _handoff_append(buffer, &wire, sizeof(wire));
+        }
+    }
+
+    for (unsigned i = 0; i < client->delayed_count; i++)
+    {
+        struct message_obj* obj = client->delayed_messages[(client->delayed_head + i) % CLIENT_DELAYED_MESSAGES];
+        _handoff_append(buffer, obj, obj->base.size);
+    }
+    return true;
+}
+
+// Collect every client of a server that can be handed over, which excludes clients
+// that are already leaving, and connections of linked servers and proxies. The client
+// update lock must be held. Returns the number of clients collected.
+static unsigned _handoff_collect_clients(struct server_node* server, struct client_node*** clients)
+{
+    unsigned capacity = 0;
+    LOOP_SOCKET_MANAGERS(server->io->sm_head, NULL, sm, capacity += sm->active_sockets);
+    *clients = quick_calloc(MAX(capacity, 1), sizeof(struct client_node*), BULB_ALLOC_NETWORKING);
+
+    unsigned count = 0;
+    LOOP_SOCKET_MANAGERS(server->io->sm_head, NULL, sm,
+    {
+        for (size_t i = 0; i < sm->active_sockets; i++)
+        {
+            struct client_node* client = (struct client_node*)sm->sockets[i]->parent_client;
+            if (client == NULL || client->server_node != server || client_flagged_for_deletion(client)
+                || client->link != NULL || client->mux != NULL || CLIENT_IS_REMOTE(client))
+                continue;
+            (*clients)[count++] = client;
+        }
+    });
+    return count;
+}
+
+// Send the record of a client. Returns false on failure.
+static bool _handoff_send_client(SOCKET conn, struct client_node* client)
+{
+    struct handoff_buffer buffer = { 0 };
+    mtx_lock(&client->mt_sock->write_lock);
+    bool success = _handoff_pack_client(&buffer, client);
+    mtx_unlock(&client->mt_sock->write_lock);
+    success = success && _handoff_send_record(conn, HANDOFF_CLIENT, client->mt_sock->socket, buffer.data,
+        buffer.size);
+    quick_free(buffer.data);
+    return success;
+}
+
+// Stop serving every client handed over to another process. Each client's socket is
+// replaced by placeholder, which reads as a closed connection, so that the clients are
+// then disconnected without anything reaching them. The client update lock must be held.
+static void _handoff_detach(struct bulb_server* server, struct client_node** clients, unsigned count,
+                            SOCKET placeholder)
+{
+    struct server_node* server_node = server->server_node;
+    for (unsigned i = 0; i < count; i++)
+    {
+        struct mt_socket* sock = clients[i]->mt_sock;
+        mtx_lock(&sock->write_lock);
+        dup2(placeholder, sock->socket);
+        sock->closed = true;
+        mtx_unlock(&sock->write_lock);
+    }
+    for (unsigned i = 0; i < count; i++)
+        server_disconnect_client(server_node, clients[i], false, true, false);
+
+    // The listen socket and parked connections are closed without being shut down, as
+    // shutting them down would also affect the other process.
+    for (unsigned i = 0; i < server_node->parked_count; i++)
+    {
+        closesocket(server_node->parked[i].sock);
+        ip_limiter_release(server_node->ip_limiter, ntohl(server_node->parked[i].addr.sin_addr.s_addr));
+    }
+    server_node->parked_count = 0;
+    atomic_store(&server_node->parked_connections, 0);
+    closesocket(server_node->listen_sock);
+    server_node->listen_sock = INVALID_SOCKET;
+}
+
+// Check the first record sent by the old process, and tell it whether this process
+// can take over its server. Returns false if not.
+static bool _handoff_recv_hello(SOCKET conn)
+{
+    struct handoff_header header;
+    struct handoff_hello hello;
+    SOCKET sock;
+    if (!_handoff_recv_header(conn, &header, &sock))
+        return false;
+    if (sock != INVALID_SOCKET)
+        closesocket(sock);
+
+    bool valid = header.type == HANDOFF_HELLO && header.size == sizeof(hello) && sock == INVALID_SOCKET
+        && _handoff_recv_all(conn, &hello, sizeof(hello))
+        && hello.magic == HANDOFF_MAGIC && hello.version == HANDOFF_VERSION
+        && hello.userinfo_size == sizeof(struct userinfo_obj) && hello.client_size == sizeof(struct handoff_client);
+    char ack = valid;
+    return _handoff_send_all(conn, &ack, sizeof(ack)) && valid;
+}
+
+// Receive every record that follows the first, up to and including HANDOFF_END.
+// Returns false on failure.
+static bool _handoff_recv_records(SOCKET conn, struct handoff* handoff)
+{
+    for (;;)
+    {
+        struct handoff_header header;
+        SOCKET sock;
+        if (!_handoff_recv_header(conn, &header, &sock))
+            return false;
+
+        // The record is kept before it is checked, so that its socket is closed along
+        // with everything else on failure.
+        struct handoff_record* record = quick_malloc(sizeof(struct handoff_record), BULB_ALLOC_NETWORKING);
+        record->type = header.type;
+        record->sock = sock;
+        record->size = header.size;
+        if (handoff->records_tail != NULL)
+            handoff->records_tail->next = record;
+        else
+            handoff->records = record;
+        handoff->records_tail = record;
+        if (header.size > SIZE_MAX / 2)
+            return false;
+        record->data = quick_malloc(MAX(record->size, 1), BULB_ALLOC_NETWORKING);
+        if (!_handoff_recv_all(conn, record->data, record->size))
+            return false;
+
+        switch (header.type)
+        {
+            case HANDOFF_SERVER:
+            {
+                if (sock == INVALID_SOCKET || handoff->listen_sock != INVALID_SOCKET
+                    || header.size != sizeof(struct handoff_server))
+                    return false;
+                struct handoff_server stats;
+                memcpy(&stats, record->data, sizeof(stats));
+                handoff->listen_sock = sock;
+                record->sock = INVALID_SOCKET;
+                handoff->accepted_connections = stats.accepted_connections;
+                handoff->rejected_connections = stats.rejected_connections;
+                handoff->limited_connections = stats.limited_connections;
+                handoff->dropped_objects = stats.dropped_objects;
+                handoff->conflated_objects = stats.conflated_objects;
+                handoff->congestion_disconnects = stats.congestion_disconnects;
+                handoff->busy_connections = stats.busy_connections;
+                break;
+            }
+            case HANDOFF_PARKED:
+                if (sock == INVALID_SOCKET || header.size != sizeof(struct sockaddr_in))
+                    return false;
+                break;
+            case HANDOFF_CLIENT:
+                if (sock == INVALID_SOCKET || header.size < sizeof(struct handoff_client))
+                    return false;
+                break;
+            case HANDOFF_END:
+                return sock == INVALID_SOCKET && header.size == 0 && handoff->listen_sock != INVALID_SOCKET;
+            default:
+                return false;
+        }
+    }
+}
+
+// Restore the read and write data queues of a client from its record. Returns false if
+// the record is malformed.
+static bool _handoff_restore_queues(struct client_node* client, const struct handoff_client* state,
+                                    struct handoff_reader* reader)
+{
+    struct mt_socket* sock = client->mt_sock;
+    if (state->reading)
+    {
+        if (state->header.size < sizeof(struct bulb_obj) || state->read_offset > state->header.size)
+            return false;
+        const char* data = _handoff_take(reader, state->read_offset);
+        if (data == NULL)
+            return false;
+        client->next_obj_header = (struct bulb_obj*)pool_alloc(sizeof(struct bulb_obj), BULB_ALLOC_OBJECTS);
+        *client->next_obj_header = state->header;
+        client->read_offset = state->read_offset;
+        if (state->read_offset > 0)
+        {
+            struct mt_socket_data_node* node = (struct mt_socket_data_node*)pool_alloc(
+                sizeof(struct mt_socket_data_node) + state->read_offset, BULB_ALLOC_NETWORKING);
+            memcpy(node->data, data, state->read_offset);
+            node->len = state->read_offset;
+            node->send_offset = 0;
+            QUEUE_ENQUEUE(node, sock->data_recv_queue, sock->data_recv_tail);
+        }
+    }
+
+    sock->control_streak = state->control_streak;
+    for (uint32_t i = 0; i < state->send_nodes; i++)
+    {
+        struct handoff_data_node header;
+        const char* data;
+        if (!_handoff_read(reader, &header, sizeof(header)) || header.lane >= MT_SOCKET_LANES
+            || header.send_offset >= header.len || (data = _handoff_take(reader, header.len)) == NULL)
+            return false;
+        struct mt_socket_data_node* node = (struct mt_socket_data_node*)pool_alloc(
+            sizeof(struct mt_socket_data_node) + header.len, BULB_ALLOC_NETWORKING);
+        memcpy(node->data, data, header.len);
+        node->len = header.len;
+        node->send_offset = header.send_offset;
+        node->lane = header.lane;
+        mt_socket_enqueue_send(sock, node);
+        bulb_obj_account_send_queue(sock, node->len, 1);
+    }
+
+    for (uint32_t i = 0; i < state->timeouts; i++)
+    {
+        struct mt_socket_timeout_node* timeout = (struct mt_socket_timeout_node*)pool_alloc(
+            sizeof(struct mt_socket_timeout_node), BULB_ALLOC_NETWORKING);
+        if (!_handoff_read(reader, &timeout->send_timestamp, sizeof(timeout->send_timestamp)))
+        {
+            pool_free(timeout);
+            return false;
+        }
+        QUEUE_ENQUEUE(timeout, sock->data_send_timeout_queue, sock->data_send_timeout_tail);
+    }
+    return true;
+}
+
+// Restore the streams of a validated client from its record. Each recipient is found
+// once every client has been restored. Returns false if the record is malformed.
+static bool _handoff_restore_streams(struct client_node* client, const struct handoff_client* state,
+                                     struct handoff_reader* reader)
+{
+    if (state->streams > CLIENT_MAX_STREAMS)
+        return false;
+    for (uint32_t i = 0; i < state->streams; i++)
+    {
+        struct handoff_stream header;
+        if (!_handoff_read(reader, &header, sizeof(header))
+            || reader->left / sizeof(struct handoff_recipient) < header.recipient_count)
+            return false;
+
+        struct client_stream* stream = &client->streams[i];
+        stream->id = header.id;
+        stream->open = true;
+        stream->chunks = header.chunks;
+        stream->granted = header.granted;
+        stream->recipients = quick_calloc(MAX(header.recipient_count, 1), sizeof(struct stream_recipient),
+            BULB_ALLOC_NETWORKING);
+        stream->recipient_count = header.recipient_count;
+        for (uint32_t j = 0; j < header.recipient_count; j++)
+        {
+            struct handoff_recipient wire;
+            _handoff_read(reader, &wire, sizeof(wire));
+            struct stream_recipient* recipient = &stream->recipients[j];
+            memcpy(recipient->name, wire.name, MAX_NAME_LENGTH);
+            recipient->room_moves = wire.room_moves;
+            recipient->acked = wire.acked;
+            recipient->active = wire.active;
+        }
+    }
+    return true;
+}
+
+// Restore the messages of a validated client held back by flood control from its
+// record. Returns false if the record is malformed.
+static bool _handoff_restore_delayed(struct server_node* server, struct client_node* client,
+                                     const struct handoff_client* state, struct handoff_reader* reader)
+{
+    if (state->delayed > CLIENT_DELAYED_MESSAGES)
+        return false;
+    for (uint32_t i = 0; i < state->delayed; i++)
+    {
+        // Each message is sized by its own header.
+        struct bulb_obj header;
+        const char* data;
+        if (reader->left < sizeof(header))
+            return false;
+        memcpy(&header, reader->data, sizeof(header));
+        if (header.size < sizeof(struct message_obj) || (data = _handoff_take(reader, header.size)) == NULL)
+            return false;
+
+        struct message_obj* obj = (struct message_obj*)pool_alloc(header.size, BULB_ALLOC_OBJECTS);
+        memcpy(obj, data, header.size);
+        client->delayed_messages[i] = obj;
+        client->delayed_count++;
+    }
+    if (client->delayed_count > 0)
+        server->delayed_clients++;
+    return true;
+}
+
+// Resume serving a client handed over by the old process. The client update lock must
+// be held.
+static void _handoff_restore_client(struct bulb_server* server, struct handoff_record* record)
+{
+    struct server_node* server_node = server->server_node;
+    struct handoff_reader reader = { .data = record->data, .left = record->size };
+    struct handoff_client state;
+    _handoff_read(&reader, &state, sizeof(state));
+    state.room[MAX_ROOM_NAME_LENGTH] = '\0';
+
+    // The client was admitted by the old process, so it is only counted against the
+    // limits of its address here. Its queues are restored before it is listened to, so
+    // that anything written to it afterwards follows on from them.
+    ip_limiter_adopt(server_node->ip_limiter, ntohl(state.addr.sin_addr.s_addr), &server_node->info);
+    struct client_node* client = server_new_client(server, record->sock, &state.addr);
+    record->sock = INVALID_SOCKET;
+    bool valid = _handoff_restore_queues(client, &state, &reader);
+    server_listen_client(server_node, client);
+    if (client_flagged_for_deletion(client))
+        return;
+    if (!valid)
+        goto malformed;
+    if (!state.validated)
+        return;
+
+    struct userinfo_obj* userinfo = (struct userinfo_obj*)pool_alloc(sizeof(struct userinfo_obj), BULB_ALLOC_ROSTER);
+    if (!_handoff_read(&reader, userinfo, sizeof(struct userinfo_obj)))
+    {
+        pool_free(userinfo);
+        goto malformed;
+    }
+    userinfo->info.prev = userinfo->info.next = NULL;
+    userinfo->info.linked = false;
+    client->userinfo = userinfo;
+    if (!server_connect_client(server_node, client))
+    {
+        client->userinfo = NULL;
+        pool_free(userinfo);
+        goto malformed;
+    }
+
+    client->ready_to_ping = state.ready_to_ping;
+    client_set_status(client, CLIENT_VALIDATED);
+    room_enter(server_node, client, room_name_valid(state.room) ? state.room : ROOM_LOBBY_NAME);
+    client->room_moves = state.room_moves;
+    if (_handoff_restore_streams(client, &state, &reader)
+        && _handoff_restore_delayed(server_node, client, &state, &reader))
+        return;
+
+malformed:
+    bulb_printf(server_node, "Client from address %s could not be resumed\n", client->ip_addr);
+    server_disconnect_client(server_node, client, false, true, false);
+}
+
+// Find the recipients of each stream of a restored client, which are no longer waited
+// on if they were not handed over.
+static void _handoff_restore_recipients(struct server_node* server, struct client_node* client)
+{
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        struct client_stream* stream = &client->streams[i];
+        for (unsigned j = 0; stream->open && j < stream->recipient_count; j++)
+        {
+            struct stream_recipient* recipient = &stream->recipients[j];
+            recipient->node = server_find_by_name(server, recipient->name);
+            if (recipient->node == NULL || CLIENT_IS_REMOTE(recipient->node))
+            {
+                recipient->node = NULL;
+                recipient->active = false;
+            }
+        }
+    }
+}
+
+// Connect to a process waiting in server_resume() at path, and check that it can take
+// over a server from this process. Returns INVALID_SOCKET on failure.
+SOCKET handoff_connect(const char* path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return INVALID_SOCKET;
+    strcpy(addr.sun_path, path);
+
+    SOCKET conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conn == INVALID_SOCKET)
+        return INVALID_SOCKET;
+    _handoff_set_timeouts(conn);
+
+    struct handoff_hello hello = { .magic = HANDOFF_MAGIC, .version = HANDOFF_VERSION,
+                                   .userinfo_size = sizeof(struct userinfo_obj),
+                                   .client_size = sizeof(struct handoff_client) };
+    char ack = 0;
+    if (connect(conn, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+        || !_handoff_send_record(conn, HANDOFF_HELLO, INVALID_SOCKET, &hello, sizeof(hello))
+        || !_handoff_recv_all(conn, &ack, sizeof(ack)) || ack != 1)
+    {
+        closesocket(conn);
+        return INVALID_SOCKET;
+    }
+    return conn;
+}
+
+// Hand a server over to the process connected through conn. The server's listen thread
+// must already be stopped. Returns true once the other process has received everything,
+// in which case this process no longer serves any of the server's clients.
+bool handoff_send(struct bulb_server* server, SOCKET conn)
+{
+    struct server_node* server_node = server->server_node;
+
+    // Each handed over socket is replaced by one end of a socket pair whose other end is
+    // already closed.
+    SOCKET placeholder[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, placeholder) != 0)
+        return false;
+    closesocket(placeholder[1]);
+
+    mtx_lock(&server_node->io->client_update_lock);
+    struct handoff_server stats = { .accepted_connections = atomic_load(&server_node->accepted_connections),
+                                    .rejected_connections = atomic_load(&server_node->rejected_connections),
+                                    .limited_connections = atomic_load(&server_node->limited_connections),
+                                    .dropped_objects = atomic_load(&server_node->dropped_objects),
+                                    .conflated_objects = atomic_load(&server_node->conflated_objects),
+                                    .congestion_disconnects = atomic_load(&server_node->congestion_disconnects),
+                                    .busy_connections = atomic_load(&server_node->busy_connections) };
+    bool success = _handoff_send_record(conn, HANDOFF_SERVER, server_node->listen_sock, &stats, sizeof(stats));
+    for (unsigned i = 0; success && i < server_node->parked_count; i++)
+    {
+        success = _handoff_send_record(conn, HANDOFF_PARKED, server_node->parked[i].sock,
+            &server_node->parked[i].addr, sizeof(struct sockaddr_in));
+    }
+
+    struct client_node** clients;
+    unsigned count = _handoff_collect_clients(server_node, &clients);
+    for (unsigned i = 0; success && i < count; i++)
+        success = _handoff_send_client(conn, clients[i]);
+
+    // The other process acknowledges the end of the hand-off once it has received
+    // everything, after which it alone serves the clients.
+    char ack = 0;
+    success = success && _handoff_send_record(conn, HANDOFF_END, INVALID_SOCKET, NULL, 0)
+        && _handoff_recv_all(conn, &ack, sizeof(ack)) && ack == 1;
+    if (success)
+        _handoff_detach(server, clients, count, placeholder[0]);
+    mtx_unlock(&server_node->io->client_update_lock);
+
+    quick_free(clients);
+    closesocket(placeholder[0]);
+    closesocket(conn);
+    return success;
+}
+
+// Wait for a process to connect at path, and receive the server that it hands over.
+// Returns NULL on failure.
+struct handoff* handoff_receive(const char* path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return NULL;
+    strcpy(addr.sun_path, path);
+
+    // Any socket left behind at path is replaced. Only the owner of this process may
+    // connect, as whoever connects decides which clients this process serves, so the
+    // socket is restricted before it starts listening.
+    SOCKET listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_sock == INVALID_SOCKET)
+        return NULL;
+    unlink(path);
+    if (bind(listen_sock, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+        || chmod(path, S_IRUSR | S_IWUSR) != 0 || listen(listen_sock, 1) == SOCKET_ERROR)
+    {
+        closesocket(listen_sock);
+        unlink(path);
+        return NULL;
+    }
+    SOCKET conn;
+    while ((conn = accept(listen_sock, NULL, NULL)) == INVALID_SOCKET && errno == EINTR);
+    closesocket(listen_sock);
+    unlink(path);
+    if (conn == INVALID_SOCKET)
+        return NULL;
+    _handoff_set_timeouts(conn);
+
+    struct handoff* handoff = quick_malloc(sizeof(struct handoff), BULB_ALLOC_NETWORKING);
+    handoff->listen_sock = INVALID_SOCKET;
+    char ack = 1;
+    if (!_handoff_recv_hello(conn) || !_handoff_recv_records(conn, handoff)
+        || !_handoff_send_all(conn, &ack, sizeof(ack)))
+    {
+        closesocket(conn);
+        handoff_free(handoff);
+        return NULL;
+    }
+    closesocket(conn);
+    return handoff;
+}
+
+// Resume serving every parked connection and client handed over to a server. The
+// server's listen thread must not have started yet. The handed over state is freed.
+void handoff_restore(struct bulb_server* server, struct handoff* handoff)
+{
+    struct server_node* server_node = server->server_node;
+    atomic_store(&server_node->accepted_connections, handoff->accepted_connections);
+    atomic_store(&server_node->rejected_connections, handoff->rejected_connections);
+    atomic_store(&server_node->limited_connections, handoff->limited_connections);
+    atomic_store(&server_node->dropped_objects, handoff->dropped_objects);
+    atomic_store(&server_node->conflated_objects, handoff->conflated_objects);
+    atomic_store(&server_node->congestion_disconnects, handoff->congestion_disconnects);
+    atomic_store(&server_node->busy_connections, handoff->busy_connections);
+
+    // Nothing is read from or written to any client until every client is restored.
+    mtx_lock(&server_node->io->client_update_lock);
+    for (struct handoff_record* record = handoff->records; record != NULL; record = record->next)
+    {
+        if (record->type == HANDOFF_PARKED)
+        {
+            struct sockaddr_in addr;
+            memcpy(&addr, record->data, sizeof(addr));
+            server_handle_connection(server, record->sock, &addr);
+            record->sock = INVALID_SOCKET;
+        }
+        else if (record->type == HANDOFF_CLIENT)
+            _handoff_restore_client(server, record);
+    }
+    LOOP_CLIENTS(server_node, NULL, node, _handoff_restore_recipients(server_node, node));
+    mtx_unlock(&server_node->io->client_update_lock);
+    handoff_free(handoff);
+}
+
+// Free handed over state that will not be restored, closing every socket it holds.
+// The sockets are not shut down, so that the old process keeps serving them.
+void handoff_free(struct handoff* handoff)
+{
+    if (handoff == NULL)
+        return;
+    if (handoff->listen_sock != INVALID_SOCKET)
+        closesocket(handoff->listen_sock);
+    while (handoff->records != NULL)
+    {
+        struct handoff_record* record = handoff->records;
+        handoff->records = record->next;
+        if (record->sock != INVALID_SOCKET)
+            closesocket(record->sock);
+        quick_free(record->data);
+        quick_free(record);
+    }
+    quick_free(handoff);
+}
+#else
+// Hot restarts rely on passing sockets between processes over Unix domain sockets,
+// which are only supported on POSIX systems.
+SOCKET handoff_connect(const char* path)
+{
+    return INVALID_SOCKET;
+}
+
+bool handoff_send(struct bulb_server* server, SOCKET conn)
+{
+    return false;
+}
+
+struct handoff* handoff_receive(const char* path)
+{
+    return NULL;
+}
+
+void handoff_restore(struct bulb_server* server, struct handoff* handoff)
+{
+}
+
+void handoff_free(struct handoff* handoff)
+{
+}
+#endif
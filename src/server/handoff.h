@@ -0,0 +1,113 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Hot restarts hand a running server over to a new process without disconnecting its
+// clients, see server_hand_off() and server_resume(). The new process waits on a Unix
+// domain socket, to which the old process connects once told to hand its server off.
+//
+// The old process stops its listen thread and holds its client update lock for the
+// rest of the hand-off, so that no client is read from or written to in the meantime.
+// It then sends its listen socket, the connections parked in its admission queue, and
+// the socket of every client along with the client's state: its userinfo and room, the
+// object it was part way through sending, the data queued for sending to it, the
+// objects it has yet to acknowledge, the streams it is sending, and any messages held
+// back by flood control. Sockets are passed with SCM_RIGHTS. Once the new process has
+// received everything, the old process replaces each socket that it handed over with
+// a closed placeholder, so that tearing down its own copy of each client cannot affect
+// the connection itself.
+//
+// Everything is sent as a series of records, each of which carries at most one socket.
+// Records hold structures as they are laid out in memory, so both processes must be
+// built for the same platform, which the first record checks.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "unisock.h"
+#include "bulb_server.h"
+#include "bulb_structs.h"
+#include "server_node.h"
+#include "client_node.h"
+
+// Time either process waits on the other during a hand-off, in seconds.
+#define HANDOFF_TIMEOUT_S   10
+
+enum handoff_record_type
+{
+    HANDOFF_HELLO,      // Sent first by the old process, carrying a handoff_hello.
+    HANDOFF_SERVER,     // Carries the listen socket and a handoff_server.
+    HANDOFF_PARKED,     // Carries a parked connection and its address.
+    HANDOFF_CLIENT,     // Carries a client's socket and its handoff_client.
+    HANDOFF_END
+};
+
+// A new connection held back by the listen thread while the server is overloaded. See
+// server.c.
+struct parked_connection
+{
+    SOCKET sock;
+    struct sockaddr_in addr;
+    int64_t parked_ms;
+};
+
+// A record received from the old process.
+struct handoff_record
+{
+    enum handoff_record_type type;
+    SOCKET sock;        // INVALID_SOCKET if the record carries no socket.
+    char* data;
+    size_t size;
+
+    struct handoff_record* next;
+};
+
+// Everything received from the old process, which is restored once the new server
+// starts listening.
+struct handoff
+{
+    SOCKET listen_sock;
+
+    // Connection statistics carried over from the old process.
+    uint64_t accepted_connections;
+    uint64_t rejected_connections;
+    uint64_t limited_connections;
+    uint64_t dropped_objects;
+    uint64_t conflated_objects;
+    uint64_t congestion_disconnects;
+    uint64_t busy_connections;
+
+    // Parked connections and clients, in the order they were sent.
+    struct handoff_record* records;
+    struct handoff_record* records_tail;
+};
+
+// Connect to a process waiting in server_resume() at path, and check that it can take
+// over a server from this process. Returns INVALID_SOCKET on failure.
+SOCKET handoff_connect(const char* path);
+
+// Hand a server over to the process connected through conn. The server's listen thread
+// must already be stopped. Returns true once the other process has received everything,
+// in which case this process no longer serves any of the server's clients.
+bool handoff_send(struct bulb_server* server, SOCKET conn);
+
+// Wait for a process to connect at path, and receive the server that it hands over.
+// Returns NULL on failure.
+struct handoff* handoff_receive(const char* path);
+
+// Resume serving every parked connection and client handed over to a server. The
+// server's listen thread must not have started yet. The handed over state is freed.
+void handoff_restore(struct bulb_server* server, struct handoff* handoff);
+
+// Free handed over state that will not be restored, closing every socket it holds.
+// The sockets are not shut down, so that the old process keeps serving them.
+void handoff_free(struct handoff* handoff);
+
+// Admit a connection as though it had just been accepted by the listen thread. See
+// server.c.
+void server_handle_connection(struct bulb_server* server, SOCKET sock, const struct sockaddr_in* addr);
+
+// Create the client node of an admitted connection, which is not listened to until
+// server_listen_client() is called. See server.c.
+struct client_node* server_new_client(struct bulb_server* server, SOCKET sock, const struct sockaddr_in* addr);
@@ -0,0 +1,209 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "util.h"
+#include "alloc.h"
+#include "trie.h"
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "userinfo_obj.h"
+#include "message_obj.h"
+#include "stdout_obj.h"
+#include "rooms.h"
+#include "history.h"
+
+// Claim the slot of the next message in the ring, replacing the oldest message once the
+// ring is full.
+static struct history_entry* _history_push(struct history* history)
+{
+    struct history_entry* entry = &history->entries[history->next];
+    history->next = (history->next + 1) % history->capacity;
+    if (history->count < history->capacity)
+        history->count++;
+    return entry;
+}
+
+// Forget the user seen longest ago who is not connected, to make room for another.
+static void _history_evict_user(struct server_node* server, struct history* history)
+{
+    char oldest[MAX_NAME_LENGTH + 1] = "";
+    int64_t oldest_seen = INT64_MAX;
+    TRIE_DFS(history->users, value,
+    {
+        struct history_user* user = (struct history_user*)value;
+        if (user->last_seen < oldest_seen && server_find_by_name(server, user->name) == NULL)
+        {
+            oldest_seen = user->last_seen;
+            strcpy(oldest, user->name);
+        }
+    });
+    if (oldest[0] != '\0' && trie_delete(history->users, oldest))
+        history->user_count--;
+}
+
+// Find a user's record by name, creating it if the user has not been seen yet. Returns
+// NULL if the user cannot be remembered.
+static struct history_user* _history_claim_user(struct server_node* server, const char* name)
+{
+    struct history* history = server->history;
+    struct history_user* user = trie_find(history->users, name);
+    if (user != NULL)
+        return user;
+
+    if (history->user_count >= HISTORY_MAX_USERS)
+        _history_evict_user(server, history);
+    if (history->user_count >= HISTORY_MAX_USERS)
+        return NULL;
+
+    struct history_user blank = { .first_seen = (int64_t)time(NULL) };
+    strncpy(blank.name, name, MAX_NAME_LENGTH);
+    if (trie_add_copy(history->users, blank.name, &blank, sizeof(blank)) == NULL)
+        return NULL;
+    history->user_count++;
+    return trie_find(history->users, blank.name);
+}
+
+// Create the history of a server node, holding as many messages as its history_size
+// setting allows.
+void history_init(struct server_node* server)
+{
+    struct history* history = quick_malloc(sizeof(struct history), BULB_ALLOC_HISTORY);
+    history->capacity = server->info.history_size;
+    if (history->capacity > 0)
+        history->entries = quick_malloc(sizeof(struct history_entry) * history->capacity, BULB_ALLOC_HISTORY);
+    history->users = trie_new();
+    server->history = history;
+}
+
+// Free the history of a server node.
+void history_free(struct server_node* server)
+{
+    struct history* history = server->history;
+    if (history == NULL)
+        return;
+    trie_free(history->users);
+    quick_free(history->entries);
+    quick_free(history);
+    server->history = NULL;
+}
+
+// Record a message sent to a room, or to every room if room is empty. client is the
+// sending client, or NULL for messages sent by a server.
+void history_message(struct server_node* server, struct client_node* client, const char* room,
+                     const char* name, const char* message, bool from_server)
+{
+    struct history* history = server->history;
+    if (history == NULL)
+        return;
+
+    // Only the messages of this server's own clients are counted towards their user.
+    if (client != NULL && !CLIENT_IS_REMOTE(client))
+    {
+        struct history_user* user = _history_claim_user(server, client->userinfo->info.name);
+        if (user != NULL)
+            user->messages++;
+    }
+
+    if (history->capacity == 0)
+        return;
+    struct history_entry* entry = _history_push(history);
+    memset(entry, 0, sizeof(*entry));
+    entry->time = (int64_t)time(NULL);
+    entry->from_server = from_server;
+    strncpy(entry->room, room, MAX_ROOM_NAME_LENGTH);
+    strncpy(entry->name, name, MAX_NAME_LENGTH);
+    strncpy(entry->message, message, MAX_MESSAGE_LENGTH);
+}
+
+// Send the recent messages of a client's room to the client, which has just entered it.
+void history_replay(struct server_node* server, struct client_node* client)
+{
+    struct history* history = server->history;
+    if (history == NULL || history->count == 0 || client->room == NULL || CLIENT_IS_REMOTE(client))
+        return;
+
+    bool announced = false;
+    for (unsigned i = 0; i < history->count; i++)
+    {
+        const struct history_entry* entry = history_entry_at(history, i);
+        if (entry->room[0] != '\0' && strcmp(entry->room, client->room->name) != 0)
+            continue;
+        if (!announced)
+        {
+            stdout_obj_write(client->mt_sock, "Recent messages:\n", STDOUT_GENERIC);
+            announced = true;
+        }
+        message_obj_write(client->mt_sock, entry->name, entry->message, entry->from_server);
+    }
+}
+
+// Record a newly-validated client connecting to the server.
+void history_user_joined(struct server_node* server, struct client_node* client)
+{
+    if (server->history == NULL)
+        return;
+    struct history_user* user = _history_claim_user(server, client->userinfo->info.name);
+    if (user == NULL)
+        return;
+    user->connections++;
+    history_user_seen(server, client);
+}
+
+// Update the record of a client with its current room, as last seen now. This is done
+// as the client disconnects, and for every connected client before a snapshot is saved.
+void history_user_seen(struct server_node* server, struct client_node* client)
+{
+    if (server->history == NULL || client->userinfo == NULL)
+        return;
+    struct history_user* user = _history_claim_user(server, client->userinfo->info.name);
+    if (user == NULL)
+        return;
+    user->last_seen = (int64_t)time(NULL);
+    if (client->room != NULL)
+        strncpy(user->room, client->room->name, MAX_ROOM_NAME_LENGTH);
+}
+
+// Find a user's record by name. Returns NULL if the user has not been seen.
+const struct history_user* history_find_user(struct server_node* server, const char* name)
+{
+    if (server->history == NULL)
+        return NULL;
+    return trie_find(server->history->users, name);
+}
+
+// Restore a message from a snapshot, after any messages already restored.
+void history_restore_message(struct server_node* server, const struct history_entry* entry)
+{
+    struct history* history = server->history;
+    if (history == NULL || history->capacity == 0)
+        return;
+    struct history_entry* slot = _history_push(history);
+    memcpy(slot, entry, sizeof(*slot));
+    slot->room[MAX_ROOM_NAME_LENGTH] = '\0';
+    slot->name[MAX_NAME_LENGTH] = '\0';
+    slot->message[MAX_MESSAGE_LENGTH] = '\0';
+}
+
+// Restore a user's record from a snapshot.
+void history_restore_user(struct server_node* server, const struct history_user* user)
+{
+    char name[MAX_NAME_LENGTH + 1];
+    memcpy(name, user->name, MAX_NAME_LENGTH);
+    name[MAX_NAME_LENGTH] = '\0';
+    if (server->history == NULL || name[0] == '\0')
+        return;
+
+    struct history_user* restored = _history_claim_user(server, name);
+    if (restored == NULL)
+        return;
+    memcpy(restored, user, sizeof(*restored));
+    memcpy(restored->name, name, sizeof(name));
+    restored->room[MAX_ROOM_NAME_LENGTH] = '\0';
+}
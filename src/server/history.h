@@ -0,0 +1,96 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// The history of a server holds the most recent messages sent to its rooms, which are
+// shown to clients as they enter a room, and a record of each user that has connected
+// to the server, which the seen command reports. Both are kept across restarts by the
+// server's snapshot, see snapshot.h.
+//
+// Messages are kept in a single ring shared by every room, so that rooms created and
+// freed as clients come and go do not take their history with them. Users are keyed by
+// name, and the user seen longest ago is forgotten once too many are known. The history
+// is only accessed while the server node's client update lock is held.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+
+// Most users remembered by a server.
+#define HISTORY_MAX_USERS   4096
+
+// A message sent to a room. These are stored as is in snapshots.
+struct history_entry
+{
+    int64_t time;       // Seconds since the epoch.
+    char room[MAX_ROOM_NAME_LENGTH + 1];    // Empty for messages broadcast to every room.
+    char name[MAX_NAME_LENGTH + 1];
+    char message[MAX_MESSAGE_LENGTH + 1];
+    bool from_server;
+};
+
+// A user that has connected to the server. These are stored as is in snapshots.
+struct history_user
+{
+    char name[MAX_NAME_LENGTH + 1];
+    char room[MAX_ROOM_NAME_LENGTH + 1];    // Room the user was last in.
+    int64_t first_seen; // Seconds since the epoch.
+    int64_t last_seen;
+    uint32_t connections;
+    uint32_t messages;
+};
+
+struct history
+{
+    // Ring of the most recent messages. The oldest message is stored at next once the
+    // ring is full.
+    struct history_entry* entries;
+    unsigned capacity;
+    unsigned count;
+    unsigned next;
+
+    // history_user records keyed by name.
+    struct trie* users;
+    unsigned user_count;
+};
+
+// Get the ith oldest message of a history.
+static inline const struct history_entry* history_entry_at(const struct history* history, unsigned i)
+{
+    return &history->entries[(history->next + history->capacity - history->count + i) % history->capacity];
+}
+
+// Create the history of a server node, holding as many messages as its history_size
+// setting allows.
+void history_init(struct server_node* server);
+
+// Free the history of a server node.
+void history_free(struct server_node* server);
+
+// Record a message sent to a room, or to every room if room is empty. client is the
+// sending client, or NULL for messages sent by a server.
+void history_message(struct server_node* server, struct client_node* client, const char* room,
+                     const char* name, const char* message, bool from_server);
+
+// Send the recent messages of a client's room to the client, which has just entered it.
+void history_replay(struct server_node* server, struct client_node* client);
+
+// Record a newly-validated client connecting to the server.
+void history_user_joined(struct server_node* server, struct client_node* client);
+
+// Update the record of a client with its current room, as last seen now. This is done
+// as the client disconnects, and for every connected client before a snapshot is saved.
+void history_user_seen(struct server_node* server, struct client_node* client);
+
+// Find a user's record by name. Returns NULL if the user has not been seen.
+const struct history_user* history_find_user(struct server_node* server, const char* name);
+
+// Restore a message from a snapshot, after any messages already restored.
+void history_restore_message(struct server_node* server, const struct history_entry* entry);
+
+// Restore a user's record from a snapshot.
+void history_restore_user(struct server_node* server, const struct history_user* user);
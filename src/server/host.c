@@ -0,0 +1,258 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "util.h"
+#include "bulb_server.h"
+#include "bulb_host.h"
+#include "shared_interface.h"
+#include "ip_limiter.h"
+#include "stdout_obj.h"
+#include "host.h"
+
+#ifdef WIN32
+#   define poll WSAPoll
+#else
+#   include <poll.h>
+#endif
+
+// Longest time the listen thread waits for new connections, in milliseconds, so that
+// parked connections are reconsidered and servers added to the host are polled.
+#define HOST_POLL_MS    100
+
+// Find a listening virtual server by name among the server nodes of an I/O context.
+// Returns NULL if not found.
+static struct server_node* _host_find_node(struct server_io* io, const char* name)
+{
+    for (struct server_node* node = io->nodes_head; node != NULL; node = node->io_list.next)
+    {
+        if (!node->cleanup && node->bulb_server->is_listening && strcmp(node->info.name, name) == 0)
+            return node;
+    }
+    return NULL;
+}
+
+// Refuse a client asking to join another virtual server.
+static void _host_refuse(struct server_node* server, struct client_node* client, struct bulb_userinfo* info,
+                         const char* error)
+{
+    char buffer[128 + MAX_NAME_LENGTH];
+    snprintf(buffer, sizeof(buffer), "%s\n", error);
+    stdout_obj_write(client->mt_sock, buffer, STDOUT_KICK_MSG);
+    bulb_printf(server, "Client \"%s\" (%s) failed to join server \"%s\": %s\n", info->name, client->ip_addr,
+        info->server_name, error);
+    server_disconnect_client(server, client, false, true, true);
+}
+
+// Listen for new connections on the listen socket of every virtual server of a host.
+static int _host_listen_thread(void* h)
+{
+    struct bulb_host* host = (struct bulb_host*)h;
+    struct pollfd* pfds = NULL;
+    unsigned pfds_capacity = 0;
+
+    for (;;)
+    {
+        // Reconsider any parked connections, and gather each listen socket to poll.
+        mtx_lock(&host->lock);
+        if (host->disconnecting)
+        {
+            mtx_unlock(&host->lock);
+            break;
+        }
+        if (pfds_capacity < host->count)
+        {
+            quick_free(pfds);
+            pfds_capacity = host->capacity;
+            pfds = quick_malloc(sizeof(struct pollfd) * pfds_capacity, BULB_ALLOC_NETWORKING);
+        }
+        unsigned count = 0;
+        for (unsigned i = 0; i < host->count; i++)
+        {
+            struct bulb_server* server = host->servers[i];
+            if (!server->is_listening)
+                continue;
+            server_host_poll(server, false);
+            if (server->server_node->listen_sock != INVALID_SOCKET)
+                pfds[count++] = (struct pollfd){ .fd = server->server_node->listen_sock, .events = POLLIN };
+        }
+        mtx_unlock(&host->lock);
+
+        // Virtual servers may be freed while the listen thread is waiting, which is safe
+        // as their listen sockets are non-blocking.
+        if (count == 0)
+        {
+            thrd_sleep(&(struct timespec){ .tv_nsec = HOST_POLL_MS * 1000000L }, NULL);
+            continue;
+        }
+        if (poll(pfds, count, HOST_POLL_MS) <= 0)
+            continue;
+
+        // Accept new connections on each listen socket that is ready.
+        mtx_lock(&host->lock);
+        for (unsigned i = 0; i < host->count; i++)
+        {
+            struct bulb_server* server = host->servers[i];
+            if (!server->is_listening || server->server_node->listen_sock == INVALID_SOCKET)
+                continue;
+            for (unsigned j = 0; j < count; j++)
+            {
+                if (pfds[j].fd == server->server_node->listen_sock && pfds[j].revents != 0)
+                {
+                    server_host_poll(server, true);
+                    break;
+                }
+            }
+        }
+        mtx_unlock(&host->lock);
+    }
+
+    quick_free(pfds);
+    return 0;
+}
+
+// Create a new host, and start its listen thread and client management thread.
+// Returns NULL on error.
+struct bulb_host* host_init()
+{
+    struct bulb_host* host = quick_malloc(sizeof(struct bulb_host), BULB_ALLOC_GENERAL);
+    mtx_init(&host->lock, mtx_plain);
+    host->io = server_io_new();
+    if (thrd_create(&host->listen_thread, _host_listen_thread, host) != thrd_success)
+    {
+        server_io_release(host->io);
+        mtx_destroy(&host->lock);
+        quick_free(host);
+        return NULL;
+    }
+    return host;
+}
+
+// Create a new virtual server on a host, which is otherwise used like any server
+// created by server_init(). If port is 0, the virtual server can only be reached by
+// name through the ports of the host's other virtual servers. error_state can be NULL.
+// Returns NULL on error.
+struct bulb_server* host_server_init(struct bulb_host* host, uint16_t port, enum server_error_state* error_state)
+{
+    ASSERT(host != NULL, return NULL);
+    struct bulb_server* server = server_create(port, host->io, error_state);
+    if (server == NULL)
+        return NULL;
+
+    // The listen thread polls every listen socket at once, so none of them may block.
+    server->host = host;
+    if (server->server_node->listen_sock != INVALID_SOCKET)
+        set_socket_non_blocking(server->server_node->listen_sock);
+
+    mtx_lock(&host->lock);
+    if (host->count == host->capacity)
+    {
+        unsigned capacity = MAX(host->capacity * 2, 8);
+        struct bulb_server** servers = quick_malloc(sizeof(struct bulb_server*) * capacity, BULB_ALLOC_GENERAL);
+        if (host->servers != NULL)
+            memcpy(servers, host->servers, sizeof(struct bulb_server*) * host->count);
+        quick_free(host->servers);
+        host->servers = servers;
+        host->capacity = capacity;
+    }
+    host->servers[host->count++] = server;
+    mtx_unlock(&host->lock);
+    return server;
+}
+
+// Get the number of virtual servers on a host.
+unsigned host_num_servers(struct bulb_host* host)
+{
+    ASSERT(host != NULL, return 0);
+    mtx_lock(&host->lock);
+    unsigned count = host->count;
+    mtx_unlock(&host->lock);
+    return count;
+}
+
+// Stop polling a virtual server that is being freed.
+void host_remove_server(struct bulb_host* host, struct bulb_server* server)
+{
+    mtx_lock(&host->lock);
+    for (unsigned i = 0; i < host->count; i++)
+    {
+        if (host->servers[i] == server)
+        {
+            memmove(&host->servers[i], &host->servers[i + 1], sizeof(struct bulb_server*) * (host->count - i - 1));
+            host->count--;
+            break;
+        }
+    }
+    mtx_unlock(&host->lock);
+}
+
+// Move a client that has yet to authenticate to the virtual server named by its
+// userinfo, which must share the client's I/O context. Returns false if the client was
+// refused, in which case it is disconnected.
+bool host_route_client(struct server_node* server, struct client_node* client, struct bulb_userinfo* info)
+{
+    info->server_name[MAX_NAME_LENGTH] = '\0';
+    if (strcmp(info->server_name, server->info.name) == 0)
+        return true;
+
+    struct server_node* target = _host_find_node(server->io, info->server_name);
+    if (target == NULL)
+    {
+        _host_refuse(server, client, info, "No server by that name is hosted here.");
+        return false;
+    }
+
+    // Sessions belong to the carrier of their proxy, which is connected to one server.
+    if (client->mt_sock->carrier != NULL)
+    {
+        _host_refuse(server, client, info, "Clients connected through a proxy cannot join another server.");
+        return false;
+    }
+
+    // The client's connection is subject to the other server's per-address limits.
+    uint32_t host_addr = ntohl(client->addr.sin_addr.s_addr);
+    if (ip_limiter_admit(target->ip_limiter, host_addr, &target->info) != IP_LIMIT_ADMITTED)
+    {
+        _host_refuse(server, client, info, "Too many connections from your address.");
+        return false;
+    }
+    ip_limiter_release(server->ip_limiter, host_addr);
+    server_move_client(server, client, target);
+    return !client_flagged_for_deletion(client);
+}
+
+// Stop a host's threads and free it. Any virtual servers that have not yet been freed
+// with server_free() are freed first.
+void host_free(struct bulb_host* host)
+{
+    ASSERT(host != NULL, return);
+    for (;;)
+    {
+        mtx_lock(&host->lock);
+        struct bulb_server* server = (host->count > 0) ? host->servers[host->count - 1] : NULL;
+        mtx_unlock(&host->lock);
+        if (server == NULL)
+            break;
+        server_free(server);
+    }
+
+    mtx_lock(&host->lock);
+    host->disconnecting = true;
+    mtx_unlock(&host->lock);
+    thrd_join(host->listen_thread, NULL);
+
+    // The I/O context is freed by its client management thread once every server node
+    // has been freed.
+    server_io_release(host->io);
+    mtx_destroy(&host->lock);
+    quick_free(host->servers);
+    quick_free(host);
+}
@@ -0,0 +1,54 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Hosts run many virtual servers in one process, see bulb_host.h. Every virtual server
+// of a host shares the host's I/O context, so that the clients of every virtual server
+// are managed by one client management thread and one set of socket manager instances,
+// and the host's listen thread polls the listen socket of every virtual server.
+//
+// As virtual servers share one client update lock, a client that has yet to
+// authenticate can be moved from one virtual server to another while that lock is held,
+// which is how clients are routed by name, see host_route_client().
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "bulb_host.h"
+#include "bulb_structs.h"
+#include "server_node.h"
+#include "client_node.h"
+
+struct bulb_host
+{
+    struct server_io* io;
+    thrd_t listen_thread;
+
+    // Every virtual server of the host. The list, and the is_listening attribute and
+    // listen socket of each virtual server, are only accessed while lock is held.
+    mtx_t lock;
+    struct bulb_server** servers;
+    unsigned count;
+    unsigned capacity;
+    bool disconnecting;
+};
+
+// Create a new server instance, whose clients are managed by the given I/O context, or
+// by an I/O context of its own if io is NULL. Servers sharing an I/O context have no
+// listen socket of their own if port is 0. error_state can be NULL. Returns NULL on
+// error. See server.c.
+struct bulb_server* server_create(uint16_t port, struct server_io* io, enum server_error_state* error_state);
+
+// Accept every connection waiting on a virtual server's listen socket, and reconsider
+// the connections parked in its admission queue. See server.c.
+void server_host_poll(struct bulb_server* server, bool readable);
+
+// Stop polling a virtual server that is being freed.
+void host_remove_server(struct bulb_host* host, struct bulb_server* server);
+
+// Move a client that has yet to authenticate to the virtual server named by its
+// userinfo, which must share the client's I/O context. Returns false if the client was
+// refused, in which case it is disconnected.
+bool host_route_client(struct server_node* server, struct client_node* client, struct bulb_userinfo* info);
@@ -0,0 +1,211 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Each address is tracked by a single entry of an open-addressed hash table, which is
+// probed linearly over a bounded window. An entry with no open connections and a full
+// token bucket behaves exactly like an absent entry, so such entries are aged out by
+// reusing them in place rather than being deleted. The table only grows once a probe
+// window holds no reusable entry, at which point aged entries are dropped.
+
+#include <threads.h>
+
+#include "util.h"
+#include "alloc.h"
+#include "token_bucket.h"
+#include "ip_limiter.h"
+
+#define IP_LIMITER_INITIAL_BITS     10
+#define IP_LIMITER_PROBE_LIMIT      32
+#define IP_LIMITER_RATE_PERIOD_MS   (60 * MILLISECONDS)
+
+struct ip_limiter_entry
+{
+    uint32_t addr;
+    uint32_t connections;
+    struct token_bucket bucket;
+    bool used;
+};
+
+struct ip_limiter
+{
+    mtx_t lock;
+    struct ip_limiter_entry* entries;
+    unsigned bits;
+};
+
+// Get the first slot probed for an address.
+static inline size_t _ip_limiter_hash(uint32_t addr, unsigned bits)
+{
+    return (size_t)((addr * 0x9E3779B1u) >> (32 - bits));
+}
+
+// Get the number of connections an address may open at once before being rate limited.
+static inline unsigned _ip_limiter_burst(const struct bulb_userinfo* info)
+{
+    return MAX(info->connection_burst_per_ip, 1);
+}
+
+// Check if an entry can be reused, refilling its token bucket as of now_ms.
+static bool _ip_limiter_entry_stale(struct ip_limiter_entry* entry, const struct bulb_userinfo* info,
+                                    int64_t now_ms)
+{
+    if (!entry->used)
+        return true;
+    if (entry->connections > 0)
+        return false;
+    if (info->connection_rate_per_ip == 0)
+        return true;
+    token_bucket_refill(&entry->bucket, info->connection_rate_per_ip, IP_LIMITER_RATE_PERIOD_MS,
+        _ip_limiter_burst(info), now_ms);
+    return token_bucket_full(&entry->bucket, _ip_limiter_burst(info));
+}
+
+// Find the entry of an address. If the address has no entry, a stale entry is claimed
+// for it instead. Returns NULL if its probe window holds no reusable entry.
+static struct ip_limiter_entry* _ip_limiter_claim(struct ip_limiter* limiter, uint32_t addr,
+                                                  const struct bulb_userinfo* info, int64_t now_ms)
+{
+    size_t mask = ((size_t)1 << limiter->bits) - 1;
+    size_t slot = _ip_limiter_hash(addr, limiter->bits);
+    struct ip_limiter_entry* reusable = NULL;
+    for (size_t i = 0; i < IP_LIMITER_PROBE_LIMIT; i++)
+    {
+        struct ip_limiter_entry* entry = &limiter->entries[(slot + i) & mask];
+        if (entry->used && entry->addr == addr)
+            return entry;
+        if (reusable == NULL && _ip_limiter_entry_stale(entry, info, now_ms))
+            reusable = entry;
+    }
+
+    if (reusable != NULL)
+    {
+        reusable->used = true;
+        reusable->addr = addr;
+        reusable->connections = 0;
+        token_bucket_init(&reusable->bucket, _ip_limiter_burst(info), now_ms);
+    }
+    return reusable;
+}
+
+// Double the capacity of an IP limiter, dropping every stale entry.
+static void _ip_limiter_grow(struct ip_limiter* limiter, const struct bulb_userinfo* info, int64_t now_ms)
+{
+    struct ip_limiter_entry* old_entries = limiter->entries;
+    size_t old_count = (size_t)1 << limiter->bits;
+
+    for (;;)
+    {
+        limiter->bits++;
+        limiter->entries = quick_malloc(sizeof(struct ip_limiter_entry) << limiter->bits,
+            BULB_ALLOC_NETWORKING);
+
+        // Entries are copied over whole, rather than claimed afresh, so that their
+        // connection counts and token buckets are preserved.
+        bool placed = true;
+        for (size_t i = 0; i < old_count && placed; i++)
+        {
+            struct ip_limiter_entry* old_entry = &old_entries[i];
+            if (_ip_limiter_entry_stale(old_entry, info, now_ms))
+                continue;
+
+            struct ip_limiter_entry* entry = _ip_limiter_claim(limiter, old_entry->addr, info, now_ms);
+            if (entry != NULL)
+                *entry = *old_entry;
+            placed = (entry != NULL);
+        }
+        if (placed)
+            break;
+        quick_free(limiter->entries);
+    }
+
+    quick_free(old_entries);
+}
+
+// Create a new IP limiter.
+struct ip_limiter* ip_limiter_new()
+{
+    struct ip_limiter* limiter = quick_malloc(sizeof(struct ip_limiter), BULB_ALLOC_NETWORKING);
+    mtx_init(&limiter->lock, mtx_plain);
+    limiter->bits = IP_LIMITER_INITIAL_BITS;
+    limiter->entries = quick_malloc(sizeof(struct ip_limiter_entry) << limiter->bits,
+        BULB_ALLOC_NETWORKING);
+    return limiter;
+}
+
+// Free an IP limiter from memory.
+void ip_limiter_free(struct ip_limiter* limiter)
+{
+    if (limiter == NULL)
+        return;
+    mtx_destroy(&limiter->lock);
+    quick_free(limiter->entries);
+    quick_free(limiter);
+}
+
+// Admit a new connection from an address, given in host byte order, according to the
+// per-address limits of a server's userinfo. Every admitted connection must later be
+// released through ip_limiter_release().
+enum ip_limit_result ip_limiter_admit(struct ip_limiter* limiter, uint32_t addr,
+                                      const struct bulb_userinfo* info)
+{
+    ASSERT(limiter, return IP_LIMIT_ADMITTED);
+
+    int64_t now_ms = token_bucket_now();
+    mtx_lock(&limiter->lock);
+    struct ip_limiter_entry* entry;
+    while ((entry = _ip_limiter_claim(limiter, addr, info, now_ms)) == NULL)
+        _ip_limiter_grow(limiter, info, now_ms);
+
+    enum ip_limit_result result = IP_LIMIT_ADMITTED;
+    if (info->max_connections_per_ip > 0 && entry->connections >= info->max_connections_per_ip)
+        result = IP_LIMIT_CONNECTIONS_EXCEEDED;
+    else if (info->connection_rate_per_ip > 0)
+    {
+        token_bucket_refill(&entry->bucket, info->connection_rate_per_ip, IP_LIMITER_RATE_PERIOD_MS,
+            _ip_limiter_burst(info), now_ms);
+        if (!token_bucket_take(&entry->bucket, 1))
+            result = IP_LIMIT_RATE_EXCEEDED;
+    }
+
+    if (result == IP_LIMIT_ADMITTED)
+        entry->connections++;
+    mtx_unlock(&limiter->lock);
+    return result;
+}
+
+// Count a connection from an address that was admitted elsewhere, such as by another
+// process that handed its server over, without applying any limits. The connection
+// must later be released through ip_limiter_release() as usual.
+void ip_limiter_adopt(struct ip_limiter* limiter, uint32_t addr, const struct bulb_userinfo* info)
+{
+    ASSERT(limiter, return);
+
+    int64_t now_ms = token_bucket_now();
+    mtx_lock(&limiter->lock);
+    struct ip_limiter_entry* entry;
+    while ((entry = _ip_limiter_claim(limiter, addr, info, now_ms)) == NULL)
+        _ip_limiter_grow(limiter, info, now_ms);
+    entry->connections++;
+    mtx_unlock(&limiter->lock);
+}
+
+// Release a connection previously admitted from an address.
+void ip_limiter_release(struct ip_limiter* limiter, uint32_t addr)
+{
+    ASSERT(limiter, return);
+
+    mtx_lock(&limiter->lock);
+    size_t mask = ((size_t)1 << limiter->bits) - 1;
+    size_t slot = _ip_limiter_hash(addr, limiter->bits);
+    for (size_t i = 0; i < IP_LIMITER_PROBE_LIMIT; i++)
+    {
+        struct ip_limiter_entry* entry = &limiter->entries[(slot + i) & mask];
+        if (entry->used && entry->addr == addr)
+        {
+            if (entry->connections > 0)
+                entry->connections--;
+            break;
+        }
+    }
+    mtx_unlock(&limiter->lock);
+}
@@ -0,0 +1,46 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// The IP limiter restricts how quickly each source address may open new connections,
+// and how many connections each source address may hold open at once. It is consulted
+// by the listen thread straight after accept(), before any client state is allocated.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bulb_structs.h"
+
+enum ip_limit_result
+{
+    IP_LIMIT_ADMITTED = 0,
+
+    // The address has opened new connections faster than its rate limit allows.
+    IP_LIMIT_RATE_EXCEEDED,
+
+    // The address already holds as many open connections as it is allowed.
+    IP_LIMIT_CONNECTIONS_EXCEEDED
+};
+
+struct ip_limiter;
+
+// Create a new IP limiter.
+struct ip_limiter* ip_limiter_new();
+
+// Free an IP limiter from memory.
+void ip_limiter_free(struct ip_limiter* limiter);
+
+// Admit a new connection from an address, given in host byte order, according to the
+// per-address limits of a server's userinfo. Every admitted connection must later be
+// released through ip_limiter_release().
+enum ip_limit_result ip_limiter_admit(struct ip_limiter* limiter, uint32_t addr,
+                                      const struct bulb_userinfo* info);
+
+// Count a connection from an address that was admitted elsewhere, such as by another
+// process that handed its server over, without applying any limits. The connection
+// must later be released through ip_limiter_release() as usual.
+void ip_limiter_adopt(struct ip_limiter* limiter, uint32_t addr, const struct bulb_userinfo* info);
+
+// Release a connection previously admitted from an address.
+void ip_limiter_release(struct ip_limiter* limiter, uint32_t addr);
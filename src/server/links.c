@@ -0,0 +1,558 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "util.h"
+#include "trie.h"
+#include "epoch.h"
+#include "bulb_version.h"
+#include "bulb_structs.h"
+#include "bulb_server.h"
+#include "shared_interface.h"
+#include "stdout_obj.h"
+#include "connect_obj.h"
+#include "message_obj.h"
+#include "direct_obj.h"
+#include "rooms.h"
+#include "links.h"
+#include "history.h"
+
+// Size of a buffer that can hold any single event.
+#define LINK_EVENT_BUFFER_SIZE  (sizeof(struct link_event) + MAX_MESSAGE_LENGTH + LINK_EVENT_ALIGN)
+
+// The most recent event seen from an origin server.
+struct link_origin
+{
+    uint64_t instance;
+    uint32_t seq;
+};
+
+// Allocate a link for a linked server's client node.
+static struct server_link* _link_new(struct server_node* server, struct client_node* client, bool outgoing)
+{
+    struct server_link* link = quick_malloc(sizeof(struct server_link), BULB_ALLOC_NETWORKING);
+    link->node = client;
+    link->outgoing = outgoing;
+    link->batch = quick_malloc(LINK_BATCH_BYTES, BULB_ALLOC_NETWORKING);
+    client->link = link;
+    LINKED_LIST_ADD(link, server->links_head, server->links_tail);
+    return link;
+}
+
+// Free a link.
+static void _link_free(struct server_link* link)
+{
+    quick_free(link->batch);
+    quick_free(link);
+}
+
+// Describe a linked server by its name and address, or only its address if it has not
+// authenticated yet.
+static const char* _link_describe(struct client_node* client, char* buffer, size_t size)
+{
+    if (client->userinfo == NULL)
+        return client->ip_addr;
+    snprintf(buffer, size, "\"%s\" (%s)", client->userinfo->info.name, client->ip_addr);
+    return buffer;
+}
+
+// Send this server's userinfo to a linked server, which authenticates this server.
+static void _link_send_userinfo(struct server_node* server, struct client_node* client)
+{
+    struct userinfo_obj obj;
+    memcpy(&obj.info, &server->info, sizeof(obj.info));
+    obj.base.type = BULB_USERINFO;
+    obj.base.size = sizeof(obj);
+    obj.info.is_server = true;
+    obj.info.major = MAJOR;
+    obj.info.minor = MINOR;
+    obj.info.patch = PATCH;
+    memset(obj.info.mux_key, 0, sizeof(obj.info.mux_key));
+    userinfo_obj_write(client->mt_sock, &obj);
+}
+
+// Send a link's batch of events, if it has any.
+static void _link_flush(struct server_link* link)
+{
+    if (link->batch_len == 0)
+        return;
+    link_obj_write(link->node->mt_sock, link->batch, link->batch_len);
+    link->batch_len = 0;
+}
+
+// Queue an event to be sent to a linked server.
+static void _link_send(struct server_node* server, struct server_link* link, const struct link_event* event)
+{
+    if (!link->established || client_flagged_for_deletion(link->node))
+        return;
+    if (link->batch_len + event->size > LINK_BATCH_BYTES)
+        _link_flush(link);
+    memcpy(link->batch + link->batch_len, event, event->size);
+    link->batch_len += event->size;
+    link->events_sent++;
+
+    // Events are sent at once if batching is disabled. Otherwise, the client management
+    // thread is woken to send every batch once the batching interval has elapsed.
+    if (server->info.link_batch_ms == 0)
+    {
+        _link_flush(link);
+        return;
+    }
+    if (!server->link_flush_pending)
+    {
+        timespec_get(&server->next_link_flush, TIME_UTC);
+        timespec_add_ms(&server->next_link_flush, server->info.link_batch_ms);
+        server->link_flush_pending = true;
+        cnd_signal(&server->io->client_update_signal);
+    }
+}
+
+// Queue an event to be sent to every linked server, except the one it arrived from.
+static void _link_flood(struct server_node* server, struct server_link* except, const struct link_event* event)
+{
+    for (struct server_link* link = server->links_head; link != NULL; link = link->next)
+    {
+        if (link != except)
+            _link_send(server, link, event);
+    }
+}
+
+// Build an event about a client, raised by this server. buffer must be able to hold
+// LINK_EVENT_BUFFER_SIZE bytes.
+static struct link_event* _link_event_new(struct server_node* server, uint64_t* buffer, enum link_event_type type,
+                                          const char* name, const char* room, const char* recipient,
+                                          const char* text)
+{
+    struct link_event* event = (struct link_event*)buffer;
+    memset(event, 0, LINK_EVENT_BUFFER_SIZE);
+    size_t text_len = MIN(strlen(text), MAX_MESSAGE_LENGTH);
+    size_t size = offsetof(struct link_event, text) + text_len + 1;
+    event->type = type;
+    event->size = (uint16_t)((size + LINK_EVENT_ALIGN - 1) / LINK_EVENT_ALIGN * LINK_EVENT_ALIGN);
+    event->seq = ++server->link_seq;
+    event->instance = server->link_instance;
+    strncpy(event->origin, server->info.name, MAX_NAME_LENGTH);
+    strncpy(event->name, name, MAX_NAME_LENGTH);
+    strncpy(event->room, room, MAX_ROOM_NAME_LENGTH);
+    strncpy(event->recipient, recipient, MAX_NAME_LENGTH);
+    memcpy(event->text, text, text_len);
+    return event;
+}
+
+// Raise an event about a client or this server, and send it to every linked server.
+static void _link_raise(struct server_node* server, enum link_event_type type, const char* name,
+                        const char* room, const char* text)
+{
+    if (server->links_head == NULL)
+        return;
+    uint64_t buffer[LINK_EVENT_BUFFER_SIZE / sizeof(uint64_t) + 1];
+    _link_flood(server, NULL, _link_event_new(server, buffer, type, name, room, "", text));
+}
+
+// Send every client that a newly established link does not know of yet to the linked
+// server: the clients of this server, and those reached through other links.
+static void _link_burst(struct server_node* server, struct server_link* link)
+{
+    uint64_t buffer[LINK_EVENT_BUFFER_SIZE / sizeof(uint64_t) + 1];
+    epoch_enter();
+    struct client_roster* roster = atomic_load(&server->roster);
+    for (unsigned i = 0; i < roster->count; i++)
+    {
+        struct client_node* node = roster->clients[i];
+        if (node->status != CLIENT_VALIDATED || node->room == NULL || node->via == link)
+            continue;
+        _link_send(server, link, _link_event_new(server, buffer, LINK_EVENT_JOIN, node->userinfo->info.name,
+            node->room->name, "", node->userinfo->info.description));
+    }
+    epoch_exit();
+}
+
+// Check whether an event from another server has been seen before, recording it if not.
+// Events from each origin server arrive in the order they were raised, unless links
+// form a cycle.
+static bool _link_seen(struct server_node* server, const struct link_event* event)
+{
+    struct link_origin* origin = trie_find(server->link_origins, event->origin);
+    if (origin == NULL)
+    {
+        trie_add_copy(server->link_origins, event->origin,
+            &(struct link_origin){ .instance = event->instance, .seq = event->seq }, sizeof(struct link_origin));
+        return false;
+    }
+
+    // Origin servers that have restarted begin their sequence of events again.
+    if (origin->instance != event->instance || event->seq > origin->seq)
+    {
+        origin->instance = event->instance;
+        origin->seq = event->seq;
+        return false;
+    }
+    return true;
+}
+
+// Find a client that was learned through a link by name. Returns NULL if not found.
+static struct client_node* _link_find_remote(struct server_node* server, struct server_link* link,
+                                             const char* name)
+{
+    struct client_node* node = server_find_by_name(server, name);
+    return (node != NULL && node->via == link && node->status == CLIENT_VALIDATED) ? node : NULL;
+}
+
+// Add a client connected to another server. Clients keep their name on each server they
+// are known to, so a client whose name is taken on this server is not added.
+static void _link_apply_join(struct server_node* server, struct server_link* link, struct link_event* event)
+{
+    struct client_node* node = quick_malloc(sizeof(struct client_node), BULB_ALLOC_ROSTER);
+    node->server_node = server;
+    client_shared_node_init(node);
+    node->via = link;
+    node->status = CLIENT_VALIDATED;
+    memcpy(node->ip_addr, link->node->ip_addr, sizeof(node->ip_addr));
+
+    node->userinfo = pool_alloc(sizeof(struct userinfo_obj), BULB_ALLOC_ROSTER);
+    memset(node->userinfo, 0, sizeof(struct userinfo_obj));
+    node->userinfo->base.type = BULB_USERINFO;
+    node->userinfo->base.size = sizeof(struct userinfo_obj);
+    strncpy(node->userinfo->info.name, event->name, MAX_NAME_LENGTH);
+    strncpy(node->userinfo->info.description, event->text, MAX_DESC_LENGTH);
+    memcpy(node->userinfo->info.ip_addr, node->ip_addr, sizeof(node->ip_addr));
+    if (!server_connect_client(server, node))
+    {
+        client_shared_node_free(node);
+        return;
+    }
+
+    // Synchronise the client's arrival with the members of its room.
+    room_enter(server, node, event->room);
+    char buffer[64 + MAX_NAME_LENGTH];
+    snprintf(buffer, sizeof(buffer), "Client \"%s\" has connected\n", event->name);
+    LOOP_ROOM(node->room, node, member,
+    {
+        stdout_obj_write(member->mt_sock, buffer, STDOUT_GENERIC);
+        connect_obj_write(member->mt_sock, node->userinfo, false);
+    });
+    bulb_printf(server, "Client \"%s\" has connected through linked server \"%s\"\n", event->name,
+        link->node->userinfo->info.name);
+}
+
+// Route a direct message towards its recipient, which is either connected to this
+// server or reached through another link.
+static void _link_route_direct(struct server_node* server, struct server_link* link, struct link_event* event)
+{
+    struct client_node* recipient = server_find_by_name(server, event->recipient);
+    if (recipient == NULL || recipient->status != CLIENT_VALIDATED)
+        return;
+    if (!CLIENT_IS_REMOTE(recipient))
+        direct_obj_write(recipient->mt_sock, 0, DIRECT_STATUS_MESSAGE, event->name, event->text);
+    else if (recipient->via != link)
+        _link_send(server, recipient->via, event);
+}
+
+// Prepare a server node for linking to other servers.
+void links_init(struct server_node* server)
+{
+    server->link_origins = trie_new();
+
+    // Each instance of a server is told apart from its previous instances, so that other
+    // servers do not discard its events after it restarts.
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    server->link_instance = (uint64_t)now.tv_sec * NANOSECONDS + (uint64_t)now.tv_nsec;
+}
+
+// Free every link of a server node. This does not free the linked servers' client nodes.
+void links_free(struct server_node* server)
+{
+    while (server->links_head != NULL)
+    {
+        struct server_link* link = server->links_head;
+        LINKED_LIST_REMOVE(link, server->links_head, server->links_tail);
+        _link_free(link);
+    }
+    trie_free(server->link_origins);
+    server->link_origins = NULL;
+}
+
+// Check whether a server node can be linked to other servers, which requires it to be
+// named and to have a link key.
+bool links_enabled(struct server_node* server)
+{
+    return server->info.name[0] != '\0' && server->info.link_key[0] != '\0';
+}
+
+// Start linking to another server through a newly connected client node, by sending it
+// this server's userinfo.
+void links_open(struct server_node* server, struct client_node* client)
+{
+    _link_new(server, client, true);
+    _link_send_userinfo(server, client);
+}
+
+// Authenticate a userinfo object sent by a linked server, which is either a server
+// linking to this server, or the reply of a server that this server is linking to.
+// The object is freed if the link is refused.
+void links_authenticate(struct server_node* server, struct client_node* client, struct userinfo_obj* obj)
+{
+    obj->info.name[MAX_NAME_LENGTH] = '\0';
+    obj->info.link_key[MAX_LINK_KEY_LENGTH] = '\0';
+
+    const char* error = NULL;
+    if (!links_enabled(server))
+        error = "This server does not accept server links.";
+    else if (!obj->info.is_server)
+        error = "Only servers can be linked to.";
+    else if (obj->info.major != MAJOR || obj->info.minor != MINOR || obj->info.patch != PATCH)
+        error = "The versions of both servers must match.";
+    else if (!str_matches_secret(server->info.link_key, obj->info.link_key))
+        error = "Incorrect link key.";
+    else if (obj->info.name[0] == '\0' || !str_isprint(obj->info.name))
+        error = "Linked servers must be named with displayable characters.";
+    else if (strcmp(obj->info.name, server->info.name) == 0 || links_find(server, obj->info.name) != NULL)
+        error = "A server with that name is already linked.";
+    else if (server->info.relay && client->link == NULL)
+        error = "This server is a relay, so only links to its core server.";
+    else if (server->info.relay && obj->info.relay)
+        error = "Relays cannot be linked to each other.";
+    else if (client->mt_sock->carrier != NULL)
+        error = "Servers cannot be linked through a proxy.";
+    if (error != NULL)
+    {
+        bulb_printf(server, "Server link with %s refused: %s\n", client->ip_addr, error);
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "%s\n", error);
+        stdout_obj_write(client->mt_sock, buffer, STDOUT_KICK_MSG);
+        pool_free(obj);
+        server_disconnect_client(server, client, false, true, true);
+        return;
+    }
+
+    // Servers linking to this server are replied to with this server's userinfo, which
+    // authenticates this server in turn.
+    pool_retag(obj, BULB_ALLOC_ROSTER);
+    client->userinfo = obj;
+    struct server_link* link = client->link;
+    if (link == NULL)
+    {
+        link = _link_new(server, client, false);
+        _link_send_userinfo(server, client);
+    }
+    link->established = true;
+    link->relay = obj->info.relay;
+    client_set_status(client, CLIENT_VALIDATED);
+    bulb_printf(server, "Linked %s %s \"%s\" (%s)\n", (link->outgoing ? "to" : "from"),
+        (link->relay ? "relay" : "server"), obj->info.name, client->ip_addr);
+    _link_burst(server, link);
+}
+
+// Check whether linked servers may send an object of the given type.
+bool links_accepts_object(enum bulb_obj_type type)
+{
+    switch (type)
+    {
+        case BULB_STDOUT:
+        case BULB_USERINFO:
+        case BULB_DISCONNECT:
+        case BULB_RECEIVED:
+        case BULB_LINK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Apply an event received from a linked server, and forward it to every other linked
+// server. Returns false if the event is invalid.
+bool links_receive(struct server_node* server, struct server_link* link, struct link_event* event)
+{
+    link->events_received++;
+    if (event->type < LINK_EVENT_JOIN || event->type > LINK_EVENT_BROADCAST || event->origin[0] == '\0'
+        || event->name[0] == '\0' || !str_isprint(event->name) || !str_isprint(event->text))
+        return false;
+    if ((event->type == LINK_EVENT_JOIN || event->type == LINK_EVENT_MOVE)
+        && event->room[0] != '\0' && !room_name_valid(event->room))
+        return false;
+
+    // Events that return to this server, or that have crossed too many links, go no
+    // further.
+    if (strcmp(event->origin, server->info.name) == 0 || event->hops >= LINK_MAX_HOPS)
+        return true;
+    event->hops++;
+
+    // Direct messages are only sent towards their recipient.
+    if (event->type == LINK_EVENT_DIRECT)
+    {
+        _link_route_direct(server, link, event);
+        return true;
+    }
+    if (_link_seen(server, event))
+        return true;
+
+    struct client_node* node = NULL;
+    switch (event->type)
+    {
+        case LINK_EVENT_JOIN:
+            if (server_find_by_name(server, event->name) == NULL)
+                _link_apply_join(server, link, event);
+            break;
+        case LINK_EVENT_PART:
+            if ((node = _link_find_remote(server, link, event->name)) != NULL)
+                server_disconnect_client(server, node, true, true, false);
+            break;
+        case LINK_EVENT_MOVE:
+            if ((node = _link_find_remote(server, link, event->name)) != NULL)
+                room_move(server, node, event->room);
+            break;
+        case LINK_EVENT_MESSAGE:
+            if ((node = _link_find_remote(server, link, event->name)) != NULL)
+            {
+                struct bulb_message msg_exception_obj = { .name = event->name, .message = event->text };
+                server_throw_exception(server->bulb_server, SERVER_RECEIVED_MESSAGE, (void*)&msg_exception_obj);
+                LOOP_ROOM(node->room, node, member,
+                    message_obj_write(member->mt_sock, event->name, event->text, false));
+                history_message(server, node, node->room->name, event->name, event->text, false);
+            }
+            break;
+        case LINK_EVENT_BROADCAST:
+            LOOP_CLIENTS(server, NULL, client, message_obj_write(client->mt_sock, "[SERVER]", event->text, true));
+            history_message(server, NULL, "", "[SERVER]", event->text, true);
+            break;
+        default:
+            break;
+    }
+    _link_flood(server, link, event);
+    return true;
+}
+
+// Close the link of a linked server's client node that is being disconnected, and
+// disconnect every client reached through it.
+void links_close(struct server_node* server, struct client_node* client, bool print_msg)
+{
+    struct server_link* link = client->link;
+    if (link == NULL)
+        return;
+    char desc[MAX_NAME_LENGTH + IPV4_ADDRESS_STRLEN + 8];
+    if (print_msg)
+        bulb_printf(server, "Server link with %s has closed\n", _link_describe(client, desc, sizeof(desc)));
+
+    // The departures of the clients reached through the link are reported to every other
+    // linked server, as the link they were learned through no longer exists.
+    LINKED_LIST_REMOVE(link, server->links_head, server->links_tail);
+    epoch_enter();
+    struct client_roster* roster = atomic_load(&server->roster);
+    for (unsigned i = 0; i < roster->count; i++)
+    {
+        struct client_node* node = roster->clients[i];
+        if (node->via != link || node->status != CLIENT_VALIDATED)
+            continue;
+        _link_raise(server, LINK_EVENT_PART, node->userinfo->info.name, "", "");
+        server_disconnect_client(server, node, true, true, false);
+    }
+    epoch_exit();
+
+    client->link = NULL;
+    _link_free(link);
+}
+
+// Close a link, reporting why to the linked server.
+void links_kick(struct server_node* server, struct client_node* client, const char* msg)
+{
+    char desc[MAX_NAME_LENGTH + IPV4_ADDRESS_STRLEN + 8];
+    bulb_printf(server, "Server link with %s has been closed%s%s\n", _link_describe(client, desc, sizeof(desc)),
+        (strlen(msg) > 0 ? ": " : "."), msg);
+
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "The server link has been closed%s%s\n", (strlen(msg) > 0 ? ": " : "."),
+        msg);
+    stdout_obj_write(client->mt_sock, buffer, STDOUT_KICK_MSG);
+    server_disconnect_client(server, client, false, true, true);
+}
+
+// Close every link as the server shuts down.
+void links_shutdown(struct server_node* server)
+{
+    mtx_lock(&server->io->client_update_lock);
+    while (server->links_head != NULL)
+    {
+        struct client_node* node = server->links_head->node;
+        stdout_obj_write(node->mt_sock, "The server has been shut down.\n", STDOUT_SERVER_SHUTDOWN);
+        server_disconnect_client(server, node, false, true, true);
+    }
+    mtx_unlock(&server->io->client_update_lock);
+}
+
+// Find a directly linked server by name. Returns NULL if not found.
+struct server_link* links_find(struct server_node* server, const char* name)
+{
+    for (struct server_link* link = server->links_head; link != NULL; link = link->next)
+    {
+        if (link->established && strcmp(link->node->userinfo->info.name, name) == 0)
+            return link;
+    }
+    return NULL;
+}
+
+// Count the directly linked servers.
+unsigned links_count(struct server_node* server)
+{
+    unsigned count = 0;
+    for (struct server_link* link = server->links_head; link != NULL; link = link->next)
+        count += link->established;
+    return count;
+}
+
+// Report a newly validated client to every linked server.
+void links_client_joined(struct server_node* server, struct client_node* client)
+{
+    _link_raise(server, LINK_EVENT_JOIN, client->userinfo->info.name, client->room->name,
+        client->userinfo->info.description);
+}
+
+// Report a disconnecting client to every linked server.
+void links_client_left(struct server_node* server, struct client_node* client)
+{
+    _link_raise(server, LINK_EVENT_PART, client->userinfo->info.name, "", "");
+}
+
+// Report a client that moved into another room to every linked server.
+void links_client_moved(struct server_node* server, struct client_node* client)
+{
+    _link_raise(server, LINK_EVENT_MOVE, client->userinfo->info.name, client->room->name, "");
+}
+
+// Relay a client's message to the members of its room on every linked server.
+void links_message(struct server_node* server, struct client_node* client, const char* msg)
+{
+    _link_raise(server, LINK_EVENT_MESSAGE, client->userinfo->info.name, "", msg);
+}
+
+// Relay a message broadcast by this server to the clients of every linked server.
+void links_broadcast(struct server_node* server, const char* msg)
+{
+    _link_raise(server, LINK_EVENT_BROADCAST, server->info.name, "", msg);
+}
+
+// Route a client's direct message towards a recipient connected to another server.
+void links_direct(struct server_node* server, struct client_node* client, struct client_node* recipient,
+                  const char* msg)
+{
+    uint64_t buffer[LINK_EVENT_BUFFER_SIZE / sizeof(uint64_t) + 1];
+    _link_send(server, recipient->via, _link_event_new(server, buffer, LINK_EVENT_DIRECT,
+        client->userinfo->info.name, "", recipient->userinfo->info.name, msg));
+}
+
+// Send every batch of events that is waiting to be sent. This should only be called
+// from the server's client management thread.
+void links_flush(struct server_node* server)
+{
+    for (struct server_link* link = server->links_head; link != NULL; link = link->next)
+        _link_flush(link);
+    server->link_flush_pending = false;
+}
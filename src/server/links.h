@@ -0,0 +1,126 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Server links join several servers into one network, so that the clients of each
+// server see the clients of every other server as though they were all connected to
+// the same server. A server links to another by connecting to it as a special kind of
+// peer, which authenticates with its server userinfo and the link key shared by the
+// network. See userinfo_obj.c.
+//
+// Linked servers exchange batches of network events, see link_obj.h: clients joining,
+// leaving and moving between rooms, and the messages they send. Clients of other
+// servers are represented by client nodes without a socket, which are registered and
+// enter rooms like any other client node, and are reached through the link that they
+// were learned from.
+//
+// Each event is raised once by its origin server, then flooded across every link other
+// than the one it arrived on. Events that have already been seen, events returning to
+// their origin and events that have crossed too many links are discarded, so that
+// events never loop between servers. Links are nonetheless expected to form a tree, as
+// clients are only ever reached through the first link they were learned from. Direct
+// messages are not flooded, but routed link by link towards their recipient.
+//
+// Relays are servers that link to a single core server as leaves of its network, see
+// server_link(). A relay holds the whole network's roster like any other linked server,
+// so status requests are answered from its own roster, and client messages sent to
+// the relay are batched towards the core like any other events.
+//
+// Links are only accessed while the server node's client update lock is held.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "server_node.h"
+#include "client_node.h"
+#include "userinfo_obj.h"
+#include "link_obj.h"
+
+// Most links that an event can cross before being discarded.
+#define LINK_MAX_HOPS   16
+
+struct server_link
+{
+    struct client_node* node;
+    bool outgoing;          // Whether this server opened the link.
+    bool established;
+    bool relay;             // Whether the linked server is an edge relay.
+
+    // Events waiting to be sent to the linked server.
+    char* batch;
+    size_t batch_len;
+
+    // Events sent to and received from the linked server.
+    uint64_t events_sent;
+    uint64_t events_received;
+
+    struct server_link* prev;
+    struct server_link* next;
+    bool linked;
+};
+
+// Prepare a server node for linking to other servers.
+void links_init(struct server_node* server);
+
+// Free every link of a server node. This does not free the linked servers' client nodes.
+void links_free(struct server_node* server);
+
+// Check whether a server node can be linked to other servers, which requires it to be
+// named and to have a link key.
+bool links_enabled(struct server_node* server);
+
+// Start linking to another server through a newly connected client node, by sending it
+// this server's userinfo.
+void links_open(struct server_node* server, struct client_node* client);
+
+// Authenticate a userinfo object sent by a linked server, which is either a server
+// linking to this server, or the reply of a server that this server is linking to.
+// The object is freed if the link is refused.
+void links_authenticate(struct server_node* server, struct client_node* client, struct userinfo_obj* obj);
+
+// Check whether linked servers may send an object of the given type.
+bool links_accepts_object(enum bulb_obj_type type);
+
+// Apply an event received from a linked server, and forward it to every other linked
+// server. Returns false if the event is invalid.
+bool links_receive(struct server_node* server, struct server_link* link, struct link_event* event);
+
+// Close the link of a linked server's client node that is being disconnected, and
+// disconnect every client reached through it.
+void links_close(struct server_node* server, struct client_node* client, bool print_msg);
+
+// Close a link, reporting why to the linked server.
+void links_kick(struct server_node* server, struct client_node* client, const char* msg);
+
+// Close every link as the server shuts down.
+void links_shutdown(struct server_node* server);
+
+// Find a directly linked server by name. Returns NULL if not found.
+struct server_link* links_find(struct server_node* server, const char* name);
+
+// Count the directly linked servers.
+unsigned links_count(struct server_node* server);
+
+// Report a newly validated client to every linked server.
+void links_client_joined(struct server_node* server, struct client_node* client);
+
+// Report a disconnecting client to every linked server.
+void links_client_left(struct server_node* server, struct client_node* client);
+
+// Report a client that moved into another room to every linked server.
+void links_client_moved(struct server_node* server, struct client_node* client);
+
+// Relay a client's message to the members of its room on every linked server.
+void links_message(struct server_node* server, struct client_node* client, const char* msg);
+
+// Relay a message broadcast by this server to the clients of every linked server.
+void links_broadcast(struct server_node* server, const char* msg);
+
+// Route a client's direct message towards a recipient connected to another server.
+void links_direct(struct server_node* server, struct client_node* client, struct client_node* recipient,
+                  const char* msg);
+
+// Send every batch of events that is waiting to be sent. This should only be called
+// from the server's client management thread.
+void links_flush(struct server_node* server);
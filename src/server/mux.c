@@ -0,0 +1,287 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "util.h"
+#include "epoch.h"
+#include "bulb_structs.h"
+#include "shared_interface.h"
+#include "obj_reader.h"
+#include "flood_control.h"
+#include "stdout_obj.h"
+#include "mux.h"
+
+// Refuse an object sent by a client node that may not send it, disconnecting the
+// client node.
+static void _mux_refuse(struct server_node* server, struct client_node* client, const char* error)
+{
+    // Authenticated clients are kicked like any other.
+    if (client->userinfo != NULL)
+    {
+        server_kick(server, client, error);
+        return;
+    }
+
+    bulb_printf(server, "Proxy from address %s refused: %s\n", client->ip_addr, error);
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%s\n", error);
+    stdout_obj_write(client->mt_sock, buffer, STDOUT_KICK_MSG);
+    server_disconnect_client(server, client, false, true, true);
+}
+
+// Kick a session, whether or not it has authenticated yet.
+static void _mux_kick_session(struct server_node* server, struct client_node* session, const char* msg)
+{
+    if (session->userinfo != NULL)
+    {
+        server_kick(server, session, msg);
+        return;
+    }
+
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "You have been kicked from the server: %s\n", msg);
+    stdout_obj_write(session->mt_sock, buffer, STDOUT_KICK_MSG);
+    server_disconnect_client(server, session, true, true, true);
+}
+
+// Find a session of a carrier by its ID. Returns NULL if not found.
+static inline struct client_node* _mux_find(struct mux_carrier* carrier, uint32_t id)
+{
+    return (id < carrier->capacity) ? carrier->sessions[id] : NULL;
+}
+
+// Grow the sessions table of a carrier to hold a session with the given ID.
+static void _mux_reserve(struct mux_carrier* carrier, uint32_t id)
+{
+    if (id < carrier->capacity)
+        return;
+    unsigned capacity = MAX(carrier->capacity, 64);
+    while (capacity <= id)
+        capacity *= 2;
+
+    struct client_node** sessions = quick_calloc(capacity, sizeof(struct client_node*), BULB_ALLOC_NETWORKING);
+    if (carrier->sessions != NULL)
+    {
+        memcpy(sessions, carrier->sessions, sizeof(struct client_node*) * carrier->capacity);
+        quick_free(carrier->sessions);
+    }
+    carrier->sessions = sessions;
+    carrier->capacity = capacity;
+}
+
+// Authenticate a proxy by its mux key, turning its client node into a carrier.
+static void _mux_hello(struct server_node* server, struct client_node* client, struct mux_obj* obj)
+{
+    char key[MAX_MUX_KEY_LENGTH + 1] = { 0 };
+    size_t len = obj->base.size - sizeof(struct mux_obj);
+    memcpy(key, obj->payload, MIN(len, MAX_MUX_KEY_LENGTH));
+
+    const char* error = NULL;
+    if (client->mux != NULL)
+        error = "The proxy has already authenticated.";
+    else if (client->userinfo != NULL)
+        error = "Only proxies may carry sessions.";
+    else if (server->info.mux_key[0] == '\0')
+        error = "This server does not accept proxies.";
+    else if (len > MAX_MUX_KEY_LENGTH || !str_matches_secret(server->info.mux_key, key))
+        error = "Incorrect mux key.";
+    if (error != NULL)
+    {
+        _mux_refuse(server, client, error);
+        return;
+    }
+
+    struct mux_carrier* carrier = quick_malloc(sizeof(struct mux_carrier), BULB_ALLOC_NETWORKING);
+    carrier->node = client;
+    client->mux = carrier;
+    LINKED_LIST_ADD(carrier, server->mux_head, server->mux_tail);
+    bulb_printf(server, "Proxy at %s has connected\n", client->ip_addr);
+    mux_obj_write(client->mt_sock, 0, MUX_HELLO, "", 0);
+}
+
+// Open a session for a client connected to a proxy.
+static void _mux_open(struct server_node* server, struct client_node* client, struct mux_obj* obj)
+{
+    struct mux_carrier* carrier = client->mux;
+    char ip_addr[IPV4_ADDRESS_STRLEN] = { 0 };
+    size_t len = obj->base.size - sizeof(struct mux_obj);
+    memcpy(ip_addr, obj->payload, MIN(len, sizeof(ip_addr) - 1));
+
+    struct client_node* node = quick_malloc(sizeof(struct client_node), BULB_ALLOC_ROSTER);
+    node->addr.sin_family = AF_INET;
+    if (obj->session >= MUX_MAX_SESSIONS || _mux_find(carrier, obj->session) != NULL
+        || len >= sizeof(ip_addr) || inet_pton(AF_INET, ip_addr, &node->addr.sin_addr) != 1)
+    {
+        quick_free(node);
+        mux_kick(server, client, "Opened an invalid session.");
+        return;
+    }
+    node->server_node = server;
+    client_shared_node_init(node);
+    memcpy(node->ip_addr, ip_addr, sizeof(node->ip_addr));
+    flood_control_init(server, node);
+
+    // The session's socket has no connection, and is instead sent through its carrier.
+    node->mt_sock = mt_socket_new(INVALID_SOCKET);
+    node->mt_sock->carrier = client->mt_sock;
+    node->mt_sock->session = obj->session;
+    node->mt_sock->dealloc_func = client_set_ready_to_delete_from_sock;
+
+    _mux_reserve(carrier, obj->session);
+    carrier->sessions[obj->session] = node;
+    carrier->count++;
+    server_listen_session(server, node);
+}
+
+// Read and process an object carried for a session.
+static void _mux_data(struct server_node* server, struct client_node* client, struct mux_obj* obj)
+{
+    // The proxy may still be sending objects for a session that the server has closed,
+    // until it receives MUX_CLOSE.
+    struct client_node* session = _mux_find(client->mux, obj->session);
+    if (session == NULL)
+        return;
+
+    char error_msg[MAX_ERROR_LENGTH + 1];
+    struct bulb_obj* inner = bulb_obj_read_buffer(session->mt_sock, obj->payload,
+        obj->base.size - sizeof(struct mux_obj), error_msg, sizeof(error_msg));
+    if (inner == NULL)
+    {
+        _mux_kick_session(server, session, (error_msg[0] != '\0') ? error_msg : "Sent a malformed object.");
+        return;
+    }
+    server_client_process(server, session, inner);
+}
+
+// Free every carrier of a server node. This does not free the carriers' client nodes.
+void mux_free(struct server_node* server)
+{
+    while (server->mux_head != NULL)
+    {
+        struct mux_carrier* carrier = server->mux_head;
+        LINKED_LIST_REMOVE(carrier, server->mux_head, server->mux_tail);
+        quick_free(carrier->sessions);
+        quick_free(carrier);
+    }
+}
+
+// Process a mux_obj object sent by a proxy.
+void mux_receive(struct server_node* server, struct client_node* client, struct mux_obj* obj)
+{
+    if (obj->op == MUX_HELLO)
+    {
+        _mux_hello(server, client, obj);
+        return;
+    }
+    if (client->mux == NULL)
+    {
+        _mux_refuse(server, client, "Only authenticated proxies may carry sessions.");
+        return;
+    }
+
+    switch (obj->op)
+    {
+        case MUX_OPEN:
+            _mux_open(server, client, obj);
+            break;
+        case MUX_DATA:
+            _mux_data(server, client, obj);
+            break;
+        case MUX_CLOSE:
+        {
+            // Sessions that the server has already closed are ignored, as MUX_CLOSE was
+            // already sent for them.
+            struct client_node* session = _mux_find(client->mux, obj->session);
+            if (session != NULL)
+                server_disconnect_client(server, session, true, true, false);
+            break;
+        }
+        default:
+            mux_kick(server, client, "Sent an invalid proxy operation.");
+            break;
+    }
+}
+
+// Close a session that is being disconnected, telling its proxy that the session has
+// ended. The session's socket is de-allocated immediately, as it has nothing left to
+// send of its own.
+void mux_session_closed(struct server_node* server, struct client_node* client)
+{
+    struct mt_socket* sock = client->mt_sock;
+    struct mux_carrier* carrier = ((struct client_node*)sock->carrier->parent_client)->mux;
+    if (carrier != NULL && _mux_find(carrier, sock->session) == client)
+    {
+        carrier->sessions[sock->session] = NULL;
+        carrier->count--;
+        mux_obj_write(sock->carrier, sock->session, MUX_CLOSE, "", 0);
+    }
+    mt_socket_free(sock);
+}
+
+// Close the carrier of a client node that is being disconnected, and disconnect every
+// session that it carries.
+void mux_close(struct server_node* server, struct client_node* client, bool print_msg)
+{
+    struct mux_carrier* carrier = client->mux;
+    if (carrier == NULL)
+        return;
+    if (print_msg)
+        bulb_printf(server, "Proxy at %s has disconnected\n", client->ip_addr);
+
+    for (unsigned i = 0; i < carrier->capacity && carrier->count > 0; i++)
+    {
+        if (carrier->sessions[i] != NULL)
+            server_disconnect_client(server, carrier->sessions[i], true, true, false);
+    }
+
+    LINKED_LIST_REMOVE(carrier, server->mux_head, server->mux_tail);
+    client->mux = NULL;
+    quick_free(carrier->sessions);
+    quick_free(carrier);
+}
+
+// Close a carrier, reporting why to its proxy.
+void mux_kick(struct server_node* server, struct client_node* client, const char* msg)
+{
+    bulb_printf(server, "Proxy at %s has been disconnected%s%s\n", client->ip_addr,
+        (strlen(msg) > 0 ? ": " : "."), msg);
+
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "The proxy has been disconnected%s%s\n", (strlen(msg) > 0 ? ": " : "."),
+        msg);
+    stdout_obj_write(client->mt_sock, buffer, STDOUT_KICK_MSG);
+    server_disconnect_client(server, client, false, true, true);
+}
+
+// Close every carrier as the server shuts down.
+void mux_shutdown(struct server_node* server)
+{
+    mtx_lock(&server->io->client_update_lock);
+    while (server->mux_head != NULL)
+    {
+        struct client_node* node = server->mux_head->node;
+        stdout_obj_write(node->mt_sock, "The server has been shut down.\n", STDOUT_SERVER_SHUTDOWN);
+        server_disconnect_client(server, node, false, true, true);
+    }
+    mtx_unlock(&server->io->client_update_lock);
+}
+
+// Count the carriers, and the sessions that they carry.
+unsigned mux_count(struct server_node* server, unsigned* sessions)
+{
+    unsigned count = 0;
+    *sessions = 0;
+    for (struct mux_carrier* carrier = server->mux_head; carrier != NULL; carrier = carrier->next)
+    {
+        count++;
+        *sessions += carrier->count;
+    }
+    return count;
+}
@@ -0,0 +1,64 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Proxies such as bulb_mux accept client connections on behalf of a server, and carry
+// many of them as sessions over a few connections to the server, see mux_obj.h. Each
+// such connection is known as a carrier, and is held by a client node that never
+// authenticates as a client itself. A proxy authenticates each carrier with the mux key
+// of the server, after which it opens a session for every client that connects to it.
+//
+// Each session is represented by a client node of its own, whose socket has no
+// connection and instead sends every object through its carrier. Sessions are
+// otherwise handled like any other client: they authenticate with their own userinfo,
+// are acknowledged, pinged and timed out, and may be kicked or banned by their address
+// as reported by the proxy. Backpressure is only applied to each carrier as a whole.
+//
+// Carriers and their sessions are only accessed while the server node's client update
+// lock is held.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "server_node.h"
+#include "client_node.h"
+#include "mux_obj.h"
+
+struct mux_carrier
+{
+    struct client_node* node;
+
+    // Sessions carried by this carrier, indexed by their ID.
+    struct client_node** sessions;
+    unsigned capacity;
+    unsigned count;
+
+    struct mux_carrier* prev;
+    struct mux_carrier* next;
+    bool linked;
+};
+
+// Free every carrier of a server node. This does not free the carriers' client nodes.
+void mux_free(struct server_node* server);
+
+// Process a mux_obj object sent by a proxy.
+void mux_receive(struct server_node* server, struct client_node* client, struct mux_obj* obj);
+
+// Close a session that is being disconnected, telling its proxy that the session has
+// ended. The session's socket is de-allocated immediately, as it has nothing left to
+// send of its own.
+void mux_session_closed(struct server_node* server, struct client_node* client);
+
+// Close the carrier of a client node that is being disconnected, and disconnect every
+// session that it carries.
+void mux_close(struct server_node* server, struct client_node* client, bool print_msg);
+
+// Close a carrier, reporting why to its proxy.
+void mux_kick(struct server_node* server, struct client_node* client, const char* msg);
+
+// Close every carrier as the server shuts down.
+void mux_shutdown(struct server_node* server);
+
+// Count the carriers, and the sessions that they carry.
+unsigned mux_count(struct server_node* server, unsigned* sessions);
@@ -18,55 +18,496 @@
 #include "client_node.h"
 #include "cmds.h"
 #include "obj_process.h"
+#include "alloc.h"
 #include "message_obj.h"
 #include "stdout_obj.h"
+#include "ip_limiter.h"
+#include "flood_control.h"
+#include "token_bucket.h"
+#include "links.h"
+#include "mux.h"
+#include "host.h"
+#include "handoff.h"
+#include "history.h"
+#include "snapshot.h"
+
+#ifdef WIN32
+#   define poll WSAPoll
+#else
+#   include <poll.h>
+#endif
+
+#define SERVER_ADMISSION_POLL_MS    100
+
+// Most parked connections admitted every SERVER_ADMISSION_POLL_MS milliseconds. The
+// processing lag is only measured again once the client management thread catches up
+// with the connections already admitted.
+#define SERVER_ADMISSION_BATCH      8
 
 #ifdef WIN32
     static WSADATA wsa_data;
 #endif
 
-// Manage the connection of new clients.
+// Close a newly accepted connection that has no mt_socket object, attempting to send
+// it a final message without waiting on the socket.
+static void _server_close_with_message(SOCKET sock, const char* msg, enum stdout_type type)
+{
+    set_socket_non_blocking(sock);
+    stdout_obj_send_raw(sock, msg, type);
+
+    // Closing a socket with unread data resets the connection, which may discard the
+    // message, so anything the peer has already sent is drained first.
+    char discard[256];
+    shutdown(sock, SHUT_WR);
+    for (int i = 0; i < 16 && recv(sock, discard, sizeof(discard), 0) > 0; i++);
+    closesocket(sock);
+}
+
+// Close a newly accepted connection if its address is banned. Returns true if the
+// connection was rejected.
+static bool _server_reject_banned(struct bulb_server* server, SOCKET sock, const char* ip_addr)
+{
+    struct bulb_ban ban_obj = { .ip_addr = ip_addr, .reason = "" };
+    server_throw_exception(server, SERVER_IS_CLIENT_BANNED, (void*)&ban_obj);
+    if (!ban_obj.is_banned)
+        return false;
+
+    char buffer[MAX_BANLIST_REASON_LENGTH + 64];
+    snprintf(buffer, sizeof(buffer), "You have been banned from the server%s%s\n",
+        (strlen(ban_obj.reason) > 0 ? ": " : "."), ban_obj.reason);
+    _server_close_with_message(sock, buffer, STDOUT_BAN_MSG);
+
+    atomic_fetch_add(&server->server_node->rejected_connections, 1);
+    return true;
+}
+
+// Get how long the longest waiting ready socket has waited for the client management
+// thread, in milliseconds.
+static uint64_t _server_processing_lag_ms(struct server_node* server)
+{
+    int64_t oldest_ms = atomic_load(&server->oldest_ready_ms);
+    if (oldest_ms == 0)
+        return 0;
+    return (uint64_t)MAX(token_bucket_now() - oldest_ms, 0);
+}
+
+// Check if the client management thread is too far behind to take on new clients,
+// according to the overload thresholds of the server's userinfo.
+static bool _server_overloaded(struct server_node* server)
+{
+    if (server->info.overload_ready_sockets > 0 
+        && atomic_load(&server->ready_sockets) >= server->info.overload_ready_sockets)
+        return true;
+    return server->info.overload_lag_ms > 0 && _server_processing_lag_ms(server) >= server->info.overload_lag_ms;
+}
+
+// Refuse a new connection while the server is overloaded, so that the peer fails fast
+// rather than adding to the backlog of clients already connected.
+static void _server_refuse_busy(struct bulb_server* server, SOCKET sock, const struct sockaddr_in* addr)
+{
+    _server_close_with_message(sock, "The server is busy, please try again later.\n", STDOUT_SERVER_BUSY);
+    ip_limiter_release(server->server_node->ip_limiter, ntohl(addr->sin_addr.s_addr));
+    atomic_fetch_add(&server->server_node->busy_connections, 1);
+}
+
+// Release a client's slot in the IP limiter once its socket has been closed.
+static void _server_client_socket_released(struct mt_socket* sock)
+{
+    struct client_node* client = (struct client_node*)sock->parent_client;
+    ip_limiter_release(client->server_node->ip_limiter, ntohl(client->addr.sin_addr.s_addr));
+    client_set_ready_to_delete_from_sock(sock);
+}
+
+// Close the listen socket of a server, if it is still open. The listen socket of a
+// virtual server is closed while its host's listen thread is not polling it.
+static void _server_close_listen_socket(struct bulb_server* server)
+{
+    if (server->host != NULL)
+        mtx_lock(&server->host->lock);
+    if (server->server_node->listen_sock != INVALID_SOCKET)
+    {
+        SOCKET sock = server->server_node->listen_sock;
+        server->server_node->listen_sock = INVALID_SOCKET;
+        shutdown(sock, SHUT_RDWR);
+        closesocket(sock);
+    }
+    if (server->host != NULL)
+        mtx_unlock(&server->host->lock);
+}
+
+// Create the client node of an admitted connection, which is not listened to until
+// server_listen_client() is called.
+struct client_node* server_new_client(struct bulb_server* server, SOCKET sock, const struct sockaddr_in* addr)
+{
+    struct client_node* node = quick_malloc(sizeof(struct client_node), BULB_ALLOC_ROSTER);
+    node->server_node = server->server_node;
+    client_shared_node_init(node);
+    node->addr = *addr;
+    inet_ntop(AF_INET, &addr->sin_addr, node->ip_addr, sizeof(node->ip_addr));
+    flood_control_init(server->server_node, node);
+    
+    // Initialize the multithreaded socket object for this client.
+    node->mt_sock = mt_socket_new(sock);
+    node->mt_sock->dealloc_func = _server_client_socket_released;
+    return node;
+}
+
+// Hand a new connection over to the client management thread.
+static void _server_accept_client(struct bulb_server* server, SOCKET sock, const struct sockaddr_in* addr)
+{
+    atomic_fetch_add(&server->server_node->accepted_connections, 1);
+    server_listen_client(server->server_node, server_new_client(server, sock, addr));
+}
+
+// Hand parked connections over to the client management thread, in the order they 
+// arrived, up to SERVER_ADMISSION_BATCH at a time while the server is not overloaded.
+// Connections that have waited too long are refused instead.
+static void _server_admit_parked(struct bulb_server* server)
+{
+    struct server_node* server_node = server->server_node;
+    struct parked_connection* parked = server_node->parked;
+    int64_t timeout_ms = (int64_t)server_node->info.admission_timeout_s * MILLISECONDS;
+    int64_t now_ms = token_bucket_now();
+    unsigned admitted = 0;
+    if (now_ms < server_node->next_admission_ms)
+        admitted = SERVER_ADMISSION_BATCH;
+    unsigned kept = 0;
+    for (unsigned i = 0; i < server_node->parked_count; i++)
+    {
+        if (kept == 0 && admitted < SERVER_ADMISSION_BATCH && !_server_overloaded(server_node))
+        {
+            _server_accept_client(server, parked[i].sock, &parked[i].addr);
+            if (admitted++ == 0)
+                server_node->next_admission_ms = now_ms + SERVER_ADMISSION_POLL_MS;
+        }
+        else if (now_ms - parked[i].parked_ms >= timeout_ms)
+            _server_refuse_busy(server, parked[i].sock, &parked[i].addr);
+        else
+            parked[kept++] = parked[i];
+    }
+    server_node->parked_count = kept;
+    atomic_store(&server_node->parked_connections, kept);
+}
+
+// Wait for a new connection on the listen socket for up to timeout_ms milliseconds.
+// Returns false if none arrived, or true if accept() should be called, including when
+// the listen socket has failed or been closed.
+static bool _server_wait_for_connection(struct bulb_server* server, unsigned timeout_ms)
+{
+    SOCKET listen_sock = server->server_node->listen_sock;
+    if (listen_sock == INVALID_SOCKET)
+        return true;
+
+    // poll() is used as the listen socket may exceed FD_SETSIZE once many clients are
+    // connected, which select() cannot wait on.
+    struct pollfd pfd = { .fd = listen_sock, .events = POLLIN };
+    return poll(&pfd, 1, (int)timeout_ms) != 0;
+}
+
+// Prepare a server's admission queue. While the client management thread lags behind,
+// new connections are parked in this bounded queue instead of adding to its backlog,
+// and are reconsidered every SERVER_ADMISSION_POLL_MS milliseconds.
+static void _server_admission_init(struct bulb_server* server)
+{
+    struct server_node* server_node = server->server_node;
+    server_node->parked_capacity = server_node->info.admission_queue_size;
+    server_node->parked_count = 0;
+    if (server_node->parked_capacity > 0)
+    {
+        server_node->parked = quick_malloc(sizeof(struct parked_connection) * server_node->parked_capacity, 
+            BULB_ALLOC_NETWORKING);
+    }
+}
+
+// Close every connection still parked in a server's admission queue, as they will
+// never be admitted, and free the admission queue.
+static void _server_admission_free(struct bulb_server* server)
+{
+    struct server_node* server_node = server->server_node;
+    for (unsigned i = 0; i < server_node->parked_count; i++)
+    {
+        _server_close_with_message(server_node->parked[i].sock, "The server has been shut down.\n", 
+            STDOUT_SERVER_SHUTDOWN);
+        ip_limiter_release(server_node->ip_limiter, ntohl(server_node->parked[i].addr.sin_addr.s_addr));
+    }
+    server_node->parked_count = 0;
+    atomic_store(&server_node->parked_connections, 0);
+    quick_free(server_node->parked);
+    server_node->parked = NULL;
+}
+
+// Admit a newly accepted connection, unless its address is limited or banned, or it
+// must be parked or refused while the server is overloaded.
+void server_handle_connection(struct bulb_server* server, SOCKET sock, const struct sockaddr_in* addr)
+{
+    struct server_node* server_node = server->server_node;
+
+    // Addresses opening connections too quickly, or holding too many of them, are
+    // simply closed, so that each refused connection costs one accept and one close.
+    uint32_t host_addr = ntohl(addr->sin_addr.s_addr);
+    if (ip_limiter_admit(server_node->ip_limiter, host_addr, &server_node->info) != IP_LIMIT_ADMITTED)
+    {
+        closesocket(sock);
+        atomic_fetch_add(&server_node->limited_connections, 1);
+        return;
+    }
+
+    // Get the connecting IP address.
+    char ip_addr[IPV4_ADDRESS_STRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, ip_addr, sizeof(ip_addr));
+
+    // Banned addresses are turned away before any client state is allocated, so
+    // that banned peers reconnecting in a loop cost as little as possible.
+    if (_server_reject_banned(server, sock, ip_addr))
+    {
+        ip_limiter_release(server_node->ip_limiter, host_addr);
+        return;
+    }
+
+    // New connections queue up behind any that are already parked.
+    if (server_node->parked_count > 0 || _server_overloaded(server_node))
+    {
+        if (server_node->parked_count >= server_node->parked_capacity)
+        {
+            _server_refuse_busy(server, sock, addr);
+            return;
+        }
+        server_node->parked[server_node->parked_count++] = (struct parked_connection){ sock, *addr, 
+            token_bucket_now() };
+        atomic_store(&server_node->parked_connections, server_node->parked_count);
+        return;
+    }
+    _server_accept_client(server, sock, addr);
+}
+
+// Manage the connection of new clients. Virtual servers instead share the listen
+// thread of their host, see host.c.
 static int _server_listen_thread(void* s)
 {
     struct bulb_server* server = (struct bulb_server*)s;
-
     for (;;)
     {
-        int length = sizeof(struct sockaddr_in);
-        struct client_node* node = quick_malloc(sizeof(struct client_node));
-        node->server_node = server->server_node;
-        client_shared_node_init(node);
-        
-        SOCKET sock = accept(server->server_node->listen_sock, (struct sockaddr*)&node->addr, &length);
+        // The listen socket is waited on for a bounded time, so that the thread stops
+        // promptly once the server is being handed off. Parked connections are then
+        // handed over along with the listen socket.
+        if (server->handing_off)
+            return 0;
+        if (server->server_node->parked_count > 0)
+            _server_admit_parked(server);
+        snapshot_poll(server);
+        if (!_server_wait_for_connection(server, SERVER_ADMISSION_POLL_MS))
+            continue;
+
+        struct sockaddr_in addr;
+        socklen_t length = sizeof(struct sockaddr_in);
+        SOCKET sock = accept(server->server_node->listen_sock, (struct sockaddr*)&addr, &length);
         if (sock == INVALID_SOCKET)
         {
-            free(node);
             if (server->disconnecting 
                 || server->server_node->listen_sock == INVALID_SOCKET
                 || !server_throw_exception(server, SERVER_CLIENT_ACCEPT_FAIL, NULL))
-                return 0;
+                break;
             continue;
         }
-
-        // Get the connecting IP address.
-        inet_ntop(AF_INET, &node->addr.sin_addr, node->ip_addr, sizeof(node->ip_addr));
-        
-        // Initialize the multithreaded socket object for this client.
-        node->mt_sock = mt_socket_new(sock);
-        node->mt_sock->dealloc_func = client_set_ready_to_delete_from_sock;
-        server_listen_client(server->server_node, node);
-        
-        // Periodically deallocate clients marked for deletion.
-        server_free_flagged_clients(server->server_node);
+        server_handle_connection(server, sock, &addr);
     }
 
+    _server_admission_free(server);
     return 0;
 }
 
-// Create a new server instance. error_state can be NULL. Returns NULL on error.
-struct bulb_server* server_init(uint16_t port, enum server_error_state* error_state)
+// Accept every connection waiting on a virtual server's listen socket, and reconsider
+// the connections parked in its admission queue. This is called by the listen thread
+// of the virtual server's host whenever its listen socket is readable, and at least
+// every SERVER_ADMISSION_POLL_MS milliseconds otherwise.
+void server_host_poll(struct bulb_server* server, bool readable)
 {
-    struct bulb_server* server = quick_malloc(sizeof(struct bulb_server));
+    if (server->server_node->parked_count > 0)
+        _server_admit_parked(server);
+    snapshot_poll(server);
+    while (readable && server->server_node->listen_sock != INVALID_SOCKET)
+    {
+        // Hosted listen sockets are non-blocking, so accept() fails once every waiting
+        // connection has been accepted.
+        struct sockaddr_in addr;
+        socklen_t length = sizeof(struct sockaddr_in);
+        SOCKET sock = accept(server->server_node->listen_sock, (struct sockaddr*)&addr, &length);
+        if (sock == INVALID_SOCKET)
+        {
+            if (socket_errno() != SOCKET_AGAIN && !server->disconnecting)
+                server_throw_exception(server, SERVER_CLIENT_ACCEPT_FAIL, NULL);
+            break;
+        }
+        server_handle_connection(server, sock, &addr);
+    }
+}
+
+// Install a custom allocator for the server library. This must be called before
+// any server instance is created. Passing NULL restores the system allocator.
+// Returns false if the server library has already allocated memory.
+bool server_set_allocator(const struct bulb_allocator* allocator)
+{
+    return alloc_set_allocator(allocator);
+}
+
+// Get the allocation statistics of one of the server library's subsystems. Returns
+// false if the tag is invalid.
+bool server_get_alloc_stats(enum bulb_alloc_tag tag, struct bulb_alloc_stats* stats)
+{
+    ASSERT(stats, return false);
+    return alloc_get_stats(tag, stats);
+}
+
+// Get the connection statistics of a server instance. Returns false on failure.
+bool server_get_stats(struct bulb_server* server, struct bulb_server_stats* stats)
+{
+    ASSERT(server != NULL && stats != NULL, return false);
+    ASSERT(server->server_node, return false);
+    stats->accepted_connections = atomic_load(&server->server_node->accepted_connections);
+    stats->rejected_connections = atomic_load(&server->server_node->rejected_connections);
+    stats->limited_connections = atomic_load(&server->server_node->limited_connections);
+    stats->dropped_objects = atomic_load(&server->server_node->dropped_objects);
+    stats->conflated_objects = atomic_load(&server->server_node->conflated_objects);
+    stats->congestion_disconnects = atomic_load(&server->server_node->congestion_disconnects);
+    stats->processing_lag_ms = _server_processing_lag_ms(server->server_node);
+    stats->ready_sockets = atomic_load(&server->server_node->ready_sockets);
+    stats->parked_connections = atomic_load(&server->server_node->parked_connections);
+    stats->busy_connections = atomic_load(&server->server_node->busy_connections);
+
+    stats->queued_bytes = stats->queued_objects = 0;
+    stats->max_client_queued_bytes = stats->congested_clients = stats->spilled_bytes = 0;
+    stats->over_budget = server->server_node->info.send_queue_budget_mb > 0 && mt_socket_total_send_queue_bytes() 
+        > (size_t)server->server_node->info.send_queue_budget_mb * 1024 * 1024;
+
+    // Sockets are only released from their client while the client update lock is held,
+    // so it is held throughout the walk.
+    mtx_lock(&server->server_node->io->client_update_lock);
+    LOOP_CLIENTS(server->server_node, NULL, node,
+    {
+        if (node->mt_sock == NULL)
+            continue;
+        mtx_lock(&node->mt_sock->write_lock);
+        stats->queued_bytes += node->mt_sock->send_queue_bytes;
+        stats->queued_objects += node->mt_sock->send_queue_objects;
+        stats->max_client_queued_bytes = MAX(stats->max_client_queued_bytes, node->mt_sock->send_queue_bytes);
+        stats->congested_clients += node->mt_sock->send_congested;
+        stats->spilled_bytes += node->mt_sock->spill_bytes;
+        mtx_unlock(&node->mt_sock->write_lock);
+    });
+    stats->linked_servers = links_count(server->server_node);
+    unsigned sessions;
+    stats->mux_proxies = mux_count(server->server_node, &sessions);
+    stats->mux_sessions = sessions;
+    mtx_unlock(&server->server_node->io->client_update_lock);
+    stats->remote_clients = 0;
+    epoch_enter();
+    struct client_roster* roster = atomic_load(&server->server_node->roster);
+    for (unsigned i = 0; i < roster->count; i++)
+        stats->remote_clients += CLIENT_IS_REMOTE(roster->clients[i]);
+    epoch_exit();
+    return true;
+}
+
+// Link the server to another server, so that the clients of both see each other as
+// though they were connected to one server. Both servers must share the same link key,
+// and be named uniquely within their network. Returns false if the other server could
+// not be reached. Whether the link was accepted is reported to the server console.
+//
+// Servers whose userinfo has the relay attribute set instead act as edge relays for a
+// core server: they link to that server alone, refuse links from other servers, and
+// fan the core network's traffic out to their own clients. Each message broadcast by
+// the core is then sent once per relay rather than once per client.
+bool server_link(struct bulb_server* server, const char* host, uint16_t port)
+{
+    ASSERT(server != NULL && host != NULL, return false);
+    ASSERT(server->server_node, return false);
+    if (!links_enabled(server->server_node))
+        return false;
+
+    // Relays only ever link to their core server.
+    mtx_lock(&server->server_node->io->client_update_lock);
+    bool linked = server->server_node->links_head != NULL;
+    mtx_unlock(&server->server_node->io->client_update_lock);
+    if (server->server_node->info.relay && linked)
+        return false;
+
+    // Resolve the hostname to connect to.
+    char port_buffer[6] = { 0 }; // 0-65535 + \0
+    snprintf(port_buffer, sizeof(port_buffer), "%hu", port);
+    struct addrinfo* addr_ptr = NULL;
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;          // Use IPv4.
+    hints.ai_socktype = SOCK_STREAM;    // Use reliable, segmented communication.
+    if (getaddrinfo(host, port_buffer, &hints, &addr_ptr) != 0)
+        return false;
+
+    SOCKET sock = socket(addr_ptr->ai_family, addr_ptr->ai_socktype, addr_ptr->ai_protocol);
+    if (sock == INVALID_SOCKET)
+    {
+        freeaddrinfo(addr_ptr);
+        return false;
+    }
+    if (connect(sock, addr_ptr->ai_addr, (int)addr_ptr->ai_addrlen) == SOCKET_ERROR)
+    {
+        closesocket(sock);
+        freeaddrinfo(addr_ptr);
+        return false;
+    }
+
+    // Another link may have been opened while connecting, so relays check again before
+    // the new link is added.
+    mtx_lock(&server->server_node->io->client_update_lock);
+    if (server->server_node->info.relay && server->server_node->links_head != NULL)
+    {
+        mtx_unlock(&server->server_node->io->client_update_lock);
+        closesocket(sock);
+        freeaddrinfo(addr_ptr);
+        return false;
+    }
+
+    // The other server is managed like any other client, except that it is not subject
+    // to the IP limiter, as it was never admitted through the listen thread.
+    struct client_node* node = quick_malloc(sizeof(struct client_node), BULB_ALLOC_ROSTER);
+    node->server_node = server->server_node;
+    client_shared_node_init(node);
+    memcpy(&node->addr, addr_ptr->ai_addr, sizeof(node->addr));
+    inet_ntop(AF_INET, &node->addr.sin_addr, node->ip_addr, sizeof(node->ip_addr));
+    freeaddrinfo(addr_ptr);
+    flood_control_init(server->server_node, node);
+    node->mt_sock = mt_socket_new(sock);
+    node->mt_sock->dealloc_func = client_set_ready_to_delete_from_sock;
+    server_listen_client(server->server_node, node);
+    if (!client_flagged_for_deletion(node))
+        links_open(server->server_node, node);
+    mtx_unlock(&server->server_node->io->client_update_lock);
+    return true;
+}
+
+// Create the server node of a new server instance, which listens to listen_sock, and
+// whose clients are managed by the given I/O context, or by an I/O context of its own
+// if io is NULL.
+static void _server_init_node(struct bulb_server* server, SOCKET listen_sock, struct server_io* io)
+{
+    server->server_node = server_shared_node_alloc(io);
+    server->server_node->bulb_server = server;
+    server->server_node->listen_sock = listen_sock;
+    server->server_node->ip_limiter = ip_limiter_new();
+    links_init(server->server_node);
+    
+    bulb_cmds_init();
+    bulb_register_server_cmds();
+}
+
+// Create a new server instance, whose clients are managed by the given I/O context, or
+// by an I/O context of its own if io is NULL. Servers sharing an I/O context have no
+// listen socket of their own if port is 0. error_state can be NULL. Returns NULL on
+// error.
+struct bulb_server* server_create(uint16_t port, struct server_io* io, enum server_error_state* error_state)
+{
+    struct bulb_server* server = quick_malloc(sizeof(struct bulb_server), BULB_ALLOC_GENERAL);
+    SOCKET listen_sock = INVALID_SOCKET;
+    struct addrinfo* addr_ptr = NULL;
 
     // If Winsock is being used, Winsock must be initialized beforehand.
     int result = 0;
@@ -79,11 +520,13 @@ struct bulb_server* server_init(uint16_t port, enum server_error_state* error_st
     }, "Winsock 2.2 failed to start:%d\n", result);
 #endif
 
+    if (io != NULL && port == 0)
+        goto create_node;
+
     char port_buffer[6] = { 0 }; // 0-65535 + \0
     snprintf(port_buffer, sizeof(port_buffer), "%hu", port);
 
     // Resolve the hostname to listen to.
-    struct addrinfo* addr_ptr = NULL;
     struct addrinfo hints;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;          // Use IPv4.
@@ -97,7 +540,7 @@ struct bulb_server* server_init(uint16_t port, enum server_error_state* error_st
     }
 
     // Create and bind the socket for the server to listen to client connections.
-    SOCKET listen_sock = socket(addr_ptr->ai_family, addr_ptr->ai_socktype,
+    listen_sock = socket(addr_ptr->ai_family, addr_ptr->ai_socktype,
         addr_ptr->ai_protocol);
     if (listen_sock == INVALID_SOCKET)
     { 
@@ -112,12 +555,8 @@ struct bulb_server* server_init(uint16_t port, enum server_error_state* error_st
     }
     freeaddrinfo(addr_ptr);
 
-    server->server_node = server_shared_node_alloc();
-    server->server_node->bulb_server = server;
-    server->server_node->listen_sock = listen_sock;
-    
-    bulb_cmds_init();
-    bulb_register_server_cmds();
+create_node:
+    _server_init_node(server, listen_sock, io);
     return server;
 
 fail:
@@ -129,10 +568,42 @@ fail:
         closesocket(listen_sock);
     if (addr_ptr != NULL)
         freeaddrinfo(addr_ptr);
-    free(server);
+    quick_free(server);
     return NULL;
 }
 
+// Create a new server instance. error_state can be NULL. Returns NULL on error.
+struct bulb_server* server_init(uint16_t port, enum server_error_state* error_state)
+{
+    return server_create(port, NULL, error_state);
+}
+
+// Create a new server instance that takes over from a server being handed off by
+// another process, see server_hand_off(). This waits for the other process to connect
+// to a Unix domain socket created at path. The server is then configured as usual, and
+// resumes serving every client handed over once server_listen() is called, without the
+// clients noticing. Hot restarts are only supported on POSIX systems. error_state can be
+// NULL. Returns NULL on error.
+struct bulb_server* server_resume(const char* path, enum server_error_state* error_state)
+{
+    ASSERT(path, return NULL);
+    struct handoff* handoff = handoff_receive(path);
+    if (handoff == NULL)
+    {
+        if (error_state != NULL)
+            *error_state = SERVER_HANDOFF_FAIL;
+        return NULL;
+    }
+
+    // The listen socket now belongs to the server, while everything else handed over is
+    // restored once the server starts listening.
+    struct bulb_server* server = quick_malloc(sizeof(struct bulb_server), BULB_ALLOC_GENERAL);
+    _server_init_node(server, handoff->listen_sock, NULL);
+    handoff->listen_sock = INVALID_SOCKET;
+    server->handoff = handoff;
+    return server;
+}
+
 // Set a custom exception handler.
 void server_set_exception_handler(struct bulb_server* server, server_exception_func func)
 {
@@ -223,18 +694,89 @@ bool server_listen(struct bulb_server* server)
         return false;
     }
 
-    int result = listen(server->server_node->listen_sock, SOMAXCONN);
-    if (result == SOCKET_ERROR)
+    // Virtual servers without a port of their own can only be reached by name.
+    if (server->server_node->listen_sock != INVALID_SOCKET 
+        && listen(server->server_node->listen_sock, SOMAXCONN) == SOCKET_ERROR)
     { 
         server->error_state = SERVER_LISTEN_SOCKET_FAIL;
         return false; 
     }
+
+    // Recent messages and users seen are restored from the server's last snapshot.
+    if (server->server_node->history == NULL)
+        history_init(server->server_node);
+    if (server->server_node->info.warm_start)
+        snapshot_load(server);
+    server->next_snapshot_ms = token_bucket_now() 
+        + (int64_t)server->server_node->info.snapshot_interval_s * MILLISECONDS;
+
+    // Virtual servers are polled by the listen thread of their host.
+    if (server->host != NULL)
+    {
+        mtx_lock(&server->host->lock);
+        _server_admission_init(server);
+        server->is_listening = true;
+        mtx_unlock(&server->host->lock);
+        return true;
+    }
+    _server_admission_init(server);
+
+    // Clients handed over by another process are served from here on, see server_resume().
+    if (server->handoff != NULL)
+    {
+        handoff_restore(server, server->handoff);
+        server->handoff = NULL;
+    }
     server->is_listening = true;
 
     thrd_create(&server->listen_thread, _server_listen_thread, server);
     return true;
 }
 
+// Hand the server over to another process waiting in server_resume() at path, such as
+// a newer build of the same program, without disconnecting its clients. The listen
+// socket and the socket of every client are passed to the other process along with the
+// state of each client, after which SERVER_FINISH is raised as with server_shutdown().
+// Links to other servers and proxy connections are closed beforehand, and must be
+// established again by the other process. Virtual servers cannot be handed off. Returns
+// false if the hand-off failed, in which case the server keeps serving its clients.
+bool server_hand_off(struct bulb_server* server, const char* path)
+{
+    ASSERT(server != NULL && path != NULL, return false);
+    if (server->host != NULL || !server->is_listening || server->handing_off)
+        return false;
+    SOCKET conn = handoff_connect(path);
+    if (conn == INVALID_SOCKET)
+        return false;
+
+    // The listen thread is stopped first, so that nothing more is accepted once the
+    // listen socket has been handed over.
+    server->handing_off = true;
+    thrd_join(server->listen_thread, NULL);
+
+    // Links and proxies keep state about this process, so they are closed rather than
+    // handed over. The banlist database is written back and closed, and the snapshot is
+    // saved, as the other process loads both once it starts listening.
+    links_shutdown(server->server_node);
+    mux_shutdown(server->server_node);
+    bool banlist_loaded = server->banlist != NULL;
+    server_banlist_close(server);
+    if (server->server_node->info.warm_start)
+        snapshot_save(server);
+
+    if (!handoff_send(server, conn))
+    {
+        if (banlist_loaded)
+            server_banlist_load(server);
+        server->handing_off = false;
+        thrd_create(&server->listen_thread, _server_listen_thread, server);
+        return false;
+    }
+    _server_admission_free(server);
+    server_throw_exception(server, SERVER_FINISH, NULL);
+    return true;
+}
+
 // Get the number of connected clients on the server. Returns -1 on failure.
 BULB_API int server_num_connected(struct bulb_server* server)
 {
@@ -275,6 +817,12 @@ bool server_input(struct bulb_server* server, const char* msg, bool* cmd_success
     
     LOOP_CLIENTS(server->server_node, NULL, node, 
         message_obj_write(node->mt_sock, "[SERVER]", msg, true));
+
+    // Linked servers each fan the message out to their own clients.
+    mtx_lock(&server->server_node->io->client_update_lock);
+    links_broadcast(server->server_node, msg);
+    history_message(server->server_node, NULL, "", "[SERVER]", msg, true);
+    mtx_unlock(&server->server_node->io->client_update_lock);
     return false;
 }
 
@@ -287,15 +835,18 @@ void server_shutdown(struct bulb_server* server, int timeout)
     ASSERT(server->is_listening, return; );
     
     // Shutdown the server's listen socket to prevent any new clients from joining.
-    closesocket(server->server_node->listen_sock);
-    server->server_node->listen_sock = INVALID_SOCKET;
+    _server_close_listen_socket(server);
 
+    links_shutdown(server->server_node);
     LOOP_CLIENTS(server->server_node, NULL, node, 
     {
         stdout_obj_write(node->mt_sock, "The server has been shut down.\n", STDOUT_SERVER_SHUTDOWN);
         server_disconnect_client(server->server_node, node, true, false, true);
     });
 
+    // Proxies are closed once every session they carry has been told of the shutdown.
+    mux_shutdown(server->server_node);
+
     struct timespec timestamp;
     timespec_get(&timestamp, TIME_UTC);
 
@@ -321,17 +872,24 @@ void server_free(struct bulb_server* server)
     ASSERT(server, return);
     
     server->disconnecting = true;
-    if (server->server_node->listen_sock != INVALID_SOCKET)
-    {
-        SOCKET sock = server->server_node->listen_sock;
-        server->server_node->listen_sock = INVALID_SOCKET;
-        shutdown(sock, SHUT_RDWR);
-        closesocket(sock);
-    }
-
+    if (server->host != NULL)
+        host_remove_server(server->host, server);
+    _server_close_listen_socket(server);
+
+    // Connections parked for a virtual server are closed here, as the listen thread of
+    // its host no longer polls it.
+    if (server->host != NULL)
+        _server_admission_free(server);
+
+    // The snapshot is saved while every client is still connected, so that each is
+    // recorded as last seen now. Servers handed over to another process leave their
+    // snapshot to that process.
+    if (server->is_listening && !server->handing_off && server->server_node->info.warm_start)
+        snapshot_save(server);
     server_disconnect_all_clients(server->server_node);
     server_banlist_close(server);
-    free(server);
+    handoff_free(server->handoff);
+    quick_free(server);
 
     bulb_cmds_cleanup();
 
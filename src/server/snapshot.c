@@ -0,0 +1,281 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+#include <time.h>
+
+#include "util.h"
+#include "alloc.h"
+#include "trie.h"
+#include "token_bucket.h"
+#include "bulb_macros.h"
+#include "bulb_structs.h"
+#include "bulb_server.h"
+#include "shared_interface.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "banlist_file.h"
+#include "history.h"
+#include "snapshot.h"
+
+#if defined WIN32
+#   include <windows.h>
+#elif defined __UNIX__
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+// A mapped snapshot file.
+struct snapshot_map
+{
+    void* data;
+    size_t size;
+};
+
+// Snapshots of every server are written one at a time, so that the listen thread and
+// server_free() never write the same file at once.
+static once_flag snapshot_init_flag = ONCE_FLAG_INIT;
+static mtx_t snapshot_write_lock;
+
+// Initialise the lock guarding snapshot writes.
+static void _snapshot_init()
+{
+    mtx_init(&snapshot_write_lock, mtx_plain);
+}
+
+// Get the path of a server's snapshot file.
+static void _snapshot_path(struct bulb_server* server, char* path)
+{
+    const char* prefix = "";
+    const char* separator = "";
+    if (server->host != NULL && server->server_node->info.name[0] != '\0')
+    {
+        prefix = server->server_node->info.name;
+        separator = ".";
+    }
+    snprintf(path, SNAPSHOT_PATH_LENGTH, "%s%s%s", prefix, separator, SNAPSHOT_FILE_NAME);
+}
+
+// Copy a server's settings as they are stored in snapshots. Keys are never written to
+// disk, and neither is anything modified by the running server.
+static void _snapshot_settings(const struct bulb_userinfo* info, struct bulb_userinfo* settings)
+{
+    memcpy(settings, info, sizeof(*settings));
+    memset(settings->link_key, 0, sizeof(settings->link_key));
+    memset(settings->mux_key, 0, sizeof(settings->mux_key));
+    memset(settings->ip_addr, 0, sizeof(settings->ip_addr));
+    settings->ping_ms = 0;
+    settings->delayed_messages = 0;
+    settings->dropped_messages = 0;
+    settings->prev = NULL;
+    settings->next = NULL;
+    settings->linked = false;
+}
+
+// Map a snapshot file into memory. Returns false if the file is absent or empty.
+// Windows cannot replace a file while a view of it is mapped, so the file is read
+// into memory there instead.
+static bool _snapshot_map(const char* path, struct snapshot_map* map)
+{
+    map->data = NULL;
+    map->size = 0;
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+#if defined WIN32
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0)
+    {
+        map->data = quick_malloc((size_t)size, BULB_ALLOC_HISTORY);
+        map->size = (size_t)size;
+        if (fread(map->data, 1, map->size, file) != map->size)
+            map->size = 0;
+    }
+#elif defined __UNIX__
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0)
+    {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (data != MAP_FAILED)
+        {
+            map->data = data;
+            map->size = (size_t)st.st_size;
+        }
+    }
+#endif
+    fclose(file);
+    return map->data != NULL;
+}
+
+// Unmap a snapshot file from memory.
+static void _snapshot_unmap(struct snapshot_map* map)
+{
+    if (map->data == NULL)
+        return;
+#if defined WIN32
+    quick_free(map->data);
+#elif defined __UNIX__
+    munmap(map->data, map->size);
+#endif
+    map->data = NULL;
+}
+
+// Check that a snapshot was saved by a build with the same layout, and that every
+// message and user lies within the file.
+static bool _snapshot_validate(const struct snapshot_map* map)
+{
+    const struct snapshot_file_header* header = map->data;
+    if (map->size < sizeof(*header) || memcmp(header->magic, SNAPSHOT_FILE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != SNAPSHOT_FILE_VERSION)
+        return false;
+    if (header->header_size != sizeof(struct snapshot_file_header)
+        || header->settings_size != sizeof(struct bulb_userinfo)
+        || header->entry_size != sizeof(struct history_entry)
+        || header->user_size != sizeof(struct history_user))
+        return false;
+
+    uint64_t size = sizeof(struct snapshot_file_header) + sizeof(struct bulb_userinfo)
+        + (uint64_t)header->entry_count * sizeof(struct history_entry)
+        + (uint64_t)header->user_count * sizeof(struct history_user);
+    return size == map->size;
+}
+
+// Load a server's snapshot, restoring its history. The server's history must be
+// empty. An absent snapshot restores nothing. Returns false if the snapshot is
+// malformed, in which case it is ignored.
+bool snapshot_load(struct bulb_server* server)
+{
+    ASSERT(server != NULL, return false);
+    struct server_node* server_node = server->server_node;
+    char path[SNAPSHOT_PATH_LENGTH];
+    _snapshot_path(server, path);
+
+    struct snapshot_map map;
+    if (!_snapshot_map(path, &map))
+        return true;
+    ASSERT(_snapshot_validate(&map),
+    {
+        _snapshot_unmap(&map);
+        return false;
+    }, "Snapshot \"%s\" is malformed or was saved by another build\n", path);
+
+    // Snapshots left by another server run from the same directory are ignored.
+    const struct snapshot_file_header* header = map.data;
+    const struct bulb_userinfo* settings = (const struct bulb_userinfo*)(header + 1);
+    if (strncmp(settings->name, server_node->info.name, MAX_NAME_LENGTH) != 0)
+    {
+        bulb_printf(server_node, "Snapshot \"%s\" was saved by another server, ignoring it\n", path);
+        _snapshot_unmap(&map);
+        return true;
+    }
+
+    const struct history_entry* entries = (const struct history_entry*)(settings + 1);
+    const struct history_user* users = (const struct history_user*)(entries + header->entry_count);
+    mtx_lock(&server_node->io->client_update_lock);
+    for (uint32_t i = 0; i < header->entry_count; i++)
+        history_restore_message(server_node, &entries[i]);
+    for (uint32_t i = 0; i < header->user_count; i++)
+        history_restore_user(server_node, &users[i]);
+    mtx_unlock(&server_node->io->client_update_lock);
+
+    bulb_printf(server_node, "Restored %u recent messages and %u users from snapshot \"%s\"\n",
+        header->entry_count, header->user_count, path);
+    _snapshot_unmap(&map);
+    return true;
+}
+
+// Save a server's snapshot, replacing the previous snapshot once it has been written
+// to permanent storage. Returns false on failure.
+bool snapshot_save(struct bulb_server* server)
+{
+    ASSERT(server != NULL, return false);
+    struct server_node* server_node = server->server_node;
+    if (server_node->history == NULL)
+        return false;
+    call_once(&snapshot_init_flag, _snapshot_init);
+
+    char path[SNAPSHOT_PATH_LENGTH];
+    char temp_path[SNAPSHOT_PATH_LENGTH + 4];
+    _snapshot_path(server, path);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    // The snapshot is gathered into memory while the client update lock is held, and
+    // only written once the lock has been released. Connected clients are recorded as
+    // last seen now, in their current room.
+    mtx_lock(&server_node->io->client_update_lock);
+    LOOP_CLIENTS(server_node, NULL, client,
+    {
+        if (client->link == NULL && client->mux == NULL)
+            history_user_seen(server_node, client);
+    });
+
+    struct history* history = server_node->history;
+    char* data = quick_malloc(sizeof(struct snapshot_file_header) + sizeof(struct bulb_userinfo)
+        + (size_t)history->count * sizeof(struct history_entry)
+        + (size_t)history->user_count * sizeof(struct history_user), BULB_ALLOC_HISTORY);
+
+    struct snapshot_file_header* header = (struct snapshot_file_header*)data;
+    memcpy(header->magic, SNAPSHOT_FILE_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_FILE_VERSION;
+    header->header_size = sizeof(struct snapshot_file_header);
+    header->settings_size = sizeof(struct bulb_userinfo);
+    header->entry_size = sizeof(struct history_entry);
+    header->user_size = sizeof(struct history_user);
+    header->entry_count = history->count;
+    header->saved = (int64_t)time(NULL);
+
+    struct bulb_userinfo* settings = (struct bulb_userinfo*)(header + 1);
+    _snapshot_settings(&server_node->info, settings);
+    struct history_entry* entries = (struct history_entry*)(settings + 1);
+    for (unsigned i = 0; i < history->count; i++)
+        memcpy(&entries[i], history_entry_at(history, i), sizeof(struct history_entry));
+    struct history_user* users = (struct history_user*)(entries + history->count);
+    TRIE_DFS(history->users, value,
+    {
+        if (header->user_count < history->user_count)
+            memcpy(&users[header->user_count++], value, sizeof(struct history_user));
+    });
+    mtx_unlock(&server_node->io->client_update_lock);
+    size_t size = (char*)(users + header->user_count) - data;
+
+    mtx_lock(&snapshot_write_lock);
+    FILE* file = fopen(temp_path, "wb");
+    bool result = (file != NULL);
+    if (result)
+    {
+        result = fwrite(data, 1, size, file) == size && banlist_file_sync(file);
+        result = (fclose(file) == 0) && result;
+        result = result && banlist_file_replace(temp_path, path);
+        if (!result)
+            remove(temp_path);
+    }
+    mtx_unlock(&snapshot_write_lock);
+    ASSERT(result, (void)0, "Failed to write snapshot \"%s\"\n", path);
+
+    quick_free(data);
+    return result;
+}
+
+// Save a server's snapshot if one is due. This is called periodically by the listen
+// thread managing the server.
+void snapshot_poll(struct bulb_server* server)
+{
+    struct server_node* server_node = server->server_node;
+    if (!server_node->info.warm_start || server_node->info.snapshot_interval_s == 0
+        || server->disconnecting || server->handing_off)
+        return;
+
+    int64_t now_ms = token_bucket_now();
+    if (now_ms < server->next_snapshot_ms)
+        return;
+    server->next_snapshot_ms = now_ms + (int64_t)server_node->info.snapshot_interval_s * MILLISECONDS;
+    snapshot_save(server);
+}
@@ -0,0 +1,63 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Snapshots keep the history of a server, see history.h, across restarts. A snapshot
+// is saved every snapshot_interval_s seconds by the server's listen thread, when the
+// server is freed, and before it is handed over to another process. It is loaded again
+// once the server starts listening, so that clients reconnecting after a restart find
+// the same recent messages as before. Bans are not part of snapshots, as the banlist
+// database is already kept in a memory-mapped file of its own, see banlist_file.h.
+
+// A snapshot file consists of a header, followed by the settings of the server that
+// saved it, its recent messages from oldest to newest, and its users. Each of these is
+// stored as it is laid out in memory, so that the file is mapped into memory and read
+// in place. All integers are stored in host byte order, and snapshots saved by builds
+// with a different layout are ignored.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bulb_macros.h"
+#include "bulb_server.h"
+
+#define SNAPSHOT_FILE_NAME      "snapshot.bin"
+
+// Longest path of a snapshot file. The snapshot of a virtual server is prefixed with
+// its name, see bulb_host.h.
+#define SNAPSHOT_PATH_LENGTH    (MAX_NAME_LENGTH + sizeof(SNAPSHOT_FILE_NAME) + 1)
+
+#define SNAPSHOT_FILE_MAGIC     "BULBSNP1"
+#define SNAPSHOT_FILE_VERSION   1
+
+struct snapshot_file_header
+{
+    char magic[8];
+    uint32_t version;
+
+    // Sizes of the header and of each stored structure, which must match those of the
+    // build reading the snapshot.
+    uint32_t header_size;
+    uint32_t settings_size;
+    uint32_t entry_size;
+    uint32_t user_size;
+
+    uint32_t entry_count;
+    uint32_t user_count;
+    uint32_t reserved;
+    int64_t saved;      // Seconds since the epoch.
+};
+
+// Load a server's snapshot, restoring its history. The server's history must be
+// empty. An absent snapshot restores nothing. Returns false if the snapshot is
+// malformed, in which case it is ignored.
+bool snapshot_load(struct bulb_server* server);
+
+// Save a server's snapshot, replacing the previous snapshot once it has been written
+// to permanent storage. Returns false on failure.
+bool snapshot_save(struct bulb_server* server);
+
+// Save a server's snapshot if one is due. This is called periodically by the listen
+// thread managing the server.
+void snapshot_poll(struct bulb_server* server);
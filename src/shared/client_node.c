@@ -5,8 +5,15 @@
 #include <threads.h>
 
 #include "util.h"
+#include "epoch.h"
+#include "pool.h"
 #include "client_node.h"
 #include "server_node.h"
+#include "stream_obj.h"
+
+#ifdef SERVER
+#   include "flood_control.h"
+#endif
 
 #ifdef CLIENT
 #   include "bulb_client.h"
@@ -31,6 +38,62 @@ void client_shared_node_init(struct client_node* client)
     cnd_init(&client->client_delete_signal);
 }
 
+// Free a client node from memory. This should only be invoked once no other thread
+// can reference the client node; see client_try_retire().
+void client_shared_node_free(struct client_node* client)
+{
+#ifdef CLIENT
+    // Only the local client node is managed on client code.
+    if (client == localclient)
+#endif
+    {
+        mtx_destroy(&client->client_status_lock);
+        mtx_destroy(&client->send_thread_lock);
+        mtx_destroy(&client->ping_lock);
+        cnd_destroy(&client->client_delete_signal);
+    }
+
+#ifdef SERVER
+    flood_control_free(client);
+#endif
+    stream_obj_free(client);
+    pool_free(client->userinfo);
+    pool_free(client->next_obj_header);
+    quick_free(client);
+}
+
+// epoch_retire() callback for client nodes.
+static void _client_retired_free(void* obj)
+{
+    client_shared_node_free((struct client_node*)obj);
+}
+
+// Retire a client node if it has been both unlinked from its server node and is ready
+// to delete. The client node is freed once no other thread can reference it.
+void client_try_retire(struct client_node* client)
+{
+    if (!atomic_load(&client->unlinked))
+        return;
+
+#ifdef CLIENT
+    // The local client node is owned by its bulb_client instance, whereas every other
+    // client node has no socket and is thus ready to delete as soon as it is unlinked.
+    if (client == localclient)
+        return;
+#else
+    mtx_lock(&client->client_status_lock);
+    bool ready = (client->status == CLIENT_READY_TO_DELETE);
+    mtx_unlock(&client->client_status_lock);
+    if (!ready)
+        return;
+#endif
+
+    // Both conditions may be satisfied concurrently by different threads, so only
+    // the first caller may retire the client node.
+    if (!atomic_exchange(&client->retired, true))
+        epoch_retire(client, _client_retired_free);
+}
+
 // Is a client being prepared for deletion?
 bool client_flagged_for_deletion(struct client_node* client)
 {
@@ -105,7 +168,12 @@ void client_set_status(struct client_node* client, enum client_status flag)
 // Flag a client node as ready to delete, given its socket instance.
 void client_set_ready_to_delete_from_sock(struct mt_socket* sock)
 {
+    // The client node may be retired by client_set_status(), but must remain valid
+    // until this function returns.
+    epoch_enter();
     struct client_node* client = (struct client_node*)sock->parent_client;
     client->mt_sock = NULL;
     client_set_status(client, CLIENT_READY_TO_DELETE);
+    client_try_retire(client);
+    epoch_exit();
 }
\ No newline at end of file
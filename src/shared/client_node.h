@@ -12,8 +12,10 @@
 #include <threads.h>
 
 #include "unisock.h"
+#include "token_bucket.h"
 #include "networking.h"
 #include "bulb_macros.h"
+#include "bulb_structs.h"
 #include "trie.h"
 #include "shared_interface.h"
 
@@ -28,15 +30,49 @@ enum client_status
     // server_disconnect_client() has been called on this client node, therefore the
     // deletion process has begun. In order to prevent race conditions during 
     // client-looping code, client node objects cannot be immediately free()'d from memory. 
-    // This must be handled at an appropriate time where LOOP_CLIENTS() is not being called.
+    // Instead, they are retired through epoch.h once unlinked and ready to delete.
     CLIENT_FLAGGED_FOR_DELETION,
 
     // This client is now ready to delete.
     CLIENT_READY_TO_DELETE
 };
 
+// Maximum number of messages from a client that flood control can hold back at once.
+#define CLIENT_DELAYED_MESSAGES 16
+
+// Maximum number of streams that a client can send at once.
+#define CLIENT_MAX_STREAMS      4
+
 struct bulb_client;
 struct userinfo_obj;
+struct message_obj;
+struct stream_recipient;
+struct room;
+struct server_link;
+struct mux_carrier;
+
+// A stream sent by a client, see stream_obj.h. On the server, each stream is relayed 
+// to the members of the client's room when it was opened. On the client, the local 
+// client node holds the streams it is sending, while every other client node holds 
+// the streams being received from that client.
+struct client_stream
+{
+    uint32_t id;
+    bool open;
+    uint32_t chunks;                        // Chunks sent, relayed or received so far.
+    uint32_t granted;                       // Chunks that the sender may send in total.
+
+#ifdef SERVER
+    struct stream_recipient* recipients;
+    unsigned recipient_count;
+#else
+    char title[MAX_STREAM_TITLE_LENGTH + 1];
+    uint64_t size;
+    uint64_t transferred;
+    uint32_t unacked;                       // Chunks received but not yet acknowledged.
+    struct bulb_stream_source source;
+#endif
+};
 
 struct client_node
 {
@@ -51,8 +87,37 @@ struct client_node
 #ifdef SERVER
     struct sockaddr_in addr;
     char ip_addr[IPV4_ADDRESS_STRLEN];
+
+    // Flood control state, see flood_control.h. Messages held back by flood control
+    // are queued in a ring in the order they were received.
+    struct token_bucket message_bucket;
+    struct token_bucket message_bytes_bucket;
+    struct message_obj* delayed_messages[CLIENT_DELAYED_MESSAGES];
+    unsigned delayed_head;
+    unsigned delayed_count;
+    bool flood_notified;
+
+    // The room this client is a member of, see rooms.h, and its position within the
+    // room's members. room_moves counts each time the client has changed rooms.
+    struct room* room;
+    unsigned room_index;
+    uint32_t room_moves;
+
+    // Server link state, see links.h. link is set for the node of a linked server, while
+    // via is set for a client connected to another server, which has no socket and is
+    // reached through the link that it was learned from.
+    struct server_link* link;
+    struct server_link* via;
+
+    // Set for the node of a proxy's connection once it has authenticated, see mux.h.
+    struct mux_carrier* mux;
 #endif
 
+    // Streams sent by this client. These are only accessed while the server node's
+    // client update lock is held.
+    struct client_stream streams[CLIENT_MAX_STREAMS];
+    uint32_t next_stream_id;
+
     // Client communication architecture.
     size_t read_offset;
     thrd_t recv_thread;
@@ -66,12 +131,22 @@ struct client_node
     struct mt_socket* mt_sock;
     bool ready_to_ping;
 
-    // Used for linking client nodes when pending deallocation.
-    struct client_node* next;
-    struct client_node* prev;
-    bool linked;
+    // Position of this client node in its server node's client registry.
+    unsigned registry_index;
+
+    // Used for determining when the client node can be retired.
+    atomic_bool unlinked;
+    atomic_bool retired;
 };
 
+// Is a client node connected to another server, and thus only reached through a server
+// link? See links.h.
+#ifdef SERVER
+#   define CLIENT_IS_REMOTE(CLIENT) ((CLIENT)->via != NULL)
+#else
+#   define CLIENT_IS_REMOTE(CLIENT) false
+#endif
+
 #ifdef CLIENT
     extern struct client_node* localclient;
 #endif
@@ -80,6 +155,14 @@ struct client_node
 // client node's shared variables in place.
 void client_shared_node_init(struct client_node* client);
 
+// Free a client node from memory. This should only be invoked once no other thread
+// can reference the client node; see client_try_retire().
+void client_shared_node_free(struct client_node* client);
+
+// Retire a client node if it has been both unlinked from its server node and is ready
+// to delete. The client node is freed once no other thread can reference it.
+void client_try_retire(struct client_node* client);
+
 // Is a client being prepared for deletion?
 bool client_flagged_for_deletion(struct client_node* client);
 
@@ -0,0 +1,161 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+#include "client_node.h"
+#include "client_registry.h"
+#include "userinfo_obj.h"
+
+#define REGISTRY_INITIAL_SLOTS      16
+#define REGISTRY_INITIAL_CLIENTS    8
+
+// Hash a client name using 32-bit FNV-1a.
+static inline uint32_t _registry_hash(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++)
+    {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Get the name a client node is registered by.
+static inline const char* _registry_name(struct client_node* client)
+{
+    return client->userinfo->info.name;
+}
+
+// Find the hash index slot of a name. Returns the first empty slot along the name's
+// probe sequence if the name is not registered.
+static inline unsigned _registry_probe(struct client_registry* registry, const char* name, uint32_t hash)
+{
+    unsigned mask = registry->slot_capacity - 1;
+    unsigned i = hash & mask;
+    for (;; i = (i + 1) & mask)
+    {
+        struct client_registry_slot* slot = &registry->slots[i];
+        if (slot->client == NULL)
+            return i;
+        if (slot->hash == hash && strcmp(_registry_name(slot->client), name) == 0)
+            return i;
+    }
+}
+
+// Double the capacity of the hash index and re-insert each registered client.
+static void _registry_grow_slots(struct client_registry* registry)
+{
+    struct client_registry_slot* old = registry->slots;
+    unsigned old_capacity = registry->slot_capacity;
+
+    registry->slot_capacity *= 2;
+    registry->slots = quick_calloc(registry->slot_capacity, sizeof(struct client_registry_slot),
+        BULB_ALLOC_ROSTER);
+    for (unsigned i = 0; i < old_capacity; i++)
+    {
+        if (old[i].client == NULL)
+            continue;
+        unsigned mask = registry->slot_capacity - 1;
+        unsigned j = old[i].hash & mask;
+        while (registry->slots[j].client != NULL)
+            j = (j + 1) & mask;
+        registry->slots[j] = old[i];
+    }
+    quick_free(old);
+}
+
+// Initialise an empty client registry in place.
+void client_registry_init(struct client_registry* registry)
+{
+    registry->slot_capacity = REGISTRY_INITIAL_SLOTS;
+    registry->slots = quick_calloc(registry->slot_capacity, sizeof(struct client_registry_slot),
+        BULB_ALLOC_ROSTER);
+    registry->capacity = REGISTRY_INITIAL_CLIENTS;
+    registry->clients = quick_calloc(registry->capacity, sizeof(struct client_node*), BULB_ALLOC_ROSTER);
+    registry->count = 0;
+}
+
+// Register a client node by its userinfo name. Returns false if the name is already
+// registered.
+bool client_registry_add(struct client_registry* registry, struct client_node* client)
+{
+    ASSERT(client->userinfo != NULL, return false);
+
+    // Keep the hash index at most half full so that probe sequences remain short.
+    if ((registry->count + 1) * 2 > registry->slot_capacity)
+        _registry_grow_slots(registry);
+
+    const char* name = _registry_name(client);
+    uint32_t hash = _registry_hash(name);
+    unsigned i = _registry_probe(registry, name, hash);
+    if (registry->slots[i].client != NULL)
+        return false;
+    registry->slots[i].hash = hash;
+    registry->slots[i].client = client;
+
+    if (registry->count == registry->capacity)
+    {
+        struct client_node** clients = quick_malloc(sizeof(struct client_node*) * registry->capacity * 2,
+            BULB_ALLOC_ROSTER);
+        memcpy(clients, registry->clients, sizeof(struct client_node*) * registry->count);
+        quick_free(registry->clients);
+        registry->clients = clients;
+        registry->capacity *= 2;
+    }
+    client->registry_index = registry->count;
+    registry->clients[registry->count++] = client;
+    return true;
+}
+
+// Unregister a client node. Returns false if the client node was not registered.
+bool client_registry_remove(struct client_registry* registry, struct client_node* client)
+{
+    if (client->userinfo == NULL)
+        return false;
+
+    const char* name = _registry_name(client);
+    uint32_t hash = _registry_hash(name);
+    unsigned i = _registry_probe(registry, name, hash);
+    if (registry->slots[i].client != client)
+        return false;
+
+    // Shift any subsequent slots in the same cluster back, so that no probe sequence
+    // is broken by the newly-emptied slot.
+    unsigned mask = registry->slot_capacity - 1;
+    registry->slots[i].client = NULL;
+    for (unsigned j = (i + 1) & mask; registry->slots[j].client != NULL; j = (j + 1) & mask)
+    {
+        // The slot at j can only be moved into i if its ideal slot does not lie
+        // cyclically within (i, j].
+        unsigned ideal = registry->slots[j].hash & mask;
+        if ((i <= j) ? (i < ideal && ideal <= j) : (i < ideal || ideal <= j))
+            continue;
+        registry->slots[i] = registry->slots[j];
+        registry->slots[j].client = NULL;
+        i = j;
+    }
+
+    // Move the last client in the dense array into the removed client's position.
+    struct client_node* last = registry->clients[--registry->count];
+    registry->clients[client->registry_index] = last;
+    last->registry_index = client->registry_index;
+    return true;
+}
+
+// Search for a client node by name. Returns NULL if not found.
+struct client_node* client_registry_find(struct client_registry* registry, const char* name)
+{
+    return registry->slots[_registry_probe(registry, name, _registry_hash(name))].client;
+}
+
+// Free a client registry's memory. This does not free the registered client nodes.
+void client_registry_free(struct client_registry* registry)
+{
+    quick_free(registry->slots);
+    quick_free(registry->clients);
+}
@@ -0,0 +1,51 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// The client registry indexes every connected client node by name. Client nodes are
+// stored in a dense array for sequential iteration, which is indexed by an open-
+// addressing hash table keyed on each client's name. Removing a client moves the
+// last client in the dense array into its place, so each client node must track its
+// own position through its registry_index attribute.
+
+// The registry is not thread-safe; see server_node.h for its synchronisation.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct client_node;
+
+struct client_registry_slot
+{
+    uint32_t hash;
+    struct client_node* client;
+};
+
+struct client_registry
+{
+    // Hash index, whose capacity is always a power of two.
+    struct client_registry_slot* slots;
+    unsigned slot_capacity;
+
+    // Dense array of each registered client.
+    struct client_node** clients;
+    unsigned count;
+    unsigned capacity;
+};
+
+// Initialise an empty client registry in place.
+void client_registry_init(struct client_registry* registry);
+
+// Register a client node by its userinfo name. Returns false if the name is already
+// registered.
+bool client_registry_add(struct client_registry* registry, struct client_node* client);
+
+// Unregister a client node. Returns false if the client node was not registered.
+bool client_registry_remove(struct client_registry* registry, struct client_node* client);
+
+// Search for a client node by name. Returns NULL if not found.
+struct client_node* client_registry_find(struct client_registry* registry, const char* name);
+
+// Free a client registry's memory. This does not free the registered client nodes.
+void client_registry_free(struct client_registry* registry);
@@ -2,19 +2,29 @@
 // Licensed under the MIT License.
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "cmds.h"
 #include "trie.h"
+#include "pool.h"
+#include "alloc.h"
 #include "client_node.h"
 #include "server_node.h"
 #include "shared_interface.h"
+#include "rooms.h"
 
 #ifdef CLIENT
 #   include "bulb_client.h"
 #else
 #   include "bulb_server.h"
+#   include "bulb_banlist.h"
+#   include "links.h"
+#   include "history.h"
 #endif
 
 #define CMD_ERROR(ERROR_MSG, ...)                                               \
@@ -55,6 +65,49 @@ bool _cmd_status(struct bulb_cmd* cmd, struct server_node* server, struct cmd_ar
     return true;
 }
 
+// pool: lists the hit rates of each allocation pool size class.
+bool _cmd_pool(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+    struct pool_stats stats;
+    for (unsigned i = 0; pool_get_stats(i, &stats); i++)
+    {
+        double hit_rate = (stats.allocs > 0) ? (100.0 * stats.hits / stats.allocs) : 0.0;
+        bulb_printf(BULB_CONSOLE, "- %zu bytes: %llu allocs, %.1f%% hits, %llu refills, %llu slabs\n",
+            stats.chunk_size, (unsigned long long)stats.allocs, hit_rate, 
+            (unsigned long long)stats.refills, (unsigned long long)stats.slabs);
+    }
+    bulb_printf(BULB_CONSOLE, "- oversize: %llu allocs\n", (unsigned long long)pool_oversize_allocs());
+    return true;
+}
+
+// memory: lists the live memory held by each subsystem, along with the allocation
+// rates since the previous invocation.
+bool _cmd_memory(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+    static struct bulb_alloc_stats last_stats[BULB_ALLOC_TAG_COUNT];
+    static struct timespec last_time;
+
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    double elapsed = (last_time.tv_sec != 0) ? timespec_diff(&now, &last_time, 3) / 1000.0 : 0.0;
+
+    for (unsigned i = 0; i < BULB_ALLOC_TAG_COUNT; i++)
+    {
+        struct bulb_alloc_stats stats;
+        alloc_get_stats(i, &stats);
+        char rates[64] = "";
+        if (elapsed > 0.0)
+            snprintf(rates, sizeof(rates), ", %.1f allocs/s, %.1f KB/s", 
+                (stats.total_allocs - last_stats[i].total_allocs) / elapsed,
+                (stats.total_bytes - last_stats[i].total_bytes) / elapsed / 1024.0);
+        bulb_printf(BULB_CONSOLE, "- %s: %llu bytes live in %llu allocs%s\n", alloc_tag_name(i),
+            (unsigned long long)stats.live_bytes, (unsigned long long)stats.live_allocs, rates);
+        last_stats[i] = stats;
+    }
+    last_time = now;
+    return true;
+}
+
 // exit: terminate the protocol.
 bool _cmd_exit(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
 {
@@ -72,6 +125,8 @@ bool _cmd_kick(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args
 {
     CMD_ENFORCE_MIN_PARAM(1);
     CMD_GET_PARAM_CLIENT(client, 0);
+    if (CLIENT_IS_REMOTE(client))
+        CMD_ERROR("Client \"%s\" is connected to another server!\n", params->argv[0]);
 
     const char* reason = ((params->argc > 1) ? params->argv[1] : "");
     server_kick(server, client, reason);
@@ -122,6 +177,308 @@ bool _cmd_store_bans(struct bulb_cmd* cmd, struct server_node* server, struct cm
     return true;
 }
 
+// stats: lists the server's connection statistics.
+bool _cmd_stats(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    struct bulb_server_stats stats;
+    if (!server_get_stats(server->bulb_server, &stats))
+        return false;
+    bulb_printf(BULB_CONSOLE, "- accepted connections: %llu\n", (unsigned long long)stats.accepted_connections);
+    bulb_printf(BULB_CONSOLE, "- rejected connections: %llu\n", (unsigned long long)stats.rejected_connections);
+    bulb_printf(BULB_CONSOLE, "- rate limited connections: %llu\n", (unsigned long long)stats.limited_connections);
+    bulb_printf(BULB_CONSOLE, "- processing lag: %llums (%llu sockets ready)\n", 
+        (unsigned long long)stats.processing_lag_ms, (unsigned long long)stats.ready_sockets);
+    bulb_printf(BULB_CONSOLE, "- admission queue: %llu parked (%llu refused as busy)\n",
+        (unsigned long long)stats.parked_connections, (unsigned long long)stats.busy_connections);
+    bulb_printf(BULB_CONSOLE, "- queued for sending: %llu bytes in %llu objects (max %llu bytes per client)\n",
+        (unsigned long long)stats.queued_bytes, (unsigned long long)stats.queued_objects,
+        (unsigned long long)stats.max_client_queued_bytes);
+    bulb_printf(BULB_CONSOLE, "- spilled to disk: %llu bytes%s\n", (unsigned long long)stats.spilled_bytes,
+        (stats.over_budget ? " (over memory budget)" : ""));
+    bulb_printf(BULB_CONSOLE, "- congested clients: %llu (%llu disconnected)\n", 
+        (unsigned long long)stats.congested_clients, (unsigned long long)stats.congestion_disconnects);
+    bulb_printf(BULB_CONSOLE, "- objects dropped: %llu, conflated: %llu\n",
+        (unsigned long long)stats.dropped_objects, (unsigned long long)stats.conflated_objects);
+    bulb_printf(BULB_CONSOLE, "- linked servers: %llu (%llu remote clients)\n",
+        (unsigned long long)stats.linked_servers, (unsigned long long)stats.remote_clients);
+    bulb_printf(BULB_CONSOLE, "- proxies: %llu (%llu sessions)\n",
+        (unsigned long long)stats.mux_proxies, (unsigned long long)stats.mux_sessions);
+#endif
+    return true;
+}
+
+// import_bans: add every ban in a banlist text file to the banlist database.
+bool _cmd_import_bans(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    CMD_ENFORCE_MIN_PARAM(1);
+    if (!server_banlist_import(server->bulb_server, params->argv[0]))
+        CMD_ERROR("Could not import bans from \"%s\"!\n", params->argv[0]);
+#endif
+    return true;
+}
+
+// export_bans: write the banlist database to a banlist text file.
+bool _cmd_export_bans(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    CMD_ENFORCE_MIN_PARAM(1);
+    if (!server_banlist_export(server->bulb_server, params->argv[0]))
+        CMD_ERROR("Could not export bans to \"%s\"!\n", params->argv[0]);
+#endif
+    return true;
+}
+
+// rooms: list every room and its number of members.
+bool _cmd_rooms(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    mtx_lock(&server->io->client_update_lock);
+    TRIE_DFS(server->rooms, value,
+    {
+        struct room* room = (struct room*)value;
+        bulb_printf(BULB_CONSOLE, "- \"%s\": %u members\n", room->name, room->count);
+    });
+    mtx_unlock(&server->io->client_update_lock);
+#endif
+    return true;
+}
+
+// link: link the server to another server.
+bool _cmd_link(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    CMD_ENFORCE_MIN_PARAM(1);
+    if (!links_enabled(server))
+        CMD_ERROR("The server must be named and have a link key to link to other servers!\n");
+
+    unsigned long port = BULB_FIRST_PORT;
+    if (params->argc > 1)
+    {
+        char* end;
+        port = strtoul(params->argv[1], &end, 10);
+        if (*end != '\0' || port == 0 || port > UINT16_MAX)
+            CMD_ERROR("Invalid port \"%s\"!\n", params->argv[1]);
+    }
+    mtx_lock(&server->io->client_update_lock);
+    bool linked = server->links_head != NULL;
+    mtx_unlock(&server->io->client_update_lock);
+    if (server->info.relay && linked)
+        CMD_ERROR("Relays can only be linked to their core server!\n");
+    if (!server_link(server->bulb_server, params->argv[0], (uint16_t)port))
+        CMD_ERROR("Could not reach %s:%lu!\n", params->argv[0], port);
+#endif
+    return true;
+}
+
+// links: list every server directly linked to the server.
+bool _cmd_links(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    mtx_lock(&server->io->client_update_lock);
+    for (struct server_link* link = server->links_head; link != NULL; link = link->next)
+    {
+        if (!link->established)
+            continue;
+        bulb_printf(BULB_CONSOLE, "- \"%s\" (%s, %s%s): %llu events sent, %llu received\n",
+            link->node->userinfo->info.name, link->node->ip_addr, (link->outgoing ? "outgoing" : "incoming"),
+            (link->relay ? " relay" : ""),
+            (unsigned long long)link->events_sent, (unsigned long long)link->events_received);
+    }
+    mtx_unlock(&server->io->client_update_lock);
+#endif
+    return true;
+}
+
+// unlink: close the link with a directly linked server.
+bool _cmd_unlink(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    CMD_ENFORCE_MIN_PARAM(1);
+    mtx_lock(&server->io->client_update_lock);
+    struct server_link* link = links_find(server, params->argv[0]);
+    if (link != NULL)
+        links_kick(server, link->node, "");
+    mtx_unlock(&server->io->client_update_lock);
+    if (link == NULL)
+        CMD_ERROR("Could not find linked server \"%s\"!\n", params->argv[0]);
+#endif
+    return true;
+}
+
+// handoff: hand the server over to another process, without disconnecting its clients.
+bool _cmd_handoff(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    CMD_ENFORCE_MIN_PARAM(1);
+    if (!server_hand_off(server->bulb_server, params->argv[0]))
+        CMD_ERROR("Could not hand the server over through \"%s\"!\n", params->argv[0]);
+#endif
+    return true;
+}
+
+#ifdef SERVER
+// Describe a duration in its largest whole unit, such as "3 hours".
+static void _cmd_format_age(char* buffer, size_t size, int64_t seconds)
+{
+    static const struct { const char* unit; int64_t seconds; } units[] = 
+    {
+        { "day", 24 * 60 * 60 }, { "hour", 60 * 60 }, { "minute", 60 }, { "second", 1 }
+    };
+    unsigned i = 0;
+    while (i < 3 && seconds < units[i].seconds)
+        i++;
+    long long count = (long long)MAX(seconds, 0) / units[i].seconds;
+    snprintf(buffer, size, "%lld %s%s", count, units[i].unit, (count == 1) ? "" : "s");
+}
+#endif
+
+// seen: report when a user was last connected to the server, and in which room.
+bool _cmd_seen(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef SERVER
+    CMD_ENFORCE_MIN_PARAM(1);
+    struct history_user user;
+    char room[MAX_ROOM_NAME_LENGTH + 1] = "";
+    mtx_lock(&server->io->client_update_lock);
+    const struct history_user* found = history_find_user(server, params->argv[0]);
+    if (found != NULL)
+        memcpy(&user, found, sizeof(user));
+    epoch_enter();
+    struct client_node* client = server_find_by_name(server, params->argv[0]);
+    if (client != NULL && client->room != NULL)
+        strcpy(room, client->room->name);
+    epoch_exit();
+    mtx_unlock(&server->io->client_update_lock);
+    if (found == NULL)
+        CMD_ERROR("Client \"%s\" has not been seen!\n", params->argv[0]);
+
+    char last_seen[32], first_seen[32];
+    int64_t now = (int64_t)time(NULL);
+    _cmd_format_age(last_seen, sizeof(last_seen), now - user.last_seen);
+    _cmd_format_age(first_seen, sizeof(first_seen), now - user.first_seen);
+    if (room[0] != '\0')
+        bulb_printf(BULB_CONSOLE, "- \"%s\" is connected, in room \"%s\"\n", user.name, room);
+    else
+        bulb_printf(BULB_CONSOLE, "- \"%s\" was last seen %s ago, in room \"%s\"\n", user.name, last_seen, 
+            user.room);
+    bulb_printf(BULB_CONSOLE, "- first seen %s ago, with %u connections and %u messages since\n", first_seen,
+        user.connections, user.messages);
+#endif
+    return true;
+}
+
+// join: move into a room.
+bool _cmd_join(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef CLIENT
+    CMD_ENFORCE_MIN_PARAM(1);
+    if (!client_join_room(localclient->bulb_client, params->argv[0]))
+        CMD_ERROR("\"%s\" is not a valid room name!\n", params->argv[0]);
+#endif
+    return true;
+}
+
+// msg: send a message to a single client.
+bool _cmd_msg(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef CLIENT
+    CMD_ENFORCE_MIN_PARAM(2);
+
+    // The message need not be quoted, so every remaining parameter is joined together.
+    char message[MAX_MESSAGE_LENGTH + 1] = "";
+    for (int i = 1; i < params->argc; i++)
+    {
+        if (i > 1)
+            strncat(message, " ", MAX_MESSAGE_LENGTH - strlen(message));
+        strncat(message, params->argv[i], MAX_MESSAGE_LENGTH - strlen(message));
+    }
+    if (!client_direct_message(localclient->bulb_client, params->argv[0], message, NULL))
+        CMD_ERROR("Could not send a message to \"%s\"!\n", params->argv[0]);
+#endif
+    return true;
+}
+
+// part: return to the lobby.
+bool _cmd_part(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef CLIENT
+    client_join_room(localclient->bulb_client, NULL);
+#endif
+    return true;
+}
+
+#ifdef CLIENT
+// A file being streamed by the send command.
+struct cmd_send_file
+{
+    FILE* file;
+    char title[MAX_STREAM_TITLE_LENGTH + 1];
+};
+
+// bulb_stream_source read callback for the send command.
+static long _cmd_send_read(void* ctx, char* buffer, size_t len)
+{
+    struct cmd_send_file* send = (struct cmd_send_file*)ctx;
+    size_t read = fread(buffer, 1, len, send->file);
+    return (read == 0 && ferror(send->file)) ? -1 : (long)read;
+}
+
+// bulb_stream_source close callback for the send command.
+static void _cmd_send_close(void* ctx, bool aborted)
+{
+    struct cmd_send_file* send = (struct cmd_send_file*)ctx;
+    bulb_printf(BULB_CONSOLE, "%s \"%s\"\n", (aborted ? "Aborted streaming" : "Finished streaming"), 
+        send->title);
+    fclose(send->file);
+    quick_free(send);
+}
+#endif
+
+// send: stream a file to every other member of the room.
+bool _cmd_send(struct bulb_cmd* cmd, struct server_node* server, struct cmd_args* params)
+{
+#ifdef CLIENT
+    CMD_ENFORCE_MIN_PARAM(1);
+    FILE* file = fopen(params->argv[0], "rb");
+    if (file == NULL)
+        CMD_ERROR("Could not open \"%s\"!\n", params->argv[0]);
+
+    // The size of the file is only used to report progress to its recipients.
+    long size = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+    rewind(file);
+
+    // Files are titled by their name by default.
+    const char* title = params->argv[0];
+    if (params->argc >= 2)
+        title = params->argv[1];
+    else if (strrchr(title, '/') != NULL)
+        title = strrchr(title, '/') + 1;
+
+    struct cmd_send_file* send = quick_malloc(sizeof(struct cmd_send_file), BULB_ALLOC_GENERAL);
+    send->file = file;
+    strncpy(send->title, title, MAX_STREAM_TITLE_LENGTH);
+    struct bulb_stream_source source = { .read_func = _cmd_send_read, .close_func = _cmd_send_close, 
+                                         .ctx = send };
+
+    // The stream must not be reported as finished before it is reported as started.
+    mtx_lock(&server->io->client_update_lock);
+    bool result = client_stream_send(localclient->bulb_client, send->title, (size > 0) ? (uint64_t)size : 0, 
+        &source);
+    if (result)
+        bulb_printf(BULB_CONSOLE, "Streaming \"%s\"\n", send->title);
+    mtx_unlock(&server->io->client_update_lock);
+    if (!result)
+    {
+        fclose(file);
+        quick_free(send);
+        CMD_ERROR("Could not stream \"%s\"!\n", params->argv[0]);
+    }
+#endif
+    return true;
+}
+
 // Register a new command. Returns true upon successful registration, otherwise 
 // false.
 bool bulb_register_cmd(const char* name, const char* desc, bulb_cmd_func func)
@@ -143,11 +500,11 @@ bool bulb_parse_cmd_input(struct server_node* server, const char* buffer)
 
     size_t temp_len = strlen(buffer) + 1;
     char cmd[MAX_CMD_NAME_LENGTH + 1] = "";
-    struct cmd_args params = { .argv = quick_calloc(1, sizeof(char*)) };
+    struct cmd_args params = { .argv = quick_calloc(1, sizeof(char*), BULB_ALLOC_GENERAL) };
 
     // This loop goes up to the end of buffer + the NUL character, in order to
     // handle creating the final parameter/finalising the command name.
-    char* temp_buffer = params.argv[params.argc] = quick_malloc(temp_len);
+    char* temp_buffer = params.argv[params.argc] = quick_malloc(temp_len, BULB_ALLOC_GENERAL);
     bool in_quotes = false;
     bool terminate = false;
     size_t offset = 0;
@@ -186,11 +543,11 @@ bool bulb_parse_cmd_input(struct server_node* server, const char* buffer)
                 }
                 else
                 {
-                    char** new = calloc(1 + (++params.argc), sizeof(char*));
+                    char** new = quick_calloc(1 + (++params.argc), sizeof(char*), BULB_ALLOC_GENERAL);
                     memcpy(new, params.argv, sizeof(char**) * params.argc);
-                    free(params.argv);
+                    quick_free(params.argv);
                     params.argv = new;
-                    temp_buffer = params.argv[params.argc] = quick_malloc(temp_len);
+                    temp_buffer = params.argv[params.argc] = quick_malloc(temp_len, BULB_ALLOC_GENERAL);
                 }
             }
             if (terminate)
@@ -200,20 +557,25 @@ bool bulb_parse_cmd_input(struct server_node* server, const char* buffer)
             temp_buffer[strlen(temp_buffer)] = buffer[offset];
     }
 
-    // The temporary buffer must be free()'d separately as it is still re-allocated 
+    // The temporary buffer must be quick_free()'d separately as it is still re-allocated 
     // independently of its assignment to any parameter object.
-    free(temp_buffer);
+    quick_free(temp_buffer);
 
     struct bulb_cmd* cmd_obj = trie_find(bulb_cmds, cmd);
     bool cmd_success = (cmd_obj != NULL);
     if (cmd_obj == NULL)
         goto finish;
+
+    // Commands may hold onto client nodes found by name, which must not be reclaimed
+    // while the command is running.
+    epoch_enter();
     cmd_success = cmd_obj->func(cmd_obj, server, &params);
+    epoch_exit();
 
 finish:
     for (int i = 0; i < params.argc; i++)
-        free(params.argv[i]);
-    free(params.argv);
+        quick_free(params.argv[i]);
+    quick_free(params.argv);
     return cmd_success && ((offset < temp_len) ? bulb_parse_cmd_input(server, &buffer[offset]) : true);
 }
 
@@ -224,6 +586,9 @@ void bulb_cmds_init()
     {
         bulb_register_cmd("list", "list", _cmd_list);
         bulb_register_cmd("status", "status", _cmd_status);
+        bulb_register_cmd("pool", "pool (lists allocation pool hit rates)", _cmd_pool);
+        bulb_register_cmd("memory", "memory (lists live memory and allocation rates per subsystem)", 
+            _cmd_memory);
         bulb_register_cmd("exit", "exit", _cmd_exit);
     }
 }
@@ -233,10 +598,31 @@ void bulb_register_server_cmds()
 {   
     ASSERT(bulb_cmds_ref_count > 0, return, "Bulb commands not initialized!");
     bulb_register_cmd("kick", "kick username [reason]", _cmd_kick);
-    bulb_register_cmd("ban", "ban ip [reason]", _cmd_ban);
-    bulb_register_cmd("unban", "unban ip", _cmd_unban);
+    bulb_register_cmd("ban", "ban ip[/prefix] [reason]", _cmd_ban);
+    bulb_register_cmd("unban", "unban ip[/prefix]", _cmd_unban);
     bulb_register_cmd("banned", "banned ip (checks if address is banned)", _cmd_banned);
     bulb_register_cmd("store_bans", "store_bans (stores bans permanently in storage)", _cmd_store_bans);
+    bulb_register_cmd("stats", "stats (lists connection statistics)", _cmd_stats);
+    bulb_register_cmd("import_bans", "import_bans file (adds bans from a banlist text file)", _cmd_import_bans);
+    bulb_register_cmd("export_bans", "export_bans file (writes bans to a banlist text file)", _cmd_export_bans);
+    bulb_register_cmd("rooms", "rooms (lists rooms and their number of members)", _cmd_rooms);
+    bulb_register_cmd("link", "link host [port] (links to another server)", _cmd_link);
+    bulb_register_cmd("links", "links (lists linked servers)", _cmd_links);
+    bulb_register_cmd("unlink", "unlink name (closes the link with a linked server)", _cmd_unlink);
+    bulb_register_cmd("handoff", "handoff path (hands the server over to a process resumed at path)", 
+        _cmd_handoff);
+    bulb_register_cmd("seen", "seen username (shows when a client was last connected, even before a restart)",
+        _cmd_seen);
+}
+
+// Register all client commands.
+void bulb_register_client_cmds()
+{
+    ASSERT(bulb_cmds_ref_count > 0, return, "Bulb commands not initialized!");
+    bulb_register_cmd("send", "send file [title] (streams a file to the room)", _cmd_send);
+    bulb_register_cmd("msg", "msg username message (sends a message to one client)", _cmd_msg);
+    bulb_register_cmd("join", "join room", _cmd_join);
+    bulb_register_cmd("part", "part (returns to the lobby)", _cmd_part);
 }
 
 // Cleanup on process exit.
@@ -39,5 +39,8 @@ void bulb_cmds_init();
 // Register all server commands.
 void bulb_register_server_cmds();
 
+// Register all client commands.
+void bulb_register_client_cmds();
+
 // Cleanup on process exit.
 void bulb_cmds_cleanup();
\ No newline at end of file
@@ -0,0 +1,181 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <string.h>
+
+#include "util.h"
+#include "pool.h"
+#include "token_bucket.h"
+#include "bulb_structs.h"
+#include "userinfo_obj.h"
+#include "stdout_obj.h"
+#include "flood_control.h"
+
+#ifdef SERVER
+// Get the number of message bytes a client can send at once. This is never below the
+// length of the longest possible message, which could otherwise never be admitted.
+static inline unsigned _flood_bytes_burst(const struct bulb_userinfo* info)
+{
+    return MAX(info->message_bytes_burst, MAX_MESSAGE_LENGTH);
+}
+
+// Take the tokens needed to send a message from a client's token buckets. Returns
+// false, taking nothing, if either bucket holds too few tokens.
+static bool _flood_take(const struct bulb_userinfo* info, struct client_node* client, 
+                        const char* message, int64_t now_ms)
+{
+    unsigned bytes = (unsigned)strnlen(message, MAX_MESSAGE_LENGTH);
+    bool limit_messages = (info->messages_per_second > 0);
+    bool limit_bytes = (info->message_bytes_per_second > 0);
+
+    if (limit_messages)
+    {
+        token_bucket_refill(&client->message_bucket, info->messages_per_second, MILLISECONDS,
+            MAX(info->message_burst, 1), now_ms);
+        if (!token_bucket_available(&client->message_bucket, 1))
+            return false;
+    }
+    if (limit_bytes)
+    {
+        token_bucket_refill(&client->message_bytes_bucket, info->message_bytes_per_second, MILLISECONDS,
+            _flood_bytes_burst(info), now_ms);
+        if (!token_bucket_available(&client->message_bytes_bucket, bytes))
+            return false;
+    }
+
+    if (limit_messages)
+        token_bucket_take(&client->message_bucket, 1);
+    if (limit_bytes)
+        token_bucket_take(&client->message_bytes_bucket, bytes);
+    return true;
+}
+
+// Discard a message from a client, informing the client once for each run of
+// discarded messages.
+static void _flood_drop(struct client_node* client)
+{
+    if (client->userinfo != NULL)
+        client->userinfo->info.dropped_messages++;
+    if (!client->flood_notified)
+    {
+        stdout_obj_write(client->mt_sock, "You are sending messages too quickly; "
+            "some of your messages have been discarded.\n", STDOUT_GENERIC);
+        client->flood_notified = true;
+    }
+}
+#endif
+
+// Fill a newly-connected client's token buckets.
+void flood_control_init(struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    int64_t now_ms = token_bucket_now();
+    token_bucket_init(&client->message_bucket, MAX(server->info.message_burst, 1), now_ms);
+    token_bucket_init(&client->message_bytes_bucket, _flood_bytes_burst(&server->info), now_ms);
+#endif
+}
+
+// Check a message received from a client against the server's flood control limits.
+// The message must be processed by the caller only if it is admitted, and freed by
+// the caller unless it is delayed.
+enum flood_result flood_control_admit(struct server_node* server, struct client_node* client,
+                                      struct message_obj* obj)
+{
+#ifdef SERVER
+    // Messages that arrive while earlier messages are held back must wait their turn.
+    if (client->delayed_count == 0 && _flood_take(&server->info, client, obj->message, token_bucket_now()))
+    {
+        client->flood_notified = false;
+        return FLOOD_ADMITTED;
+    }
+
+    switch (server->info.flood_policy)
+    {
+        case BULB_FLOOD_KICK:
+            server_kick(server, client, "Sent messages too quickly.");
+            return FLOOD_KICKED;
+
+        case BULB_FLOOD_DELAY:
+            if (client->delayed_count < CLIENT_DELAYED_MESSAGES)
+            {
+                unsigned tail = (client->delayed_head + client->delayed_count) % CLIENT_DELAYED_MESSAGES;
+                client->delayed_messages[tail] = obj;
+                if (client->delayed_count++ == 0)
+                    server->delayed_clients++;
+                if (client->userinfo != NULL)
+                    client->userinfo->info.delayed_messages++;
+                return FLOOD_DELAYED;
+            }
+
+            // The message is dropped once too many are held back.
+            _flood_drop(client);
+            return FLOOD_DROPPED;
+
+        default:
+            _flood_drop(client);
+            return FLOOD_DROPPED;
+    }
+#else
+    return FLOOD_ADMITTED;
+#endif
+}
+
+// Check a direct message received from a client against the server's flood control
+// limits. Direct messages are never delayed, as their sender is told of their outcome
+// instead, so they are only ever admitted, dropped or cause their sender to be kicked.
+enum flood_result flood_control_admit_direct(struct server_node* server, struct client_node* client,
+                                             const char* message)
+{
+#ifdef SERVER
+    if (client->delayed_count == 0 && _flood_take(&server->info, client, message, token_bucket_now()))
+        return FLOOD_ADMITTED;
+    if (server->info.flood_policy == BULB_FLOOD_KICK)
+    {
+        server_kick(server, client, "Sent messages too quickly.");
+        return FLOOD_KICKED;
+    }
+    if (client->userinfo != NULL)
+        client->userinfo->info.dropped_messages++;
+    return FLOOD_DROPPED;
+#else
+    return FLOOD_ADMITTED;
+#endif
+}
+
+// Process every delayed message that the limits of its sender now allow. This should
+// only be called from the server's client management thread.
+void flood_control_release(struct server_node* server)
+{
+#ifdef SERVER
+    // Clients that have since disconnected are no longer in the roster, so the number
+    // of clients with delayed messages is recounted rather than maintained.
+    int64_t now_ms = token_bucket_now();
+    unsigned delayed_clients = 0;
+    LOOP_CLIENTS(server, NULL, node,
+    {
+        while (node->delayed_count > 0 
+            && _flood_take(&server->info, node, node->delayed_messages[node->delayed_head]->message, now_ms))
+        {
+            struct message_obj* obj = node->delayed_messages[node->delayed_head];
+            node->delayed_head = (node->delayed_head + 1) % CLIENT_DELAYED_MESSAGES;
+            node->delayed_count--;
+            message_obj_process(obj, server, node);
+        }
+        if (node->delayed_count > 0)
+            delayed_clients++;
+    });
+    server->delayed_clients = delayed_clients;
+#endif
+}
+
+// Free every message held back for a client.
+void flood_control_free(struct client_node* client)
+{
+#ifdef SERVER
+    for (; client->delayed_count > 0; client->delayed_count--)
+    {
+        pool_free(client->delayed_messages[client->delayed_head]);
+        client->delayed_head = (client->delayed_head + 1) % CLIENT_DELAYED_MESSAGES;
+    }
+#endif
+}
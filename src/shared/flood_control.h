@@ -0,0 +1,49 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Flood control limits how quickly each client can send messages, using one token
+// bucket for messages and another for message bytes. Messages sent over either limit
+// are delayed, dropped or cause their sender to be kicked, as per the server's flood
+// policy. Flood control is only enforced by the server.
+
+#pragma once
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "server_node.h"
+#include "client_node.h"
+#include "message_obj.h"
+
+// How often messages held back by flood control are reconsidered, in milliseconds.
+#define FLOOD_RELEASE_INTERVAL_MS   50
+
+enum flood_result
+{
+    FLOOD_ADMITTED = 0,
+    FLOOD_DELAYED,
+    FLOOD_DROPPED,
+    FLOOD_KICKED
+};
+
+// Fill a newly-connected client's token buckets.
+void flood_control_init(struct server_node* server, struct client_node* client);
+
+// Check a message received from a client against the server's flood control limits.
+// The message must be processed by the caller only if it is admitted, and freed by
+// the caller unless it is delayed.
+enum flood_result flood_control_admit(struct server_node* server, struct client_node* client,
+                                      struct message_obj* obj);
+
+// Check a direct message received from a client against the server's flood control
+// limits. Direct messages are never delayed, as their sender is told of their outcome
+// instead, so they are only ever admitted, dropped or cause their sender to be kicked.
+enum flood_result flood_control_admit_direct(struct server_node* server, struct client_node* client,
+                                             const char* message);
+
+// Process every delayed message that the limits of its sender now allow. This should
+// only be called from the server's client management thread.
+void flood_control_release(struct server_node* server);
+
+// Free every message held back for a client.
+void flood_control_free(struct client_node* client);
@@ -11,6 +11,143 @@
 #include "unisock.h"
 #include "networking.h"
 #include "bulb_obj.h"
+#include "disconnect_obj.h"
+#include "stdout_obj.h"
+#include "mux_obj.h"
+
+#ifdef SERVER
+#   include "server_node.h"
+#   include "client_node.h"
+#   include "update_userinfo_obj.h"
+
+// Get the server node whose settings apply to a socket, or NULL if the socket has not
+// been assigned to a client yet.
+static inline struct server_node* _bulb_obj_socket_server(struct mt_socket* sock)
+{
+    struct client_node* client = (struct client_node*)sock->parent_client;
+    return (client != NULL) ? client->server_node : NULL;
+}
+
+// Check if the write data queues of every socket together exceed the server's budget.
+static inline bool _bulb_obj_over_budget(struct server_node* server)
+{
+    return server->info.send_queue_budget_mb > 0 
+        && mt_socket_total_send_queue_bytes() > (size_t)server->info.send_queue_budget_mb * 1024 * 1024;
+}
+
+// Replace a queued presence update with a newer presence update about the same client.
+// Returns false if no presence update about the same client is queued. The socket's
+// write lock must be held.
+static bool _bulb_obj_conflate(struct mt_socket* sock, struct bulb_obj* obj)
+{
+    struct update_userinfo_obj* update = (struct update_userinfo_obj*)obj;
+    for (struct mt_socket_data_node* node = sock->data_send_tail[MT_SOCKET_LANE_BULK]; node != NULL; 
+         node = node->prev)
+    {
+        // Data that has been partially sent can no longer be replaced.
+        struct update_userinfo_obj* queued = (struct update_userinfo_obj*)node->data;
+        if (node->send_offset > 0 || node->len != obj->size || queued->base.type != BULB_UPDATE_USERINFO)
+            continue;
+        if (strcmp(queued->client_name, update->client_name) != 0)
+            continue;
+
+        memcpy(node->data, obj, obj->size);
+        return true;
+    }
+    return false;
+}
+
+// Apply backpressure to an object about to be queued on a congested socket. Returns
+// true if the object was dealt with and must not be queued. The socket's write lock
+// must be held.
+static bool _bulb_obj_backpressure(struct mt_socket* sock, struct bulb_obj* obj)
+{
+    struct server_node* server = _bulb_obj_socket_server(sock);
+    if (server == NULL)
+        return false;
+
+    // While the server is over its send queue budget without spilling to disk, it runs
+    // degraded, treating every client with a backlog as congested.
+    bool degraded = !server->info.spill_send_queues && sock->send_queue_objects > 0
+        && _bulb_obj_over_budget(server);
+    if (!sock->send_congested && !degraded)
+        return false;
+
+    // Only chat messages and presence updates can be held back from a congested
+    // client; anything else is needed to keep the connection working.
+    if (obj->type != BULB_MESSAGE && obj->type != BULB_UPDATE_USERINFO)
+        return false;
+
+    unsigned policy = server->info.send_queue_policy;
+    if ((policy & BULB_SEND_QUEUE_CONFLATE) && obj->type == BULB_UPDATE_USERINFO 
+        && _bulb_obj_conflate(sock, obj))
+    {
+        atomic_fetch_add(&server->conflated_objects, 1);
+        return true;
+    }
+    if ((policy & BULB_SEND_QUEUE_DROP) || degraded)
+    {
+        atomic_fetch_add(&server->dropped_objects, 1);
+        return true;
+    }
+    return false;
+}
+
+// Spill the backlog of a lagging client to disk while the server is over its send
+// queue budget, if enabled, given the data node that was just queued. The socket's
+// write lock must be held.
+static void _bulb_obj_spill(struct mt_socket* sock, struct mt_socket_data_node* node)
+{
+    // Only the bulk lane is spilled, as the control lane is sent ahead of any backlog.
+    struct server_node* server = _bulb_obj_socket_server(sock);
+    if (server == NULL || !server->info.spill_send_queues || node->lane != MT_SOCKET_LANE_BULK)
+        return;
+
+    // Once anything is spilled, newly queued data must follow it into the spill file,
+    // as spilled data is sent after the bulk lane.
+    if (sock->spill_nodes > 0)
+    {
+        mt_socket_spill(sock, node);
+        return;
+    }
+    if (!_bulb_obj_over_budget(server) || sock->send_queue_bytes < MAX(server->info.send_queue_low_bytes, 1))
+        return;
+
+    // The data node at the head of the bulk lane may already be partially sent, so it
+    // is kept in memory.
+    if (sock->data_send_queue[MT_SOCKET_LANE_BULK]->next != NULL)
+        mt_socket_spill(sock, sock->data_send_queue[MT_SOCKET_LANE_BULK]->next);
+}
+#endif
+
+// Get the lane of a socket's write data queue that an object is sent through. Pings
+// and acknowledgements are sent ahead of any backlog, so that they measure network
+// latency rather than queueing delay. So is the disconnection of the peer itself,
+// along with the message explaining it.
+static enum mt_socket_lane _bulb_obj_lane(struct bulb_obj* obj)
+{
+    switch (obj->type)
+    {
+        case BULB_PING:
+        case BULB_RECEIVED:
+        case BULB_STREAM_ACK:
+            return MT_SOCKET_LANE_CONTROL;
+        case BULB_DISCONNECT:
+            return (((struct disconnect_obj*)obj)->name[0] == '\0') 
+                ? MT_SOCKET_LANE_CONTROL : MT_SOCKET_LANE_BULK;
+        case BULB_STDOUT:
+            return (((struct stdout_obj*)obj)->type >= STDOUT_KICK_MSG) 
+                ? MT_SOCKET_LANE_CONTROL : MT_SOCKET_LANE_BULK;
+
+        // Carried objects keep the lane of the object within, while anything else that
+        // concerns a session must follow the session's carried objects.
+        case BULB_MUX:
+            return (((struct mux_obj*)obj)->op == MUX_DATA) 
+                ? _bulb_obj_lane((struct bulb_obj*)((struct mux_obj*)obj)->payload) : MT_SOCKET_LANE_BULK;
+        default:
+            return MT_SOCKET_LANE_BULK;
+    }
+}
 
 // This is a basic template for reading a Bulb object that has no additional reading
 // requirements. Returns NULL on failure.
@@ -22,7 +159,7 @@ struct bulb_obj* bulb_obj_template_recv(struct mt_socket* sock, struct bulb_obj*
 
     // Copy the buffered data nodes into a new Bulb object instance. This is the 
     // standard method for reading objects.
-    struct bulb_obj* obj = quick_malloc(header->size);
+    struct bulb_obj* obj = pool_alloc(header->size, BULB_ALLOC_OBJECTS);
     size_t offset = 0;
     do
     {
@@ -32,31 +169,112 @@ struct bulb_obj* bulb_obj_template_recv(struct mt_socket* sock, struct bulb_obj*
         memcpy((char*)obj + offset, node->data, node->len);
 
         offset += node->len;
-        free(node);
+        pool_free(node);
     } while (header->size > offset);
 
     return obj;
 }
 
+// Account for data being added to or removed from a socket's send queue, updating
+// whether the send queue is congested. The socket's write lock must be held.
+void bulb_obj_account_send_queue(struct mt_socket* sock, long long bytes, int objects)
+{
+    mt_socket_account_send_queue(sock, bytes, objects);
+
+#ifdef SERVER
+    // The send queue becomes congested once it reaches either high-water mark, and is
+    // no longer congested once it is at or below both low-water marks.
+    struct server_node* server = _bulb_obj_socket_server(sock);
+    if (server == NULL)
+        return;
+    const struct bulb_userinfo* info = &server->info;
+    if (!sock->send_congested)
+    {
+        if ((info->send_queue_high_bytes > 0 && sock->send_queue_bytes >= info->send_queue_high_bytes)
+            || (info->send_queue_high_objects > 0 && sock->send_queue_objects >= info->send_queue_high_objects))
+        {
+            sock->send_congested = true;
+            timespec_get(&sock->congested_since, TIME_UTC);
+        }
+    }
+    else if (sock->send_queue_bytes <= info->send_queue_low_bytes 
+        && sock->send_queue_objects <= info->send_queue_low_objects)
+        sock->send_congested = false;
+#endif
+}
+
+// Send a Bulb object to a session multiplexed over a carrier socket. Backpressure is
+// applied by the carrier as a whole rather than per session. Returns false on failure.
+static bool _bulb_obj_write_session(struct mt_socket* sock, struct bulb_obj* obj)
+{
+    if (obj->size > MUX_MAX_PAYLOAD)
+        return false;
+    mtx_lock(&sock->write_lock);
+    if (sock->closed)
+    {
+        mtx_unlock(&sock->write_lock);
+        return false;
+    }
+
+    // Timeouts are still assessed per session, as the session's peer acknowledges each
+    // object itself.
+    if (obj->type != BULB_RECEIVED)
+    {
+        struct mt_socket_timeout_node* timeout = (struct mt_socket_timeout_node*)pool_alloc(
+            sizeof(struct mt_socket_timeout_node), BULB_ALLOC_NETWORKING);
+        timespec_get(&timeout->send_timestamp, TIME_UTC);
+        QUEUE_ENQUEUE(timeout, sock->data_send_timeout_queue, sock->data_send_timeout_tail);
+    }
+    mtx_unlock(&sock->write_lock);
+    return mux_obj_write(sock->carrier, sock->session, MUX_DATA, obj, obj->size);
+}
+
 // Send a Bulb object of an arbitrary type to a socket stream. Returns false on failure.
 bool bulb_obj_write(struct mt_socket* sock, struct bulb_obj* obj)
 {
+    // The socket may have been de-allocated if its client disconnected during a
+    // LOOP_CLIENTS() iteration.
+    if (sock == NULL)
+        return false;
+    if (sock->carrier != NULL)
+        return _bulb_obj_write_session(sock, obj);
     mtx_lock(&sock->write_lock);
+    if (sock->closed)
+    {
+        mtx_unlock(&sock->write_lock);
+        return false;
+    }
 
-    // Create a new mt_socket_data_node object and link it to the socket's data
-    // send queue.
-    struct mt_socket_data_node* node = (struct mt_socket_data_node*)quick_malloc(
-        sizeof(struct mt_socket_data_node) + obj->size);
+#ifdef SERVER
+    // Objects that a congested client can do without are not queued.
+    if (_bulb_obj_backpressure(sock, obj))
+    {
+        mtx_unlock(&sock->write_lock);
+        return true;
+    }
+#endif
+
+    // Create a new mt_socket_data_node object and link it to its lane of the socket's 
+    // data send queue.
+    struct mt_socket_data_node* node = (struct mt_socket_data_node*)pool_alloc(
+        sizeof(struct mt_socket_data_node) + obj->size, BULB_ALLOC_NETWORKING);
     memcpy(node->data, (const char*)obj, obj->size);
     node->len = obj->size;
-    QUEUE_ENQUEUE(node, sock->data_send_queue, sock->data_send_tail);
+    node->send_offset = 0;
+    node->lane = _bulb_obj_lane(obj);
+    mt_socket_enqueue_send(sock, node);
+    bulb_obj_account_send_queue(sock, node->len, 1);
+#ifdef SERVER
+    _bulb_obj_spill(sock, node);
+#endif
 
     // Additionally, except for received_obj, queue a timestamp node to assess
-    // potential timeouts.
-    if (obj->type != BULB_RECEIVED)
+    // potential timeouts. The objects carried by mux_obj are acknowledged by each
+    // session instead.
+    if (obj->type != BULB_RECEIVED && obj->type != BULB_MUX)
     {
-        struct mt_socket_timeout_node* timeout = (struct mt_socket_timeout_node*)quick_malloc(
-            sizeof(struct mt_socket_timeout_node));
+        struct mt_socket_timeout_node* timeout = (struct mt_socket_timeout_node*)pool_alloc(
+            sizeof(struct mt_socket_timeout_node), BULB_ALLOC_NETWORKING);
         timespec_get(&timeout->send_timestamp, TIME_UTC);
         QUEUE_ENQUEUE(timeout, sock->data_send_timeout_queue, sock->data_send_timeout_tail);
     }
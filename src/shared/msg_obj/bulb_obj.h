@@ -10,6 +10,7 @@
 
 #include "unisock.h"
 #include "networking.h"
+#include "pool.h"
 
 #define RECV_BUFFER_SIZE    512
 
@@ -24,7 +25,15 @@ enum bulb_obj_type
     BULB_MESSAGE,
     BULB_PING,
     BULB_UPDATE_USERINFO,
-    BULB_RECEIVED
+    BULB_RECEIVED,
+    BULB_STREAM_OPEN,
+    BULB_STREAM_CHUNK,
+    BULB_STREAM_ACK,
+    BULB_STREAM_CLOSE,
+    BULB_ROOM,
+    BULB_DIRECT,
+    BULB_LINK,
+    BULB_MUX
 };
 
 struct bulb_obj
@@ -37,5 +46,9 @@ struct bulb_obj
 // requirements. Returns NULL on failure.
 struct bulb_obj* bulb_obj_template_recv(struct mt_socket* sock, struct bulb_obj* header, size_t size);
 
+// Account for data being added to or removed from a socket's send queue, updating
+// whether the send queue is congested. The socket's write lock must be held.
+void bulb_obj_account_send_queue(struct mt_socket* sock, long long bytes, int objects);
+
 // Send a Bulb object of an arbitrary type to a socket stream. Returns false on failure.
 bool bulb_obj_write(struct mt_socket* sock, struct bulb_obj* obj);
\ No newline at end of file
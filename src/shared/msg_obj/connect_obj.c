@@ -47,14 +47,15 @@ void connect_obj_process(struct connect_obj* obj, struct server_node* server, st
         goto finish;
     }
 
-    node = quick_malloc(sizeof(struct client_node));
+    node = quick_malloc(sizeof(struct client_node), BULB_ALLOC_ROSTER);
     node->status = CLIENT_VALIDATED;
     node->server_node = server;
-    node->userinfo = quick_malloc(sizeof(struct userinfo_obj));
+    node->userinfo = pool_alloc(sizeof(struct userinfo_obj), BULB_ALLOC_ROSTER);
     memcpy(node->userinfo, &obj->userinfo, sizeof(struct userinfo_obj));
 
 finish:
-    server_connect_client(server, node);
+    ASSERT(server_connect_client(server, node), if (node != client) client_shared_node_free(node), 
+        "Server sent duplicate client \"%s\"\n", node->userinfo->info.name);
 #endif
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for sending a message to a single client, through the server.
+// The server routes the message to its recipient with a single lookup by name, then
+// sends the object back to its sender with the outcome in status.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "bulb_structs.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "userinfo_obj.h"
+#include "direct_obj.h"
+
+#ifdef CLIENT
+#   include "bulb_client.h"
+#else
+#   include "flood_control.h"
+#   include "links.h"
+#endif
+
+// Read a direct_obj object. Returns NULL on failure.
+struct bulb_obj* direct_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    struct direct_obj* obj = (struct direct_obj*)bulb_obj_template_recv(sock, header, size);
+    if (obj == NULL)
+        return NULL;
+    obj->name[MAX_NAME_LENGTH] = '\0';
+    obj->message[MAX_MESSAGE_LENGTH] = '\0';
+    return (struct bulb_obj*)obj;
+}
+
+// Write a direct_obj object. Returns false on failure.
+bool direct_obj_write(struct mt_socket* sock, uint32_t id, uint8_t status, const char* name, const char* msg)
+{
+    struct direct_obj obj = { .base.type = BULB_DIRECT,
+                              .base.size = sizeof(struct direct_obj),
+                              .id = id,
+                              .status = status };
+    strncpy(obj.name, name, MAX_NAME_LENGTH);
+    strncpy(obj.message, msg, MAX_MESSAGE_LENGTH);
+    return bulb_obj_write(sock, (struct bulb_obj*)&obj);
+}
+
+// Process a direct_obj object.
+void direct_obj_process(struct direct_obj* obj, struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    // Verify the client's message before processing it.
+    if (obj->status != DIRECT_STATUS_MESSAGE)
+    {
+        server_kick(server, client, "Attempted to send the outcome of a direct message.");
+        goto finish;
+    }
+    if (!str_isprint(obj->message))
+    {
+        server_kick(server, client, "Message communication must utilise displayable characters!");
+        goto finish;
+    }
+
+    // Direct messages draw from the same flood control limits as other messages.
+    uint8_t status = BULB_DIRECT_THROTTLED;
+    switch (flood_control_admit_direct(server, client, obj->message))
+    {
+        case FLOOD_KICKED:
+            goto finish;
+        case FLOOD_ADMITTED:
+        {
+            // The message is forwarded under the name the server knows its sender by.
+            struct client_node* recipient = server_find_by_name(server, obj->name);
+            if (recipient == NULL || recipient->status != CLIENT_VALIDATED)
+            {
+                status = BULB_DIRECT_NOT_FOUND;
+                break;
+            }
+
+            // Recipients connected to other servers are reached through their link, and
+            // are reported as delivered once the message has been routed.
+            if (CLIENT_IS_REMOTE(recipient))
+                links_direct(server, client, recipient, obj->message);
+            else
+            {
+                direct_obj_write(recipient->mt_sock, obj->id, DIRECT_STATUS_MESSAGE,
+                    client->userinfo->info.name, obj->message);
+            }
+            status = BULB_DIRECT_DELIVERED;
+            break;
+        }
+        default:
+            break;
+    }
+    direct_obj_write(client->mt_sock, obj->id, status, obj->name, "");
+
+finish:
+#else
+    if (obj->status == DIRECT_STATUS_MESSAGE)
+    {
+        struct bulb_message msg_exception_obj = { .name = obj->name, .message = obj->message };
+        client_throw_exception(client->bulb_client, CLIENT_RECEIVED_DIRECT, (void*)&msg_exception_obj);
+    }
+    else
+    {
+        struct bulb_direct_result result = { .name = obj->name,
+                                             .id = obj->id,
+                                             .status = (enum bulb_direct_status)obj->status };
+        client_throw_exception(client->bulb_client, CLIENT_DIRECT_RESULT, (void*)&result);
+    }
+#endif
+    pool_free(obj);
+}
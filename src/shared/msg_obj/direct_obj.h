@@ -0,0 +1,44 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for sending a message to a single client, through the server.
+// The server routes the message to its recipient with a single lookup by name, then
+// sends the object back to its sender with the outcome in status.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "bulb_obj.h"
+
+// The status of a direct_obj that carries a message, rather than the outcome of one.
+// Any other status is an enum bulb_direct_status.
+#define DIRECT_STATUS_MESSAGE   0
+
+struct direct_obj
+{
+    struct bulb_obj base;
+    uint32_t id;
+    uint8_t status;
+
+    // The recipient when sent by a client, the sender when routed by the server, and the
+    // recipient again when reporting the outcome.
+    char name[MAX_NAME_LENGTH + 1];
+    char message[MAX_MESSAGE_LENGTH + 1];
+};
+
+// Read a direct_obj object. Returns NULL on failure.
+struct bulb_obj* direct_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Write a direct_obj object. Returns false on failure.
+bool direct_obj_write(struct mt_socket* sock, uint32_t id, uint8_t status, const char* name, const char* msg);
+
+// Process a direct_obj object.
+void direct_obj_process(struct direct_obj* obj, struct server_node* server, struct client_node* client);
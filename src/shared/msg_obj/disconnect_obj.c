@@ -53,5 +53,5 @@ void disconnect_obj_process(struct disconnect_obj* obj,
     }
 #endif
 not_found:
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
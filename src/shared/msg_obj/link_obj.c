@@ -0,0 +1,84 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for exchanging a batch of network events between linked servers,
+// such as clients joining, leaving or sending messages. It is only ever sent between
+// servers. See links.h.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "link_obj.h"
+
+#ifdef SERVER
+#   include "links.h"
+#endif
+
+// Read a link_obj object. Returns NULL on failure.
+struct bulb_obj* link_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    // Batches vary in length, but never exceed LINK_BATCH_BYTES bytes of events.
+    if (size <= sizeof(struct link_obj) || size > sizeof(struct link_obj) + LINK_BATCH_BYTES)
+        return NULL;
+    return bulb_obj_template_recv(sock, header, size);
+}
+
+// Write a link_obj object. Returns false on failure.
+bool link_obj_write(struct mt_socket* sock, const char* events, size_t len)
+{
+    size_t size = sizeof(struct link_obj) + len;
+    struct link_obj* obj = pool_alloc(size, BULB_ALLOC_OBJECTS);
+    obj->base.type = BULB_LINK;
+    obj->base.size = size;
+    memcpy(obj->events, events, len);
+    bool result = bulb_obj_write(sock, (struct bulb_obj*)obj);
+    pool_free(obj);
+    return result;
+}
+
+// Process a link_obj object.
+void link_obj_process(struct link_obj* obj, struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    if (client->link == NULL || client->status != CLIENT_VALIDATED)
+    {
+        server_kick(server, client, "Only linked servers may send network events.");
+        goto finish;
+    }
+
+    // Each event is validated before being applied, as the batch may have been sent by
+    // a faulty server.
+    size_t len = obj->base.size - sizeof(struct link_obj);
+    for (size_t offset = 0; offset < len;)
+    {
+        struct link_event* event = (struct link_event*)(obj->events + offset);
+        size_t text_offset = offsetof(struct link_event, text);
+        if (len - offset <= text_offset || event->size <= text_offset || event->size > len - offset
+            || event->size % LINK_EVENT_ALIGN != 0)
+        {
+            server_kick(server, client, "Sent a malformed network event.");
+            goto finish;
+        }
+        event->origin[MAX_NAME_LENGTH] = '\0';
+        event->name[MAX_NAME_LENGTH] = '\0';
+        event->room[MAX_ROOM_NAME_LENGTH] = '\0';
+        event->recipient[MAX_NAME_LENGTH] = '\0';
+        event->text[event->size - text_offset - 1] = '\0';
+        offset += event->size;
+
+        if (!links_receive(server, client->link, event))
+        {
+            server_kick(server, client, "Sent an invalid network event.");
+            goto finish;
+        }
+    }
+
+finish:
+#endif
+    pool_free(obj);
+}
@@ -0,0 +1,69 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for exchanging a batch of network events between linked servers,
+// such as clients joining, leaving or sending messages. It is only ever sent between
+// servers. See links.h.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "bulb_obj.h"
+
+// Most bytes of events carried by a single link_obj.
+#define LINK_BATCH_BYTES    16384
+
+// Events are padded to this alignment within a batch.
+#define LINK_EVENT_ALIGN    8
+
+enum link_event_type
+{
+    LINK_EVENT_JOIN = 1,        // A client joined the network, text is its description.
+    LINK_EVENT_PART,            // A client left the network.
+    LINK_EVENT_MOVE,            // A client moved into another room.
+    LINK_EVENT_MESSAGE,         // A client sent a message to its room, text is the message.
+    LINK_EVENT_DIRECT,          // A client sent a message to recipient, text is the message.
+    LINK_EVENT_BROADCAST        // A server broadcast a message to every client, name is the server.
+};
+
+struct link_event
+{
+    uint8_t type;
+    uint8_t hops;                       // Links crossed so far.
+    uint16_t size;                      // Size of the event including its text and padding.
+
+    // The server that raised the event, the instance of that server, and the event's
+    // position in the sequence of events that server has raised. These are used for
+    // discarding events that have already been seen.
+    uint32_t seq;
+    uint64_t instance;
+    char origin[MAX_NAME_LENGTH + 1];
+
+    char name[MAX_NAME_LENGTH + 1];         // The client or server that the event concerns.
+    char room[MAX_ROOM_NAME_LENGTH + 1];    // Its room, for LINK_EVENT_JOIN and LINK_EVENT_MOVE.
+    char recipient[MAX_NAME_LENGTH + 1];    // The recipient, for LINK_EVENT_DIRECT.
+    char text[];
+};
+
+struct link_obj
+{
+    struct bulb_obj base;
+    char events[];  // The size of the object determines the length of the events.
+};
+
+// Read a link_obj object. Returns NULL on failure.
+struct bulb_obj* link_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Write a link_obj object. Returns false on failure.
+bool link_obj_write(struct mt_socket* sock, const char* events, size_t len);
+
+// Process a link_obj object.
+void link_obj_process(struct link_obj* obj, struct server_node* server, struct client_node* client);
@@ -14,11 +14,14 @@
 #include "client_node.h"
 #include "userinfo_obj.h"
 #include "message_obj.h"
+#include "rooms.h"
 
 #ifdef CLIENT
 #   include "bulb_client.h"
 #else
 #   include "bulb_server.h"
+#   include "links.h"
+#   include "history.h"
 #endif
 
 // Read a message_obj object. Returns NULL on failure.
@@ -56,12 +59,14 @@ void message_obj_process(struct message_obj* obj, struct server_node* server, st
     server_throw_exception(server->bulb_server, SERVER_RECEIVED_MESSAGE, (void*)&msg_exception_obj);
 
     // On the server, after printing the sender's username and their message, the message
-    // object should be forwarded to all other clients. Even though the object will contain 
-    // a copy of the sending client's name, the name stored in the client parameter's
-    // userinfo object instead should be used in case a fraudulent username is passed
-    // in the message object by the client.
-    LOOP_CLIENTS(server, client, node, message_obj_write(node->mt_sock, client->userinfo->info.name, 
+    // object should be forwarded to the other members of the sender's room. Even though 
+    // the object will contain a copy of the sending client's name, the name stored in the 
+    // client parameter's userinfo object instead should be used in case a fraudulent 
+    // username is passed in the message object by the client.
+    LOOP_ROOM(client->room, client, node, message_obj_write(node->mt_sock, client->userinfo->info.name, 
         obj->message, false));
+    links_message(server, client, obj->message);
+    history_message(server, client, client->room->name, client->userinfo->info.name, obj->message, false);
 #else
     struct bulb_message msg_exception_obj;
     msg_exception_obj.name = obj->name;
@@ -71,5 +76,5 @@ void message_obj_process(struct message_obj* obj, struct server_node* server, st
 #endif
 
 finish:
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for carrying many client sessions over a single connection, which
+// is opened to a server by a bulb_mux proxy. Each session is identified by an ID chosen
+// by the proxy, and carries the objects of one client in either direction. See mux.h.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "mux_obj.h"
+
+#ifdef SERVER
+#   include "mux.h"
+#endif
+
+// Read a mux_obj object. Returns NULL on failure.
+struct bulb_obj* mux_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    if (size < sizeof(struct mux_obj) || size > sizeof(struct mux_obj) + MUX_MAX_PAYLOAD)
+        return NULL;
+    return bulb_obj_template_recv(sock, header, size);
+}
+
+// Write a mux_obj object. Returns false on failure.
+bool mux_obj_write(struct mt_socket* sock, uint32_t session, enum mux_op op, const void* payload, size_t len)
+{
+    size_t size = sizeof(struct mux_obj) + len;
+    struct mux_obj* obj = pool_alloc(size, BULB_ALLOC_OBJECTS);
+    obj->base.type = BULB_MUX;
+    obj->base.size = size;
+    obj->session = session;
+    obj->op = op;
+    memcpy(obj->payload, payload, len);
+    bool result = bulb_obj_write(sock, (struct bulb_obj*)obj);
+    pool_free(obj);
+    return result;
+}
+
+// Process a mux_obj object.
+void mux_obj_process(struct mux_obj* obj, struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    mux_receive(server, client, obj);
+#endif
+    pool_free(obj);
+}
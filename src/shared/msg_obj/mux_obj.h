@@ -0,0 +1,51 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for carrying many client sessions over a single connection, which
+// is opened to a server by a bulb_mux proxy. Each session is identified by an ID chosen
+// by the proxy, and carries the objects of one client in either direction. See mux.h.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "bulb_obj.h"
+
+// Largest object that can be carried for a session.
+#define MUX_MAX_PAYLOAD     (16 * 1024)
+
+// Session IDs are below this, so at most this many sessions share a connection.
+#define MUX_MAX_SESSIONS    65536
+
+enum mux_op
+{
+    MUX_HELLO = 1,      // Authenticates a proxy with the payload as its key, and is echoed on success.
+    MUX_OPEN,           // Opens a session for a client, with the payload as its address.
+    MUX_DATA,           // Carries a single object of a session.
+    MUX_CLOSE           // Closes a session. The server always sends this once a session has ended,
+                        // after which the proxy may reuse the session's ID.
+};
+
+struct mux_obj
+{
+    struct bulb_obj base;
+    uint32_t session;
+    uint32_t op;
+    char payload[];     // The size of the object determines the length of the payload.
+};
+
+// Read a mux_obj object. Returns NULL on failure.
+struct bulb_obj* mux_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Write a mux_obj object. Returns false on failure.
+bool mux_obj_write(struct mt_socket* sock, uint32_t session, enum mux_op op, const void* payload, size_t len);
+
+// Process a mux_obj object.
+void mux_obj_process(struct mux_obj* obj, struct server_node* server, struct client_node* client);
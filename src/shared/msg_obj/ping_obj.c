@@ -13,6 +13,7 @@
 #include "ping_obj.h"
 #include "userinfo_obj.h"
 #include "update_userinfo_obj.h"
+#include "rooms.h"
 
 // Read a ping_obj object. Returns NULL on failure.
 struct bulb_obj* ping_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
@@ -26,6 +27,8 @@ bool ping_obj_write(struct mt_socket* sock, bool final_destination)
     struct ping_obj obj = { .base.type = BULB_PING,
                             .base.size = sizeof(struct ping_obj),
                             .final_destination = final_destination };
+    if (sock == NULL)
+        return false;
     if (!final_destination)
         timespec_ns_get(&sock->ping_start);
 
@@ -41,13 +44,18 @@ void ping_obj_process(struct ping_obj* obj, struct server_node* server, struct c
         client->userinfo->info.ping_ms = timespec_diff(&client->mt_sock->ping_end, 
             &client->mt_sock->ping_start, 3);
         client->ready_to_ping = true;
-        LOOP_CLIENTS(server, NULL, node, 
+
+        // Pings are only ever initiated by the server, and only reported to the members
+        // of the client's room.
+#ifdef SERVER
+        LOOP_ROOM(client->room, NULL, node, 
         {
             update_userinfo_obj_write(node->mt_sock, &client->userinfo->info, 
                 client->userinfo->info.name);
         });
+#endif
     }
     else
         ping_obj_write(client->mt_sock, true);
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
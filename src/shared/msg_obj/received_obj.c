@@ -34,8 +34,12 @@ bool received_obj_write(struct mt_socket* sock)
 // Process a received_obj object.
 void received_obj_process(struct received_obj* obj, struct server_node* server, struct client_node* client)
 {
-    if (QUEUE_EMPTY(client->mt_sock))
+    // The timeout nodes queue is shared with any thread writing to this socket.
+    mtx_lock(&client->mt_sock->write_lock);
+    if (QUEUE_EMPTY(client->mt_sock->data_send_timeout_queue))
     {
+        mtx_unlock(&client->mt_sock->write_lock);
+        pool_free(obj);
 #ifdef SERVER
         server_kick(client->server_node, client,
             "Client attempted to dequeue from empty timeout nodes queue");
@@ -48,7 +52,8 @@ void received_obj_process(struct received_obj* obj, struct server_node* server,
     struct mt_socket_timeout_node* node;
     QUEUE_DEQUEUE(node, client->mt_sock->data_send_timeout_queue,
         client->mt_sock->data_send_timeout_tail);
-    free(node);
+    mtx_unlock(&client->mt_sock->write_lock);
+    pool_free(node);
 
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
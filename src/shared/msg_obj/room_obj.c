@@ -0,0 +1,60 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for moving a client between rooms. Clients send it with the name
+// of the room to join, or an empty name to return to the lobby. The server sends it
+// back with the name of the room that the client is now in. See rooms.h.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "stdout_obj.h"
+#include "room_obj.h"
+#include "rooms.h"
+
+#ifdef CLIENT
+#   include "bulb_client.h"
+#else
+#   include "links.h"
+#endif
+
+// Read a room_obj object. Returns NULL on failure.
+struct bulb_obj* room_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    struct room_obj* obj = (struct room_obj*)bulb_obj_template_recv(sock, header, size);
+    if (obj == NULL)
+        return NULL;
+    obj->name[MAX_ROOM_NAME_LENGTH] = '\0';
+    return (struct bulb_obj*)obj;
+}
+
+// Write a room_obj object. Returns false on failure.
+bool room_obj_write(struct mt_socket* sock, const char* name)
+{
+    struct room_obj obj = { .base.type = BULB_ROOM,
+                            .base.size = sizeof(struct room_obj) };
+    strncpy(obj.name, name, MAX_ROOM_NAME_LENGTH);
+    return bulb_obj_write(sock, (struct bulb_obj*)&obj);
+}
+
+// Process a room_obj object.
+void room_obj_process(struct room_obj* obj, struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    if (obj->name[0] != '\0' && !room_name_valid(obj->name))
+        server_kick(server, client, "Room names must be a single word of displayable characters!");
+    else if (!room_move(server, client, obj->name))
+        stdout_obj_write(client->mt_sock, "You are already in that room.\n", STDOUT_GENERIC);
+    else
+        links_client_moved(server, client);
+#else
+    strcpy(server->room, obj->name);
+    client_throw_exception(client->bulb_client, CLIENT_ROOM_CHANGED, server->room);
+#endif
+    pool_free(obj);
+}
@@ -0,0 +1,33 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// This object is used for moving a client between rooms. Clients send it with the name
+// of the room to join, or an empty name to return to the lobby. The server sends it
+// back with the name of the room that the client is now in. See rooms.h.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "bulb_obj.h"
+
+struct room_obj
+{
+    struct bulb_obj base;
+    char name[MAX_ROOM_NAME_LENGTH + 1];
+};
+
+// Read a room_obj object. Returns NULL on failure.
+struct bulb_obj* room_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Write a room_obj object. Returns false on failure.
+bool room_obj_write(struct mt_socket* sock, const char* name);
+
+// Process a room_obj object.
+void room_obj_process(struct room_obj* obj, struct server_node* server, struct client_node* client);
@@ -30,7 +30,7 @@ bool stdout_obj_write(struct mt_socket* sock, const char* msg, enum stdout_type
     // The size of the object is the size of the base structure + the length of the message
     // + 1 for the NUL character at the end.
     size_t size = sizeof(struct stdout_obj) + strlen(msg) + 1;
-    struct stdout_obj* obj = quick_malloc(size);
+    struct stdout_obj* obj = pool_alloc(size, BULB_ALLOC_OBJECTS);
     obj->base.type = BULB_STDOUT;
     obj->base.size = size;
     obj->type = type;
@@ -38,13 +38,29 @@ bool stdout_obj_write(struct mt_socket* sock, const char* msg, enum stdout_type
 
     if (bulb_obj_write(sock, (struct bulb_obj*)obj) == false)
     {
-        free(obj);
+        pool_free(obj);
         return false;
     }
-    free(obj);
+    pool_free(obj);
     return true;
 }
 
+// Send a stdout_obj object directly to a raw socket that has no mt_socket object.
+// Returns false on failure, or if the socket is non-blocking and not writable.
+bool stdout_obj_send_raw(SOCKET sock, const char* msg, enum stdout_type type)
+{
+    size_t size = sizeof(struct stdout_obj) + strlen(msg) + 1;
+    struct stdout_obj* obj = pool_alloc(size, BULB_ALLOC_OBJECTS);
+    obj->base.type = BULB_STDOUT;
+    obj->base.size = size;
+    obj->type = type;
+    strcpy(obj->buffer, msg);
+
+    bool result = (send(sock, (const char*)obj, (int)size, MSG_NOSIGNAL) == (int)size);
+    pool_free(obj);
+    return result;
+}
+
 // Process a stdout_obj object.
 void stdout_obj_process(struct stdout_obj* obj, struct server_node* server, struct client_node* client)
 {
@@ -57,10 +73,12 @@ void stdout_obj_process(struct stdout_obj* obj, struct server_node* server, stru
     if (obj->type >= STDOUT_KICK_MSG)
         client->exit_is_orderly = true;
 #else
-    // Throw an assert as this should've been caught when the object was received.
-    ASSERT(false, return, "stdout_obj found in processing queue from client thread!\n");
+    // Only linked servers may send this object to the server, to report why they closed
+    // the link. Otherwise, this should've been caught when the object was received.
+    ASSERT(client->link != NULL, goto finish, "stdout_obj found in processing queue from client thread!\n");
+    bulb_printf(server, "Linked server at %s: %s", client->ip_addr, obj->buffer);
 #endif
 
 finish:
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
@@ -28,5 +28,9 @@ struct bulb_obj* stdout_obj_read(struct mt_socket* sock, struct bulb_obj* header
 // Write a stdout_obj object. Returns false on failure.
 bool stdout_obj_write(struct mt_socket* sock, const char* msg, enum stdout_type type);
 
+// Send a stdout_obj object directly to a raw socket that has no mt_socket object.
+// Returns false on failure, or if the socket is non-blocking and not writable.
+bool stdout_obj_send_raw(SOCKET sock, const char* msg, enum stdout_type type);
+
 // Process a stdout_obj object.
 void stdout_obj_process(struct stdout_obj* obj, struct server_node* server, struct client_node* client);
\ No newline at end of file
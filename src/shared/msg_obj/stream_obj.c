@@ -0,0 +1,506 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// These objects are used for streaming payloads of any size from a client to every
+// other member of its room, through the server. See stream_obj.h for the flow control scheme.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "alloc.h"
+#include "bulb_structs.h"
+#include "shared_interface.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "userinfo_obj.h"
+#include "stream_obj.h"
+#include "rooms.h"
+
+#ifdef CLIENT
+#   include "bulb_client.h"
+#else
+#   include "bulb_server.h"
+#endif
+
+// Find an open stream sent by a client. Returns NULL if not found.
+static struct client_stream* _stream_find(struct client_node* client, uint32_t id)
+{
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        if (client->streams[i].open && client->streams[i].id == id)
+            return &client->streams[i];
+    }
+    return NULL;
+}
+
+// Claim an unused stream slot of a client. Returns NULL if the client already has
+// CLIENT_MAX_STREAMS streams open.
+static struct client_stream* _stream_claim(struct client_node* client, uint32_t id)
+{
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        struct client_stream* stream = &client->streams[i];
+        if (stream->open)
+            continue;
+        memset(stream, 0, sizeof(struct client_stream));
+        stream->id = id;
+        stream->open = true;
+        return stream;
+    }
+    return NULL;
+}
+
+#ifdef SERVER
+// Check if a recipient of a stream is still connected and has not left the room since,
+// marking it inactive otherwise.
+static bool _stream_recipient_active(struct server_node* server, struct stream_recipient* recipient)
+{
+    if (recipient->active && (server_find_by_name(server, recipient->name) != recipient->node 
+            || recipient->node->room_moves != recipient->room_moves))
+        recipient->active = false;
+    return recipient->active;
+}
+
+// Grant the sender of a stream credit for STREAM_WINDOW_CHUNKS chunks more than its
+// slowest recipient has acknowledged.
+static void _stream_grant(struct server_node* server, struct client_node* client, struct client_stream* stream)
+{
+    uint32_t acked = stream->chunks;
+    for (unsigned i = 0; i < stream->recipient_count; i++)
+    {
+        if (_stream_recipient_active(server, &stream->recipients[i]))
+            acked = MIN(acked, stream->recipients[i].acked);
+    }
+    if (acked + STREAM_WINDOW_CHUNKS <= stream->granted)
+        return;
+
+    uint32_t credits = acked + STREAM_WINDOW_CHUNKS - stream->granted;
+    stream->granted += credits;
+    stream_ack_obj_write(client->mt_sock, stream->id, "", credits);
+}
+
+// Close a stream for each of its recipients and release it.
+static void _stream_relay_close(struct server_node* server, struct client_node* client,
+                                struct client_stream* stream, bool aborted)
+{
+    for (unsigned i = 0; i < stream->recipient_count; i++)
+    {
+        struct stream_recipient* recipient = &stream->recipients[i];
+        if (_stream_recipient_active(server, recipient))
+            stream_close_obj_write(recipient->node->mt_sock, stream->id, client->userinfo->info.name, aborted);
+    }
+    quick_free(stream->recipients);
+    memset(stream, 0, sizeof(struct client_stream));
+}
+#else
+// Notify the client application of an event of a stream being received.
+static void _stream_notify(struct client_node* sender, struct client_stream* stream,
+                           enum client_error_state error, const char* data, size_t len, bool aborted)
+{
+    struct bulb_stream event = { .name = sender->userinfo->info.name,
+                                 .title = stream->title,
+                                 .size = stream->size,
+                                 .transferred = stream->transferred,
+                                 .data = data,
+                                 .len = len,
+                                 .aborted = aborted };
+    client_throw_exception(localclient->bulb_client, error, &event);
+}
+
+// End a stream being sent by the local client and release it.
+static void _stream_finish(struct client_stream* stream, bool aborted)
+{
+    if (stream->source.close_func != NULL)
+        stream->source.close_func(stream->source.ctx, aborted);
+    memset(stream, 0, sizeof(struct client_stream));
+}
+
+// Send as much of a stream's payload as its credit allows, closing the stream once
+// its source is exhausted. Each chunk is read directly into the object being sent.
+static void _stream_pump(struct client_node* client, struct client_stream* stream)
+{
+    if (stream->chunks >= stream->granted)
+        return;
+
+    struct stream_chunk_obj* chunk = pool_alloc(sizeof(struct stream_chunk_obj) + STREAM_CHUNK_SIZE,
+        BULB_ALLOC_OBJECTS);
+    memset(chunk, 0, sizeof(struct stream_chunk_obj));
+    chunk->base.type = BULB_STREAM_CHUNK;
+    chunk->id = stream->id;
+    while (stream->chunks < stream->granted)
+    {
+        long read = stream->source.read_func(stream->source.ctx, chunk->data, STREAM_CHUNK_SIZE);
+        if (read <= 0)
+        {
+            stream_close_obj_write(client->mt_sock, stream->id, "", read < 0);
+            _stream_finish(stream, read < 0);
+            break;
+        }
+
+        read = MIN(read, STREAM_CHUNK_SIZE);
+        chunk->base.size = sizeof(struct stream_chunk_obj) + read;
+        bulb_obj_write(client->mt_sock, (struct bulb_obj*)chunk);
+        stream->chunks++;
+        stream->transferred += read;
+    }
+    pool_free(chunk);
+}
+#endif
+
+// Read a stream_open_obj object. Returns NULL on failure.
+struct bulb_obj* stream_open_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    struct stream_open_obj* obj = (struct stream_open_obj*)bulb_obj_template_recv(sock, header, size);
+    if (obj == NULL)
+        return NULL;
+    obj->name[MAX_NAME_LENGTH] = '\0';
+    obj->title[MAX_STREAM_TITLE_LENGTH] = '\0';
+    return (struct bulb_obj*)obj;
+}
+
+// Read a stream_chunk_obj object. Returns NULL on failure.
+struct bulb_obj* stream_chunk_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    // Chunks vary in length, but never exceed STREAM_CHUNK_SIZE bytes of data.
+    if (size <= sizeof(struct stream_chunk_obj) || size > sizeof(struct stream_chunk_obj) + STREAM_CHUNK_SIZE)
+        return NULL;
+    struct stream_chunk_obj* obj = (struct stream_chunk_obj*)bulb_obj_template_recv(sock, header, size);
+    if (obj == NULL)
+        return NULL;
+    obj->name[MAX_NAME_LENGTH] = '\0';
+    return (struct bulb_obj*)obj;
+}
+
+// Read a stream_ack_obj object. Returns NULL on failure.
+struct bulb_obj* stream_ack_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    struct stream_ack_obj* obj = (struct stream_ack_obj*)bulb_obj_template_recv(sock, header, size);
+    if (obj == NULL)
+        return NULL;
+    obj->name[MAX_NAME_LENGTH] = '\0';
+    return (struct bulb_obj*)obj;
+}
+
+// Read a stream_close_obj object. Returns NULL on failure.
+struct bulb_obj* stream_close_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size)
+{
+    struct stream_close_obj* obj = (struct stream_close_obj*)bulb_obj_template_recv(sock, header, size);
+    if (obj == NULL)
+        return NULL;
+    obj->name[MAX_NAME_LENGTH] = '\0';
+    return (struct bulb_obj*)obj;
+}
+
+// Write a stream_open_obj object. Returns false on failure.
+bool stream_open_obj_write(struct mt_socket* sock, uint32_t id, const char* name, const char* title,
+                           uint64_t size)
+{
+    struct stream_open_obj obj = { .base.type = BULB_STREAM_OPEN,
+                                   .base.size = sizeof(struct stream_open_obj),
+                                   .id = id,
+                                   .size = size };
+    strncpy(obj.name, name, MAX_NAME_LENGTH);
+    strncpy(obj.title, title, MAX_STREAM_TITLE_LENGTH);
+    return bulb_obj_write(sock, (struct bulb_obj*)&obj);
+}
+
+// Write a stream_chunk_obj object. Returns false on failure.
+bool stream_chunk_obj_write(struct mt_socket* sock, uint32_t id, const char* name, const char* data,
+                            size_t len)
+{
+    ASSERT(len > 0 && len <= STREAM_CHUNK_SIZE, return false);
+    size_t size = sizeof(struct stream_chunk_obj) + len;
+    struct stream_chunk_obj* obj = pool_alloc(size, BULB_ALLOC_OBJECTS);
+    memset(obj, 0, sizeof(struct stream_chunk_obj));
+    obj->base.type = BULB_STREAM_CHUNK;
+    obj->base.size = size;
+    obj->id = id;
+    strncpy(obj->name, name, MAX_NAME_LENGTH);
+    memcpy(obj->data, data, len);
+
+    bool result = bulb_obj_write(sock, (struct bulb_obj*)obj);
+    pool_free(obj);
+    return result;
+}
+
+// Write a stream_ack_obj object. Returns false on failure.
+bool stream_ack_obj_write(struct mt_socket* sock, uint32_t id, const char* name, uint32_t credits)
+{
+    struct stream_ack_obj obj = { .base.type = BULB_STREAM_ACK,
+                                  .base.size = sizeof(struct stream_ack_obj),
+                                  .id = id,
+                                  .credits = credits };
+    strncpy(obj.name, name, MAX_NAME_LENGTH);
+    return bulb_obj_write(sock, (struct bulb_obj*)&obj);
+}
+
+// Write a stream_close_obj object. Returns false on failure.
+bool stream_close_obj_write(struct mt_socket* sock, uint32_t id, const char* name, bool aborted)
+{
+    struct stream_close_obj obj = { .base.type = BULB_STREAM_CLOSE,
+                                    .base.size = sizeof(struct stream_close_obj),
+                                    .id = id,
+                                    .aborted = aborted };
+    strncpy(obj.name, name, MAX_NAME_LENGTH);
+    return bulb_obj_write(sock, (struct bulb_obj*)&obj);
+}
+
+// Process a stream_open_obj object.
+void stream_open_obj_process(struct stream_open_obj* obj, struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    if (!str_isprint(obj->title))
+    {
+        server_kick(server, client, "Stream titles must utilise displayable characters!");
+        goto finish;
+    }
+    if (_stream_find(client, obj->id) != NULL)
+    {
+        server_kick(server, client, "Attempted to open a stream that is already open.");
+        goto finish;
+    }
+
+    // Clients with too many streams open have the new stream closed straight away.
+    struct client_stream* stream = _stream_claim(client, obj->id);
+    if (stream == NULL)
+    {
+        stream_close_obj_write(client->mt_sock, obj->id, "", true);
+        goto finish;
+    }
+    bulb_printf(server, "Client \"%s\" is streaming \"%s\" (%llu bytes)\n", client->userinfo->info.name,
+        obj->title, (unsigned long long)obj->size);
+
+    // The stream is relayed to every other member of the sender's room at this point,
+    // which are each then waited on before the sender is granted further credit. Streams
+    // are not relayed to linked servers, so members connected to them are skipped.
+    stream->recipients = quick_calloc(MAX(client->room->count, 1), sizeof(struct stream_recipient),
+        BULB_ALLOC_NETWORKING);
+    LOOP_ROOM(client->room, client, node,
+    {
+        if (CLIENT_IS_REMOTE(node))
+            continue;
+        struct stream_recipient* recipient = &stream->recipients[stream->recipient_count++];
+        recipient->node = node;
+        strcpy(recipient->name, node->userinfo->info.name);
+        recipient->room_moves = node->room_moves;
+        recipient->active = true;
+        stream_open_obj_write(node->mt_sock, obj->id, client->userinfo->info.name, obj->title, obj->size);
+    });
+    _stream_grant(server, client, stream);
+#else
+    struct client_node* sender = server_find_by_name(server, obj->name);
+    if (sender == NULL || sender == client)
+        goto finish;
+    struct client_stream* stream = _stream_claim(sender, obj->id);
+    if (stream == NULL)
+        goto finish;
+    strcpy(stream->title, obj->title);
+    stream->size = obj->size;
+    _stream_notify(sender, stream, CLIENT_STREAM_OPENED, NULL, 0, false);
+#endif
+
+finish:
+    pool_free(obj);
+}
+
+// Process a stream_chunk_obj object.
+void stream_chunk_obj_process(struct stream_chunk_obj* obj, struct server_node* server,
+                              struct client_node* client)
+{
+#ifdef SERVER
+    struct client_stream* stream = _stream_find(client, obj->id);
+    if (stream == NULL)
+    {
+        server_kick(server, client, "Attempted to send data for a stream that is not open.");
+        goto finish;
+    }
+    if (stream->chunks >= stream->granted)
+    {
+        server_kick(server, client, "Attempted to send stream data without credit.");
+        goto finish;
+    }
+    stream->chunks++;
+
+    // Each chunk is relayed as soon as it arrives, under the name the server knows
+    // its sender by.
+    strncpy(obj->name, client->userinfo->info.name, MAX_NAME_LENGTH);
+    for (unsigned i = 0; i < stream->recipient_count; i++)
+    {
+        struct stream_recipient* recipient = &stream->recipients[i];
+        if (_stream_recipient_active(server, recipient))
+            bulb_obj_write(recipient->node->mt_sock, (struct bulb_obj*)obj);
+    }
+    _stream_grant(server, client, stream);
+#else
+    size_t len = obj->base.size - sizeof(struct stream_chunk_obj);
+    struct client_node* sender = server_find_by_name(server, obj->name);
+    struct client_stream* stream = (sender != NULL) ? _stream_find(sender, obj->id) : NULL;
+    if (stream == NULL || sender == client)
+        goto finish;
+    stream->chunks++;
+    stream->transferred += len;
+    _stream_notify(sender, stream, CLIENT_STREAM_DATA, obj->data, len, false);
+
+    // Chunks are acknowledged in batches of half a window, so that the sender is
+    // granted more credit before it runs out.
+    if (++stream->unacked >= STREAM_WINDOW_CHUNKS / 2)
+    {
+        stream_ack_obj_write(client->mt_sock, stream->id, obj->name, stream->unacked);
+        stream->unacked = 0;
+    }
+#endif
+
+finish:
+    pool_free(obj);
+}
+
+// Process a stream_ack_obj object.
+void stream_ack_obj_process(struct stream_ack_obj* obj, struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    // Recipients acknowledge chunks of a stream by the name of its sender.
+    struct client_node* sender = server_find_by_name(server, obj->name);
+    struct client_stream* stream = (sender != NULL) ? _stream_find(sender, obj->id) : NULL;
+    if (stream == NULL)
+        goto finish;
+    for (unsigned i = 0; i < stream->recipient_count; i++)
+    {
+        struct stream_recipient* recipient = &stream->recipients[i];
+        if (recipient->node == client && recipient->active)
+        {
+            recipient->acked = MIN(recipient->acked + obj->credits, stream->chunks);
+            _stream_grant(server, sender, stream);
+            break;
+        }
+    }
+
+finish:
+#else
+    // The server grants credit for streams sent by the local client.
+    struct client_stream* stream = _stream_find(client, obj->id);
+    if (stream != NULL)
+    {
+        stream->granted += obj->credits;
+        _stream_pump(client, stream);
+    }
+#endif
+    pool_free(obj);
+}
+
+// Process a stream_close_obj object.
+void stream_close_obj_process(struct stream_close_obj* obj, struct server_node* server,
+                              struct client_node* client)
+{
+#ifdef SERVER
+    struct client_stream* stream = _stream_find(client, obj->id);
+    if (stream != NULL)
+        _stream_relay_close(server, client, stream, obj->aborted);
+#else
+    // Streams sent by the local client are only closed by the server if refused.
+    if (obj->name[0] == '\0')
+    {
+        struct client_stream* stream = _stream_find(client, obj->id);
+        if (stream != NULL)
+            _stream_finish(stream, true);
+        goto finish;
+    }
+
+    struct client_node* sender = server_find_by_name(server, obj->name);
+    struct client_stream* stream = (sender != NULL) ? _stream_find(sender, obj->id) : NULL;
+    if (stream != NULL && sender != client)
+    {
+        _stream_notify(sender, stream, CLIENT_STREAM_CLOSED, NULL, 0, obj->aborted);
+        memset(stream, 0, sizeof(struct client_stream));
+    }
+
+finish:
+#endif
+    pool_free(obj);
+}
+
+// Open a stream from the local client. The server node's client update lock must be
+// held. Returns false if the stream could not be opened.
+bool stream_obj_open(struct server_node* server, struct client_node* client, const char* title,
+                     uint64_t size, const struct bulb_stream_source* source)
+{
+#ifdef CLIENT
+    if (client->status != CLIENT_VALIDATED || source->read_func == NULL
+        || strlen(title) > MAX_STREAM_TITLE_LENGTH || !str_isprint(title))
+        return false;
+    struct client_stream* stream = _stream_claim(client, client->next_stream_id);
+    if (stream == NULL)
+        return false;
+    if (!stream_open_obj_write(client->mt_sock, stream->id, "", title, size))
+    {
+        memset(stream, 0, sizeof(struct client_stream));
+        return false;
+    }
+
+    // The payload is only read once the server grants credit for it.
+    client->next_stream_id++;
+    strcpy(stream->title, title);
+    stream->size = size;
+    stream->source = *source;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// End every stream sent by a client that is disconnecting. The server node's client
+// update lock must be held.
+void stream_obj_abort_all(struct server_node* server, struct client_node* client)
+{
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        struct client_stream* stream = &client->streams[i];
+        if (!stream->open)
+            continue;
+#ifdef SERVER
+        _stream_relay_close(server, client, stream, true);
+#else
+        if (client == localclient)
+            _stream_finish(stream, true);
+        else
+        {
+            _stream_notify(client, stream, CLIENT_STREAM_CLOSED, NULL, 0, true);
+            memset(stream, 0, sizeof(struct client_stream));
+        }
+#endif
+    }
+}
+
+// Stop waiting on recipients of a client's streams that have since disconnected or
+// left the room, granting the client any credit they were holding back. This should only be called
+// from the server's client management thread.
+void stream_obj_refresh(struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        if (client->streams[i].open)
+            _stream_grant(server, client, &client->streams[i]);
+    }
+#endif
+}
+
+// Free every stream of a client node.
+void stream_obj_free(struct client_node* client)
+{
+    for (int i = 0; i < CLIENT_MAX_STREAMS; i++)
+    {
+        struct client_stream* stream = &client->streams[i];
+        if (!stream->open)
+            continue;
+#ifdef SERVER
+        quick_free(stream->recipients);
+        memset(stream, 0, sizeof(struct client_stream));
+#else
+        _stream_finish(stream, true);
+#endif
+    }
+}
@@ -0,0 +1,136 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// These objects are used for streaming payloads of any size from a client to every
+// other member of its room, through the server. A stream is opened with stream_open_obj, its
+// payload is sent in bounded chunks with stream_chunk_obj, and it is ended with
+// stream_close_obj. Chunks are sent through the bulk lane, so that they interleave
+// with other traffic rather than blocking it.
+//
+// Each stream is flow controlled with credits, counted in chunks. The server grants
+// its sender STREAM_WINDOW_CHUNKS chunks more than its slowest recipient has
+// acknowledged with stream_ack_obj, so the server relays each chunk as it arrives
+// without ever holding a whole payload in memory.
+//
+// Streams are identified by their sender's name and an ID chosen by the sender. The
+// name is left empty in objects exchanged between a sender and the server, as it is
+// implied by the connection.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unisock.h"
+#include "networking.h"
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+#include "bulb_obj.h"
+
+#define STREAM_CHUNK_SIZE       4096
+#define STREAM_WINDOW_CHUNKS    8
+
+#ifdef SERVER
+// A client that a stream is relayed to. The client node is only ever dereferenced once
+// it is found to still be connected, as it may have been freed once it disconnected.
+struct stream_recipient
+{
+    struct client_node* node;
+    char name[MAX_NAME_LENGTH + 1];
+    uint32_t room_moves;
+    uint32_t acked;
+    bool active;
+};
+#endif
+
+struct stream_open_obj
+{
+    struct bulb_obj base;
+    uint32_t id;
+    char name[MAX_NAME_LENGTH + 1];
+    char title[MAX_STREAM_TITLE_LENGTH + 1];
+    uint64_t size;
+};
+
+struct stream_chunk_obj
+{
+    struct bulb_obj base;
+    uint32_t id;
+    char name[MAX_NAME_LENGTH + 1];
+    char data[];    // The size of the object determines the length of the data.
+};
+
+struct stream_ack_obj
+{
+    struct bulb_obj base;
+    uint32_t id;
+    char name[MAX_NAME_LENGTH + 1];
+    uint32_t credits;
+};
+
+struct stream_close_obj
+{
+    struct bulb_obj base;
+    uint32_t id;
+    char name[MAX_NAME_LENGTH + 1];
+    bool aborted;
+};
+
+// Read a stream_open_obj object. Returns NULL on failure.
+struct bulb_obj* stream_open_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Read a stream_chunk_obj object. Returns NULL on failure.
+struct bulb_obj* stream_chunk_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Read a stream_ack_obj object. Returns NULL on failure.
+struct bulb_obj* stream_ack_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Read a stream_close_obj object. Returns NULL on failure.
+struct bulb_obj* stream_close_obj_read(struct mt_socket* sock, struct bulb_obj* header, size_t size);
+
+// Write a stream_open_obj object. Returns false on failure.
+bool stream_open_obj_write(struct mt_socket* sock, uint32_t id, const char* name, const char* title,
+                           uint64_t size);
+
+// Write a stream_chunk_obj object. Returns false on failure.
+bool stream_chunk_obj_write(struct mt_socket* sock, uint32_t id, const char* name, const char* data,
+                            size_t len);
+
+// Write a stream_ack_obj object. Returns false on failure.
+bool stream_ack_obj_write(struct mt_socket* sock, uint32_t id, const char* name, uint32_t credits);
+
+// Write a stream_close_obj object. Returns false on failure.
+bool stream_close_obj_write(struct mt_socket* sock, uint32_t id, const char* name, bool aborted);
+
+// Process a stream_open_obj object.
+void stream_open_obj_process(struct stream_open_obj* obj, struct server_node* server, struct client_node* client);
+
+// Process a stream_chunk_obj object.
+void stream_chunk_obj_process(struct stream_chunk_obj* obj, struct server_node* server,
+                              struct client_node* client);
+
+// Process a stream_ack_obj object.
+void stream_ack_obj_process(struct stream_ack_obj* obj, struct server_node* server, struct client_node* client);
+
+// Process a stream_close_obj object.
+void stream_close_obj_process(struct stream_close_obj* obj, struct server_node* server,
+                              struct client_node* client);
+
+// Open a stream from the local client. The server node's client update lock must be
+// held. Returns false if the stream could not be opened.
+bool stream_obj_open(struct server_node* server, struct client_node* client, const char* title,
+                     uint64_t size, const struct bulb_stream_source* source);
+
+// End every stream sent by a client that is disconnecting. The server node's client
+// update lock must be held.
+void stream_obj_abort_all(struct server_node* server, struct client_node* client);
+
+// Stop waiting on recipients of a client's streams that have since disconnected or
+// left the room, granting the client any credit they were holding back. This should only be called
+// from the server's client management thread.
+void stream_obj_refresh(struct server_node* server, struct client_node* client);
+
+// Free every stream of a client node.
+void stream_obj_free(struct client_node* client);
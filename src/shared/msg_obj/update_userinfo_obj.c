@@ -52,5 +52,5 @@ void update_userinfo_obj_process(struct update_userinfo_obj* obj,
     userinfo->ping_ms = obj->updated_info.ping_ms;
 #endif
 not_found:
-    free(obj);
+    pool_free(obj);
 }
\ No newline at end of file
@@ -18,9 +18,14 @@
 #include "stdout_obj.h"
 #include "userinfo_obj.h"
 #include "connect_obj.h"
+#include "room_obj.h"
+#include "rooms.h"
 
 #ifdef SERVER
 #   include "bulb_server.h"
+#   include "links.h"
+#   include "host.h"
+#   include "history.h"
 #endif
 
 // Read a userinfo_obj object. Returns NULL on failure.
@@ -43,10 +48,29 @@ void userinfo_obj_process(struct userinfo_obj* obj, struct server_node* server,
     if (client->userinfo != NULL)
     {
         server_kick(server, client, "Attempted to re-authenticate by sending duplicate userinfo_obj node");
-        free(obj);
+        pool_free(obj);
         return;
     }
 
+    // Servers linking to this server, and the replies of servers that this server is
+    // linking to, are authenticated separately.
+    if (obj->info.is_server || client->link != NULL)
+    {
+        links_authenticate(server, client, obj);
+        return;
+    }
+
+    // Clients may ask to join another virtual server of the same host, see bulb_host.h.
+    if (obj->info.server_name[0] != '\0')
+    {
+        if (!host_route_client(server, client, &obj->info))
+        {
+            pool_free(obj);
+            return;
+        }
+        server = client->server_node;
+    }
+
     // Reject clients with empty usernames.
     bool client_kicked = true;
     if (strlen(obj->info.name) == 0)
@@ -112,35 +136,34 @@ void userinfo_obj_process(struct userinfo_obj* obj, struct server_node* server,
         goto kick_client;
     }
 
-    // Reject the client if it has the same username as another user.
-    client_kicked = false;
-    LOOP_CLIENTS(server, client, node,
-    {
-        if (strcmp(obj->info.name, node->userinfo->info.name) == 0)
-        {
-            stdout_obj_write(client->mt_sock, 
-                "Sorry, another client is already connected with that name!\n", STDOUT_KICK_MSG);
-            bulb_printf(server, "Client \"%s\" (%s) failed to connect as the given username is "      \
-                "already occupied\n", obj->info.name, obj->info.ip_addr);
-            
-            client_kicked = true;
-            break;
-        }
-    });
-    if (client_kicked)
-        goto kick_client;
-    
     // Reject the client if it is already flagged for deletion.
+    client_kicked = false;
     mtx_lock(&server->connection_update_mutex);
     if (client_flagged_for_deletion(client))
         goto unlock_mutex;
 
-    // Validate the client and log its entry.
+    // Reject the client if it has the same username as another user. This is checked
+    // whilst connecting the client, so that no other client can claim the same name
+    // in the meantime.
     client->userinfo = obj;
+    if (!server_connect_client(server, client))
+    {
+        client->userinfo = NULL;
+        stdout_obj_write(client->mt_sock, 
+            "Sorry, another client is already connected with that name!\n", STDOUT_KICK_MSG);
+        bulb_printf(server, "Client \"%s\" (%s) failed to connect as the given username is "          \
+            "already occupied\n", obj->info.name, obj->info.ip_addr);
+        client_kicked = true;
+        goto unlock_mutex;
+    }
+
+    // Validate the client and log its entry. The object now belongs to the client
+    // node, so account for it as such.
+    pool_retag(obj, BULB_ALLOC_ROSTER);
     client->ready_to_ping = true;
     client_set_status(client, CLIENT_VALIDATED);
-    server_connect_client(server, client);
-    LOOP_CLIENTS(server, NULL, node,
+    room_enter_lobby(server, client);
+    LOOP_ROOM(client->room, NULL, node,
     {
         char buffer[64 + MAX_NAME_LENGTH];
         snprintf(buffer, sizeof(buffer), "Client \"%s\" has connected\n", client->userinfo->info.name);
@@ -155,24 +178,34 @@ void userinfo_obj_process(struct userinfo_obj* obj, struct server_node* server,
     memcpy(&server_obj.info, &server->info, sizeof(server_obj.info));
     server_obj.base.type = BULB_USERINFO;
     server_obj.base.size = sizeof(server_obj);
+    memset(server_obj.info.link_key, 0, sizeof(server_obj.info.link_key));
+    memset(server_obj.info.mux_key, 0, sizeof(server_obj.info.mux_key));
     userinfo_obj_write(client->mt_sock, &server_obj);
 
-    // Synchronise the client list on each client.
-    LOOP_CLIENTS(server, client, node, 
+    // Synchronise the client list on each client in the lobby.
+    LOOP_ROOM(client->room, client, node, 
     {
         connect_obj_write(client->mt_sock, node->userinfo, false);
         connect_obj_write(node->mt_sock, client->userinfo, false);
     });
+    room_obj_write(client->mt_sock, client->room->name);
+    links_client_joined(server, client);
+    history_user_joined(server, client);
+    history_replay(server, client);
 
 unlock_mutex:
     mtx_unlock(&server->connection_update_mutex);
 kick_client:
     if (client_kicked)
+    {
         server_disconnect_client(server, client, false, true, true);
+        pool_free(obj);
+    }
     return;
 #else
     struct bulb_userinfo* next = server->info.next;
     memcpy(&server->info, &obj->info, sizeof(server->info));
     server->info.next = next;
+    pool_free(obj);
 #endif
 }
\ No newline at end of file
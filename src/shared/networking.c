@@ -12,9 +12,12 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <threads.h>
+#include <stdatomic.h>
 
 #include "unisock.h"
 #include "networking.h"
+#include "pool.h"
+#include "epoch.h"
 
 #if defined __UNIX__
 #   include "fcntl.h"
@@ -25,6 +28,9 @@
 #define FLAG_SEND       (1 << 1)
 #define FLAG_CLOSED     (1 << 2)
 
+// Bytes held in the write data queues of every mt_socket instance.
+static atomic_size_t total_send_queue_bytes;
+
 #if defined WIN32
 #   define SOCK_EVENT                       WSAEVENT
 #   define SOCK_EVENT_GET(MT_SOCK)          MT_SOCK->_event
@@ -49,6 +55,9 @@
         {                                                                           \
             QUEUE_ENQUEUE(SOCKET, *SOCKET->GLUE(ATTRIB, _queue.queue),              \
                 *SOCKET->GLUE(ATTRIB, _queue.tail), GLUE(ATTRIB, _queue));          \
+            timespec_ns_get(&SOCKET->GLUE(ATTRIB, _queue.ready_since));             \
+            if (SOCKET->GLUE(ATTRIB, _queue.length) != NULL)                        \
+                (*SOCKET->GLUE(ATTRIB, _queue.length))++;                           \
             cnd_broadcast(SOCKET->ready_signal);                                    \
         }                                                                           \
     }
@@ -56,14 +65,20 @@
 #define MT_SOCKET_REMOVE_FROM_QUEUE(SOCKET, ATTRIB)                                 \
     {                                                                               \
         if (SOCKET->GLUE(ATTRIB, _queue.linked))                                    \
+        {                                                                           \
             LINKED_LIST_REMOVE(SOCKET, *SOCKET->GLUE(ATTRIB, _queue.queue),         \
                 *SOCKET->GLUE(ATTRIB, _queue.tail), GLUE(ATTRIB, _queue));          \
+            if (SOCKET->GLUE(ATTRIB, _queue.length) != NULL)                        \
+                (*SOCKET->GLUE(ATTRIB, _queue.length))--;                           \
+        }                                                                           \
     }
 
 #define MT_SOCKET_DEQUEUE(SOCKET, NODE, ATTRIB)                                     \
     {                                                                               \
         QUEUE_DEQUEUE(NODE, *SOCKET->GLUE(ATTRIB, _queue.queue),                    \
             *SOCKET->GLUE(ATTRIB, _queue.tail), GLUE(ATTRIB, _queue));              \
+        if (SOCKET->GLUE(ATTRIB, _queue.length) != NULL)                            \
+            (*SOCKET->GLUE(ATTRIB, _queue.length))--;                               \
     }
 
 // Extract each socket event object from each socket manager's active
@@ -92,8 +107,13 @@ static inline void _sm_remove_socket(struct socket_manager* sm, struct mt_socket
     // socket being removed if it is not at the tail of the sockets array.
     if (sock->_index + 1 < sm->active_sockets--)
     {
-        memcpy(&sm->sockets[sock->_index], &sm->sockets[sock->_index + 1], 
+        memmove(&sm->sockets[sock->_index], &sm->sockets[sock->_index + 1], 
             sizeof(struct mt_socket*) * (sm->active_sockets - sock->_index));
+
+        // Each moved socket's index must remain accurate in case another socket is
+        // removed before the sockets array is next extracted.
+        for (int i = sock->_index; i < sm->active_sockets; i++)
+            sm->sockets[i]->_index = i;
     }
     sm->sockets[sm->active_sockets] = NULL;
 
@@ -127,11 +147,15 @@ static inline void _sm_interrupt_specific(struct mt_socket* sock)
 #if defined WIN32
     WSASetEvent(sock->_event);
 #elif defined __UNIX__
-    if (sock->parent_sm != NULL)
+    // The socket's parent socket manager may be de-allocated by a concurrent merger.
+    epoch_enter();
+    struct socket_manager* sm = sock->parent_sm;
+    if (sm != NULL)
     {
-        sock->parent_sm->_fake_pollin_signalled = true;
-        _sm_interrupt(sock->parent_sm);    
+        sm->_fake_pollin_signalled = true;
+        _sm_interrupt(sm);    
     }
+    epoch_exit();
 #else
     ASSERT(false, return NULL, "Target platform not supported by mt_socket!");
 #endif
@@ -140,22 +164,25 @@ static inline void _sm_interrupt_specific(struct mt_socket* sock)
 // Merge a socket manager instance into another.
 static inline void _sm_merge_into(struct socket_manager* sm, struct socket_manager* into)
 {
-    mtx_lock(&into->socket_add_lock);
+    // The update lock is always locked before the socket add lock, as the update lock
+    // is held while sockets are added to and removed from each socket manager.
     MTX_OP_NULLABLE(into->update_lock, mtx_lock);
+    mtx_lock(&into->socket_add_lock);
 
     for (int i = 0; i < sm->active_sockets; i++)
     {
         struct mt_socket* sock = sm->sockets[i];
         sock->parent_sm = into;
-        into->sockets[into->active_sockets + i] = sock;
+        sock->_index = into->active_sockets + i;
+        into->sockets[sock->_index] = sock;
     }
 
     into->active_sockets += sm->active_sockets;
     into->incoming_sockets -= sm->active_sockets;
     sm_free(sm);
 
-    MTX_OP_NULLABLE(into->update_lock, mtx_unlock);
     mtx_unlock(&into->socket_add_lock);
+    MTX_OP_NULLABLE(into->update_lock, mtx_unlock);
     _sm_interrupt(into);
 }
 
@@ -306,7 +333,7 @@ static int _sm_listen_function(void* obj)
         // or the end of the sockets array has been reached.
         for (int i = 0; i < sm->active_sockets; i++)
         {
-            bool updated = false;
+            unsigned updated = 0;
             struct mt_socket* selected = sm->sockets[i];
             selected->_pfd.revents = events[i].revents;
 
@@ -335,7 +362,7 @@ static int _sm_listen_function(void* obj)
 // Create a new mt_socket instance.
 struct mt_socket* mt_socket_new(SOCKET s)
 {
-    struct mt_socket* sock = (struct mt_socket*)quick_malloc(sizeof(struct mt_socket));
+    struct mt_socket* sock = (struct mt_socket*)quick_malloc(sizeof(struct mt_socket), BULB_ALLOC_NETWORKING);
     sock->socket = s;
     mtx_init(&sock->read_lock, mtx_plain);
     mtx_init(&sock->write_lock, mtx_plain);
@@ -346,13 +373,173 @@ struct mt_socket* mt_socket_new(SOCKET s)
     sock->_pfd.fd = s;
     sock->_pfd.events = POLLIN;
 #else
-    free(sock);
+    quick_free(sock);
     ASSERT(false, return NULL, "Target platform not supported by mt_socket!");
 #endif
     
     return sock;
 }
 
+// Account for data nodes being added to or removed from an mt_socket instance's write
+// data queue. The socket's write lock must be held.
+void mt_socket_account_send_queue(struct mt_socket* sock, long long bytes, int nodes)
+{
+    sock->send_queue_bytes += bytes;
+    sock->send_queue_objects += nodes;
+    atomic_fetch_add(&total_send_queue_bytes, bytes);
+}
+
+// Get the number of bytes held in the write data queues of every mt_socket instance.
+size_t mt_socket_total_send_queue_bytes()
+{
+    return atomic_load(&total_send_queue_bytes);
+}
+
+// Move every data node from node onwards out of an mt_socket instance's write data
+// queue and into its spill file. Returns false, moving nothing, on failure. The
+// socket's write lock must be held.
+bool mt_socket_spill(struct mt_socket* sock, struct mt_socket_data_node* node)
+{
+    if (sock->spill_file == NULL)
+    {
+        sock->spill_file = tmpfile();
+        if (sock->spill_file == NULL)
+            return false;
+    }
+
+    // Each data node is stored as its length followed by its data, so that the data
+    // nodes are restored exactly as they were queued. Nothing is moved unless every
+    // data node is written.
+    if (fseek(sock->spill_file, sock->spill_write_offset, SEEK_SET) != 0)
+        return false;
+    long write_offset = sock->spill_write_offset;
+    for (struct mt_socket_data_node* it = node; it != NULL; it = it->next)
+    {
+        uint32_t len = (uint32_t)it->len;
+        if (fwrite(&len, sizeof(len), 1, sock->spill_file) != 1 
+            || fwrite(it->data, 1, it->len, sock->spill_file) != it->len)
+            return false;
+        write_offset += sizeof(len) + it->len;
+    }
+    sock->spill_write_offset = write_offset;
+
+    while (node != NULL)
+    {
+        struct mt_socket_data_node* next = node->next;
+        LINKED_LIST_REMOVE(node, sock->data_send_queue[MT_SOCKET_LANE_BULK], 
+            sock->data_send_tail[MT_SOCKET_LANE_BULK]);
+        mt_socket_account_send_queue(sock, -(long long)node->len, -1);
+        sock->spill_bytes += node->len;
+        sock->spill_nodes++;
+        pool_free(node);
+        node = next;
+    }
+    return true;
+}
+
+// Move up to around max_bytes of spilled data back into an mt_socket instance's write
+// data queue. Returns the number of bytes moved. The socket's write lock must be held.
+size_t mt_socket_unspill(struct mt_socket* sock, size_t max_bytes)
+{
+    if (sock->spill_nodes == 0 || fflush(sock->spill_file) != 0
+        || fseek(sock->spill_file, sock->spill_read_offset, SEEK_SET) != 0)
+        return 0;
+
+    size_t moved = 0;
+    while (sock->spill_nodes > 0 && moved < max_bytes)
+    {
+        uint32_t len;
+        if (fread(&len, sizeof(len), 1, sock->spill_file) != 1)
+            break;
+        struct mt_socket_data_node* node = (struct mt_socket_data_node*)pool_alloc(
+            sizeof(struct mt_socket_data_node) + len, BULB_ALLOC_NETWORKING);
+        if (fread(node->data, 1, len, sock->spill_file) != len)
+        {
+            pool_free(node);
+            break;
+        }
+        node->len = len;
+        node->send_offset = 0;
+        node->lane = MT_SOCKET_LANE_BULK;
+        QUEUE_ENQUEUE(node, sock->data_send_queue[MT_SOCKET_LANE_BULK], 
+            sock->data_send_tail[MT_SOCKET_LANE_BULK]);
+        mt_socket_account_send_queue(sock, len, 1);
+
+        sock->spill_read_offset += sizeof(len) + len;
+        sock->spill_bytes -= len;
+        sock->spill_nodes--;
+        moved += len;
+    }
+
+    // The spill file is reused from the start once it has been fully read back.
+    if (sock->spill_nodes == 0)
+        sock->spill_read_offset = sock->spill_write_offset = 0;
+    return moved;
+}
+
+// Queue a data node of pending write data in its lane of an mt_socket instance. The
+// socket's write lock must be held.
+void mt_socket_enqueue_send(struct mt_socket* sock, struct mt_socket_data_node* node)
+{
+    ASSERT(node->lane < MT_SOCKET_LANES, return);
+    QUEUE_ENQUEUE(node, sock->data_send_queue[node->lane], sock->data_send_tail[node->lane]);
+}
+
+// Dequeue the next data node to send from an mt_socket instance, loading spilled data
+// back as needed. Returns NULL if no write data is pending. The socket's write lock
+// must be held.
+struct mt_socket_data_node* mt_socket_dequeue_send(struct mt_socket* sock)
+{
+    struct mt_socket_data_node** queue = sock->data_send_queue;
+    struct mt_socket_data_node** tail = sock->data_send_tail;
+    if (QUEUE_EMPTY(queue[MT_SOCKET_LANE_BULK]))
+        mt_socket_unspill(sock, MT_SOCKET_UNSPILL_BATCH);
+
+    // A partially sent data node must be completed before anything else is sent, as the
+    // peer would otherwise receive interleaved objects.
+    enum mt_socket_lane lane = MT_SOCKET_LANES;
+    for (int i = 0; i < MT_SOCKET_LANES && lane == MT_SOCKET_LANES; i++)
+    {
+        if (!QUEUE_EMPTY(queue[i]) && queue[i]->send_offset > 0)
+            lane = i;
+    }
+
+    // Otherwise, the control lane takes priority, although the bulk lane is still given
+    // a turn every MT_SOCKET_CONTROL_BURST data nodes so that it is never starved.
+    if (lane == MT_SOCKET_LANES)
+    {
+        bool bulk_waiting = !QUEUE_EMPTY(queue[MT_SOCKET_LANE_BULK]);
+        if (!QUEUE_EMPTY(queue[MT_SOCKET_LANE_CONTROL]) 
+            && (!bulk_waiting || sock->control_streak < MT_SOCKET_CONTROL_BURST))
+            lane = MT_SOCKET_LANE_CONTROL;
+        else if (bulk_waiting)
+            lane = MT_SOCKET_LANE_BULK;
+        else
+            return NULL;
+        sock->control_streak = (lane == MT_SOCKET_LANE_CONTROL) ? sock->control_streak + 1 : 0;
+    }
+
+    struct mt_socket_data_node* node;
+    QUEUE_DEQUEUE(node, queue[lane], tail[lane]);
+    return node;
+}
+
+// Return a data node that could not be sent in full to the front of its lane, so that
+// it is completed before anything else is sent. The socket's write lock must be held.
+void mt_socket_requeue_send(struct mt_socket* sock, struct mt_socket_data_node* node)
+{
+    ASSERT(node->lane < MT_SOCKET_LANES, return);
+    struct mt_socket_data_node** queue = &sock->data_send_queue[node->lane];
+    node->prev = NULL;
+    node->next = *queue;
+    if (node->next != NULL)
+        node->next->prev = node;
+    else
+        sock->data_send_tail[node->lane] = node;
+    *queue = node;
+    node->linked = true;
+}
+
 // Configure an mt_socket instance to be non-blocking.
 void mt_socket_configure_non_blocking(struct mt_socket* sock)
 {
@@ -365,6 +552,10 @@ void mt_socket_configure_non_blocking(struct mt_socket* sock)
 #else
     ASSERT(false, return NULL, "Target platform not supported by mt_socket!");
 #endif
+
+    // Streams are flow controlled by small acknowledgements, which Nagle's algorithm
+    // would otherwise delay until the peer's delayed ACK timer fires.
+    set_socket_no_delay(sock->socket);
 }
 
 // Read data into a buffer. This is preferred over raw recv().
@@ -394,8 +585,11 @@ void mt_socket_flag_pending_for_send(struct mt_socket* sock)
     // no-op
 #elif defined __UNIX__
     sock->_pfd.events |= POLLOUT;
-    if (sock->parent_sm != NULL)
-        _sm_interrupt(sock->parent_sm);
+    epoch_enter();
+    struct socket_manager* sm = sock->parent_sm;
+    if (sm != NULL)
+        _sm_interrupt(sm);
+    epoch_exit();
 #else
     ASSERT(false, return NULL, "Target platform not supported by mt_socket!");
 #endif
@@ -444,8 +638,6 @@ void mt_socket_shutdown(struct mt_socket* sock)
 
     sock->listening = false;
     shutdown(sock->socket, SHUT_WR);
-    mtx_destroy(&sock->read_lock);
-    mtx_destroy(&sock->write_lock);
 
     // If the last call to recv() blocked, immediately mark this socket as ready for
     // closure.
@@ -457,6 +649,15 @@ void mt_socket_shutdown(struct mt_socket* sock)
         _sm_interrupt_specific(sock);
 }
 
+// epoch_retire() callback for mt_socket instances.
+static void _mt_socket_release(void* obj)
+{
+    struct mt_socket* sock = (struct mt_socket*)obj;
+    mtx_destroy(&sock->read_lock);
+    mtx_destroy(&sock->write_lock);
+    quick_free(sock);
+}
+
 // Free an mt_socket instance. This should not be called if the mt_socket instanece
 // is currently being managed by a socket manager. If this is the case, please see
 // mt_socket_shutdown() instead.
@@ -464,21 +665,47 @@ void mt_socket_free(struct mt_socket* sock)
 {
     ASSERT(sock != NULL, return);
 
-    // Free any queued data nodes.
+    // Other threads may still be writing to this socket while iterating through a
+    // snapshot of the clients roster, so no more data may be queued once the send 
+    // queue has been freed.
+    mtx_lock(&sock->write_lock);
+    sock->closed = true;
+
+    // Free any queued data and timeout nodes.
     struct mt_socket_data_node* node = sock->data_recv_queue;
     while (node != NULL)
     {
         struct mt_socket_data_node* temp = node;
         node = node->next;
-        free(temp);
+        pool_free(temp);
     }
-    node = sock->data_send_queue;
-    while (node != NULL)
+    for (int i = 0; i < MT_SOCKET_LANES; i++)
     {
-        struct mt_socket_data_node* temp = node;
-        node = node->next;
-        free(temp);
+        node = sock->data_send_queue[i];
+        while (node != NULL)
+        {
+            struct mt_socket_data_node* temp = node;
+            node = node->next;
+            pool_free(temp);
+        }
+        sock->data_send_queue[i] = sock->data_send_tail[i] = NULL;
+    }
+    struct mt_socket_timeout_node* timeout = sock->data_send_timeout_queue;
+    while (timeout != NULL)
+    {
+        struct mt_socket_timeout_node* temp = timeout;
+        timeout = timeout->next;
+        pool_free(temp);
     }
+    sock->data_recv_queue = sock->data_recv_tail = NULL;
+    atomic_fetch_sub(&total_send_queue_bytes, sock->send_queue_bytes);
+    sock->send_queue_bytes = sock->send_queue_objects = 0;
+    if (sock->spill_file != NULL)
+        fclose(sock->spill_file);
+    sock->spill_file = NULL;
+    sock->spill_bytes = sock->spill_nodes = 0;
+    sock->data_send_timeout_queue = sock->data_send_timeout_tail = NULL;
+    mtx_unlock(&sock->write_lock);
 
     // Call the socket's de-allocation function. This is intentionally designed such
     // that this code can easily be decoupled from Bulb for future use. Per Bulb's
@@ -489,13 +716,15 @@ void mt_socket_free(struct mt_socket* sock)
     shutdown(sock->socket, SHUT_RDWR);
     closesocket(sock->socket);
 
-    free(sock);
+    // The socket instance itself must remain valid until no other thread can still
+    // reference it.
+    epoch_retire(sock, _mt_socket_release);
 }
 
 // Create a new socket manager instance.
 struct socket_manager* sm_new()
 {
-    struct socket_manager* sm = (struct socket_manager*)quick_malloc(sizeof(struct socket_manager));
+    struct socket_manager* sm = (struct socket_manager*)quick_malloc(sizeof(struct socket_manager), BULB_ALLOC_NETWORKING);
     mtx_init(&sm->socket_add_lock, mtx_plain | mtx_recursive);
 
     // There must be a way to alert a polling socket manager instance whether a socket
@@ -534,6 +763,7 @@ bool sm_add(struct socket_manager* sm, struct mt_socket* sock)
     result = true;
     sock->listening = true;
     sock->parent_sm = sm;
+    sock->_index = sm->active_sockets;
     sm->sockets[sm->active_sockets++] = sock;
 
     // Interrupt the socket manager instance so that it can begin listening to the new
@@ -600,6 +830,20 @@ finish:
     return true;
 }
 
+// epoch_retire() callback for socket manager instances.
+static void _sm_release(void* obj)
+{
+    struct socket_manager* sm = (struct socket_manager*)obj;
+    mtx_destroy(&sm->socket_add_lock);
+#if defined WIN32
+    WSACloseEvent(sm->_connection_changed_event);
+#elif defined __UNIX__
+    close(sm->_connection_changed_pipe[PIPE_READ]);
+    close(sm->_connection_changed_pipe[PIPE_WRITE]);
+#endif
+    quick_free(sm);
+}
+
 // Clean-up a socket manager instance. This should not be called if the socket manager
 // instance is currently running.
 void sm_free(struct socket_manager* sm)
@@ -609,6 +853,7 @@ void sm_free(struct socket_manager* sm)
     if (sm->dealloc_func != NULL)
         sm->dealloc_func(sm);
 
-    mtx_destroy(&sm->socket_add_lock);
-    free(sm);
+    // Writer threads may still be interrupting this socket manager instance through
+    // a managed socket's parent_sm attribute.
+    epoch_retire(sm, _sm_release);
 }
\ No newline at end of file
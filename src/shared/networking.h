@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -21,6 +22,12 @@
 
 #define SOCKETS_PER_POLLING_THREAD  63                           
 
+// Most pending write data loaded back from a socket's spill file at once, in bytes.
+#define MT_SOCKET_UNSPILL_BATCH     (64 * 1024)
+
+// Most data nodes sent from the control lane in a row while the bulk lane is waiting.
+#define MT_SOCKET_CONTROL_BURST     8
+
 #define LOOP_SOCKET_MANAGERS(LIST, EXCEPT, ID, SCOPE)                               \
     {                                                                               \
         struct socket_manager* ID = LIST;                                           \
@@ -34,12 +41,22 @@
 
 struct socket_manager;
 
+// Pending write data is queued in one of several lanes, which are sent in order of
+// priority.
+enum mt_socket_lane
+{
+    MT_SOCKET_LANE_CONTROL,     // Small objects that keep the connection working.
+    MT_SOCKET_LANE_BULK,        // Everything else.
+    MT_SOCKET_LANES
+};
+
 // Stores information about recv()/send() data.
 struct mt_socket_data_node
 {
     struct mt_socket_data_node* next;
     struct mt_socket_data_node* prev;
     bool linked;
+    enum mt_socket_lane lane;   // Only used for write data.
     int send_offset;
     size_t len;
 
@@ -73,6 +90,7 @@ struct mt_socket
     bool flag_send;
 
     bool ready_to_close;
+    bool closed;        // Set once de-allocated; no more data may be queued for sending.
 
     struct timespec ping_start;
     struct timespec ping_end;
@@ -89,19 +107,48 @@ struct mt_socket
         struct mt_socket* prev;
         struct mt_socket* next;
         bool linked;
+
+        // Length of the queue, if it is tracked, and when this instance was last flagged 
+        // as ready, which together measure how far behind the queue's consumer is.
+        unsigned* length;
+        struct timespec ready_since;
     } recv_queue, send_queue;
 
-    // Used for storing pending read/write data.
+    // Used for storing pending read/write data. Pending write data is split into lanes,
+    // and control_streak counts the data nodes sent from the control lane in a row.
     struct mt_socket_data_node* data_recv_queue;
     struct mt_socket_data_node* data_recv_tail;
-    struct mt_socket_data_node* data_send_queue;
-    struct mt_socket_data_node* data_send_tail;
+    struct mt_socket_data_node* data_send_queue[MT_SOCKET_LANES];
+    struct mt_socket_data_node* data_send_tail[MT_SOCKET_LANES];
+    unsigned control_streak;
 
     // Used for storing timeout information about pending write data.
     struct mt_socket_timeout_node* data_send_timeout_queue;
     struct mt_socket_timeout_node* data_send_timeout_tail;
     unsigned timeout_node_dec_count;
 
+    // Depth of the pending write data queue across every lane, see
+    // mt_socket_account_send_queue(). 
+    // Whether the queue is congested, and since when, is maintained by the owner of
+    // the socket.
+    size_t send_queue_bytes;
+    unsigned send_queue_objects;
+    bool send_congested;
+    struct timespec congested_since;
+
+    // Pending write data in the bulk lane can be spilled to a temporary file, in which
+    // case it is sent once every data node still in the bulk lane has been sent.
+    FILE* spill_file;
+    long spill_read_offset;
+    long spill_write_offset;
+    size_t spill_bytes;
+    unsigned spill_nodes;
+
+    // A session multiplexed over another socket has no connection of its own, and is
+    // sent through its carrier instead, see mux_obj.h.
+    struct mt_socket* carrier;
+    uint32_t session;
+
     // Called when the mt_socket instance is being de-allocated.
     OBJ_FUNC_P(struct mt_socket* sock, dealloc_func);
 
@@ -127,6 +174,35 @@ int mt_socket_recv(struct mt_socket* sock, char* buffer, int len, int flags);
 // Send data from a buffer. This is preferred over raw send().
 int mt_socket_send(struct mt_socket* sock, const char* buffer, int len, int flags);
 
+// Account for data nodes being added to or removed from an mt_socket instance's write
+// data queue. The socket's write lock must be held.
+void mt_socket_account_send_queue(struct mt_socket* sock, long long bytes, int nodes);
+
+// Get the number of bytes held in the write data queues of every mt_socket instance.
+size_t mt_socket_total_send_queue_bytes();
+
+// Move every data node from node onwards out of an mt_socket instance's bulk lane and
+// into its spill file. Returns false, moving nothing, on failure. The socket's write
+// lock must be held.
+bool mt_socket_spill(struct mt_socket* sock, struct mt_socket_data_node* node);
+
+// Move up to around max_bytes of spilled data back into an mt_socket instance's bulk
+// lane. Returns the number of bytes moved. The socket's write lock must be held.
+size_t mt_socket_unspill(struct mt_socket* sock, size_t max_bytes);
+
+// Queue a data node of pending write data in its lane of an mt_socket instance. The
+// socket's write lock must be held.
+void mt_socket_enqueue_send(struct mt_socket* sock, struct mt_socket_data_node* node);
+
+// Dequeue the next data node to send from an mt_socket instance, loading spilled data
+// back as needed. Returns NULL if no write data is pending. The socket's write lock
+// must be held.
+struct mt_socket_data_node* mt_socket_dequeue_send(struct mt_socket* sock);
+
+// Return a data node that could not be sent in full to the front of its lane, so that
+// it is completed before anything else is sent. The socket's write lock must be held.
+void mt_socket_requeue_send(struct mt_socket* sock, struct mt_socket_data_node* node);
+
 // Tell an mt_socket instance to begin waiting for when send() can be used again.
 // This function is effectively a no-op on non-POSIX systems.
 void mt_socket_flag_pending_for_send(struct mt_socket* sock);
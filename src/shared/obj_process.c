@@ -17,6 +17,11 @@
 #include "ping_obj.h"
 #include "update_userinfo_obj.h"
 #include "received_obj.h"
+#include "stream_obj.h"
+#include "room_obj.h"
+#include "direct_obj.h"
+#include "link_obj.h"
+#include "mux_obj.h"
 
 // Process a Bulb object. The object may be free()'d afterwards. Returns false on error.
 bool bulb_process_object(struct bulb_obj* obj, struct server_node* server, struct client_node* client)
@@ -49,8 +54,32 @@ bool bulb_process_object(struct bulb_obj* obj, struct server_node* server, struc
         case BULB_RECEIVED:
             received_obj_process((struct received_obj*)obj, server, client);
             return true;
+        case BULB_STREAM_OPEN:
+            stream_open_obj_process((struct stream_open_obj*)obj, server, client);
+            return true;
+        case BULB_STREAM_CHUNK:
+            stream_chunk_obj_process((struct stream_chunk_obj*)obj, server, client);
+            return true;
+        case BULB_STREAM_ACK:
+            stream_ack_obj_process((struct stream_ack_obj*)obj, server, client);
+            return true;
+        case BULB_STREAM_CLOSE:
+            stream_close_obj_process((struct stream_close_obj*)obj, server, client);
+            return true;
+        case BULB_ROOM:
+            room_obj_process((struct room_obj*)obj, server, client);
+            return true;
+        case BULB_DIRECT:
+            direct_obj_process((struct direct_obj*)obj, server, client);
+            return true;
+        case BULB_LINK:
+            link_obj_process((struct link_obj*)obj, server, client);
+            return true;
+        case BULB_MUX:
+            mux_obj_process((struct mux_obj*)obj, server, client);
+            return true;
         default:
-            free(obj);
+            pool_free(obj);
             return false;
     }
 }
\ No newline at end of file
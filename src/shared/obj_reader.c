@@ -6,6 +6,7 @@
 #include "unisock.h"
 #include "networking.h"
 #include "obj_reader.h"
+#include "pool.h"
 #include "stdout_obj.h"
 #include "userinfo_obj.h"
 #include "connect_obj.h"
@@ -14,6 +15,11 @@
 #include "ping_obj.h"
 #include "update_userinfo_obj.h"
 #include "received_obj.h"
+#include "stream_obj.h"
+#include "room_obj.h"
+#include "direct_obj.h"
+#include "link_obj.h"
+#include "mux_obj.h"
 
 #define EVALUATE_READ_FAIL()                                                                \
     {                                                                                       \
@@ -39,6 +45,88 @@
             return NULL;                                                                    \
     }
 
+// Select the read function for an object whose header and data have been received.
+// Returns NULL on failure.
+static struct bulb_obj* _bulb_obj_read_object(struct mt_socket* sock, struct bulb_obj* header, 
+                                              char* error_msg, size_t len)
+{
+#ifdef SERVER
+    struct client_node* client = (struct client_node*)sock->parent_client;
+#endif
+
+    // A switch table is used to select the exact read function to use for reading the
+    // given object from the given socket stream. The size of each object is passed
+    // as a parameter to each non-default object, in order to validate against
+    // objects that could crash the server from invalid clients.
+    switch (header->type)
+    {
+        case BULB_OBJ:
+            // This object should not be received whatsoever.
+#ifdef CLIENT
+            ASSERT(false, return NULL, "Test object was found in stream")
+#else
+            snprintf(error_msg, len, "Client attempted to send test object");
+#endif
+            return NULL;
+        case BULB_STDOUT:
+#ifdef SERVER
+            // Because this object is of variable length and incorporates zero character 
+            // filtering, this object must NOT be sent by client code as it is inherently 
+            // dangerous. Linked servers may send it, to report why a link was closed.
+            if (client->link == NULL)
+            {
+                snprintf(error_msg, len, "Client attempted to send stdout_obj");
+                return NULL;
+            }
+#endif
+
+            // It is difficult to perform size validations due to the variadic size of 
+            // this object.
+            return stdout_obj_read(sock, header, header->size);
+        case BULB_USERINFO:
+            return userinfo_obj_read(sock, header, sizeof(struct userinfo_obj));
+        case BULB_CONNECT:
+            return connect_obj_read(sock, header, sizeof(struct connect_obj));
+        case BULB_DISCONNECT:
+            return disconnect_obj_read(sock, header, sizeof(struct disconnect_obj));
+        case BULB_MESSAGE:
+            return message_obj_read(sock, header, sizeof(struct message_obj));
+        case BULB_PING:
+            return ping_obj_read(sock, header, sizeof(struct ping_obj));
+        case BULB_UPDATE_USERINFO:
+            return update_userinfo_obj_read(sock, header, sizeof(struct update_userinfo_obj));
+        case BULB_RECEIVED:
+            return received_obj_read(sock, header, sizeof(struct received_obj));
+        case BULB_STREAM_OPEN:
+            return stream_open_obj_read(sock, header, sizeof(struct stream_open_obj));
+        case BULB_STREAM_CHUNK:
+            // Chunks vary in length, so their size is validated by the read function.
+            return stream_chunk_obj_read(sock, header, header->size);
+        case BULB_STREAM_ACK:
+            return stream_ack_obj_read(sock, header, sizeof(struct stream_ack_obj));
+        case BULB_STREAM_CLOSE:
+            return stream_close_obj_read(sock, header, sizeof(struct stream_close_obj));
+        case BULB_ROOM:
+            return room_obj_read(sock, header, sizeof(struct room_obj));
+        case BULB_DIRECT:
+            return direct_obj_read(sock, header, sizeof(struct direct_obj));
+        case BULB_LINK:
+            // Batches vary in length, so their size is validated by the read function.
+            return link_obj_read(sock, header, header->size);
+        case BULB_MUX:
+            // Carried objects vary in length, so their size is validated by the read
+            // function.
+            return mux_obj_read(sock, header, header->size);
+        default:
+#ifdef CLIENT
+            ASSERT(false, return NULL, "Invalid obj type %d\n", header->type);
+#else
+            snprintf(error_msg, len, "Client attempted to send invalid obj type %d", header->type);
+#endif
+            return NULL;
+    }
+}
+
 // Read a Bulb object from a socket. The object is dynamically allocated and thus
 // must be released from memory afterwards. This is a non-blocking function.
 struct bulb_obj* bulb_obj_read(struct mt_socket* sock, char* error_msg, size_t len, bool* try_again)
@@ -63,7 +151,7 @@ struct bulb_obj* bulb_obj_read(struct mt_socket* sock, char* error_msg, size_t l
         while ((read = mt_socket_recv(sock, buffer, sizeof(struct bulb_obj), MSG_PEEK)) 
             < (int)sizeof(struct bulb_obj))
             EVALUATE_READ_FAIL();
-        client->next_obj_header = (struct bulb_obj*)quick_malloc(sizeof(struct bulb_obj));
+        client->next_obj_header = (struct bulb_obj*)pool_alloc(sizeof(struct bulb_obj), BULB_ALLOC_OBJECTS);
         memcpy(client->next_obj_header, buffer, sizeof(struct bulb_obj));
     }
 
@@ -76,76 +164,67 @@ struct bulb_obj* bulb_obj_read(struct mt_socket* sock, char* error_msg, size_t l
             <= 0)
             EVALUATE_READ_FAIL();
 
-        struct mt_socket_data_node* node = (struct mt_socket_data_node*)quick_malloc(
-            sizeof(struct mt_socket_data_node) + read);
+        struct mt_socket_data_node* node = (struct mt_socket_data_node*)pool_alloc(
+            sizeof(struct mt_socket_data_node) + read, BULB_ALLOC_NETWORKING);
         memcpy(node->data, buffer, read);
         node->len = read;
+        node->send_offset = 0;
         QUEUE_ENQUEUE(node, sock->data_recv_queue, sock->data_recv_tail);
             
         client->read_offset += read;
     } while (client->next_obj_header->size > client->read_offset);
     
-    // A switch table is used to select the exact read function to use for reading the
-    // given object from the given socket stream. The size of each object is passed
-    // as a parameter to each non-default object, in order to validate against
-    // objects that could crash the server from invalid clients.
-    struct bulb_obj* return_obj = NULL;
-    switch (client->next_obj_header->type)
-    {
-        case BULB_OBJ:
-            // This object should not be received whatsoever.
-#ifdef CLIENT
-            ASSERT(false, return NULL, "Test object was found in stream")
-#else
-            snprintf(error_msg, len, "Client attempted to send test object");
-#endif
-            return NULL;
-        case BULB_STDOUT:
-#ifdef SERVER
-            // Because this object is of variable length and incorporates zero character 
-            // filtering, this object must NOT be sent by client code as it is inherently 
-            // dangerous.
-            snprintf(error_msg, len, "Client attempted to send stdout_obj");
-            return NULL;
-#endif
-
-            // It is difficult to perform size validations due to the variadic size of 
-            // this object.
-            return_obj = stdout_obj_read(sock, client->next_obj_header, client->next_obj_header->size);
-            break;
-        case BULB_USERINFO:
-            return_obj = userinfo_obj_read(sock, client->next_obj_header, sizeof(struct userinfo_obj));
-            break;
-        case BULB_CONNECT:
-            return_obj = connect_obj_read(sock, client->next_obj_header, sizeof(struct connect_obj));
-            break;
-        case BULB_DISCONNECT:
-            return_obj = disconnect_obj_read(sock, client->next_obj_header, sizeof(struct disconnect_obj));
-            break;
-        case BULB_MESSAGE:
-            return_obj = message_obj_read(sock, client->next_obj_header, sizeof(struct message_obj));
-            break;
-        case BULB_PING:
-            return_obj = ping_obj_read(sock, client->next_obj_header, sizeof(struct ping_obj));
-            break;
-        case BULB_UPDATE_USERINFO:
-            return_obj = update_userinfo_obj_read(sock, client->next_obj_header, 
-                sizeof(struct update_userinfo_obj));
-            break;
-        case BULB_RECEIVED:
-            return_obj = received_obj_read(sock, client->next_obj_header, sizeof(struct received_obj));
-            break;
-        default:
-#ifdef CLIENT
-            ASSERT(false, return NULL, "Invalid obj type %d\n", client->next_obj_header->type);
-#else
-            snprintf(error_msg, len, "Client attempted to send invalid obj type %d", 
-                client->next_obj_header->type);
-#endif
-            return NULL;
-    }
-
+    struct bulb_obj* return_obj = _bulb_obj_read_object(sock, client->next_obj_header, error_msg, len);
+    pool_free(client->next_obj_header);
     client->next_obj_header = NULL;
     client->read_offset = 0;
     return return_obj;
-}
\ No newline at end of file
+}
+
+// Read a Bulb object that has already been received in full into a buffer, on behalf
+// of a socket. This is used for objects carried inside other objects, see mux_obj.h.
+// The object is dynamically allocated and thus must be released from memory
+// afterwards.
+struct bulb_obj* bulb_obj_read_buffer(struct mt_socket* sock, const char* data, size_t size, 
+                                      char* error_msg, size_t len)
+{
+    memset(error_msg, 0, len);
+
+    // The header is validated against the buffer, as it was not used to receive the
+    // object. Objects that carry other objects, or that only linked servers send, may
+    // not be carried themselves.
+    struct bulb_obj header;
+    if (size < sizeof(struct bulb_obj))
+    {
+        snprintf(error_msg, len, "Client sent a truncated object");
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(struct bulb_obj));
+    if (header.size != size)
+    {
+        snprintf(error_msg, len, "Client sent an object of mismatching size");
+        return NULL;
+    }
+    if (header.type == BULB_MUX || header.type == BULB_LINK)
+    {
+        snprintf(error_msg, len, "Client attempted to send obj type %d within another object", header.type);
+        return NULL;
+    }
+
+    struct mt_socket_data_node* node = (struct mt_socket_data_node*)pool_alloc(
+        sizeof(struct mt_socket_data_node) + size, BULB_ALLOC_NETWORKING);
+    memcpy(node->data, data, size);
+    node->len = size;
+    node->send_offset = 0;
+    QUEUE_ENQUEUE(node, sock->data_recv_queue, sock->data_recv_tail);
+
+    // Objects that are rejected before being read leave their data behind, which must
+    // not be mistaken for the start of the next object.
+    struct bulb_obj* obj = _bulb_obj_read_object(sock, &header, error_msg, len);
+    while (sock->data_recv_queue != NULL)
+    {
+        QUEUE_DEQUEUE(node, sock->data_recv_queue, sock->data_recv_tail);
+        pool_free(node);
+    }
+    return obj;
+}
@@ -12,4 +12,11 @@
 
 // Read a Bulb object from a socket. The object is dynamically allocated and thus
 // must be released from memory afterwards.
-struct bulb_obj* bulb_obj_read(struct mt_socket* sock, char* error_msg, size_t len, bool* try_again);
\ No newline at end of file
+struct bulb_obj* bulb_obj_read(struct mt_socket* sock, char* error_msg, size_t len, bool* try_again);
+
+// Read a Bulb object that has already been received in full into a buffer, on behalf
+// of a socket. This is used for objects carried inside other objects, see mux_obj.h.
+// The object is dynamically allocated and thus must be released from memory
+// afterwards.
+struct bulb_obj* bulb_obj_read_buffer(struct mt_socket* sock, const char* data, size_t size, 
+                                      char* error_msg, size_t len);
\ No newline at end of file
@@ -0,0 +1,196 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "util.h"
+#include "trie.h"
+#include "bulb_structs.h"
+#include "userinfo_obj.h"
+#include "connect_obj.h"
+#include "disconnect_obj.h"
+#include "stdout_obj.h"
+#include "room_obj.h"
+#include "stream_obj.h"
+#include "rooms.h"
+
+#ifdef SERVER
+#   include "history.h"
+#endif
+
+#define ROOM_INITIAL_MEMBERS    8
+
+#ifdef SERVER
+// Allocate an empty room.
+static struct room* _room_new(const char* name)
+{
+    struct room* room = quick_malloc(sizeof(struct room), BULB_ALLOC_ROSTER);
+    strncpy(room->name, name, MAX_ROOM_NAME_LENGTH);
+    room->capacity = ROOM_INITIAL_MEMBERS;
+    room->members = quick_calloc(room->capacity, sizeof(struct client_node*), BULB_ALLOC_ROSTER);
+    return room;
+}
+
+// Free a room.
+static void _room_free(struct room* room)
+{
+    quick_free(room->members);
+    quick_free(room);
+}
+
+// Find a room by name, creating it if it does not exist yet.
+static struct room* _room_find_or_create(struct server_node* server, const char* name)
+{
+    if (name[0] == '\0' || strcmp(name, ROOM_LOBBY_NAME) == 0)
+        return server->lobby;
+
+    struct room* room = trie_find(server->rooms, name);
+    if (room == NULL)
+    {
+        room = _room_new(name);
+        trie_add(server->rooms, room->name, room);
+    }
+    return room;
+}
+
+// Add a client to a room, without synchronising its arrival.
+static void _room_add(struct room* room, struct client_node* client)
+{
+    if (room->count == room->capacity)
+    {
+        struct client_node** members = quick_malloc(sizeof(struct client_node*) * room->capacity * 2,
+            BULB_ALLOC_ROSTER);
+        memcpy(members, room->members, sizeof(struct client_node*) * room->count);
+        quick_free(room->members);
+        room->members = members;
+        room->capacity *= 2;
+    }
+    client->room = room;
+    client->room_index = room->count;
+    room->members[room->count++] = client;
+}
+#endif
+
+// Create the lobby of a server node.
+void rooms_init(struct server_node* server)
+{
+#ifdef SERVER
+    server->rooms = trie_new();
+    server->lobby = _room_new(ROOM_LOBBY_NAME);
+    trie_add(server->rooms, server->lobby->name, server->lobby);
+#endif
+}
+
+// Free every room of a server node. This does not free the member client nodes.
+void rooms_free(struct server_node* server)
+{
+#ifdef SERVER
+    TRIE_DFS(server->rooms, room, _room_free((struct room*)room));
+    trie_free(server->rooms);
+    server->rooms = NULL;
+    server->lobby = NULL;
+#endif
+}
+
+// Check whether a room name is valid.
+bool room_name_valid(const char* name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len > MAX_ROOM_NAME_LENGTH)
+        return false;
+
+    // Room names are a single word, so that they can be given as command arguments.
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isgraph((unsigned char)name[i]))
+            return false;
+    }
+    return true;
+}
+
+// Add a newly-validated client to the lobby. The client's arrival must be synchronised
+// by the caller.
+void room_enter_lobby(struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    _room_add(server->lobby, client);
+#endif
+}
+
+// Add a client connected to a linked server to a room, creating the room if it does not
+// exist yet. The client's arrival must be synchronised by the caller.
+void room_enter(struct server_node* server, struct client_node* client, const char* name)
+{
+#ifdef SERVER
+    _room_add(_room_find_or_create(server, name), client);
+#endif
+}
+
+// Move a client into another room, creating the room if it does not exist yet. The
+// client's departure and arrival are synchronised with the members of both rooms.
+// Returns false if the client is already in the room.
+bool room_move(struct server_node* server, struct client_node* client, const char* name)
+{
+#ifdef SERVER
+    struct room* room = _room_find_or_create(server, name);
+    if (room == client->room)
+        return false;
+
+    // Streams sent by the client are only relayed to the members of its room, so any
+    // that are still open are aborted.
+    stream_obj_abort_all(server, client);
+    client->room_moves++;
+
+    // Members of the previous room are told that the client has left, and are removed
+    // from the client's roster in turn.
+    char buffer[64 + MAX_NAME_LENGTH + MAX_ROOM_NAME_LENGTH];
+    snprintf(buffer, sizeof(buffer), "Client \"%s\" has left the room\n", client->userinfo->info.name);
+    LOOP_ROOM(client->room, client, node,
+    {
+        disconnect_obj_write(node->mt_sock, client->userinfo->info.name, false);
+        stdout_obj_write(node->mt_sock, buffer, STDOUT_GENERIC);
+        disconnect_obj_write(client->mt_sock, node->userinfo->info.name, false);
+    });
+    room_leave(server, client);
+
+    // Members of the new room are told that the client has joined, and are added to
+    // the client's roster in turn.
+    _room_add(room, client);
+    snprintf(buffer, sizeof(buffer), "Client \"%s\" has joined the room\n", client->userinfo->info.name);
+    LOOP_ROOM(room, client, node,
+    {
+        connect_obj_write(node->mt_sock, client->userinfo, false);
+        stdout_obj_write(node->mt_sock, buffer, STDOUT_GENERIC);
+        connect_obj_write(client->mt_sock, node->userinfo, false);
+    });
+    room_obj_write(client->mt_sock, room->name);
+    history_replay(server, client);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Remove a client from its room, without synchronising its departure. The room is
+// freed if this leaves it empty, unless it is the lobby.
+void room_leave(struct server_node* server, struct client_node* client)
+{
+#ifdef SERVER
+    struct room* room = client->room;
+    if (room == NULL)
+        return;
+
+    struct client_node* last = room->members[--room->count];
+    room->members[client->room_index] = last;
+    last->room_index = client->room_index;
+    client->room = NULL;
+
+    if (room->count == 0 && room != server->lobby)
+    {
+        trie_delete(server->rooms, room->name);
+        _room_free(room);
+    }
+#endif
+}
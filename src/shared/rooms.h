@@ -0,0 +1,76 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Rooms partition the clients of a server, so that messages and presence traffic are
+// only fanned out to the members of a single room rather than to every client. Each
+// client is a member of exactly one room at a time, starting with the lobby. Rooms
+// other than the lobby are created when first joined, and freed once emptied.
+//
+// The roster that each client holds only consists of the members of its room, so
+// clients are told of other clients joining and leaving their room as though they
+// had connected or disconnected. Rooms are only managed by the server, and are only
+// accessed while the server node's client update lock is held.
+//
+// Clients connected to linked servers are members of rooms too, see links.h. As they
+// have no socket, anything written to them within LOOP_ROOM() is simply discarded.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "bulb_macros.h"
+#include "server_node.h"
+#include "client_node.h"
+
+#define ROOM_LOBBY_NAME "lobby"
+
+// This loop iterates over the members of a room. The server node's client update lock
+// must be held, and the room's membership must not change within this loop.
+#define LOOP_ROOM(ROOM, EXCEPT, ID, SCOPE)                                      \
+    {                                                                           \
+        struct room* room##ID = (ROOM);                                         \
+        for (unsigned i##ID = 0; room##ID != NULL && i##ID < room##ID->count; i##ID++) \
+        {                                                                       \
+            struct client_node* ID = room##ID->members[i##ID];                  \
+            if (ID != EXCEPT && ID->status == CLIENT_VALIDATED)                 \
+                SCOPE;                                                          \
+        }                                                                       \
+    }
+
+struct room
+{
+    char name[MAX_ROOM_NAME_LENGTH + 1];
+
+    // Dense array of each member. Removing a member moves the last member into its
+    // place, so each client node tracks its own position through its room_index
+    // attribute.
+    struct client_node** members;
+    unsigned count;
+    unsigned capacity;
+};
+
+// Create the lobby of a server node.
+void rooms_init(struct server_node* server);
+
+// Free every room of a server node. This does not free the member client nodes.
+void rooms_free(struct server_node* server);
+
+// Check whether a room name is valid.
+bool room_name_valid(const char* name);
+
+// Add a newly-validated client to the lobby. The client's arrival must be synchronised
+// by the caller.
+void room_enter_lobby(struct server_node* server, struct client_node* client);
+
+// Add a client connected to a linked server to a room, creating the room if it does not
+// exist yet. The client's arrival must be synchronised by the caller.
+void room_enter(struct server_node* server, struct client_node* client, const char* name);
+
+// Move a client into another room, creating the room if it does not exist yet. The
+// client's departure and arrival are synchronised with the members of both rooms.
+// Returns false if the client is already in the room.
+bool room_move(struct server_node* server, struct client_node* client, const char* name);
+
+// Remove a client from its room, without synchronising its departure. The room is
+// freed if this leaves it empty, unless it is the lobby.
+void room_leave(struct server_node* server, struct client_node* client);
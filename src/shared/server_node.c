@@ -11,6 +11,8 @@
 #include "unisock.h"
 #include "networking.h"
 #include "trie.h"
+#include "pool.h"
+#include "epoch.h"
 #include "bulb_macros.h"
 #include "bulb_structs.h"
 #include "shared_interface.h"
@@ -22,9 +24,16 @@
 #include "stdout_obj.h"
 #include "ping_obj.h"
 #include "received_obj.h"
+#include "stream_obj.h"
+#include "rooms.h"
 
 #ifdef SERVER
 #   include "bulb_server.h"
+#   include "ip_limiter.h"
+#   include "flood_control.h"
+#   include "links.h"
+#   include "mux.h"
+#   include "history.h"
 #endif
 
 // Flag a client node for deletion.
@@ -43,36 +52,60 @@ static inline void _client_flag_for_deletion(struct client_node* client, bool se
     cnd_broadcast(&client->client_delete_signal);
 }
 
-// Close and free a client node.
+// Close and free a client node. This should only be called while the server's client
+// update lock is locked, so that the server does not begin handling this client node's
+// object processing while this client node is being deleted.
 static void _client_close(struct client_node* client)
 {
-    // The server's client update lock must be locked so that the server does not
-    // begin handling this client node's object processing while this client node
-    // is being deleted.
-    mtx_t* server_client_update_lock = &client->server_node->client_update_lock;
-    mtx_lock(server_client_update_lock);
-
     if (client->mt_sock != NULL)
     {
+        // The socket may outlive both the client node and its server node, as the
+        // socket's I/O context may be shared with other server nodes.
         client->mt_sock->dealloc_func = NULL;
+        client->mt_sock->parent_client = NULL;
+
+#ifdef SERVER
+        // Sessions are not managed by any socket manager, see mux.h.
+        if (client->mt_sock->carrier != NULL)
+        {
+            mt_socket_free(client->mt_sock);
+            client_shared_node_free(client);
+            return;
+        }
+#endif
 
         // The socket manager should independently handle de-allocating the client's
         // socket object. This function serves as a hint towards the socket's
         // assigned socket manager to free the socket instance when ready.
         mt_socket_shutdown(client->mt_sock);
     }
-    mtx_destroy(&client->client_status_lock);
-    mtx_destroy(&client->send_thread_lock);
-    mtx_destroy(&client->ping_lock);
-    cnd_destroy(&client->client_delete_signal);
-
-    if (client->userinfo != NULL)
-        free(client->userinfo);
-    if (client->next_obj_header != NULL)
-        free(client->next_obj_header);
-    free(client);
-
-    mtx_unlock(server_client_update_lock);
+    client_shared_node_free(client);
+}
+
+// Allocate a clients roster snapshot with room for count clients.
+static inline struct client_roster* _roster_alloc(unsigned count)
+{
+    struct client_roster* roster = quick_malloc(sizeof(struct client_roster) 
+        + sizeof(struct client_node*) * count, BULB_ALLOC_ROSTER);
+    roster->count = count;
+    return roster;
+}
+
+// epoch_retire() callback for clients roster snapshots.
+static void _roster_free(void* obj)
+{
+    quick_free(obj);
+}
+
+// Publish a new clients roster snapshot from the server's client registry. The server's
+// connection update mutex must be locked.
+static void _roster_publish(struct server_node* server)
+{
+    struct client_roster* new = _roster_alloc(server->clients.count);
+    memcpy(new->clients, server->clients.clients, sizeof(struct client_node*) * server->clients.count);
+
+    struct client_roster* old = atomic_exchange(&server->roster, new);
+    epoch_retire(old, _roster_free);
 }
 
 // Read and process an object for a given client.
@@ -104,13 +137,52 @@ static bool _server_client_recv(struct server_node* server, struct client_node*
         }
         return false;
     }
+    return server_client_process(server, client, obj);
+}
+
+// Process an object read for a given client. The object is freed afterwards. Returns
+// false if the object could not be processed.
+bool server_client_process(struct server_node* server, struct client_node* client, struct bulb_obj* obj)
+{
+#ifdef SERVER
+    // Proxies only carry sessions once authenticated, see mux.h.
+    if (client->mux != NULL && obj->type != BULB_MUX)
+    {
+        pool_free(obj);
+        server_kick(server, client, "Sent an object that proxies may not send.");
+        return false;
+    }
 
-    bool is_received_obj = (obj->type == BULB_RECEIVED);
+    // Linked servers only exchange the objects needed for maintaining their link.
+    if (client->link != NULL && !links_accepts_object(obj->type))
+    {
+        pool_free(obj);
+        server_kick(server, client, "Sent an object that linked servers may not send.");
+        return false;
+    }
+
+    // Messages are subject to flood control before being processed. Messages that are
+    // not admitted are still acknowledged, as they were received successfully.
+    if (obj->type == BULB_MESSAGE)
+    {
+        enum flood_result result = flood_control_admit(server, client, (struct message_obj*)obj);
+        if (result != FLOOD_ADMITTED)
+        {
+            if (result != FLOOD_DELAYED)
+                pool_free(obj);
+            received_obj_write(client->mt_sock);
+            return true;
+        }
+    }
+#endif
+
+    enum bulb_obj_type type = obj->type;
     ASSERT(bulb_process_object(obj, server, client), return false,
-        "Failed to process Bulb object of type %d\n", obj->type);
+        "Failed to process Bulb object of type %d\n", type);
 
-    // The sending end should be notified of the successful object transmission.
-    if (!is_received_obj)
+    // The sending end should be notified of the successful object transmission. The
+    // objects carried by mux_obj are acknowledged by each session instead.
+    if (type != BULB_RECEIVED && type != BULB_MUX)
         received_obj_write(client->mt_sock);
 
     return true;
@@ -124,10 +196,11 @@ static void _server_client_send(struct server_node* server, struct client_node*
     // to allow for complete objects to be transmitted before any client disconnect
     // may be handled.
     mtx_lock(&client->mt_sock->write_lock);
-    while (!QUEUE_EMPTY(client->mt_sock->data_send_queue))
+    if (client->mt_sock->closed)
+        goto exit;
+    struct mt_socket_data_node* node;
+    while ((node = mt_socket_dequeue_send(client->mt_sock)) != NULL)
     {
-        struct mt_socket_data_node* node;
-        QUEUE_DEQUEUE(node, client->mt_sock->data_send_queue, client->mt_sock->data_send_tail);
         do
         {
             int result = mt_socket_send(client->mt_sock, node->data + node->send_offset, 
@@ -137,41 +210,210 @@ static void _server_client_send(struct server_node* server, struct client_node*
             if (result <= 0)
             {
                 // If the socket is blocking, the data node must be added back to the 
-                // start of the queue.
+                // start of its lane.
                 if (socket_errno() == SOCKET_AGAIN)
+                    mt_socket_requeue_send(client->mt_sock, node);
+                else
                 {
-                    node->prev = NULL;
-                    node->next = client->mt_sock->data_send_queue;
-                    if (node->next != NULL)
-                        node->next->prev = node;
-                    client->mt_sock->data_send_queue = node;
+                    bulb_obj_account_send_queue(client->mt_sock, -(long long)node->len, -1);
+                    pool_free(node);
                 }
-                else
-                    free(node);
                 goto exit;
             }
 
             node->send_offset += result;
         } while (node->send_offset < node->len);
-        free(node);
+        bulb_obj_account_send_queue(client->mt_sock, -(long long)node->len, -1);
+        pool_free(node);
     }
 
-    // If the data queue is now empty and the client is flagged for deletion, hint to 
+    // The data queue is now empty, so if the client is flagged for deletion, hint to 
     // the client socket's assigned socket manager instance that it should now be
     // removed from the socket manager.
-    if (QUEUE_EMPTY(client->mt_sock->data_send_queue) && client_flagged_for_deletion(client))
+    if (client_flagged_for_deletion(client))
         mt_socket_shutdown(client->mt_sock);
 exit:
     mtx_unlock(&client->mt_sock->write_lock);
 }
 
-// Each client is managed in a single centralised thread operated by the server,
-// dependent on whether a client is ready to receive & process or send an object.
+// Check if any messages held back by flood control are due to be reconsidered.
+static inline bool _server_delay_release_due(struct server_node* server, struct timespec* now)
+{
+#ifdef SERVER
+    return server->delayed_clients > 0 && timespec_cmp(now, &server->next_delay_release) >= 0;
+#else
+    return false;
+#endif
+}
+
+// Check if any batches of events for linked servers are due to be sent.
+static inline bool _server_link_flush_due(struct server_node* server, struct timespec* now)
+{
+#ifdef SERVER
+    return server->link_flush_pending && timespec_cmp(now, &server->next_link_flush) >= 0;
+#else
+    return false;
+#endif
+}
+
+// Publish how far behind the client management thread is, so that new clients can be
+// held back while the server is overloaded. The virtual servers of a host share their
+// client management thread, and thus how far behind it is.
+static void _server_publish_lag(struct server_io* io)
+{
+#ifdef SERVER
+    // Sockets are re-queued at the tail, so the head of each queue has waited longest.
+    int64_t oldest_ms = 0;
+    if (!QUEUE_EMPTY(io->socket_recv_queue))
+        oldest_ms = timespec_to_ms(&io->socket_recv_queue->recv_queue.ready_since);
+    if (!QUEUE_EMPTY(io->socket_send_queue))
+    {
+        int64_t send_ms = timespec_to_ms(&io->socket_send_queue->send_queue.ready_since);
+        oldest_ms = (oldest_ms == 0) ? send_ms : MIN(oldest_ms, send_ms);
+    }
+    for (struct server_node* server = io->nodes_head; server != NULL; server = server->io_list.next)
+    {
+        atomic_store(&server->oldest_ready_ms, oldest_ms);
+        atomic_store(&server->ready_sockets, io->socket_recv_length + io->socket_send_length);
+    }
+#endif
+}
+
+// Check if any server node of an I/O context has work due other than its sockets, or
+// if the I/O context itself is due to be freed.
+static bool _server_io_due(struct server_io* io, struct timespec* now)
+{
+    for (struct server_node* server = io->nodes_head; server != NULL; server = server->io_list.next)
+    {
+        if (server->cleanup || _server_delay_release_due(server, now) || _server_link_flush_due(server, now))
+            return true;
+    }
+    return !io->held && io->nodes_head == NULL;
+}
+
+// Bring a wake-up time forward to when any server node of an I/O context next has work
+// due other than its sockets.
+static void _server_io_next_wake(struct server_io* io, struct timespec* wake)
+{
+#ifdef SERVER
+    for (struct server_node* server = io->nodes_head; server != NULL; server = server->io_list.next)
+    {
+        if (server->delayed_clients > 0 && timespec_cmp(&server->next_delay_release, wake) < 0)
+            *wake = server->next_delay_release;
+        if (server->link_flush_pending && timespec_cmp(&server->next_link_flush, wake) < 0)
+            *wake = server->next_link_flush;
+    }
+#endif
+}
+
+// Free every server node of an I/O context that is being de-allocated from memory.
+// Returns true if the I/O context should now be freed too.
+static bool _server_io_collect(struct server_io* io)
+{
+    struct server_node* server = io->nodes_head;
+    while (server != NULL)
+    {
+        struct server_node* next = server->io_list.next;
+        if (server->cleanup)
+        {
+            LINKED_LIST_REMOVE(server, io->nodes_head, io->nodes_tail, io_list);
+#ifdef SERVER
+            ip_limiter_free(server->ip_limiter);
+            rooms_free(server);
+            links_free(server);
+            mux_free(server);
+            history_free(server);
+#endif
+            quick_free(server);
+        }
+        server = next;
+    }
+    return !io->held && io->nodes_head == NULL;
+}
+
+// Kick each client of a server node that has timed out, and ping the remaining clients
+// if ping is set.
+static void _server_check_timeouts(struct server_node* server, struct timespec* now, bool ping)
+{
+#ifdef SERVER
+    LOOP_CLIENTS(server, NULL, node,
+    {
+        // If the server has waited more than the timeout duration specified in the
+        // server info's timeout_s attribute, the client node must be kicked. The
+        // socket is kept, as kicking a session de-allocates it immediately.
+        struct mt_socket* sock = node->mt_sock;
+        mtx_lock(&node->mt_sock->write_lock);
+        struct mt_socket_timeout_node* timeout = node->mt_sock->data_send_timeout_queue;
+        bool timed_out = timeout != NULL
+            && timespec_diff(now, &timeout->send_timestamp, 0) > server->info.timeout_s;
+
+        // Slow consumers are disconnected early if their send queue stays
+        // congested for too long, or grows far beyond its high-water marks.
+        bool overloaded = (server->info.send_queue_policy & BULB_SEND_QUEUE_DISCONNECT)
+            && node->mt_sock->send_congested
+            && (timespec_diff(now, &node->mt_sock->congested_since, 0) 
+                    > server->info.send_queue_timeout_s
+                || (server->info.send_queue_high_bytes > 0 
+                    && node->mt_sock->send_queue_bytes >= 2 * (size_t)server->info.send_queue_high_bytes)
+                || (server->info.send_queue_high_objects > 0 
+                    && node->mt_sock->send_queue_objects >= 2 * server->info.send_queue_high_objects));
+        mtx_unlock(&node->mt_sock->write_lock);
+        if (overloaded && !timed_out)
+        {
+            atomic_fetch_add(&server->congestion_disconnects, 1);
+            server_kick(server, node, "Could not keep up with the server.");
+            if (sock->carrier == NULL)
+                mt_socket_shutdown(sock);
+        }
+        else if (timed_out)
+        {
+            server_kick(server, node, "Exceeded server timeout duration.");
+
+            // Immediately shut down the client's socket, as there is no successful
+            // response being made with the server. Sessions have no connection of
+            // their own to shut down.
+            if (sock->carrier == NULL)
+                mt_socket_shutdown(sock);
+        }
+
+        // If the client has not timed out, send a ping object if the ping timeout
+        // duration has also been exceeded.
+        else if (server->info.ping_clients && node->ready_to_ping && ping)
+        {
+            ping_obj_write(node->mt_sock, false);
+            node->ready_to_ping = false;
+        }
+
+        // Streams must not stall on recipients that have since disconnected.
+        stream_obj_refresh(server, node);
+    });
+#else
+    // Check if the local client has timed out.
+    struct mt_socket_timeout_node* timeout = localclient->mt_sock->data_send_timeout_queue;
+    if (timeout != NULL && localclient->userinfo != NULL
+        && (timespec_diff(now, &timeout->send_timestamp, 0)
+            > localclient->userinfo->info.timeout_s
+        ) && !client_flagged_for_deletion(localclient))
+    {
+        bulb_printf_type(localclient, STDOUT_KICK_MSG,
+            "Client timed out while attempting to send data to server!\n");
+        server_disconnect_client(server, localclient, false, true, true);
+        
+        // Immediately shut down the client's socket, as there is no successful
+        // response being made with the server.
+        mt_socket_shutdown(localclient->mt_sock);
+    }
+#endif
+}
+
+// Each client is managed in a single centralised thread operated by the server's I/O
+// context, dependent on whether a client is ready to receive & process or send an
+// object. The virtual servers of a host share this thread.
 static int _server_manage_thread(void* s)
 {
     // TODO post-v1: consider SPSC ring buffers before IOCP/epoll overhaul?
 
-    struct server_node* server = (struct server_node*)s;
+    struct server_io* io = (struct server_io*)s;
     struct timespec next_timeout_check;
     struct timespec next_ping;
     timespec_get(&next_timeout_check, TIME_UTC);
@@ -182,133 +424,126 @@ static int _server_manage_thread(void* s)
     for (;;)
     {
         // Wait for any updates from any client, or after a second has elapsed for
-        // managing client timeout.
+        // managing client timeout. The manage thread must not be in a critical section
+        // while waiting, as it would otherwise prevent client nodes from being reclaimed.
         struct timespec current_timestamp;
         int timeout_sec_diff;
-        mtx_lock(&server->client_update_lock);
+        mtx_lock(&io->client_update_lock);
         timespec_get(&current_timestamp, TIME_UTC);
-        while (QUEUE_EMPTY(server->socket_recv_queue) && QUEUE_EMPTY(server->socket_send_queue)
-            && (timeout_sec_diff = timespec_diff(&current_timestamp, &next_timeout_check, 0)) < 0
-            && !server->cleanup)
+        while ((timeout_sec_diff = timespec_diff(&current_timestamp, &next_timeout_check, 0)) < 0
+            && QUEUE_EMPTY(io->socket_recv_queue) && QUEUE_EMPTY(io->socket_send_queue)
+            && !_server_io_due(io, &current_timestamp))
         {
-            cnd_timedwait(&server->client_update_signal, &server->client_update_lock, &next_timeout_check);
+            struct timespec wake = next_timeout_check;
+            _server_io_next_wake(io, &wake);
+            cnd_timedwait(&io->client_update_signal, &io->client_update_lock, &wake);
             timespec_get(&current_timestamp, TIME_UTC);
         }
 
-        // If the server node object is being de-allocated from memory, terminate
-        // this thread.
-        if (server->cleanup)
+        // Free any server node that is being de-allocated from memory, and terminate
+        // this thread once the I/O context itself is no longer needed.
+        if (_server_io_collect(io))
         {
-            cnd_destroy(&server->client_update_signal);
-            mtx_unlock(&server->client_update_lock);
-            mtx_destroy(&server->client_update_lock);
-            free(server);
+            cnd_destroy(&io->client_update_signal);
+            mtx_unlock(&io->client_update_lock);
+            mtx_destroy(&io->client_update_lock);
+            quick_free(io);
             return 0;
         }
+
+        // Any client node processed in this iteration must remain valid until the
+        // iteration is complete, even if it is disconnected in the meantime.
+        epoch_enter();
+
+#ifdef SERVER
+        for (struct server_node* server = io->nodes_head; server != NULL; server = server->io_list.next)
+        {
+            // Process any messages held back by flood control that can now be sent.
+            if (_server_delay_release_due(server, &current_timestamp))
+            {
+                flood_control_release(server);
+                server->next_delay_release = current_timestamp;
+                timespec_add_ms(&server->next_delay_release, FLOOD_RELEASE_INTERVAL_MS);
+            }
+
+            // Send any batches of events for linked servers that are now due.
+            if (_server_link_flush_due(server, &current_timestamp))
+                links_flush(server);
+        }
+#endif
         
         // Handle timeout.
         if (timeout_sec_diff >= 0)
         {
             next_timeout_check.tv_sec += timeout_sec_diff + 1;
 
-#ifdef SERVER
+            // Release any disconnected client nodes that can no longer be referenced.
+            // This is attempted once a second, as each retired client node requires 
+            // two advances of the global epoch before it can be released.
+            epoch_exit();
+            epoch_collect();
+            epoch_enter();
+
             // Check for whether to ping each client, which should take place every 5 
             // seconds.
             int ping_sec_diff = timespec_diff(&current_timestamp, &next_ping, 0);
             if (ping_sec_diff >= 0)
                 next_ping.tv_sec += 5 * (ping_sec_diff / 5 + 1);
-
-            // Clients being kicked must be linked separately as disconnecting clients
-            // within LOOP_CLIENTS() will cause undefined behaviour due to LOOP_CLIENTS()
-            // relying on the clients trie, which would otherwise be modified during
-            // iteration. Each client node's next/prev pointers should not be actively
-            // used at this point. This behaviour may be amended in the future.
-            struct client_node* to_kick_head = NULL;
-            struct client_node* to_kick_tail = NULL;
-
-            LOOP_CLIENTS(server, NULL, node,
-            {
-                // If the server has waited more than the timeout duration specified in the
-                // server info's timeout_s attribute, the client node must be kicked.
-                struct mt_socket_timeout_node* timeout = node->mt_sock->data_send_timeout_queue;
-                if (timeout != NULL && (timespec_diff(&current_timestamp, &timeout->send_timestamp, 0) 
-                    > server->info.timeout_s))
-                {
-                    LINKED_LIST_ADD(node, to_kick_head, to_kick_tail);
-                }
-
-                // If the client has not timed out, send a ping object if the ping timeout
-                // duration has also been exceeded.
-                else if (server->info.ping_clients && node->ready_to_ping && ping_sec_diff >= 0)
-                {
-                    ping_obj_write(node->mt_sock, false);
-                    node->ready_to_ping = false;
-                }
-            });
-
-            struct client_node* to_kick = to_kick_head;
-            while (to_kick != NULL)
-            {
-                struct client_node* next = to_kick->next;
-                server_kick(server, to_kick, "Exceeded server timeout duration.");
-
-                // Immediately shut down the client's socket, as there is no successful
-                // response being made with the server.
-                mt_socket_shutdown(to_kick->mt_sock);
-                
-                to_kick = next;
-            }
-#else
-            // Check if the local client has timed out.
-            struct mt_socket_timeout_node* timeout = localclient->mt_sock->data_send_timeout_queue;
-            if (timeout != NULL && localclient->userinfo != NULL
-                && (timespec_diff(&current_timestamp, &timeout->send_timestamp, 0)
-                    > localclient->userinfo->info.timeout_s
-                ) && !client_flagged_for_deletion(localclient))
-            {
-                bulb_printf_type(localclient, STDOUT_KICK_MSG,
-                    "Client timed out while attempting to send data to server!\n");
-                server_disconnect_client(server, localclient, false, true, true);
-                
-                // Immediately shut down the client's socket, as there is no successful
-                // response being made with the server.
-                mt_socket_shutdown(localclient->mt_sock);
-            }
-#endif
+            for (struct server_node* server = io->nodes_head; server != NULL; server = server->io_list.next)
+                _server_check_timeouts(server, &current_timestamp, ping_sec_diff >= 0);
         }
 
+        // The lag is published both before and after processing, so that it keeps growing
+        // while a single iteration stalls, and drops back to 0 once both queues are empty.
+        _server_publish_lag(io);
+
         // Dequeue a socket from the read queue and attempt to read an object from it.
         struct mt_socket* selected;
-        if (!QUEUE_EMPTY(server->socket_recv_queue))
+        if (!QUEUE_EMPTY(io->socket_recv_queue))
         {
-            QUEUE_DEQUEUE(selected, server->socket_recv_queue, server->socket_recv_tail, recv_queue);
-
-            // In order to trigger the next read event, the socket should be added
-            // back to the recv() queue if an object was read and processed successfully.
-            if (_server_client_recv(server, selected->parent_client))
-                QUEUE_ENQUEUE(selected, server->socket_recv_queue, server->socket_recv_tail, recv_queue);
+            QUEUE_DEQUEUE(selected, io->socket_recv_queue, io->socket_recv_tail, recv_queue);
+            io->socket_recv_length--;
+
+            // Sockets left behind by a freed server node have no client, and only need
+            // to be closed. Otherwise, in order to trigger the next read event, the
+            // socket should be added back to the recv() queue if an object was read and
+            // processed successfully.
+            struct client_node* client = selected->parent_client;
+            if (client == NULL)
+                mt_socket_flag_ready_for_closure(selected);
+            else if (_server_client_recv(client->server_node, client))
+            {
+                QUEUE_ENQUEUE(selected, io->socket_recv_queue, io->socket_recv_tail, recv_queue);
+                timespec_ns_get(&selected->recv_queue.ready_since);
+                io->socket_recv_length++;
+            }
         }
             
         // Dequeue a socket from the write queue and attempt to write an object to it.
-        if (!QUEUE_EMPTY(server->socket_send_queue))
+        if (!QUEUE_EMPTY(io->socket_send_queue))
         {
-            QUEUE_DEQUEUE(selected, server->socket_send_queue, server->socket_send_tail, send_queue);
-            _server_client_send(server, selected->parent_client);
+            QUEUE_DEQUEUE(selected, io->socket_send_queue, io->socket_send_tail, send_queue);
+            io->socket_send_length--;
+            struct client_node* client = selected->parent_client;
+            if (client != NULL)
+                _server_client_send(client->server_node, client);
         }
 
         // Unlock the client update lock and continue.
-        mtx_unlock(&server->client_update_lock);
+        _server_publish_lag(io);
+        epoch_exit();
+        mtx_unlock(&io->client_update_lock);
     }
 }
 
 // Manage the removal of a socket from a socket manager instance.
 void _server_sm_manage_socket_removal(struct socket_manager* sm)
 {
-    struct server_node* server = (struct server_node*)sm->parent_server;
+    struct server_io* io = (struct server_io*)sm->parent_server;
 
     // Loop through each socket manager instance that isn't the current instance, and
     // attempt to complete a merger.
-    LOOP_SOCKET_MANAGERS(server->sm_head, sm, other,
+    LOOP_SOCKET_MANAGERS(io->sm_head, sm, other,
     {
         if (sm_merge(sm, other))
             return;
@@ -318,39 +553,87 @@ void _server_sm_manage_socket_removal(struct socket_manager* sm)
 // Manage the deletion of a socket manager instance.
 void _server_sm_manage_deallocation(struct socket_manager* sm)
 {
-    struct server_node* server = (struct server_node*)sm->parent_server;
-    LINKED_LIST_REMOVE(sm, server->sm_head, server->sm_tail);
+    struct server_io* io = (struct server_io*)sm->parent_server;
+    LINKED_LIST_REMOVE(sm, io->sm_head, io->sm_tail);
+}
+
+// Create a new I/O context, which is held until server_io_release() is called.
+struct server_io* server_io_new()
+{
+    struct server_io* io = quick_malloc(sizeof(struct server_io), BULB_ALLOC_GENERAL);
+    mtx_init(&io->client_update_lock, mtx_plain | mtx_recursive);
+    cnd_init(&io->client_update_signal);
+    io->held = true;
+    thrd_create(&io->client_manage_thread, _server_manage_thread, io);
+    return io;
+}
+
+// Release an I/O context, which is freed once every one of its server nodes has been
+// freed.
+void server_io_release(struct server_io* io)
+{
+    mtx_lock(&io->client_update_lock);
+    io->held = false;
+    cnd_broadcast(&io->client_update_signal);
+    mtx_unlock(&io->client_update_lock);
 }
 
-// Initialise the server node.
-struct server_node* server_shared_node_alloc()
+// Initialise the server node. Its clients are managed by the given I/O context, or by
+// an I/O context of its own if io is NULL.
+struct server_node* server_shared_node_alloc(struct server_io* io)
 {
-    struct server_node* server = quick_malloc(sizeof(struct server_node));
+    struct server_node* server = quick_malloc(sizeof(struct server_node), BULB_ALLOC_GENERAL);
     mtx_init(&server->connection_update_mutex, (mtx_plain | mtx_recursive));
     mtx_init(&server->server_emptied_mutex, mtx_plain);
     cnd_init(&server->server_emptied_signal);
-
-    mtx_init(&server->client_update_lock, mtx_plain | mtx_recursive);
-    cnd_init(&server->client_update_signal);
-    thrd_create(&server->client_manage_thread, _server_manage_thread, server);
     
-    server->clients = trie_new();
+    client_registry_init(&server->clients);
+    atomic_init(&server->roster, _roster_alloc(0));
+    rooms_init(server);
     server->clients_info_head = server->clients_info_tail = &server->info;
+
+    // A private I/O context is released at once, so that it is freed along with the
+    // server node.
+    server->io = (io != NULL) ? io : server_io_new();
+    mtx_lock(&server->io->client_update_lock);
+    LINKED_LIST_ADD(server, server->io->nodes_head, server->io->nodes_tail, io_list);
+    mtx_unlock(&server->io->client_update_lock);
+    if (io == NULL)
+        server_io_release(server->io);
     return server;
 }
 
+// Count a newly connected client towards the server's capacity, disconnecting it if the
+// server is full.
+static void _server_admit_client(struct server_node* server, struct client_node* client)
+{
+    server->number_connected++;
+
+    // Is the server currently at its max capacity?
+    if (server->info.max_clients > 0 && server->number_connected > server->info.max_clients)
+    {
+        char message[256];
+        snprintf(message, sizeof(message), "The server is currently full (max clients: %u).\n",
+            server->info.max_clients);
+        stdout_obj_write(client->mt_sock, message, STDOUT_KICK_MSG);
+        server_disconnect_client(server, client, true, true, true);
+    }
+}
+
 // Begin listening to a client's socket. The client's socket object will be
 // automatically released from memory as soon as it is disused.
 void server_listen_client(struct server_node* server, struct client_node* client)
 {
     // Link the client's mt_socket instance to the client and its queues.
     client->mt_sock->parent_client = client;
-    client->mt_sock->recv_queue.queue = &server->socket_recv_queue;
-    client->mt_sock->recv_queue.tail = &server->socket_recv_tail;
-    client->mt_sock->send_queue.queue = &server->socket_send_queue;
-    client->mt_sock->send_queue.tail = &server->socket_send_tail;
-    client->mt_sock->ready_signal = &server->client_update_signal;
-    client->mt_sock->update_lock = &server->client_update_lock;
+    client->mt_sock->recv_queue.queue = &server->io->socket_recv_queue;
+    client->mt_sock->recv_queue.tail = &server->io->socket_recv_tail;
+    client->mt_sock->send_queue.queue = &server->io->socket_send_queue;
+    client->mt_sock->send_queue.tail = &server->io->socket_send_tail;
+    client->mt_sock->recv_queue.length = &server->io->socket_recv_length;
+    client->mt_sock->send_queue.length = &server->io->socket_send_length;
+    client->mt_sock->ready_signal = &server->io->client_update_signal;
+    client->mt_sock->update_lock = &server->io->client_update_lock;
 
     // Configure the client's socket to be non-blocking and start provoking
     // recv()/send() operations by adding the client socket to the socket
@@ -362,20 +645,12 @@ void server_listen_client(struct server_node* server, struct client_node* client
     // client is disconnected at this point, there must still be brief
     // communication for e.g. alerting the user as to why their connection
     // attempt was rejected.
-    server->number_connected++;
-
-    // Is the server currently at its max capacity?
-    if (server->info.max_clients > 0 && server->number_connected > server->info.max_clients)
-    {
-        char message[256];
-        snprintf(message, sizeof(message), "The server is currently full (max clients: %u).\n",
-            server->info.max_clients);
-        stdout_obj_write(client->mt_sock, message, STDOUT_KICK_MSG);
-        server_disconnect_client(server, client, true, true, true);
-    }
+    _server_admit_client(server, client);
 
-    // Configure a socket manager instance to listen to the client's socket.
-    struct socket_manager* sm = server->sm_head;
+    // Configure a socket manager instance to listen to the client's socket. The socket
+    // managers of an I/O context are shared by each of its server nodes.
+    mtx_lock(&server->io->client_update_lock);
+    struct socket_manager* sm = server->io->sm_head;
     bool added = false;
     while (sm != NULL)
     {
@@ -389,27 +664,58 @@ void server_listen_client(struct server_node* server, struct client_node* client
     if (!added)
     {
         sm = sm_new();
-        sm->parent_server = server;
-        sm->update_lock = &server->client_update_lock;
+        sm->parent_server = server->io;
+        sm->update_lock = &server->io->client_update_lock;
         sm->removed_func = _server_sm_manage_socket_removal;
         sm->dealloc_func = _server_sm_manage_deallocation;
         sm_add(sm, client->mt_sock);
         sm_listen(sm);
-        LINKED_LIST_ADD(sm, server->sm_head, server->sm_tail);
+        LINKED_LIST_ADD(sm, server->io->sm_head, server->io->sm_tail);
     }
+    mtx_unlock(&server->io->client_update_lock);
 
     // Flag the socket as ready for recv(). This is required so as to immediately
     // begin reading any objects on the socket.
     mt_socket_flag_ready_for_recv(client->mt_sock);
 }
 
-// Connect a new client to a server node's clients list.
-void server_connect_client(struct server_node* server, struct client_node* client)
+// Move a client that has yet to authenticate to another server node sharing the same
+// I/O context, counting it towards the other server node's capacity instead. The
+// client is disconnected if the other server node is full.
+void server_move_client(struct server_node* server, struct client_node* client, struct server_node* to)
+{
+#ifdef SERVER
+    server->number_connected--;
+    client->server_node = to;
+    flood_control_init(to, client);
+    _server_admit_client(to, client);
+#endif
+}
+
+// Begin handling a client's session, which is multiplexed over the connection of a
+// proxy rather than listened to, see mux.h.
+void server_listen_session(struct server_node* server, struct client_node* client)
+{
+    client->mt_sock->parent_client = client;
+    client->mt_sock->update_lock = &server->io->client_update_lock;
+    _server_admit_client(server, client);
+}
+
+// Connect a new client to a server node's clients list. Returns false if another client
+// is already connected with the same name.
+bool server_connect_client(struct server_node* server, struct client_node* client)
 {
     // The client node should already have its socket and userinfo configured.
 
+    mtx_lock(&server->connection_update_mutex);
+    if (!client_registry_add(&server->clients, client))
+    {
+        mtx_unlock(&server->connection_update_mutex);
+        return false;
+    }
     LINKED_LIST_ADD(&client->userinfo->info, server->clients_info_head, server->clients_info_tail);
-    trie_add(server->clients, client->userinfo->info.name, client);
+    _roster_publish(server);
+    mtx_unlock(&server->connection_update_mutex);
 
 #ifdef CLIENT
     // Clients are not responsible for managing the socket of each connected client,
@@ -420,6 +726,7 @@ void server_connect_client(struct server_node* server, struct client_node* clien
 #endif
 
     // See further client connection (i.e. authentication) code in msg_obj/userinfo_obj.c.
+    return true;
 }   
 
 // Start disconnecting a client from a server node's clients list.
@@ -429,13 +736,21 @@ void server_disconnect_client(struct server_node* server,
                               bool unlink,
                               bool server_shutdown)
 {
+    // Rooms and streams are only accessed while the client update lock is held. Any
+    // streams that the client was sending are aborted first, as this may require
+    // looking up their recipients.
+    mtx_lock(&server->io->client_update_lock);
+    stream_obj_abort_all(server, client);
+
+    epoch_enter();
     mtx_lock(&server->connection_update_mutex);
 
 #ifdef SERVER
     // If the client did not fail server authentication checks, log whether it disconnected 
     // or if the client attempted to connect but a connection could not be established to 
-    // begin with.
-    if (print_msg)
+    // begin with. Linked servers and proxies log their departure in links_close() and
+    // mux_close() instead.
+    if (print_msg && client->link == NULL && client->mux == NULL)
     {
         if (client->userinfo != NULL)
         {
@@ -448,19 +763,27 @@ void server_disconnect_client(struct server_node* server,
             char buffer[64 + MAX_NAME_LENGTH];
             snprintf(buffer, sizeof(buffer), "Client \"%s\" has disconnected\n",
                 client->userinfo->info.name);
-            LOOP_CLIENTS(server, client, node, stdout_obj_write(node->mt_sock, buffer, STDOUT_GENERIC));
+            LOOP_ROOM(client->room, client, node, stdout_obj_write(node->mt_sock, buffer, STDOUT_GENERIC));
         }
         else
             bulb_printf(server, "Client from address %s failed to connect\n", 
                 client->ip_addr);
     }
 
-    // Synchronise the client's departure with all other clients.
+    // Synchronise the client's departure with the other members of its room.
     if (client->status >= CLIENT_VALIDATED)
     {
-        LOOP_CLIENTS(server, client, node, 
+        LOOP_ROOM(client->room, client, node, 
             disconnect_obj_write(node->mt_sock, client->userinfo->info.name, server_shutdown));
     }
+    if (client->room != NULL && !CLIENT_IS_REMOTE(client))
+    {
+        links_client_left(server, client);
+        history_user_seen(server, client);
+    }
+    room_leave(server, client);
+    links_close(server, client, print_msg);
+    mux_close(server, client, print_msg);
 #endif
 
     // By default, unlink should be toggled as server_disconnect_client should only be
@@ -471,19 +794,47 @@ void server_disconnect_client(struct server_node* server,
     {
         if (client->userinfo)
         {
-            trie_delete(server->clients, client->userinfo->info.name);
-            LINKED_LIST_REMOVE(&client->userinfo->info, server->clients_info_head, 
-                server->clients_info_tail);
+            if (client_registry_remove(&server->clients, client))
+            {
+                LINKED_LIST_REMOVE(&client->userinfo->info, server->clients_info_head, 
+                    server->clients_info_tail);
+                _roster_publish(server);
+            }
         }
-        LINKED_LIST_ADD(client, server->flagged_clients_list, server->flagged_clients_list_tail);
+        atomic_store(&client->unlinked, true);
     }
 
-    server->number_connected--;
-    if (server_shutdown)
-        client->exit_is_orderly = true;
-    _client_flag_for_deletion(client, server_shutdown);
+    // Clients connected to other servers have no socket to wait on, so they are ready to
+    // delete as soon as they are unlinked.
+    if (CLIENT_IS_REMOTE(client))
+    {
+        mtx_lock(&client->client_status_lock);
+        client->status = CLIENT_READY_TO_DELETE;
+        mtx_unlock(&client->client_status_lock);
+    }
+    else
+    {
+        server->number_connected--;
+        if (server_shutdown)
+            client->exit_is_orderly = true;
+        _client_flag_for_deletion(client, server_shutdown);
+
+#ifdef SERVER
+        // Sessions have nothing left to send of their own once their disconnection has
+        // been sent through their carrier.
+        if (client->mt_sock != NULL && client->mt_sock->carrier != NULL)
+            mux_session_closed(server, client);
+#endif
+    }
 
     mtx_unlock(&server->connection_update_mutex);
+
+    // The client node is freed once its socket has been de-allocated and no other
+    // thread can still reference it.
+    if (unlink)
+        client_try_retire(client);
+    epoch_exit();
+    mtx_unlock(&server->io->client_update_lock);
 }
 
 // Check if a client is connected without iterating through the entire list of clients.
@@ -492,13 +843,29 @@ struct client_node* server_find_by_name(struct server_node* server, const char*
 {
     if (strlen(name) > MAX_NAME_LENGTH)
         return NULL;
-    return trie_find(server->clients, name);
+
+    mtx_lock(&server->connection_update_mutex);
+    struct client_node* client = client_registry_find(&server->clients, name);
+    mtx_unlock(&server->connection_update_mutex);
+    return client;
 }
 
 // Kick a client. This should be called from server code only.
 void server_kick(struct server_node* server, struct client_node* client, const char* msg)
 {
 #ifdef SERVER
+    // Linked servers and proxies are not clients, so they are not reported to any room.
+    if (client->link != NULL)
+    {
+        links_kick(server, client, msg);
+        return;
+    }
+    if (client->mux != NULL)
+    {
+        mux_kick(server, client, msg);
+        return;
+    }
+
     // Log the client's departure in the server console.
     bulb_printf(server, "Client \"%s\" (%s) has been kicked from the server%s%s\n", 
         client->userinfo->info.name, client->ip_addr, (strlen(msg) > 0 ? ": " : "."), msg);
@@ -509,13 +876,15 @@ void server_kick(struct server_node* server, struct client_node* client, const c
         (strlen(msg) > 0 ? ": " : "."), msg);
     stdout_obj_write(client->mt_sock, buffer, STDOUT_KICK_MSG);
 
-    // Write to all other clients that this user has been kicked.
+    // Write to the other members of the client's room that this user has been kicked.
     snprintf(buffer, sizeof(buffer), "Client \"%s\" has been kicked from the server%s%s\n",
         client->userinfo->info.name, (strlen(msg) > 0 ? ": " : "."), msg);
-    LOOP_CLIENTS(server, client, node, stdout_obj_write(node->mt_sock, buffer, STDOUT_GENERIC));
+    mtx_lock(&server->io->client_update_lock);
+    LOOP_ROOM(client->room, client, node, stdout_obj_write(node->mt_sock, buffer, STDOUT_GENERIC));
 
     // Start disconnecting the client.
     server_disconnect_client(server, client, false, true, true);
+    mtx_unlock(&server->io->client_update_lock);
     return;
 #endif
 
@@ -548,43 +917,53 @@ bool server_unban(struct server_node* server, const char* ip_addr)
     ASSERT(false, return false);
 }
 
-// Disconnect a client that is flagged for deletion.
-void server_free_flagged_client(struct server_node* server, struct client_node* client)
-{
-    ASSERT(client->status == CLIENT_READY_TO_DELETE, return, 
-        "Attempted to delete client \"%s\", which is not ready to delete!", client->userinfo->info.name);
-
-    LINKED_LIST_REMOVE(client, server->flagged_clients_list, server->flagged_clients_list_tail);
-    _client_close(client);
-}
-
-// Disconnect any clients that are flagged for deletion.
-void server_free_flagged_clients(struct server_node* server)
-{
-    struct client_node* node = server->flagged_clients_list;
-    while (node != NULL)
-    {
-        struct client_node* next = node->next;
-        if (node->status == CLIENT_READY_TO_DELETE)
-            server_free_flagged_client(server, node);
-        node = next;
-    }
-}
-
 // Disconnect all connected clients from a server node's clients list. This will free
 // all client nodes from memory. This should only be called when the Bulb protocol is
 // being terminated as it frees the server node from memory.
 void server_disconnect_all_clients(struct server_node* server)
 {
-    mtx_lock(&server->client_update_lock);
+    mtx_lock(&server->io->client_update_lock);
 
-    TRIE_DFS(server->clients, node,
+    // Client nodes that were unlinked are instead freed through client_try_retire(),
+    // with the exception of the local client node on client code.
+#ifdef CLIENT
+    if (atomic_load(&localclient->unlinked))
+        _client_close(localclient);
+#endif
+    for (unsigned i = 0; i < server->clients.count; i++)
     {
-        struct client_node* client = (struct client_node*)node;
-        _client_flag_for_deletion(client, false);
+        struct client_node* client = server->clients.clients[i];
+        if (!CLIENT_IS_REMOTE(client))
+            _client_flag_for_deletion(client, false);
         _client_close(client);
-    });
-    trie_free(server->clients);
+    }
+    client_registry_free(&server->clients);
+    quick_free(atomic_load(&server->roster));
+
+#ifdef SERVER
+    // Linked servers and proxies are never added to the clients list, so their client
+    // nodes are closed separately. Their links and carriers are freed along with the
+    // server node.
+    for (struct server_link* link = server->links_head; link != NULL; link = link->next)
+    {
+        if (atomic_load(&link->node->unlinked))
+            continue;
+        _client_flag_for_deletion(link->node, false);
+        _client_close(link->node);
+    }
+    for (struct mux_carrier* carrier = server->mux_head; carrier != NULL; carrier = carrier->next)
+    {
+        if (atomic_load(&carrier->node->unlinked))
+            continue;
+        _client_flag_for_deletion(carrier->node, false);
+        _client_close(carrier->node);
+    }
+#endif
+
+    // Attempt to release any client nodes that are still pending reclamation. Each
+    // retired object is released after at most three advances of the global epoch.
+    for (int i = 0; i < 3; i++)
+        epoch_collect();
 
     mtx_destroy(&server->connection_update_mutex);
     mtx_destroy(&server->server_emptied_mutex);
@@ -593,6 +972,6 @@ void server_disconnect_all_clients(struct server_node* server)
     // Signal to the central client management thread that the server must be
     // de-allocated.
     server->cleanup = true;
-    cnd_broadcast(&server->client_update_signal);
-    mtx_unlock(&server->client_update_lock);
+    cnd_broadcast(&server->io->client_update_signal);
+    mtx_unlock(&server->io->client_update_lock);
 }
\ No newline at end of file
@@ -7,34 +7,148 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "unisock.h"
 #include "networking.h"
 #include "trie.h"
+#include "epoch.h"
 #include "bulb_structs.h"
 #include "shared_interface.h"
 #include "client_node.h"   
+#include "client_registry.h"
 
-// Clients should NOT be disconnected/kicked from the server within this loop!
+// This loop iterates over an immutable snapshot of the clients roster without locking,
+// so clients may be disconnected/kicked from the server within this loop. Clients that
+// join or leave during the loop may or may not be visited. Clients connected to other
+// servers are never visited, as they have no socket.
 #define LOOP_CLIENTS(SERVER, EXCEPT, ID, SCOPE)                                 \
     {                                                                           \
-        mtx_lock(&SERVER->connection_update_mutex);                             \
-        TRIE_DFS(SERVER->clients, trie##ID,                                     \
+        epoch_enter();                                                          \
+        struct client_roster* roster##ID = atomic_load(&SERVER->roster);        \
+        for (unsigned i##ID = 0; i##ID < roster##ID->count; i##ID++)            \
         {                                                                       \
-            struct client_node* ID = (struct client_node*)trie##ID;             \
-            if (ID != EXCEPT && ID->status == CLIENT_VALIDATED)                 \
+            struct client_node* ID = roster##ID->clients[i##ID];                \
+            if (ID != EXCEPT && ID->status == CLIENT_VALIDATED                  \
+                && !CLIENT_IS_REMOTE(ID))                                       \
                 SCOPE;                                                          \
-        });                                                                     \
-        mtx_unlock(&SERVER->connection_update_mutex);                           \
+        }                                                                       \
+        epoch_exit();                                                           \
     }                                                                  
 
+// An immutable snapshot of every connected client. A new snapshot is published
+// whenever a client joins or leaves, while the previous snapshot is retired once no
+// LOOP_CLIENTS() iteration can still be using it.
+struct client_roster
+{
+    unsigned count;
+    struct client_node* clients[];
+};
+
+// The client management thread and socket manager instances that manage the clients of
+// one or more server nodes. Each server node normally has an I/O context of its own,
+// whereas the virtual servers of a host share one, see bulb_host.h. These fields are
+// only accessed while the client update lock is held.
+struct server_io
+{
+    thrd_t client_manage_thread;
+    mtx_t client_update_lock;
+    cnd_t client_update_signal;
+    struct mt_socket* socket_recv_queue;
+    struct mt_socket* socket_recv_tail;
+    struct mt_socket* socket_send_queue;
+    struct mt_socket* socket_send_tail;
+    unsigned socket_recv_length;
+    unsigned socket_send_length;
+    struct socket_manager* sm_head;
+    struct socket_manager* sm_tail;
+
+    // Server nodes managed by this I/O context. The I/O context is freed once it is no
+    // longer held by its owner and every one of its server nodes has been freed.
+    struct server_node* nodes_head;
+    struct server_node* nodes_tail;
+    bool held;
+};
+
 struct bulb_server;
+struct ip_limiter;
+struct parked_connection;
+struct room;
+struct server_link;
+struct mux_carrier;
+struct history;
+struct bulb_obj;
 
 struct server_node
 {
 #ifdef SERVER
     struct bulb_server* bulb_server;
     SOCKET listen_sock;
+
+    // Per-address connection limits, which are checked upon accept.
+    struct ip_limiter* ip_limiter;
+
+    // Every room keyed by name, including the lobby, see rooms.h.
+    struct trie* rooms;
+    struct room* lobby;
+
+    // Connection statistics, see struct bulb_server_stats.
+    atomic_uint_fast64_t accepted_connections;
+    atomic_uint_fast64_t rejected_connections;
+    atomic_uint_fast64_t limited_connections;
+    atomic_uint_fast64_t dropped_objects;
+    atomic_uint_fast64_t conflated_objects;
+    atomic_uint_fast64_t congestion_disconnects;
+
+    // Number of clients with messages held back by flood control, and when those
+    // messages are next reconsidered. Only used by the client management thread.
+    unsigned delayed_clients;
+    struct timespec next_delay_release;
+
+    // How far behind the client management thread is, published after each iteration
+    // for the listen thread: the number of sockets waiting to be processed, and the
+    // monotonic time in milliseconds at which the longest waiting socket became ready,
+    // or 0 if none are waiting.
+    atomic_uint ready_sockets;
+    atomic_int_fast64_t oldest_ready_ms;
+
+    // Admission queue statistics, see struct bulb_server_stats.
+    atomic_uint parked_connections;
+    atomic_uint_fast64_t busy_connections;
+
+    // New connections held back while the server is overloaded. Only accessed by the
+    // listen thread, or by the listen thread of the server's host while the host's lock
+    // is held.
+    struct parked_connection* parked;
+    unsigned parked_capacity;
+    unsigned parked_count;
+    int64_t next_admission_ms;
+
+    // Links to other servers, see links.h. Events bound for linked servers are batched,
+    // and every batch is next flushed at next_link_flush. These are only accessed while
+    // the client update lock is held.
+    struct server_link* links_head;
+    struct server_link* links_tail;
+    struct trie* link_origins;
+    uint64_t link_instance;
+    uint32_t link_seq;
+    bool link_flush_pending;
+    struct timespec next_link_flush;
+
+    // Connections of proxies carrying client sessions, see mux.h. These are only
+    // accessed while the client update lock is held.
+    struct mux_carrier* mux_head;
+    struct mux_carrier* mux_tail;
+
+    // Recent messages and the users seen by the server, see history.h. These are only
+    // accessed while the client update lock is held.
+    struct history* history;
+#else
+    // The room that the local client is a member of.
+    char room[MAX_ROOM_NAME_LENGTH + 1];
+
+    // ID of the next direct message sent by the local client.
+    atomic_uint_fast32_t next_direct_id;
 #endif
 
     // Server information.
@@ -46,41 +160,61 @@ struct server_node
     mtx_t server_emptied_mutex;
     cnd_t server_emptied_signal;
 
-    // Client socket communication architecture.
-    thrd_t client_manage_thread;
-    mtx_t client_update_lock;
-    cnd_t client_update_signal;
+    // Client socket communication architecture, which may be shared with other server
+    // nodes. The server node is freed by the client management thread once cleanup is
+    // set.
+    struct server_io* io;
     bool cleanup;
-    struct mt_socket* socket_recv_queue;
-    struct mt_socket* socket_recv_tail;
-    struct mt_socket* socket_send_queue;
-    struct mt_socket* socket_send_tail;
-    struct socket_manager* sm_head;
-    struct socket_manager* sm_tail;
-
-    // Dictionary of actual connected clients.
-    struct trie* clients;
+    struct
+    {
+        struct server_node* prev;
+        struct server_node* next;
+        bool linked;
+    } io_list;
+
+    // Registry of actual connected clients, and the current snapshot of the clients 
+    // roster. Both are only modified while connection_update_mutex is locked.
+    struct client_registry clients;
+    _Atomic(struct client_roster*) roster;
 
     // List of clients' userinfo objects.
     struct bulb_userinfo* clients_info_head;
     struct bulb_userinfo* clients_info_tail;
-    
-    // List of clients flagged for deletion.
-    struct client_node* flagged_clients_list;
-    struct client_node* flagged_clients_list_tail;
 };
 
 typedef void (*loop_clients_func)(struct server_node* server, struct client_node* client);
 
-// Initialise the server node.
-struct server_node* server_shared_node_alloc();
+// Create a new I/O context, which is held until server_io_release() is called.
+struct server_io* server_io_new();
+
+// Release an I/O context, which is freed once every one of its server nodes has been
+// freed.
+void server_io_release(struct server_io* io);
+
+// Initialise the server node. Its clients are managed by the given I/O context, or by
+// an I/O context of its own if io is NULL.
+struct server_node* server_shared_node_alloc(struct server_io* io);
 
 // Begin listening to a client's socket. The client's socket object will be
 // automatically released from memory as soon as it is disused.
 void server_listen_client(struct server_node* server, struct client_node* client);
 
-// Connect a new client to a server node's clients list.
-void server_connect_client(struct server_node* server, struct client_node* client);
+// Move a client that has yet to authenticate to another server node sharing the same
+// I/O context, counting it towards the other server node's capacity instead. The
+// client is disconnected if the other server node is full.
+void server_move_client(struct server_node* server, struct client_node* client, struct server_node* to);
+
+// Begin handling a client's session, which is multiplexed over the connection of a
+// proxy rather than listened to, see mux.h.
+void server_listen_session(struct server_node* server, struct client_node* client);
+
+// Process an object read for a given client. The object is freed afterwards. Returns
+// false if the object could not be processed.
+bool server_client_process(struct server_node* server, struct client_node* client, struct bulb_obj* obj);
+
+// Connect a new client to a server node's clients list. Returns false if another client
+// is already connected with the same name.
+bool server_connect_client(struct server_node* server, struct client_node* client);
 
 // Start disconnecting a client from a server node's clients list.
 void server_disconnect_client(struct server_node* server, 
@@ -90,7 +224,8 @@ void server_disconnect_client(struct server_node* server,
                               bool server_shutdown);
 
 // Check if a client is connected without iterating through the entire list of clients.
-// Returns the client node if found, othewrise NULL.
+// Returns the client node if found, othewrise NULL. The client node is only guaranteed
+// to remain valid within an epoch critical section.
 struct client_node* server_find_by_name(struct server_node* server, const char* name);
 
 // Loop through each client.
@@ -108,12 +243,6 @@ bool server_ban(struct server_node* server, const char* ip_addr, const char* rea
 // Unbans an address. Returns false if the address was not in the ban database.
 bool server_unban(struct server_node* server, const char* ip_addr);
 
-// Disconnect a client that is flagged for deletion.
-void server_free_flagged_client(struct server_node* server, struct client_node* client);
-
-// Disconnect any clients that are flagged for deletion.
-void server_free_flagged_clients(struct server_node* server);
-
 // Disconnect all connected clients from a server node's clients list. This will free
 // all client nodes from memory. This should only be called when the Bulb protocol is
 // being terminated as it frees the server node from memory.
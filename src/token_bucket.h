@@ -0,0 +1,87 @@
+// floason (C) 2026
+// Licensed under the MIT License.
+
+// Token buckets admit bursts of up to a fixed number of events, after which events are
+// admitted at a steady rate. Tokens are counted in thousandths, and any refill too
+// small to make up a whole thousandth is carried over to the next refill, so that
+// slow rates still refill smoothly and at their full rate.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "util.h"
+
+#define TOKEN_BUCKET_SCALE  1000
+
+struct token_bucket
+{
+    int64_t tokens;         // Thousandths of a token.
+    int64_t last_refill_ms;
+    int64_t remainder;      // Refill carried over, in thousandths of a token times period_ms.
+};
+
+// Get the current time of the monotonic clock used by token buckets, in milliseconds.
+static inline int64_t token_bucket_now()
+{
+    struct timespec now;
+    timespec_ns_get(&now);
+    return timespec_to_ms(&now);
+}
+
+// Fill a token bucket to its capacity of burst tokens.
+static inline void token_bucket_init(struct token_bucket* bucket, unsigned burst, int64_t now_ms)
+{
+    bucket->tokens = (int64_t)burst * TOKEN_BUCKET_SCALE;
+    bucket->last_refill_ms = now_ms;
+    bucket->remainder = 0;
+}
+
+// Refill a token bucket by rate tokens for every period_ms milliseconds elapsed, up
+// to its capacity of burst tokens.
+static inline void token_bucket_refill(struct token_bucket* bucket, unsigned rate, unsigned period_ms,
+                                       unsigned burst, int64_t now_ms)
+{
+    int64_t elapsed = now_ms - bucket->last_refill_ms;
+    if (elapsed <= 0)
+        return;
+    bucket->last_refill_ms = now_ms;
+
+    // Refills are made in whole thousandths of a token, and whatever is left over is
+    // kept for the next refill rather than lost, however often the bucket is refilled.
+    int64_t period = MAX(period_ms, 1);
+    int64_t progress = elapsed * rate * TOKEN_BUCKET_SCALE + bucket->remainder;
+    int64_t capacity = (int64_t)burst * TOKEN_BUCKET_SCALE;
+    bucket->tokens += progress / period;
+    bucket->remainder = progress % period;
+    if (bucket->tokens >= capacity)
+    {
+        bucket->tokens = capacity;
+        bucket->remainder = 0;
+    }
+}
+
+// Check if a token bucket holds at least cost tokens.
+static inline bool token_bucket_available(const struct token_bucket* bucket, unsigned cost)
+{
+    return bucket->tokens >= (int64_t)cost * TOKEN_BUCKET_SCALE;
+}
+
+// Take cost tokens from a token bucket. Returns false, taking nothing, if the
+// bucket holds too few tokens.
+static inline bool token_bucket_take(struct token_bucket* bucket, unsigned cost)
+{
+    int64_t scaled_cost = (int64_t)cost * TOKEN_BUCKET_SCALE;
+    if (bucket->tokens < scaled_cost)
+        return false;
+    bucket->tokens -= scaled_cost;
+    return true;
+}
+
+// Check if a token bucket has been refilled to its capacity of burst tokens.
+static inline bool token_bucket_full(const struct token_bucket* bucket, unsigned burst)
+{
+    return bucket->tokens >= (int64_t)burst * TOKEN_BUCKET_SCALE;
+}
@@ -2,160 +2,813 @@
 // Licensed under the MIT License.
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "trie.h"
 #include "util.h"
 
-// Internal function for searching for a trie node.
-static struct trie* _trie_find(struct trie* trie, const char* key)
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#   define TRIE_SSE2
+#   include <emmintrin.h>
+#   if defined _MSC_VER
+#       include <intrin.h>
+#   endif
+#endif
+
+// Only the first TRIE_MAX_PREFIX bytes of a compressed path are stored within its
+// node. Any remaining bytes are verified against a leaf's key instead.
+#define TRIE_MAX_PREFIX         10
+
+// Leaves are distinguished from inner nodes by tagging the lowest bit of their
+// pointer.
+#define TRIE_IS_LEAF(NODE)      (((uintptr_t)(NODE) & 1) != 0)
+#define TRIE_LEAF(NODE)         ((struct trie_leaf*)((uintptr_t)(NODE) & ~(uintptr_t)1))
+#define TRIE_TAG_LEAF(LEAF)     ((struct trie_node*)((uintptr_t)(LEAF) | 1))
+
+enum trie_node_type
 {
-    ASSERT(trie, return NULL);
+    TRIE_NODE4,
+    TRIE_NODE16,
+    TRIE_NODE48,
+    TRIE_NODE256
+};
+
+struct trie_node
+{
+    uint8_t type;
+    uint16_t count;
+    uint32_t prefix_len;
+    unsigned char prefix[TRIE_MAX_PREFIX];
+};
+
+// Keys and children are kept sorted by key.
+struct trie_node4
+{
+    struct trie_node base;
+    unsigned char keys[4];
+    struct trie_node* children[4];
+};
+
+// Keys and children are kept sorted by key.
+struct trie_node16
+{
+    struct trie_node base;
+    unsigned char keys[16];
+    struct trie_node* children[16];
+};
+
+// child_index maps each key to its position in children + 1, or 0 if unused.
+struct trie_node48
+{
+    struct trie_node base;
+    unsigned char child_index[256];
+    struct trie_node* children[48];
+};
+
+struct trie_node256
+{
+    struct trie_node base;
+    struct trie_node* children[256];
+};
+
+// The stored key includes its NUL terminator, so that no key is a prefix of
+// another.
+struct trie_leaf
+{
+    void* value;
+    bool value_copied;
+    size_t key_len;
+    char key[];
+};
+
+// Get the index of the lowest set bit of a non-zero mask.
+static inline unsigned _trie_ctz(unsigned mask)
+{
+#if defined _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+// Allocate an empty inner node.
+static struct trie_node* _trie_node_new(enum trie_node_type type)
+{
+    static const size_t sizes[] = {
+        sizeof(struct trie_node4),
+        sizeof(struct trie_node16),
+        sizeof(struct trie_node48),
+        sizeof(struct trie_node256)
+    };
+    struct trie_node* node = (struct trie_node*)quick_malloc(sizes[type], BULB_ALLOC_TRIE);
+    node->type = type;
+    return node;
+}
+
+// Replace an inner node with a new node of a different size, keeping its prefix.
+static struct trie_node* _trie_node_resize(struct trie_node* node, enum trie_node_type type)
+{
+    struct trie_node* new_node = _trie_node_new(type);
+    new_node->count = node->count;
+    new_node->prefix_len = node->prefix_len;
+    memcpy(new_node->prefix, node->prefix, TRIE_MAX_PREFIX);
+    return new_node;
+}
+
+// Allocate a new leaf for a key of key_len bytes, including its NUL terminator.
+static struct trie_leaf* _trie_leaf_new(const char* key, size_t key_len, void* value)
+{
+    struct trie_leaf* leaf = (struct trie_leaf*)quick_malloc(sizeof(struct trie_leaf) + key_len,
+        BULB_ALLOC_TRIE);
+    leaf->value = value;
+    leaf->key_len = key_len;
+    memcpy(leaf->key, key, key_len);
+    return leaf;
+}
+
+// De-allocate a leaf and its value, if the value is owned by the trie.
+static void _trie_leaf_free(struct trie_leaf* leaf)
+{
+    if (leaf->value_copied)
+        quick_free(leaf->value);
+    quick_free(leaf);
+}
+
+// Check whether a leaf is keyed on the given key.
+static inline bool _trie_leaf_matches(struct trie_leaf* leaf, const char* key, size_t key_len)
+{
+    return leaf->key_len == key_len && memcmp(leaf->key, key, key_len) == 0;
+}
 
-    int len = strlen(key);
-    if (len == 0)
+// Find the slot holding the child of an inner node for a given key byte. Returns
+// NULL if there is no such child.
+static struct trie_node** _trie_find_child(struct trie_node* node, unsigned char c)
+{
+    switch (node->type)
+    {
+    case TRIE_NODE4:
+    {
+        struct trie_node4* n = (struct trie_node4*)node;
+        for (unsigned i = 0; i < node->count; i++)
+            if (n->keys[i] == c)
+                return &n->children[i];
+        return NULL;
+    }
+
+    case TRIE_NODE16:
+    {
+        struct trie_node16* n = (struct trie_node16*)node;
+#ifdef TRIE_SSE2
+        // Compare every key at once, masking off any unused keys.
+        __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)c), _mm_loadu_si128((const __m128i*)n->keys));
+        unsigned mask = (unsigned)_mm_movemask_epi8(cmp) & ((1u << node->count) - 1);
+        return (mask != 0) ? &n->children[_trie_ctz(mask)] : NULL;
+#else
+        for (unsigned i = 0; i < node->count; i++)
+            if (n->keys[i] == c)
+                return &n->children[i];
         return NULL;
+#endif
+    }
+
+    case TRIE_NODE48:
+    {
+        struct trie_node48* n = (struct trie_node48*)node;
+        unsigned index = n->child_index[c];
+        return (index != 0) ? &n->children[index - 1] : NULL;
+    }
+
+    case TRIE_NODE256:
+    {
+        struct trie_node256* n = (struct trie_node256*)node;
+        return (n->children[c] != NULL) ? &n->children[c] : NULL;
+    }
+    }
+    return NULL;
+}
 
-    struct trie* child = trie->children;
-    for (int i = 0; i < len; i++)
+// Get the child of an inner node at or after a given position, in key order. The
+// position is advanced past the returned child. Returns NULL if there are no
+// children remaining.
+static struct trie_node* _trie_next_child(struct trie_node* node, unsigned* position)
+{
+    switch (node->type)
     {
-        while (child)
+    case TRIE_NODE4:
+        return (*position < node->count) ? ((struct trie_node4*)node)->children[(*position)++] : NULL;
+
+    case TRIE_NODE16:
+        return (*position < node->count) ? ((struct trie_node16*)node)->children[(*position)++] : NULL;
+
+    case TRIE_NODE48:
+    {
+        struct trie_node48* n = (struct trie_node48*)node;
+        for (; *position < 256; (*position)++)
+            if (n->child_index[*position] != 0)
+                return n->children[n->child_index[(*position)++] - 1];
+        return NULL;
+    }
+
+    case TRIE_NODE256:
+    {
+        struct trie_node256* n = (struct trie_node256*)node;
+        for (; *position < 256; (*position)++)
+            if (n->children[*position] != NULL)
+                return n->children[(*position)++];
+        return NULL;
+    }
+    }
+    return NULL;
+}
+
+// Get the leaf with the smallest key below a node.
+static struct trie_leaf* _trie_minimum(struct trie_node* node)
+{
+    while (!TRIE_IS_LEAF(node))
+    {
+        unsigned position = 0;
+        node = _trie_next_child(node, &position);
+    }
+    return TRIE_LEAF(node);
+}
+
+// Count how many bytes of a node's stored prefix match the key at the given depth.
+static size_t _trie_check_prefix(struct trie_node* node, const char* key, size_t key_len, size_t depth)
+{
+    size_t max = MIN(MIN(node->prefix_len, TRIE_MAX_PREFIX), key_len - depth);
+    size_t i = 0;
+    while (i < max && node->prefix[i] == (unsigned char)key[depth + i])
+        i++;
+    return i;
+}
+
+// Count how many bytes of a node's full prefix match the key at the given depth,
+// resolving any bytes that are not stored in the node through its minimum leaf.
+static size_t _trie_prefix_mismatch(struct trie_node* node, const char* key, size_t key_len, size_t depth)
+{
+    size_t i = _trie_check_prefix(node, key, key_len, depth);
+    if (i < TRIE_MAX_PREFIX || node->prefix_len <= TRIE_MAX_PREFIX)
+        return i;
+
+    struct trie_leaf* leaf = _trie_minimum(node);
+    size_t max = MIN(MIN(leaf->key_len, key_len) - depth, node->prefix_len);
+    while (i < max && leaf->key[depth + i] == key[depth + i])
+        i++;
+    return i;
+}
+
+// Add a child to an inner node, growing the node if it is full. ref is the slot
+// that holds the inner node.
+static void _trie_add_child(struct trie_node** ref, unsigned char c, struct trie_node* child)
+{
+    struct trie_node* node = *ref;
+    switch (node->type)
+    {
+    case TRIE_NODE4:
+    {
+        struct trie_node4* n = (struct trie_node4*)node;
+        if (node->count < 4)
         {
-            if (child->prefix == key[i])
+            unsigned i = 0;
+            while (i < node->count && n->keys[i] < c)
+                i++;
+            memmove(&n->keys[i + 1], &n->keys[i], node->count - i);
+            memmove(&n->children[i + 1], &n->children[i], sizeof(struct trie_node*) * (node->count - i));
+            n->keys[i] = c;
+            n->children[i] = child;
+            node->count++;
+            return;
+        }
+
+        struct trie_node16* new_node = (struct trie_node16*)_trie_node_resize(node, TRIE_NODE16);
+        memcpy(new_node->keys, n->keys, 4);
+        memcpy(new_node->children, n->children, sizeof(n->children));
+        *ref = (struct trie_node*)new_node;
+        quick_free(node);
+        _trie_add_child(ref, c, child);
+        return;
+    }
+
+    case TRIE_NODE16:
+    {
+        struct trie_node16* n = (struct trie_node16*)node;
+        if (node->count < 16)
+        {
+            unsigned i = 0;
+            while (i < node->count && n->keys[i] < c)
+                i++;
+            memmove(&n->keys[i + 1], &n->keys[i], node->count - i);
+            memmove(&n->children[i + 1], &n->children[i], sizeof(struct trie_node*) * (node->count - i));
+            n->keys[i] = c;
+            n->children[i] = child;
+            node->count++;
+            return;
+        }
+
+        struct trie_node48* new_node = (struct trie_node48*)_trie_node_resize(node, TRIE_NODE48);
+        for (unsigned i = 0; i < 16; i++)
+        {
+            new_node->child_index[n->keys[i]] = i + 1;
+            new_node->children[i] = n->children[i];
+        }
+        *ref = (struct trie_node*)new_node;
+        quick_free(node);
+        _trie_add_child(ref, c, child);
+        return;
+    }
+
+    case TRIE_NODE48:
+    {
+        struct trie_node48* n = (struct trie_node48*)node;
+        if (node->count < 48)
+        {
+            unsigned i = 0;
+            while (n->children[i] != NULL)
+                i++;
+            n->children[i] = child;
+            n->child_index[c] = i + 1;
+            node->count++;
+            return;
+        }
+
+        struct trie_node256* new_node = (struct trie_node256*)_trie_node_resize(node, TRIE_NODE256);
+        for (unsigned i = 0; i < 256; i++)
+            if (n->child_index[i] != 0)
+                new_node->children[i] = n->children[n->child_index[i] - 1];
+        *ref = (struct trie_node*)new_node;
+        quick_free(node);
+        _trie_add_child(ref, c, child);
+        return;
+    }
+
+    case TRIE_NODE256:
+    {
+        ((struct trie_node256*)node)->children[c] = child;
+        node->count++;
+        return;
+    }
+    }
+}
+
+// Remove a child from an inner node, shrinking or collapsing the node if it is
+// sparse enough. ref is the slot that holds the inner node, and slot is the slot
+// holding the child.
+static void _trie_remove_child(struct trie_node** ref, unsigned char c, struct trie_node** slot)
+{
+    struct trie_node* node = *ref;
+    switch (node->type)
+    {
+    case TRIE_NODE4:
+    {
+        struct trie_node4* n = (struct trie_node4*)node;
+        unsigned i = (unsigned)(slot - n->children);
+        memmove(&n->keys[i], &n->keys[i + 1], node->count - i - 1);
+        memmove(&n->children[i], &n->children[i + 1], sizeof(struct trie_node*) * (node->count - i - 1));
+        node->count--;
+        if (node->count > 1)
+            return;
+
+        // Collapse this node into its only remaining child, merging this node's
+        // prefix and the child's key byte into the child's prefix.
+        struct trie_node* child = n->children[0];
+        if (!TRIE_IS_LEAF(child))
+        {
+            size_t prefix_len = node->prefix_len;
+            if (prefix_len < TRIE_MAX_PREFIX)
+                node->prefix[prefix_len++] = n->keys[0];
+            if (prefix_len < TRIE_MAX_PREFIX)
             {
-                if (i + 1 == len)
-                    return child;
-                else
-                {
-                    child = child->children;
-                    break;
-                }
+                size_t sub_len = MIN(child->prefix_len, TRIE_MAX_PREFIX - prefix_len);
+                memcpy(&node->prefix[prefix_len], child->prefix, sub_len);
+                prefix_len += sub_len;
             }
-            else
-                child = child->next;
+            memcpy(child->prefix, node->prefix, MIN(prefix_len, TRIE_MAX_PREFIX));
+            child->prefix_len += node->prefix_len + 1;
         }
+        *ref = child;
+        quick_free(node);
+        return;
     }
 
-    return (child && child->value != NULL) ? child : NULL;
+    case TRIE_NODE16:
+    {
+        struct trie_node16* n = (struct trie_node16*)node;
+        unsigned i = (unsigned)(slot - n->children);
+        memmove(&n->keys[i], &n->keys[i + 1], node->count - i - 1);
+        memmove(&n->children[i], &n->children[i + 1], sizeof(struct trie_node*) * (node->count - i - 1));
+        node->count--;
+        if (node->count > 3)
+            return;
+
+        struct trie_node4* new_node = (struct trie_node4*)_trie_node_resize(node, TRIE_NODE4);
+        memcpy(new_node->keys, n->keys, node->count);
+        memcpy(new_node->children, n->children, sizeof(struct trie_node*) * node->count);
+        *ref = (struct trie_node*)new_node;
+        quick_free(node);
+        return;
+    }
+
+    case TRIE_NODE48:
+    {
+        struct trie_node48* n = (struct trie_node48*)node;
+        n->children[n->child_index[c] - 1] = NULL;
+        n->child_index[c] = 0;
+        node->count--;
+        if (node->count > 12)
+            return;
+
+        struct trie_node16* new_node = (struct trie_node16*)_trie_node_resize(node, TRIE_NODE16);
+        unsigned count = 0;
+        for (unsigned i = 0; i < 256; i++)
+        {
+            if (n->child_index[i] == 0)
+                continue;
+            new_node->keys[count] = (unsigned char)i;
+            new_node->children[count++] = n->children[n->child_index[i] - 1];
+        }
+        *ref = (struct trie_node*)new_node;
+        quick_free(node);
+        return;
+    }
+
+    case TRIE_NODE256:
+    {
+        struct trie_node256* n = (struct trie_node256*)node;
+        n->children[c] = NULL;
+        node->count--;
+        if (node->count > 37)
+            return;
+
+        struct trie_node48* new_node = (struct trie_node48*)_trie_node_resize(node, TRIE_NODE48);
+        unsigned count = 0;
+        for (unsigned i = 0; i < 256; i++)
+        {
+            if (n->children[i] == NULL)
+                continue;
+            new_node->child_index[i] = count + 1;
+            new_node->children[count++] = n->children[i];
+        }
+        *ref = (struct trie_node*)new_node;
+        quick_free(node);
+        return;
+    }
+    }
+}
+
+// Internal function for searching for a trie leaf.
+static struct trie_leaf* _trie_find(struct trie* trie, const char* key)
+{
+    ASSERT(trie, return NULL);
+
+    size_t key_len = strlen(key) + 1;
+    if (key_len == 1)
+        return NULL;
+
+    struct trie_node* node = trie->root;
+    size_t depth = 0;
+    while (node != NULL)
+    {
+        if (TRIE_IS_LEAF(node))
+        {
+            struct trie_leaf* leaf = TRIE_LEAF(node);
+            return _trie_leaf_matches(leaf, key, key_len) ? leaf : NULL;
+        }
+
+        // The stored prefix is compared optimistically. Any bytes beyond it are
+        // verified against the leaf's key.
+        if (node->prefix_len > 0)
+        {
+            if (_trie_check_prefix(node, key, key_len, depth) != MIN(node->prefix_len, TRIE_MAX_PREFIX))
+                return NULL;
+            depth += node->prefix_len;
+        }
+        if (depth >= key_len)
+            return NULL;
+
+        struct trie_node** child = _trie_find_child(node, (unsigned char)key[depth++]);
+        node = (child != NULL) ? *child : NULL;
+    }
+    return NULL;
 }
 
 // Create a new trie.
 struct trie* trie_new()
 {
-    return (struct trie*)quick_malloc(sizeof(struct trie));
+    return (struct trie*)quick_malloc(sizeof(struct trie), BULB_ALLOC_TRIE);
 }
 
-// Add a new entry to the trie. Returns NULL if the key already exists, or on 
-// failure.
-struct trie* trie_add(struct trie* trie, const char* key, void* value)
+// Internal function for adding a new leaf to the trie.
+static struct trie_leaf* _trie_add(struct trie* trie, const char* key, void* value)
 {
     ASSERT(trie, return NULL);
+    ASSERT(value, return NULL);
 
-    int len = strlen(key);
-    ASSERT(len > 0, return NULL);
+    size_t key_len = strlen(key) + 1;
+    ASSERT(key_len > 1, return NULL);
 
-    struct trie* parent = trie;
-    struct trie* child = parent->children;
-    for (int i = 0; i < len; i++)
+    struct trie_node** ref = &trie->root;
+    size_t depth = 0;
+    for (;;)
     {
-        if (child != NULL)
+        struct trie_node* node = *ref;
+        if (node == NULL)
+        {
+            struct trie_leaf* leaf = _trie_leaf_new(key, key_len, value);
+            *ref = TRIE_TAG_LEAF(leaf);
+            return leaf;
+        }
+
+        // Split an existing leaf into a new inner node holding both leaves, whose
+        // prefix is the remainder of the keys that both leaves share.
+        if (TRIE_IS_LEAF(node))
         {
-            for (;;)
+            struct trie_leaf* other = TRIE_LEAF(node);
+            if (_trie_leaf_matches(other, key, key_len))
+                return NULL;
+
+            size_t common = 0;
+            while (other->key[depth + common] == key[depth + common])
+                common++;
+
+            struct trie_leaf* leaf = _trie_leaf_new(key, key_len, value);
+            struct trie_node* new_node = _trie_node_new(TRIE_NODE4);
+            new_node->prefix_len = (uint32_t)common;
+            memcpy(new_node->prefix, &key[depth], MIN(common, TRIE_MAX_PREFIX));
+            *ref = new_node;
+            _trie_add_child(ref, (unsigned char)other->key[depth + common], node);
+            _trie_add_child(ref, (unsigned char)key[depth + common], TRIE_TAG_LEAF(leaf));
+            return leaf;
+        }
+
+        // Split the prefix of an inner node if the key diverges from it.
+        if (node->prefix_len > 0)
+        {
+            size_t common = _trie_prefix_mismatch(node, key, key_len, depth);
+            if (common < node->prefix_len)
             {
-                if (child->prefix == key[i])
-                    goto next_index;
-                else if (child->next != NULL)
-                    child = child->next;
+                struct trie_leaf* leaf = _trie_leaf_new(key, key_len, value);
+                struct trie_node* new_node = _trie_node_new(TRIE_NODE4);
+                new_node->prefix_len = (uint32_t)common;
+                memcpy(new_node->prefix, node->prefix, MIN(common, TRIE_MAX_PREFIX));
+                *ref = new_node;
+
+                // The old node keeps whatever remains of its prefix after the byte
+                // it is now keyed on in the new node.
+                unsigned char c;
+                if (node->prefix_len <= TRIE_MAX_PREFIX)
+                {
+                    c = node->prefix[common];
+                    node->prefix_len -= (uint32_t)common + 1;
+                    memmove(node->prefix, &node->prefix[common + 1], node->prefix_len);
+                }
                 else
-                    break;
+                {
+                    struct trie_leaf* minimum = _trie_minimum(node);
+                    c = (unsigned char)minimum->key[depth + common];
+                    node->prefix_len -= (uint32_t)common + 1;
+                    memcpy(node->prefix, &minimum->key[depth + common + 1],
+                        MIN(node->prefix_len, TRIE_MAX_PREFIX));
+                }
+                _trie_add_child(ref, c, node);
+                _trie_add_child(ref, (unsigned char)key[depth + common], TRIE_TAG_LEAF(leaf));
+                return leaf;
             }
-            child->next = trie_new();
-            child->next->prev = child;
-            child = child->next;
+            depth += node->prefix_len;
         }
-        else
-            child = parent->children = trie_new();
-        child->prefix = key[i];
-        child->parent = parent;
 
-next_index:
-        parent = child;
-        child = child->children;
+        struct trie_node** child = _trie_find_child(node, (unsigned char)key[depth]);
+        if (child == NULL)
+        {
+            struct trie_leaf* leaf = _trie_leaf_new(key, key_len, value);
+            _trie_add_child(ref, (unsigned char)key[depth], TRIE_TAG_LEAF(leaf));
+            return leaf;
+        }
+        ref = child;
+        depth++;
     }
+}
 
-finish:
-    if (parent->value != NULL)
+// Add a new entry to the trie. value must not be NULL. Returns NULL if the key
+// already exists, or on failure.
+struct trie* trie_add(struct trie* trie, const char* key, void* value)
+{
+    if (_trie_add(trie, key, value) == NULL)
         return NULL;
-    parent->value = value;
-    return parent;
+    trie->count++;
+    return trie;
 }
 
-// Add a new entry to the trie by copying its value instead of referencing it. 
+// Add a new entry to the trie by copying its value instead of referencing it.
 // Returns NULL if the key already exists, or on failure.
 struct trie* trie_add_copy(struct trie* trie, const char* key, void* value, size_t size)
 {
     ASSERT(trie, return NULL);
     ASSERT(strlen(key) > 0, return NULL);
 
-    void* new_value = quick_malloc(size);
+    void* new_value = quick_malloc(size, BULB_ALLOC_TRIE);
     memcpy(new_value, value, size);
 
-    struct trie* node = trie_add(trie, key, new_value);
-    if (node == NULL)
+    struct trie_leaf* leaf = _trie_add(trie, key, new_value);
+    if (leaf == NULL)
+    {
+        quick_free(new_value);
         return NULL;
+    }
 
-    node->value_copied = true;
-    return node;
+    leaf->value_copied = true;
+    trie->count++;
+    return trie;
 }
 
 // Search for an entry in the trie. Returns NULL if the key is not found,
 // or on failure.
 void* trie_find(struct trie* trie, const char* key)
 {
-    struct trie* node = _trie_find(trie, key);
-    return node ? node->value : NULL;
+    struct trie_leaf* leaf = _trie_find(trie, key);
+    return leaf ? leaf->value : NULL;
 }
 
 // Delete an entry in the trie. Returns false if the key is not found,
 // or on failure.
 bool trie_delete(struct trie* trie, const char* key)
 {
-    struct trie* node = _trie_find(trie, key);
-    if (node == NULL)
-        return false;
-
-    if (node->value_copied)
-        free(node->value);
-    node->value = NULL;
-    
-    // Iteratively walk through the node's chain of parents to cleanup any
-    // unused nodes.
-    while (node != NULL && node->parent != NULL && node->value == NULL && node->children == NULL)
-    {
-        struct trie* parent = node->parent;
-
-        if (node->next != NULL)
-            node->next->prev = node->prev;
-        
-        if (node->prev != NULL)
-            node->prev->next = node->next;
-        else
-            parent->children = node->next;
+    ASSERT(trie, return false);
+
+    size_t key_len = strlen(key) + 1;
+    struct trie_node** ref = &trie->root;
+    size_t depth = 0;
+    while (*ref != NULL)
+    {
+        struct trie_node* node = *ref;
+
+        // A leaf can only be reached directly when it is the trie's only entry.
+        if (TRIE_IS_LEAF(node))
+        {
+            struct trie_leaf* leaf = TRIE_LEAF(node);
+            if (!_trie_leaf_matches(leaf, key, key_len))
+                return false;
+            *ref = NULL;
+            _trie_leaf_free(leaf);
+            trie->count--;
+            return true;
+        }
+
+        if (node->prefix_len > 0)
+        {
+            if (_trie_check_prefix(node, key, key_len, depth) != MIN(node->prefix_len, TRIE_MAX_PREFIX))
+                return false;
+            depth += node->prefix_len;
+        }
+        if (depth >= key_len)
+            return false;
+
+        unsigned char c = (unsigned char)key[depth];
+        struct trie_node** child = _trie_find_child(node, c);
+        if (child == NULL)
+            return false;
+
+        // Leaves are removed from their parent, so that the parent can be shrunk.
+        if (TRIE_IS_LEAF(*child))
+        {
+            struct trie_leaf* leaf = TRIE_LEAF(*child);
+            if (!_trie_leaf_matches(leaf, key, key_len))
+                return false;
+            _trie_remove_child(ref, c, child);
+            _trie_leaf_free(leaf);
+            trie->count--;
+            return true;
+        }
 
-        free(node);
-        node = parent;
+        ref = child;
+        depth++;
     }
-    
-    return true;
+    return false;
+}
+
+// Push a node onto an iterator's stack, spilling the stack onto the heap if needed.
+static void _trie_iter_push(struct trie_iter* iter, struct trie_node* node)
+{
+    if (iter->depth == iter->capacity)
+    {
+        struct trie_iter_frame* stack = (struct trie_iter_frame*)quick_malloc(
+            sizeof(struct trie_iter_frame) * iter->capacity * 2, BULB_ALLOC_TRIE);
+        memcpy(stack, iter->stack, sizeof(struct trie_iter_frame) * iter->depth);
+        if (iter->stack != iter->inline_stack)
+            quick_free(iter->stack);
+        iter->stack = stack;
+        iter->capacity *= 2;
+    }
+    iter->stack[iter->depth++] = (struct trie_iter_frame){ node, 0 };
 }
 
 // Delete a trie.
 void trie_free(struct trie* trie)
 {
-    if (trie->next)
-        trie_free(trie->next);
-    if (trie->children)
-        trie_free(trie->children);
-    if (trie->value_copied)
-        free(trie->value);
-    free(trie);
-}
\ No newline at end of file
+    ASSERT(trie, return);
+
+    // Walk the trie iteratively, releasing each inner node once all of its children
+    // have been released.
+    struct trie_iter iter;
+    iter.stack = iter.inline_stack;
+    iter.depth = 0;
+    iter.capacity = TRIE_ITER_INLINE_DEPTH;
+    if (trie->root != NULL)
+        _trie_iter_push(&iter, trie->root);
+    while (iter.depth > 0)
+    {
+        struct trie_iter_frame* frame = &iter.stack[iter.depth - 1];
+        if (TRIE_IS_LEAF(frame->node))
+        {
+            _trie_leaf_free(TRIE_LEAF(frame->node));
+            iter.depth--;
+            continue;
+        }
+
+        struct trie_node* child = _trie_next_child(frame->node, &frame->position);
+        if (child != NULL)
+            _trie_iter_push(&iter, child);
+        else
+        {
+            quick_free(frame->node);
+            iter.depth--;
+        }
+    }
+
+    trie_iter_end(&iter);
+    quick_free(trie);
+}
+
+// Begin iterating through every entry in a trie whose key begins with prefix. The
+// trie must not be modified until the iterator is released with trie_iter_end().
+void trie_iter_init(struct trie_iter* iter, struct trie* trie, const char* prefix)
+{
+    iter->stack = iter->inline_stack;
+    iter->depth = 0;
+    iter->capacity = TRIE_ITER_INLINE_DEPTH;
+    ASSERT(trie, return);
+
+    // Find the highest node whose every key could begin with the prefix.
+    size_t prefix_len = strlen(prefix);
+    struct trie_node* node = trie->root;
+    size_t depth = 0;
+    while (node != NULL && !TRIE_IS_LEAF(node) && depth < prefix_len)
+    {
+        if (node->prefix_len > 0)
+        {
+            size_t max = MIN(node->prefix_len, TRIE_MAX_PREFIX);
+            if (_trie_check_prefix(node, prefix, prefix_len, depth) != MIN(max, prefix_len - depth))
+                return;
+            depth += node->prefix_len;
+            if (depth >= prefix_len)
+                break;
+        }
+
+        struct trie_node** child = _trie_find_child(node, (unsigned char)prefix[depth++]);
+        node = (child != NULL) ? *child : NULL;
+    }
+    if (node == NULL)
+        return;
+
+    // Each key below the node shares the same first depth bytes, so the prefix only
+    // needs to be verified against one of them.
+    if (strncmp(_trie_minimum(node)->key, prefix, prefix_len) != 0)
+        return;
+    _trie_iter_push(iter, node);
+}
+
+// Get the next value of an iteration, and optionally its key. Returns NULL once
+// the iteration is finished.
+void* trie_iter_next(struct trie_iter* iter, const char** key)
+{
+    while (iter->depth > 0)
+    {
+        struct trie_iter_frame* frame = &iter->stack[iter->depth - 1];
+        if (TRIE_IS_LEAF(frame->node))
+        {
+            struct trie_leaf* leaf = TRIE_LEAF(frame->node);
+            iter->depth--;
+            if (key != NULL)
+                *key = leaf->key;
+            return leaf->value;
+        }
+
+        struct trie_node* child = _trie_next_child(frame->node, &frame->position);
+        if (child != NULL)
+            _trie_iter_push(iter, child);
+        else
+            iter->depth--;
+    }
+    return NULL;
+}
+
+// Release an iterator.
+void trie_iter_end(struct trie_iter* iter)
+{
+    if (iter->stack != iter->inline_stack)
+        quick_free(iter->stack);
+    iter->stack = iter->inline_stack;
+    iter->depth = 0;
+}
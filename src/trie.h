@@ -1,56 +1,70 @@
 // floason (C) 2026
 // Licensed under the MIT License.
 
+// Tries are implemented as adaptive radix trees keyed on NUL-terminated strings.
+// Each inner node switches between holding 4, 16, 48 or 256 children depending on
+// its fan-out, and any chain of single-child nodes is collapsed into a prefix that
+// is stored within its descendant. Values are iterated in byte-wise lexicographic
+// order of their keys.
+
 #pragma once
 
 #include <stdbool.h>
 #include <threads.h>
 #include <stddef.h>
 
-#define TRIE_DFS(ROOT, ID, SCOPE)                                               \
+// Iterate through every value in a trie. SCOPE may break out of the loop, but must not
+// return or goto out of it, as the iterator must be released once the iteration ends.
+#define TRIE_DFS(ROOT, ID, SCOPE) TRIE_PREFIX_DFS(ROOT, "", ID, SCOPE)
+
+// Iterate through every value in a trie whose key begins with PREFIX.
+#define TRIE_PREFIX_DFS(ROOT, PREFIX, ID, SCOPE)                                \
     {                                                                           \
-        struct trie* node##ID = ((struct trie*)ROOT)->children;                 \
-        while (node##ID != NULL)                                                \
+        struct trie_iter iter##ID;                                              \
+        trie_iter_init(&iter##ID, ROOT, PREFIX);                                \
+        for (;;)                                                                \
         {                                                                       \
-            if (node##ID->value != NULL)                                        \
-            {                                                                   \
-                void* ID = node##ID->value;                                     \
-                SCOPE;                                                          \
-            }                                                                   \
-                                                                                \
-            if (node##ID->children != NULL)                                     \
-                node##ID = node##ID->children;                                  \
-            else                                                                \
-            {                                                                   \
-                while (node##ID != NULL && node##ID->next == NULL)              \
-                    node##ID = node##ID->parent;                                \
-                if (node##ID != NULL)                                           \
-                    node##ID = node##ID->next;                                  \
-            }                                                                   \
+            void* ID = trie_iter_next(&iter##ID, NULL);                         \
+            if (ID == NULL)                                                     \
+                break;                                                          \
+            SCOPE;                                                              \
         }                                                                       \
+        trie_iter_end(&iter##ID);                                               \
     }
 
+// Number of nodes an iterator can hold before spilling its stack onto the heap.
+#define TRIE_ITER_INLINE_DEPTH  16
+
+struct trie_node;
+
 struct trie
 {
-    char prefix;
-    void* value;
-    bool value_copied;
-    struct trie* parent;
-    struct trie* children;
-
-    // Used for linking children together in a doubly-linked list.
-    struct trie* next;
-    struct trie* prev;
+    struct trie_node* root;
+    size_t count;
+};
+
+struct trie_iter_frame
+{
+    struct trie_node* node;
+    unsigned position;
+};
+
+struct trie_iter
+{
+    struct trie_iter_frame* stack;
+    unsigned depth;
+    unsigned capacity;
+    struct trie_iter_frame inline_stack[TRIE_ITER_INLINE_DEPTH];
 };
 
 // Create a new trie.
 struct trie* trie_new();
 
-// Add a new entry to the trie. Returns NULL if the key already exists, or on 
-// failure.
+// Add a new entry to the trie. value must not be NULL. Returns NULL if the key
+// already exists, or on failure.
 struct trie* trie_add(struct trie* trie, const char* key, void* value);
 
-// Add a new entry to the trie by copying its value instead of referencing it. 
+// Add a new entry to the trie by copying its value instead of referencing it.
 // Returns NULL if the key already exists, or on failure.
 struct trie* trie_add_copy(struct trie* trie, const char* key, void* value, size_t size);
 
@@ -63,4 +77,15 @@ void* trie_find(struct trie* trie, const char* key);
 bool trie_delete(struct trie* trie, const char* key);
 
 // Delete a trie.
-void trie_free(struct trie* trie);
\ No newline at end of file
+void trie_free(struct trie* trie);
+
+// Begin iterating through every entry in a trie whose key begins with prefix. The
+// trie must not be modified until the iterator is released with trie_iter_end().
+void trie_iter_init(struct trie_iter* iter, struct trie* trie, const char* prefix);
+
+// Get the next value of an iteration, and optionally its key. Returns NULL once
+// the iteration is finished.
+void* trie_iter_next(struct trie_iter* iter, const char** key);
+
+// Release an iterator.
+void trie_iter_end(struct trie_iter* iter);
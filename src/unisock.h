@@ -37,10 +37,13 @@
 // Define POSIX-specific macros and headers.
 #elif defined __UNIX__
 #   include <unistd.h>
+#   include <fcntl.h>
 #   include <sys/types.h>
 #   include <sys/socket.h>
 #   include <sys/time.h>
 #   include <arpa/inet.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
 #   include <netdb.h>
 
     // Define SOCKET as int since POSIX sockets are int descriptors.
@@ -80,6 +83,27 @@ static inline int set_socket_timeout(SOCKET sock, unsigned timeout, bool write)
         sizeof(optval));
 }
 
+// Put a raw socket into non-blocking mode. Returns 0 on success.
+static inline int set_socket_non_blocking(SOCKET sock)
+{
+#if defined WIN32
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode);
+#elif defined __UNIX__
+    return fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#else
+    ASSERT(false, return -1, "Operating system not supported!\n");
+#endif
+}
+
+// Disable Nagle's algorithm on a raw socket, so that small objects such as
+// acknowledgements are not held back waiting on outstanding data. Returns 0 on success.
+static inline int set_socket_no_delay(SOCKET sock)
+{
+    int optval = 1;
+    return setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&optval, sizeof(optval));
+}
+
 static inline int socket_errno()
 {
 #ifdef WIN32
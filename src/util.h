@@ -13,6 +13,8 @@
 #include <ctype.h>
 #include <time.h>
 
+#include "alloc.h"
+
 #if defined __unix__ || defined __APPLE__
 #   define __UNIX__
 #endif
@@ -177,17 +179,40 @@ static inline int str_isprint(const char* str)
     return true;
 }
 
-static inline void* quick_calloc(size_t count, size_t size)
+// Check whether a string matches a secret, such as a key. Every character of the secret
+// is compared, so that the secret cannot be guessed by timing how quickly a string is
+// rejected.
+static inline bool str_matches_secret(const char* secret, const char* str)
+{
+    unsigned char diff = 0;
+    size_t i = 0;
+    for (; secret[i] != '\0'; i++)
+        diff |= (unsigned char)(secret[i] ^ str[i]);
+    return diff == 0 && str[i] == '\0';
+}
+
+// Allocate zeroed memory attributed to the given subsystem. This never returns NULL, and
+// aborts if count * size overflows.
+static inline void* quick_calloc(size_t count, size_t size, enum bulb_alloc_tag tag)
 {
-    void* ptr = calloc(count, size);
+    if (size != 0 && count > SIZE_MAX / size)
+        abort();
+    void* ptr = alloc_tagged(count * size, tag);
     if (!ptr)
         abort();
+    memset(ptr, 0, count * size);
     return ptr;
 }
 
-static inline void* quick_malloc(size_t size)
+static inline void* quick_malloc(size_t size, enum bulb_alloc_tag tag)
+{
+    return quick_calloc(1, size, tag);
+}
+
+// Release memory returned by quick_calloc() or quick_malloc().
+static inline void quick_free(void* ptr)
 {
-    return quick_calloc(1, size);
+    alloc_free(ptr);
 }
 
 void sleeps(unsigned seconds);
@@ -219,4 +244,22 @@ static inline int64_t timespec_diff(struct timespec* lhs, struct timespec* rhs,
     return (s_diff * ten_exponents[pow]) + (ns_diff / ten_exponents[9 - pow]);
 }
 
+// Advance a timespec by a number of milliseconds.
+static inline void timespec_add_ms(struct timespec* timespec, int64_t ms)
+{
+    timespec->tv_sec += ms / MILLISECONDS;
+    timespec->tv_nsec += (ms % MILLISECONDS) * (NANOSECONDS / MILLISECONDS);
+    if (timespec->tv_nsec >= NANOSECONDS)
+    {
+        timespec->tv_sec++;
+        timespec->tv_nsec -= NANOSECONDS;
+    }
+}
+
+// Convert a timespec to a number of milliseconds.
+static inline int64_t timespec_to_ms(const struct timespec* timespec)
+{
+    return (int64_t)timespec->tv_sec * MILLISECONDS + timespec->tv_nsec / (NANOSECONDS / MILLISECONDS);
+}
+
 bool timespec_ns_get(struct timespec* timespec);
\ No newline at end of file